@@ -1,4 +1,8 @@
+// The bit operations live in lib/bits.c, so build with both files:
+//     gcc Task1.c lib/bits.c    (or ./build.sh)
 #include <stdio.h>
+#include <stdint.h>
+#include "lib/bits.h"
 
 void printBinaryPositive();
 void printBinaryNegative();
@@ -46,22 +50,10 @@ int main()
 
 void printBinary(int n)
 {
-    unsigned mask = 1U << (sizeof(n) * 8 - 1);
-    int started = 0;
+    char binary[BITS_BINARY_SIZE];
 
-    for (; mask; mask >>= 1)
-    {
-        int bit = (n & mask);
-
-        if (bit || started)
-        {
-            putchar(bit ? '1' : '0');
-            started = 1;
-        }
-    }
-
-    if (!started)
-        putchar('0');
+    bits_to_binary((uint32_t)n, binary);
+    fputs(binary, stdout);
 }
 
 void printBinaryPositive()
@@ -110,14 +102,7 @@ void countOnes()
         return;
     }
 
-    int count = 0;
-    unsigned mask = 1U << (sizeof(n) * 8 - 1);
-
-    for (; mask; mask >>= 1)
-    {
-        if (n & mask)
-            count++;
-    }
+    int count = (int)bits_popcount(&n, sizeof(n));
 
     printf("Binary: ");
     printBinary(n);
@@ -142,8 +127,9 @@ void replaceThirdByte()
     printf("Enter value for third byte (0–255): ");
     scanf("%hhu", &newByte);
 
-    unsigned int mask = 0xFF << (8 * 2);
-    n = (n & ~mask) | ((unsigned int)newByte << (8 * 2));
+    uint32_t value = (uint32_t)n;
+    bits_replace_byte(&value, 1, 2, newByte);
+    n = (int)value;
 
     printf("Result number: %d\n", n);
     printf("Binary: ");
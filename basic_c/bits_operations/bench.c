@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lib/bits.h"
+
+// GB/s of every bit-ops kernel, each on a buffer that fits in the cache
+// and on one that does not, next to the loops Task1.c used to run.
+// Popcount and the byte lanes count the bytes read, the binary strings
+// the text written.
+
+#define SMALL_BYTES (16 << 10)
+#define LARGE_BYTES (64 << 20)
+#define BINARY_VALUES (1 << 20)
+#define MIN_MS 250.0
+
+static const char *kernelNames[] = { "scalar", "popcnt", "avx2" };
+
+enum
+{
+    OP_POPCOUNT_LOOP,
+    OP_POPCOUNT,
+    OP_BINARY_LOOP,
+    OP_BINARY,
+    OP_BINARY32,
+    OP_REPLACE,
+    OP_EXTRACT
+};
+
+struct job
+{
+    int op;
+    const uint8_t *buf;
+    size_t len;
+    uint64_t count;
+    uint32_t *values;
+    uint8_t *bytes;
+    size_t n;
+    char *text;
+};
+
+static double NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// what Task1.c did per int: a mask walked over 32 bits
+static uint64_t PopcountLoop(const uint8_t *buf, size_t len)
+{
+    uint64_t count = 0;
+    for (size_t i = 0; i + 4 <= len; i += 4)
+    {
+        unsigned n;
+        memcpy(&n, buf + i, 4);
+        for (unsigned mask = 1U << 31; mask; mask >>= 1)
+        {
+            if (n & mask)
+                count++;
+        }
+    }
+    return count;
+}
+
+// Task1.c's printBinary() into a buffer: a digit per bit, no leading zeros
+static size_t BinaryLoop(unsigned n, char *out)
+{
+    size_t len = 0;
+    int started = 0;
+    for (unsigned mask = 1U << 31; mask; mask >>= 1)
+    {
+        int bit = (n & mask) != 0;
+        if (bit || started)
+        {
+            out[len++] = bit ? '1' : '0';
+            started = 1;
+        }
+    }
+    if (!started)
+        out[len++] = '0';
+    out[len] = '\0';
+    return len;
+}
+
+// bytes read or written by one run
+static double Run(struct job *job)
+{
+    size_t pos = 0;
+    switch (job->op)
+    {
+        case OP_POPCOUNT_LOOP:
+            job->count = PopcountLoop(job->buf, job->len);
+            return job->len;
+        case OP_POPCOUNT:
+            job->count = bits_popcount(job->buf, job->len);
+            return job->len;
+        case OP_BINARY_LOOP:
+            for (size_t i = 0; i < job->n; i++)
+                pos += BinaryLoop(job->values[i], job->text + pos) + 1;
+            return pos;
+        case OP_BINARY:
+            for (size_t i = 0; i < job->n; i++)
+                pos += bits_to_binary(job->values[i], job->text + pos) + 1;
+            return pos;
+        case OP_BINARY32:
+            for (size_t i = 0; i < job->n; i++)
+                bits_to_binary32(job->values[i], job->text + i * BITS_BINARY_SIZE);
+            return job->n * BITS_BINARY_SIZE;
+        case OP_REPLACE:
+            bits_replace_byte(job->values, job->n, 2, 0xAB);
+            return job->n * 4;
+        default:
+            bits_extract_byte(job->values, job->bytes, job->n, 2);
+            return job->n * 4;
+    }
+}
+
+// GB/s, repeating the job for at least MIN_MS
+static double Time(struct job *job)
+{
+    double bytes = 0;
+    double t0 = NowMs();
+    double ms;
+    do
+    {
+        bytes += Run(job);
+    } while ((ms = NowMs() - t0) < MIN_MS);
+    return bytes / ms / 1e6;
+}
+
+static void Print(const char *what, size_t bytes, const char *method, double gbs, const char *note)
+{
+    printf("%-10s %10zu %10.2f  %s%s\n", what, bytes, gbs, method, note);
+}
+
+int main(void)
+{
+    size_t sizes[] = { SMALL_BYTES, LARGE_BYTES };
+    uint8_t *buf = malloc(LARGE_BYTES);
+    uint8_t *bytes = malloc(LARGE_BYTES / 4);
+    uint8_t *expectBytes = malloc(LARGE_BYTES / 4);
+    uint32_t *values = malloc(LARGE_BYTES);
+    char *text = malloc((size_t)BINARY_VALUES * BITS_BINARY_SIZE);
+    char *expectText = malloc((size_t)BINARY_VALUES * BITS_BINARY_SIZE);
+    if (!buf || !bytes || !expectBytes || !values || !text || !expectText)
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    unsigned long long seed = 88172645463325252ull;
+    for (size_t i = 0; i < LARGE_BYTES; i += 8)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        memcpy(buf + i, &seed, 8);
+    }
+
+    printf("default kernel: %s\n\n", bits_kernel());
+    printf("what            bytes       GB/s  method\n");
+
+    int same = 1;
+    for (size_t s = 0; s < 2; s++)
+    {
+        struct job job = { .op = OP_POPCOUNT_LOOP, .buf = buf, .len = sizes[s] };
+        double gbs = Time(&job);
+        uint64_t expect = job.count;
+        Print("popcount", sizes[s], "Task1 loop", gbs, "");
+
+        job.op = OP_POPCOUNT;
+        for (size_t k = 0; k < sizeof(kernelNames) / sizeof(kernelNames[0]); k++)
+        {
+            if (!bits_use_kernel(kernelNames[k]))
+                continue;
+            gbs = Time(&job);
+            same = same && job.count == expect;
+            Print("popcount", sizes[s], kernelNames[k], gbs, job.count == expect ? "" : " (MISMATCH)");
+        }
+    }
+
+    // binary strings of a million values, NUL-separated
+    memcpy(values, buf, (size_t)BINARY_VALUES * 4);
+    struct job job = { .op = OP_BINARY_LOOP, .values = values, .n = BINARY_VALUES, .text = expectText };
+    double gbs = Time(&job);
+    size_t textBytes = (size_t)Run(&job);
+    Print("binary", textBytes, "Task1 loop", gbs, "");
+    job.op = OP_BINARY;
+    job.text = text;
+    gbs = Time(&job);
+    int ok = memcmp(text, expectText, textBytes) == 0;
+    same = same && ok;
+    Print("binary", textBytes, "lut", gbs, ok ? "" : " (MISMATCH)");
+    job.op = OP_BINARY32;
+    gbs = Time(&job);
+    Print("binary32", (size_t)BINARY_VALUES * BITS_BINARY_SIZE, "lut", gbs, "");
+
+    // byte lane 2 of every value; extract checked against scalar
+    const char *laneKernels[] = { "scalar", "avx2" };
+    for (int op = OP_REPLACE; op <= OP_EXTRACT; op++)
+    {
+        for (size_t s = 0; s < 2; s++)
+        {
+            for (size_t k = 0; k < 2; k++)
+            {
+                if (!bits_use_kernel(laneKernels[k]))
+                    continue;
+                memcpy(values, buf, sizes[s]);
+                struct job lanes = { .op = op, .values = values, .bytes = bytes, .n = sizes[s] / 4 };
+                gbs = Time(&lanes);
+
+                ok = 1;
+                if (op == OP_EXTRACT)
+                {
+                    if (k == 0)
+                        memcpy(expectBytes, bytes, lanes.n);
+                    ok = memcmp(bytes, expectBytes, lanes.n) == 0;
+                }
+                else
+                {
+                    for (size_t i = 0; i < lanes.n && ok; i++)
+                    {
+                        uint32_t was;
+                        memcpy(&was, buf + 4 * i, 4);
+                        ok = values[i] == ((was & 0xFF00FFFFu) | 0xAB0000u);
+                    }
+                }
+                same = same && ok;
+                Print(op == OP_REPLACE ? "replace" : "extract", sizes[s], laneKernels[k], gbs,
+                    ok ? "" : " (MISMATCH)");
+            }
+        }
+    }
+
+    printf("\nresults match: %s\n", same ? "yes" : "NO");
+    free(buf);
+    free(bytes);
+    free(expectBytes);
+    free(values);
+    free(text);
+    free(expectText);
+    return same ? 0 : 1;
+}
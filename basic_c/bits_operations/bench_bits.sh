@@ -0,0 +1,11 @@
+#!/bin/sh
+# Bit-ops kernels in GB/s: popcount (Task1's loop, scalar SWAR, POPCNT,
+# Harley-Seal AVX2), int to binary string (Task1's loop, lookup table) and
+# byte lane replace/extract (scalar, AVX2), on 16 KiB and 64 MiB.
+# usage: ./bench_bits.sh
+
+BIN=/tmp/bits_bench
+
+gcc -std=gnu11 -O2 -Wall -o "$BIN" bench.c lib/bits.c || exit 1
+
+"$BIN"
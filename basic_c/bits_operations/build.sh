@@ -0,0 +1,7 @@
+#!/bin/sh
+# Builds Task1 with the bit-ops library it uses from lib/.
+# usage: ./build.sh [output]
+
+OUT=${1:-task1}
+
+gcc -std=gnu11 -O2 -Wall -o "$OUT" Task1.c lib/bits.c || exit 1
@@ -0,0 +1,300 @@
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITS_X86 1
+#endif
+
+#include "bits.h"
+
+typedef uint64_t (*popcount_kernel)(const uint8_t *p, size_t len);
+typedef void (*replace_kernel)(uint32_t *v, size_t n, int lane, uint8_t value);
+typedef void (*extract_kernel)(const uint32_t *v, uint8_t *out, size_t n, int lane);
+
+struct kernels
+{
+    const char *name;
+    popcount_kernel popcount;
+    replace_kernel replace;
+    extract_kernel extract;
+};
+
+/* Scalar: SWAR, the bits of a word summed in pairs, nibbles, then bytes,
+ * and the bytes added up by one multiply */
+
+static inline uint64_t popcount64(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (x * 0x0101010101010101ull) >> 56;
+}
+
+static uint64_t popcount_scalar(const uint8_t *p, size_t len)
+{
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        count += popcount64(w);
+    }
+    if (i < len)
+    {
+        uint64_t w = 0;
+        memcpy(&w, p + i, len - i);
+        count += popcount64(w);
+    }
+    return count;
+}
+
+static void replace_scalar(uint32_t *v, size_t n, int lane, uint8_t value)
+{
+    uint32_t keep = ~(0xFFu << (8 * lane));
+    uint32_t put = (uint32_t)value << (8 * lane);
+    for (size_t i = 0; i < n; i++)
+        v[i] = (v[i] & keep) | put;
+}
+
+static void extract_scalar(const uint32_t *v, uint8_t *out, size_t n, int lane)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = (uint8_t)(v[i] >> (8 * lane));
+}
+
+#ifdef BITS_X86
+
+// four independent sums: on some CPUs POPCNT waits on its destination
+__attribute__((target("popcnt")))
+static uint64_t popcount_popcnt(const uint8_t *p, size_t len)
+{
+    uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        uint64_t w[4];
+        memcpy(w, p + i, 32);
+        c0 += _mm_popcnt_u64(w[0]);
+        c1 += _mm_popcnt_u64(w[1]);
+        c2 += _mm_popcnt_u64(w[2]);
+        c3 += _mm_popcnt_u64(w[3]);
+    }
+    return c0 + c1 + c2 + c3 + popcount_scalar(p + i, len - i);
+}
+
+/*
+ * Harley-Seal (Mula, Kurz, Lemire): carry-save adders fold sixteen
+ * vectors into ones, twos, fours, eights and one sixteens vector, so only
+ * one vector in sixteen goes through the (nibble lookup) popcount.
+ */
+
+// per 64-bit lane
+__attribute__((target("avx2")))
+static inline __m256i popcount256(__m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low));
+    __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+// a + b + c as *high * 2 + *low, bitwise
+__attribute__((target("avx2")))
+static inline void csa(__m256i *high, __m256i *low, __m256i a, __m256i b, __m256i c)
+{
+    __m256i u = _mm256_xor_si256(a, b);
+    *high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    *low = _mm256_xor_si256(u, c);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load256(const uint8_t *p, size_t k)
+{
+    return _mm256_loadu_si256((const __m256i *)(p + 32 * k));
+}
+
+__attribute__((target("avx2")))
+static uint64_t popcount_avx2(const uint8_t *p, size_t len)
+{
+    __m256i total = _mm256_setzero_si256();
+    __m256i ones = _mm256_setzero_si256();
+    __m256i twos = _mm256_setzero_si256();
+    __m256i fours = _mm256_setzero_si256();
+    __m256i eights = _mm256_setzero_si256();
+    __m256i sixteens, twosA, twosB, foursA, foursB, eightsA, eightsB;
+    size_t i = 0;
+
+    for (; i + 512 <= len; i += 512)
+    {
+        const uint8_t *q = p + i;
+        csa(&twosA, &ones, ones, load256(q, 0), load256(q, 1));
+        csa(&twosB, &ones, ones, load256(q, 2), load256(q, 3));
+        csa(&foursA, &twos, twos, twosA, twosB);
+        csa(&twosA, &ones, ones, load256(q, 4), load256(q, 5));
+        csa(&twosB, &ones, ones, load256(q, 6), load256(q, 7));
+        csa(&foursB, &twos, twos, twosA, twosB);
+        csa(&eightsA, &fours, fours, foursA, foursB);
+        csa(&twosA, &ones, ones, load256(q, 8), load256(q, 9));
+        csa(&twosB, &ones, ones, load256(q, 10), load256(q, 11));
+        csa(&foursA, &twos, twos, twosA, twosB);
+        csa(&twosA, &ones, ones, load256(q, 12), load256(q, 13));
+        csa(&twosB, &ones, ones, load256(q, 14), load256(q, 15));
+        csa(&foursB, &twos, twos, twosA, twosB);
+        csa(&eightsB, &fours, fours, foursA, foursB);
+        csa(&sixteens, &eights, eights, eightsA, eightsB);
+        total = _mm256_add_epi64(total, popcount256(sixteens));
+    }
+
+    total = _mm256_slli_epi64(total, 4);
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(eights), 3));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(fours), 2));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(twos), 1));
+    total = _mm256_add_epi64(total, popcount256(ones));
+    for (; i + 32 <= len; i += 32)
+        total = _mm256_add_epi64(total, popcount256(load256(p + i, 0)));
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcount_scalar(p + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static void replace_avx2(uint32_t *v, size_t n, int lane, uint8_t value)
+{
+    const __m256i keep = _mm256_set1_epi32((int)~(0xFFu << (8 * lane)));
+    const __m256i put = _mm256_set1_epi32((int)((uint32_t)value << (8 * lane)));
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            __m256i *at = (__m256i *)(v + i + 8 * k);
+            _mm256_storeu_si256(at, _mm256_or_si256(_mm256_and_si256(_mm256_loadu_si256(at), keep), put));
+        }
+    }
+    replace_scalar(v + i, n - i, lane, value);
+}
+
+// 32 values to 32 bytes: shift the lane down, then narrow with the packs,
+// which work per 128-bit half; the permute puts the groups back in order
+__attribute__((target("avx2")))
+static void extract_avx2(const uint32_t *v, uint8_t *out, size_t n, int lane)
+{
+    const __m128i shift = _mm_cvtsi32_si128(8 * lane);
+    const __m256i low = _mm256_set1_epi32(0xFF);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i b[4];
+        for (int k = 0; k < 4; k++)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(v + i + 8 * k));
+            b[k] = _mm256_and_si256(_mm256_srl_epi32(x, shift), low);
+        }
+        __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(b[0], b[1]), _mm256_packus_epi32(b[2], b[3]));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permutevar8x32_epi32(bytes, order));
+    }
+    extract_scalar(v + i, out + i, n - i, lane);
+}
+
+#endif
+
+static const struct kernels table[] = {
+#ifdef BITS_X86
+    { "avx2", popcount_avx2, replace_avx2, extract_avx2 },
+    { "popcnt", popcount_popcnt, replace_scalar, extract_scalar },
+#endif
+    { "scalar", popcount_scalar, replace_scalar, extract_scalar },
+};
+
+static const struct kernels *active = &table[sizeof(table) / sizeof(table[0]) - 1];
+
+static int supported(const struct kernels *k)
+{
+#ifdef BITS_X86
+    __builtin_cpu_init();
+    if (strcmp(k->name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if (strcmp(k->name, "popcnt") == 0)
+        return __builtin_cpu_supports("popcnt");
+#endif
+    return 1;
+}
+
+// eight binary digits for each byte value
+static char digits[256][8];
+
+__attribute__((constructor))
+static void init(void)
+{
+    for (int b = 0; b < 256; b++)
+    {
+        for (int bit = 0; bit < 8; bit++)
+            digits[b][bit] = (b >> (7 - bit)) & 1 ? '1' : '0';
+    }
+
+    // the table is ordered best first
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        if (supported(&table[i]))
+        {
+            active = &table[i];
+            return;
+        }
+    }
+}
+
+const char *bits_kernel(void)
+{
+    return active->name;
+}
+
+int bits_use_kernel(const char *name)
+{
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        if (strcmp(table[i].name, name) == 0 && supported(&table[i]))
+        {
+            active = &table[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t bits_popcount(const void *buf, size_t len)
+{
+    return active->popcount(buf, len);
+}
+
+void bits_replace_byte(uint32_t *v, size_t n, int lane, uint8_t value)
+{
+    active->replace(v, n, lane, value);
+}
+
+void bits_extract_byte(const uint32_t *v, uint8_t *out, size_t n, int lane)
+{
+    active->extract(v, out, n, lane);
+}
+
+void bits_to_binary32(uint32_t v, char *out)
+{
+    memcpy(out, digits[v >> 24], 8);
+    memcpy(out + 8, digits[(v >> 16) & 0xFF], 8);
+    memcpy(out + 16, digits[(v >> 8) & 0xFF], 8);
+    memcpy(out + 24, digits[v & 0xFF], 8);
+    out[32] = '\0';
+}
+
+size_t bits_to_binary(uint32_t v, char *out)
+{
+    char all[BITS_BINARY_SIZE];
+    size_t len = v ? 32 - __builtin_clz(v) : 1;
+    bits_to_binary32(v, all);
+    memcpy(out, all + 32 - len, len + 1);
+    return len;
+}
\ No newline at end of file
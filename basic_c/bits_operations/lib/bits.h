@@ -0,0 +1,28 @@
+#ifndef TASK1_BITS_H
+#define TASK1_BITS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Set bits in len bytes of buf
+uint64_t bits_popcount(const void *buf, size_t len);
+
+// v in binary into out (at least BITS_BINARY_SIZE bytes), NUL-terminated:
+// bits_to_binary() without leading zeros ("0" for 0) and returns the
+// length, bits_to_binary32() always writes all 32 digits
+#define BITS_BINARY_SIZE 33
+size_t bits_to_binary(uint32_t v, char *out);
+void bits_to_binary32(uint32_t v, char *out);
+
+// Byte lane lane (0 the lowest, 2 the third) of each of n values:
+// replaced by value in place, or copied out to out[i]
+void bits_replace_byte(uint32_t *v, size_t n, int lane, uint8_t value);
+void bits_extract_byte(const uint32_t *v, uint8_t *out, size_t n, int lane);
+
+// Kernels behind the bulk calls: "avx2" (Harley-Seal popcount, vector
+// byte lanes), "popcnt" (the POPCNT instruction) or "scalar", picked for
+// the CPU at load time. bits_use_kernel() switches, 0 if not supported.
+const char *bits_kernel(void);
+int bits_use_kernel(const char *name);
+
+#endif
\ No newline at end of file
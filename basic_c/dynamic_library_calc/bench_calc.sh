@@ -0,0 +1,13 @@
+#!/bin/sh
+# Batch calls (add_n, sub_n, mul_n, superdiv_n) with every kernel the CPU
+# has, against a loop of single calls, on 4096 and 4M elements, linked
+# with the shared libcalc.so.
+# usage: ./bench_calc.sh
+
+DIR=/tmp/calc_dynamic
+mkdir -p "$DIR" || exit 1
+
+gcc -std=gnu11 -O2 -fPIC -shared -o "$DIR/libcalc.so" lib/add.c lib/sub.c lib/mul.c lib/div.c lib/batch.c || exit 1
+gcc -std=gnu11 -O2 -Ilib -o "$DIR/bench" src/bench.c -L"$DIR" -lcalc -Wl,-rpath,"$DIR" || exit 1
+
+"$DIR/bench"
@@ -0,0 +1,13 @@
+#!/bin/sh
+# The plugin build against direct linking: the cost of calling through the
+# function table, the batch throughput of each variant this CPU runs, and
+# the time of a hot reload.
+# usage: ./bench_plugin.sh
+
+DIR=/tmp/calc_plugin
+
+./build.sh "$DIR" || exit 1
+gcc -std=gnu11 -O2 -Wall -Ilib -o "$DIR/bench_plugin" src/bench_plugin.c src/loader.c \
+    -L"$DIR" -lcalc -ldl -Wl,-rpath,"$DIR" || exit 1
+
+"$DIR/bench_plugin"
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Builds the calculator and its library as plugins into DIR: calc loads
+# the best of libcalc-generic.so, -sse42.so, -avx2.so and -avx512.so this
+# CPU runs (or the file in CALC_PLUGIN), and picks up a new one put in
+# its place with mv. libcalc.so is the same library for direct linking.
+# usage: ./build.sh [dir]
+
+DIR=${1:-build}
+LIB="lib/add.c lib/sub.c lib/mul.c lib/div.c lib/batch.c"
+CFLAGS="-std=gnu11 -O2 -Wall"
+
+mkdir -p "$DIR" || exit 1
+
+# variant, batch kernel, instruction set; written aside and moved in, so
+# a running calc sees a new file and reloads it
+plugin() {
+    gcc $CFLAGS -fPIC -shared -fvisibility=hidden $3 \
+        -DCALC_VARIANT=\"$1\" -DCALC_KERNEL=\"$2\" \
+        -o "$DIR/libcalc-$1.so.tmp" $LIB lib/plugin.c || exit 1
+    mv "$DIR/libcalc-$1.so.tmp" "$DIR/libcalc-$1.so" || exit 1
+}
+
+plugin generic scalar ""
+plugin sse42 sse4.1 "-msse4.2"
+plugin avx2 avx2 "-mavx2"
+plugin avx512 avx512 "-mavx512f -mavx512bw -mavx512vl"
+
+gcc $CFLAGS -fPIC -shared -o "$DIR/libcalc.so" $LIB || exit 1
+gcc $CFLAGS -Ilib -o "$DIR/calc" src/main.c src/loader.c -ldl || exit 1
@@ -1,9 +1,25 @@
 #ifndef TASK7_CALC_H
 #define TASK7_CALC_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 int add(int a, int b, int *result);
 int sub(int a, int b, int *result);
 int mul(int a, int b, int *result);
 int superdiv(int a, int b, double *result);
 
+// Batch versions: out[i] = a[i] op b[i] for i < n. ovf[i] is 1 where the
+// scalar call would return 0 (overflow, division error); out[i] is 0 there.
+void add_n(const int *a, const int *b, int *out, uint8_t *ovf, size_t n);
+void sub_n(const int *a, const int *b, int *out, uint8_t *ovf, size_t n);
+void mul_n(const int *a, const int *b, int *out, uint8_t *ovf, size_t n);
+void superdiv_n(const int *a, const int *b, double *out, uint8_t *ovf, size_t n);
+
+// Kernel behind the batch calls: "avx512", "avx2", "sse4.1" or "scalar",
+// picked for the CPU at load time. calc_use_kernel() switches, 0 if not
+// supported.
+const char *calc_kernel(void);
+int calc_use_kernel(const char *name);
+
 #endif
\ No newline at end of file
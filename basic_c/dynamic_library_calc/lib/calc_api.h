@@ -0,0 +1,35 @@
+#ifndef TASK7_CALC_API_H
+#define TASK7_CALC_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The library as a plugin: libcalc-<variant>.so exports one symbol,
+//     const struct calc_api *calc_api(void);
+// and everything else stays hidden. The table only grows: fields are
+// appended, never removed or reordered, and version changes only when an
+// existing field changes meaning. A host checks version, and that size
+// covers the fields it uses.
+#define CALC_API_VERSION 1
+#define CALC_API_SYMBOL "calc_api"
+
+struct calc_api
+{
+    uint32_t version;
+    uint32_t size;
+    const char *variant;    // "generic", "sse42", "avx2", "avx512"
+
+    int (*add)(int a, int b, int *result);
+    int (*sub)(int a, int b, int *result);
+    int (*mul)(int a, int b, int *result);
+    int (*superdiv)(int a, int b, double *result);
+
+    void (*add_n)(const int *a, const int *b, int *out, uint8_t *ovf, size_t n);
+    void (*sub_n)(const int *a, const int *b, int *out, uint8_t *ovf, size_t n);
+    void (*mul_n)(const int *a, const int *b, int *out, uint8_t *ovf, size_t n);
+    void (*superdiv_n)(const int *a, const int *b, double *out, uint8_t *ovf, size_t n);
+};
+
+typedef const struct calc_api *(*calc_api_fn)(void);
+
+#endif
\ No newline at end of file
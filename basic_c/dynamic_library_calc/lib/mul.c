@@ -3,12 +3,11 @@
 
 int mul(int a, int b, int *result)
 {
-    if (a != 0 && b != 0)
-    {
-        if (a > INT_MAX / b || a < INT_MIN / b)
-            return 0;
-    }
+    long long product = (long long)a * b;
 
-    *result = a * b;
+    if (product > INT_MAX || product < INT_MIN)
+        return 0;
+
+    *result = (int)product;
     return 1;
 }
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "calc.h"
+#include "calc_api.h"
+
+// One variant of the plugin. build.sh compiles the library once per
+// variant with that instruction set enabled, and with CALC_VARIANT and the
+// batch kernel it pins (CALC_KERNEL) defined.
+#ifndef CALC_VARIANT
+#define CALC_VARIANT "generic"
+#define CALC_KERNEL "scalar"
+#endif
+
+static const struct calc_api api = {
+    .version = CALC_API_VERSION,
+    .size = sizeof(struct calc_api),
+    .variant = CALC_VARIANT,
+    .add = add,
+    .sub = sub,
+    .mul = mul,
+    .superdiv = superdiv,
+    .add_n = add_n,
+    .sub_n = sub_n,
+    .mul_n = mul_n,
+    .superdiv_n = superdiv_n,
+};
+
+// NULL when the CPU lacks the variant's kernel
+__attribute__((visibility("default")))
+const struct calc_api *calc_api(void)
+{
+    if (!calc_use_kernel(CALC_KERNEL))
+        return NULL;
+    return &api;
+}
\ No newline at end of file
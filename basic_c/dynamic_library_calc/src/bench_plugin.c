@@ -0,0 +1,271 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "calc.h"
+#include "loader.h"
+
+// Direct linking against libcalc.so compared with the plugins: what one
+// call through the table costs, what each variant's batch kernels give,
+// and how long a hot reload takes. The plugins are looked for next to
+// this program, as build.sh puts them.
+
+#define CALLS 10000000
+#define CALL_ROUNDS 5
+#define SMALL_N 4096
+#define LARGE_N (1 << 22)
+#define TOTAL_ELEMENTS (64 << 20)
+#define RELOAD_CHECKS 100000
+
+static const char *variantNames[] = { "generic", "sse42", "avx2", "avx512" };
+#define VARIANTS (sizeof(variantNames) / sizeof(variantNames[0]))
+
+static double NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static unsigned long long seed = 88172645463325252ull;
+
+static int RandomInt(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    int v = (int)(seed >> 32);
+    return (seed & 1) ? v : v % 40000;
+}
+
+static void PluginPath(const char *variant, char *path)
+{
+    char dir[PATH_MAX - 32];    // room for the file name
+    ssize_t len = readlink("/proc/self/exe", dir, sizeof(dir) - 1);
+    dir[len > 0 ? len : 0] = '\0';
+    char *slash = strrchr(dir, '/');
+    if (slash)
+        *slash = '\0';
+    snprintf(path, PATH_MAX, "%s/libcalc-%s.so", dir, variant);
+}
+
+static int CopyFile(const char *from, const char *to)
+{
+    char buf[1 << 16];
+    int in = open(from, O_RDONLY);
+    int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+    ssize_t got = 0;
+    while (in >= 0 && out >= 0 && (got = read(in, buf, sizeof(buf))) > 0)
+    {
+        if (write(out, buf, got) != got)
+        {
+            got = -1;
+            break;
+        }
+    }
+    if (in >= 0)
+        close(in);
+    if (out >= 0)
+        close(out);
+    return in >= 0 && out >= 0 && got == 0;
+}
+
+static volatile int sink;
+
+// ns per call, the best of CALL_ROUNDS; p NULL calls the linked add()
+// through the PLT, otherwise the table is read again at every call, as
+// main.c does
+static double TimeCalls(const struct calc_plugin *p)
+{
+    double best = 1e30;
+    for (int round = 0; round < CALL_ROUNDS; round++)
+    {
+        int r, sum = 0;
+        double t0 = NowMs();
+        if (p)
+        {
+            for (int i = 0; i < CALLS; i++)
+            {
+                if (p->api->add(i & 0xFFFF, 1, &r))
+                    sum += r;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < CALLS; i++)
+            {
+                if (add(i & 0xFFFF, 1, &r))
+                    sum += r;
+            }
+        }
+        double ns = (NowMs() - t0) * 1e6 / CALLS;
+        sink = sum;
+        if (ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+// 0 add_n, 1 mul_n, 2 superdiv_n; api NULL for the directly linked ones
+static void Batch(const struct calc_api *api, int op, const int *a, const int *b, void *out, uint8_t *ovf, size_t n)
+{
+    if (op == 0)
+        (api ? api->add_n : add_n)(a, b, out, ovf, n);
+    else if (op == 1)
+        (api ? api->mul_n : mul_n)(a, b, out, ovf, n);
+    else
+        (api ? api->superdiv_n : superdiv_n)(a, b, out, ovf, n);
+}
+
+// ns per element
+static double TimeBatch(const struct calc_api *api, int op, const int *a, const int *b, void *out, uint8_t *ovf, size_t n)
+{
+    int reps = TOTAL_ELEMENTS / n;
+    double t0 = NowMs();
+    for (int r = 0; r < reps; r++)
+        Batch(api, op, a, b, out, ovf, n);
+    return (NowMs() - t0) * 1e6 / ((double)reps * n);
+}
+
+static int Reload(void)
+{
+    char dir[] = "/tmp/calc_reload.XXXXXX";
+    char path[PATH_MAX], next[PATH_MAX], from[PATH_MAX];
+    if (!mkdtemp(dir))
+    {
+        perror("mkdtemp");
+        return 0;
+    }
+    snprintf(path, sizeof(path), "%s/libcalc.so", dir);
+    snprintf(next, sizeof(next), "%s/libcalc.so.new", dir);
+
+    // start on generic, then put the best variant in its place
+    struct calc_plugin p;
+    PluginPath("generic", from);
+    int ok = CopyFile(from, path) && calc_plugin_open(&p, path);
+    if (!ok)
+    {
+        printf("перезагрузка: %s\n", calc_plugin_error());
+        rmdir(dir);
+        return 0;
+    }
+
+    double t0 = NowMs();
+    for (int i = 0; i < RELOAD_CHECKS; i++)
+        calc_plugin_reload(&p);
+    double check = (NowMs() - t0) * 1e6 / RELOAD_CHECKS;
+
+    PluginPath(calc_best_variant(), from);
+    CopyFile(from, next);
+    rename(next, path);
+    t0 = NowMs();
+    int reloaded = calc_plugin_reload(&p);
+    double reload = NowMs() - t0;
+
+    int r = 0;
+    ok = reloaded == 1 && strcmp(p.api->variant, calc_best_variant()) == 0 && p.api->add(2, 3, &r) && r == 5;
+    printf("проверка без изменений: %.0f нс, перезагрузка generic -> %s: %.3f мс, %s\n",
+        check, p.api->variant, reload, ok ? "работает" : "ОШИБКА");
+
+    calc_plugin_close(&p);
+    unlink(path);
+    rmdir(dir);
+    return ok;
+}
+
+int main(void)
+{
+    const char *opNames[] = { "add_n", "mul_n", "superdiv_n" };
+    size_t sizes[] = { SMALL_N, LARGE_N };
+    struct calc_plugin plugins[VARIANTS];
+    int loaded[VARIANTS];
+
+    printf("процессор: лучший вариант %s\n", calc_best_variant());
+    for (size_t v = 0; v < VARIANTS; v++)
+    {
+        char path[PATH_MAX];
+        PluginPath(variantNames[v], path);
+        loaded[v] = calc_variant_supported(variantNames[v]) && calc_plugin_open(&plugins[v], path);
+        if (!loaded[v] && calc_variant_supported(variantNames[v]))
+            printf("%s: %s\n", variantNames[v], calc_plugin_error());
+    }
+    if (!loaded[0])
+        return 1;
+
+    struct calc_plugin best;
+    if (!calc_plugin_open(&best, NULL))
+    {
+        printf("%s\n", calc_plugin_error());
+        return 1;
+    }
+
+    double direct = TimeCalls(NULL);
+    double table = TimeCalls(&best);
+    printf("\nодин вызов add(): напрямую %.2f нс, через таблицу %s %.2f нс, разница %+.2f нс\n",
+        direct, best.api->variant, table, table - direct);
+
+    int *a = malloc(LARGE_N * sizeof(int));
+    int *b = malloc(LARGE_N * sizeof(int));
+    double *out = malloc(LARGE_N * sizeof(double));
+    double *expect = malloc(LARGE_N * sizeof(double));
+    uint8_t *ovf = malloc(LARGE_N);
+    uint8_t *expectOvf = malloc(LARGE_N);
+    if (!a || !b || !out || !expect || !ovf || !expectOvf)
+    {
+        perror("malloc");
+        return 1;
+    }
+    for (size_t i = 0; i < LARGE_N; i++)
+    {
+        a[i] = RandomInt();
+        b[i] = RandomInt();
+    }
+
+    printf("\nоперация    элементов    нс/элем      млн/с   ускор.  вариант\n");
+    int same = 1;
+    for (int op = 0; op < 3; op++)
+    {
+        size_t width = op == 2 ? sizeof(double) : sizeof(int);
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            size_t n = sizes[s];
+            double generic = TimeBatch(plugins[0].api, op, a, b, expect, expectOvf, n);
+            printf("%-10s %10zu %10.3f %10.1f %8.2f  generic\n", opNames[op], n, generic, 1e3 / generic, 1.0);
+
+            // the plugins, then libcalc.so with its own dispatch
+            for (size_t v = 1; v <= VARIANTS; v++)
+            {
+                if (v < VARIANTS && !loaded[v])
+                    continue;
+                const struct calc_api *api = v < VARIANTS ? plugins[v].api : NULL;
+                memset(out, 0x55, n * width);
+                double ns = TimeBatch(api, op, a, b, out, ovf, n);
+                int ok = memcmp(out, expect, n * width) == 0 && memcmp(ovf, expectOvf, n) == 0;
+                same = same && ok;
+                printf("%-10s %10zu %10.3f %10.1f %8.2f  %s%s\n", opNames[op], n, ns, 1e3 / ns, generic / ns,
+                    api ? api->variant : "libcalc.so", ok ? "" : " (РАСХОЖДЕНИЕ)");
+            }
+        }
+    }
+
+    printf("\n");
+    int reloadOk = Reload();
+    printf("\nрезультаты совпадают: %s\n", same ? "да" : "НЕТ");
+
+    for (size_t v = 0; v < VARIANTS; v++)
+    {
+        if (loaded[v])
+            calc_plugin_close(&plugins[v]);
+    }
+    calc_plugin_close(&best);
+    free(a);
+    free(b);
+    free(out);
+    free(expect);
+    free(ovf);
+    free(expectOvf);
+    return same && reloadOk ? 0 : 1;
+}
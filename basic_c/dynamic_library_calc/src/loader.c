@@ -0,0 +1,237 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CALC_X86 1
+#endif
+
+#include "loader.h"
+
+enum
+{
+    CPU_SSE42 = 1,
+    CPU_AVX2 = 2,
+    CPU_AVX512 = 4
+};
+
+// best first
+static const struct
+{
+    const char *name;
+    int needs;
+} variants[] = {
+    { "avx512", CPU_AVX512 },
+    { "avx2", CPU_AVX2 },
+    { "sse42", CPU_SSE42 },
+    { "generic", 0 },
+};
+
+#define VARIANT_COUNT (sizeof(variants) / sizeof(variants[0]))
+
+static char error[PATH_MAX + 256];
+
+static int Fail(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error, sizeof(error), format, args);
+    va_end(args);
+    return 0;
+}
+
+const char *calc_plugin_error(void)
+{
+    return error;
+}
+
+static int CpuFeatures(void)
+{
+    int features = 0;
+#ifdef CALC_X86
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d))
+        return 0;
+    if (c & bit_SSE4_2)
+        features |= CPU_SSE42;
+
+    // AVX registers count only when the OS saves them: OSXSAVE, then the
+    // YMM (and for AVX-512 the opmask and ZMM) state bits in XCR0
+    if (!(c & bit_OSXSAVE) || !(c & bit_AVX))
+        return features;
+    unsigned xcr0, xcr0High;
+    __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+        return features;
+    if ((xcr0 & 0x06) == 0x06 && (b & bit_AVX2))
+        features |= CPU_AVX2;
+    if ((xcr0 & 0xE6) == 0xE6 && (b & bit_AVX512F) && (b & bit_AVX512BW) && (b & bit_AVX512VL))
+        features |= CPU_AVX512;
+#endif
+    return features;
+}
+
+int calc_variant_supported(const char *variant)
+{
+    int features = CpuFeatures();
+    for (size_t i = 0; i < VARIANT_COUNT; i++)
+    {
+        if (strcmp(variants[i].name, variant) == 0)
+            return (features & variants[i].needs) == variants[i].needs;
+    }
+    return 0;
+}
+
+const char *calc_best_variant(void)
+{
+    int features = CpuFeatures();
+    for (size_t i = 0; i < VARIANT_COUNT; i++)
+    {
+        if ((features & variants[i].needs) == variants[i].needs)
+            return variants[i].name;
+    }
+    return "generic";
+}
+
+// the best supported libcalc-<variant>.so in the executable's directory
+static int FindPlugin(char *path)
+{
+    char dir[PATH_MAX - 32];    // room for the file name
+    ssize_t len = readlink("/proc/self/exe", dir, sizeof(dir) - 1);
+    if (len <= 0)
+        return Fail("не найден каталог программы: %s", strerror(errno));
+    dir[len] = '\0';
+    *strrchr(dir, '/') = '\0';
+
+    int features = CpuFeatures();
+    for (size_t i = 0; i < VARIANT_COUNT; i++)
+    {
+        if ((features & variants[i].needs) != variants[i].needs)
+            continue;
+        snprintf(path, PATH_MAX, "%s/libcalc-%s.so", dir, variants[i].name);
+        if (access(path, R_OK) == 0)
+            return 1;
+    }
+    return Fail("в %s нет libcalc-<вариант>.so для этого процессора", dir);
+}
+
+static int Load(struct calc_plugin *p, const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return Fail("%s: %s", path, strerror(errno));
+    if (fstat(fd, &p->seen) != 0)
+    {
+        int err = errno;
+        close(fd);
+        return Fail("%s: %s", path, strerror(err));
+    }
+
+    // dlopen() hands back an object it already has for the same name, so
+    // go through /proc/self/fd: the old plugin's descriptor is still open,
+    // the new one gets another number and with it another name
+    char name[64];
+    snprintf(name, sizeof(name), "/proc/self/fd/%d", fd);
+    void *handle = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+    {
+        close(fd);
+        return Fail("%s: %s", path, dlerror());
+    }
+
+    calc_api_fn get = (calc_api_fn)dlsym(handle, CALC_API_SYMBOL);
+    const struct calc_api *api = get ? get() : NULL;
+
+    // the message is made before dlclose(): api points into the library
+    int ok = 0;
+    if (!get)
+        Fail("%s: нет символа %s", path, CALC_API_SYMBOL);
+    else if (!api)
+        Fail("%s: вариант не поддерживается процессором", path);
+    else if (api->version != CALC_API_VERSION)
+        Fail("%s: несовместимая версия интерфейса (%u, нужна %u)", path, api->version, CALC_API_VERSION);
+    else if (api->size < sizeof(struct calc_api))
+        Fail("%s: таблица функций короче ожидаемой (%u байт, нужно %zu)", path, api->size, sizeof(struct calc_api));
+    else if (!calc_variant_supported(api->variant))
+        Fail("%s: вариант %s не поддерживается процессором", path, api->variant);
+    else
+        ok = 1;
+
+    if (!ok)
+    {
+        dlclose(handle);
+        close(fd);
+        return 0;
+    }
+
+    p->api = api;
+    p->handle = handle;
+    p->fd = fd;
+    return 1;
+}
+
+int calc_plugin_open(struct calc_plugin *p, const char *path)
+{
+    memset(p, 0, sizeof(*p));
+    p->fd = -1;
+    if (path)
+        snprintf(p->path, sizeof(p->path), "%s", path);
+    else if (!FindPlugin(p->path))
+        return 0;
+    return Load(p, p->path);
+}
+
+static int SameFile(const struct stat *a, const struct stat *b)
+{
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size
+        && a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+int calc_plugin_reload(struct calc_plugin *p)
+{
+    struct stat st;
+    // missing for a moment while being replaced: keep the old one
+    if (stat(p->path, &st) != 0 || SameFile(&st, &p->seen))
+        return 0;
+
+    struct calc_plugin next = *p;
+    if (!Load(&next, p->path))
+    {
+        p->seen = st;
+        return -1;
+    }
+
+    // rewritten in place, same inode: the loader returns the mapping it
+    // already has, and the running code changed under it anyway
+    if (next.handle == p->handle)
+    {
+        dlclose(next.handle);
+        close(next.fd);
+        p->seen = next.seen;
+        Fail("%s изменён на месте; новую версию нужно ставить через mv", p->path);
+        return -1;
+    }
+
+    dlclose(p->handle);
+    close(p->fd);
+    *p = next;
+    return 1;
+}
+
+void calc_plugin_close(struct calc_plugin *p)
+{
+    if (p->handle)
+        dlclose(p->handle);
+    if (p->fd >= 0)
+        close(p->fd);
+    p->api = NULL;
+    p->handle = NULL;
+    p->fd = -1;
+}
\ No newline at end of file
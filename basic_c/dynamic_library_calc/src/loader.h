@@ -0,0 +1,35 @@
+#ifndef TASK7_LOADER_H
+#define TASK7_LOADER_H
+
+#include <limits.h>
+#include <sys/stat.h>
+#include "calc_api.h"
+
+// A loaded libcalc plugin. api stays valid until the next successful
+// calc_plugin_reload() or calc_plugin_close(), so read it at each call
+// instead of keeping its function pointers.
+struct calc_plugin
+{
+    const struct calc_api *api;
+    void *handle;
+    int fd;                 // the file dlopen() went through, kept open
+    char path[PATH_MAX];
+    struct stat seen;       // the file as last looked at, to spot a new one
+};
+
+// Best variant this CPU runs, by cpuid: "avx512", "avx2", "sse42" or "generic"
+const char *calc_best_variant(void);
+int calc_variant_supported(const char *variant);
+
+// Loads path, or with NULL the best variant found next to the executable.
+// 0 on failure, see calc_plugin_error().
+int calc_plugin_open(struct calc_plugin *p, const char *path);
+
+// Loads the file again if it was replaced since: 1 reloaded, 0 unchanged,
+// -1 the new file was rejected and the old plugin is still in use.
+int calc_plugin_reload(struct calc_plugin *p);
+
+void calc_plugin_close(struct calc_plugin *p);
+const char *calc_plugin_error(void);
+
+#endif
\ No newline at end of file
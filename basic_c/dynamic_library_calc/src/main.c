@@ -2,7 +2,7 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <errno.h>
-#include "calc.h"
+#include "loader.h"
 
 int ReadInt(const char *prompt, int *out);
 
@@ -13,10 +13,26 @@ int main(void)
     int b;
     int res;
     double dres;
+    struct calc_plugin calc;
+
+    // CALC_PLUGIN names a plugin file; by default the best variant for
+    // this CPU is taken from the program's directory
+    if (!calc_plugin_open(&calc, getenv("CALC_PLUGIN")))
+    {
+        printf("Не удалось загрузить библиотеку: %s\n", calc_plugin_error());
+        return 1;
+    }
 
     while (1)
     {
-        printf("\nМеню функций СуперКалькулятора-3000:\n");
+        // a new library put in place of the old one is picked up here
+        int reloaded = calc_plugin_reload(&calc);
+        if (reloaded > 0)
+            printf("\nБиблиотека перезагружена: %s\n", calc.path);
+        else if (reloaded < 0)
+            printf("\nНовая библиотека не загружена, работает прежняя: %s\n", calc_plugin_error());
+
+        printf("\nМеню функций СуперКалькулятора-3000 (%s):\n", calc.api->variant);
         printf("1. Сложение\n");
         printf("2. Вычитание\n");
         printf("3. Умножение\n");
@@ -28,7 +44,10 @@ int main(void)
             continue;
 
         if (choice == 5)
+        {
+            calc_plugin_close(&calc);
             return 0;
+        }
 
         if (!ReadInt("Введите первое число: ", &a))
             continue;
@@ -38,25 +57,25 @@ int main(void)
         switch (choice)
         {
             case 1:
-                if (add(a, b, &res))
+                if (calc.api->add(a, b, &res))
                     printf("%d + %d = %d\n", a, b, res);
                 else
                     printf("Переполнение!\n");
                 break;
             case 2:
-                if (sub(a, b, &res))
+                if (calc.api->sub(a, b, &res))
                     printf("%d - %d = %d\n", a, b, res);
                 else
                     printf("Переполнение!\n");
                 break;
             case 3:
-                if (mul(a, b, &res))
+                if (calc.api->mul(a, b, &res))
                     printf("%d * %d = %d\n", a, b, res);
                 else
                     printf("Переполнение!\n");
                 break;
             case 4:
-                if (superdiv(a, b, &dres))
+                if (calc.api->superdiv(a, b, &dres))
                     printf("%d / %d = %.2f\n", a, b, dres);
                 else
                     printf("Ошибка деления!\n");
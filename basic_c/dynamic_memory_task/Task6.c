@@ -1,36 +1,189 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
-#include <malloc.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define QUERY_FOR_SEARCH_INPUT_ARRAY 20
 
-// structure for implementation via a doubly linked list (pointers to the next and previous elements)
+#define NAME_SIZE 20
+#define TEL_SIZE 11
+#define DEFAULT_BOOK "phonebook.db"
+
+/*
+ * The directory lives in one memory-mapped file, so opening it costs
+ * the same for ten records and for ten million. Records are stored as
+ * columns (struct of arrays) and never move; a deleted record keeps its
+ * slot until the file is compacted. Names are interned: every distinct
+ * name is stored once and records hold its number.
+ *
+ * Indexes, all inside the same file:
+ * - a hash table on the phone number, for exact lookups
+ * - trigram lists over the distinct names and over the phone numbers,
+ *   so a substring search only checks records sharing the rarest
+ *   trigram of the query
+ * - a Fenwick tree over the live records, turning a position in the
+ *   list into a slot and back in O(log n)
+ */
+
+#define BOOK_MAGIC 0x31424b50u /* "PKB1" */
+#define BOOK_VERSION 1
+#define BOOK_ALIGN 64
+
+#define GRAM_BUCKETS (1u << 16)
+#define BLOCK_IDS 14
+#define NO_STRING UINT32_MAX
+#define TOMBSTONE UINT32_MAX
+#define COMPACT_MIN 4096
+
+// record fields as typed in and printed
 struct customer
 {
-    char name[20];
-    char secondName[20];
-    char tel[11];
+    char name[NAME_SIZE];
+    char secondName[NAME_SIZE];
+    char tel[TEL_SIZE];
+};
+
+// a list of ids in chained blocks; block 0 is never used, so 0 ends a chain
+struct postingList
+{
+    uint32_t head;
+    uint32_t tail;
+    uint32_t count;
+};
 
-    struct customer *prev;
-    struct customer *next;
+struct postingBlock
+{
+    uint32_t next;
+    uint32_t count;
+    uint32_t ids[BLOCK_IDS];
+};
+
+// an interned name and the records using it
+struct stringEntry
+{
+    uint32_t offset;
+    uint32_t length;
+    struct postingList refs;
+};
+
+enum
+{
+    SEC_FIRST,   // string number of the name, NO_STRING once deleted
+    SEC_LAST,    // string number of the second name
+    SEC_TEL,     // phone numbers, TEL_SIZE bytes each
+    SEC_FENWICK, // live records, 1-based Fenwick tree over the slots
+    SEC_STRINGS,
+    SEC_POOL,    // interned names, NUL-terminated
+    SEC_INTERN,  // hash table: string number + 1, 0 if empty
+    SEC_PHONE,   // hash table: slot + 1, 0 if empty, TOMBSTONE if deleted
+    SEC_GRAMS,   // trigram lists, names then phones
+    SEC_BLOCKS,
+    SEC_COUNT
+};
+
+enum { GRAM_NAME, GRAM_TEL };
+
+struct bookHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;     // slots used
+    uint32_t live;      // records not deleted
+    uint32_t strings;
+    uint32_t poolUsed;
+    uint32_t blocks;
+    uint32_t phoneUsed; // tombstones included
+    uint32_t cap[SEC_COUNT];
+    uint64_t off[SEC_COUNT];
+    uint64_t fileSize;
+};
+
+struct book
+{
+    int fd;
+    char *base;
+    struct bookHeader *h;
+
+    uint32_t *first;
+    uint32_t *last;
+    char (*tel)[TEL_SIZE];
+    uint32_t *fenwick;
+    struct stringEntry *strings;
+    char *pool;
+    uint32_t *intern;
+    uint32_t *phone;
+    struct postingList *grams;
+    struct postingBlock *blocks;
+};
+
+// results of a search: slots in ascending order
+struct slotList
+{
+    uint32_t *slots;
+    size_t count;
+    size_t capacity;
+};
+
+static const size_t sectionElem[SEC_COUNT] = {
+    sizeof(uint32_t), sizeof(uint32_t), TEL_SIZE, sizeof(uint32_t),
+    sizeof(struct stringEntry), 1, sizeof(uint32_t), sizeof(uint32_t),
+    sizeof(struct postingList), sizeof(struct postingBlock)
 };
 
 /* Prototypes */
 void PrintCustomer(int index, struct customer *cptr);
-void AddCustomer(struct customer **head);
-void DeleteCustomer(struct customer **head);
-void SearchCustomers(struct customer *head);
-void OutputAllCustomers(struct customer *head);
+void AddCustomer(struct book *b);
+void DeleteCustomer(struct book *b);
+void SearchCustomers(struct book *b);
+void SearchByPhone(struct book *b);
+void OutputAllCustomers(struct book *b);
 
 int IsDigitsOnly(const char *s);
 void ReadString(char *buf, size_t size);
 
-int main(void)
+struct book *OpenBook(const char *path);
+int CloseBook(struct book *b, const char *path);
+int BookAdd(struct book *b, const struct customer *c);
+int BookDelete(struct book *b, uint32_t slot);
+int BookSearch(struct book *b, const char *query, struct slotList *out);
+int BookFindPhone(struct book *b, const char *tel, struct slotList *out);
+uint32_t BookSlotAt(struct book *b, uint32_t position);
+uint32_t BookPosition(struct book *b, uint32_t slot);
+void BookGet(struct book *b, uint32_t slot, struct customer *c);
+
+int BenchBook(int records, const char *path);
+
+int main(int argc, char **argv)
 {
     int choice;
-    struct customer *head = NULL;
+    const char *path = DEFAULT_BOOK;
+
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+        return BenchBook(argc > 2 ? atoi(argv[2]) : 0, argc > 3 ? argv[3] : NULL);
+
+    if (argc == 2)
+        path = argv[1];
+    else if (argc > 2)
+    {
+        fprintf(stderr, "Использование: %s [FILE] | --bench [COUNT] [FILE]\n", argv[0]);
+        return 2;
+    }
+
+    struct book *head = OpenBook(path);
+    if (head == NULL)
+    {
+        perror(path);
+        return 1;
+    }
 
     while (1)
     {
@@ -39,6 +192,7 @@ int main(void)
         printf("2. Удалить абонента\n");
         printf("3. Поиск абонента по ключевым символам\n");
         printf("4. Вывод всех записей\n");
+        printf("5. Поиск абонента по номеру телефона\n");
         printf("0. Выход\n");
         printf("Выбор: ");
 
@@ -47,17 +201,22 @@ int main(void)
 
         if (sscanf(line, "%d", &choice) != 1)
         {
-            printf("Некорректный ввод.\n");
-            continue;
+            if (feof(stdin))
+                choice = 0;
+            else
+            {
+                printf("Некорректный ввод.\n");
+                continue;
+            }
         }
 
         switch (choice)
         {
             case 1:
-                AddCustomer(&head);
+                AddCustomer(head);
                 break;
             case 2:
-                DeleteCustomer(&head);
+                DeleteCustomer(head);
                 break;
             case 3:
                 SearchCustomers(head);
@@ -65,72 +224,54 @@ int main(void)
             case 4:
                 OutputAllCustomers(head);
                 break;
-            case 0: // Exit the program with memory cleanup
-                while (head)
-                {
-                    struct customer *tmp = head;
-                    head = head->next;
-                    free(tmp);
-                }
-                return 0;
+            case 5:
+                SearchByPhone(head);
+                break;
+            case 0: // Exit: the records are already in the file
+                return CloseBook(head, path) != 0;
             default:
                 printf("Недоступный выбор.\n");
         }
     }
 }
 
+// One line of the list or of a search result, empty names included
 void PrintCustomer(int index, struct customer *cptr)
 {
-    if (cptr->name[0] != '\0')
-        printf("%d. %s %s %s\n", index + 1, cptr->name, cptr->secondName, cptr->tel);
+    printf("%d. %s %s %s\n", index + 1, cptr->name, cptr->secondName, cptr->tel);
 }
 
-// Adding customer to the dictionary using a doubly linked list
-void AddCustomer(struct customer **head)
+// Adding customer to the end of the directory
+void AddCustomer(struct book *b)
 {
-    struct customer *newNode = malloc(sizeof(struct customer));
-    if (newNode == NULL)
-    {
-        fprintf(stderr, "malloc failed!\n");
-        return;
-    }
+    struct customer c;
 
     printf("Введите имя: ");
-    ReadString(newNode->name, sizeof(newNode->name));
+    ReadString(c.name, sizeof(c.name));
 
     printf("Введите фамилию: ");
-    ReadString(newNode->secondName, sizeof(newNode->secondName));
+    ReadString(c.secondName, sizeof(c.secondName));
 
     do
     {
         printf("Введите телефон: ");
-        ReadString(newNode->tel, sizeof(newNode->tel));
+        ReadString(c.tel, sizeof(c.tel));
 
-        if (!IsDigitsOnly(newNode->tel))
+        if (!IsDigitsOnly(c.tel))
+        {
+            if (feof(stdin))
+                return;
             printf("Номер должен содержать только цифры.\n");
-
-    }
-    while (!IsDigitsOnly(newNode->tel));
-
-    newNode->next = NULL;
-    newNode->prev = NULL;
-
-    if (*head == NULL)
-    {
-        *head = newNode;
-        return;
+        }
     }
+    while (!IsDigitsOnly(c.tel));
 
-    struct customer *currentNode = *head;
-    while (currentNode->next)
-        currentNode = currentNode->next;
-
-    currentNode->next = newNode;
-    newNode->prev = currentNode;
+    if (BookAdd(b, &c) != 0)
+        fprintf(stderr, "Не удалось добавить запись: %s\n", strerror(errno));
 }
 
-// Delete customer ... but now we have a doubly linked list :D
-void DeleteCustomer(struct customer **head)
+// Delete customer by position: the Fenwick tree finds the slot
+void DeleteCustomer(struct book *b)
 {
     int n;
     char line[16];
@@ -144,63 +285,72 @@ void DeleteCustomer(struct customer **head)
         return;
     }
 
-    struct customer *current = *head;
-    for (int i = 1; current && i < n; i++)
-        current = current->next;
-
-    if (!current)
+    if ((uint32_t)n > b->h->live)
     {
         printf("Неверная позиция.\n");
         return;
     }
 
-    if (current->prev)
-        current->prev->next = current->next;
-    else
-        *head = current->next;
+    BookDelete(b, BookSlotAt(b, n));
+    printf("Запись %d удалена.\n", n);
+}
 
-    if (current->next)
-        current->next->prev = current->prev;
+static void PrintSlots(struct book *b, const struct slotList *found)
+{
+    for (size_t i = 0; i < found->count; i++)
+    {
+        struct customer c;
+        BookGet(b, found->slots[i], &c);
+        PrintCustomer(BookPosition(b, found->slots[i]) - 1, &c);
+    }
 
-    free(current);
-    printf("Запись %d удалена.\n", n);
+    if (found->count == 0)
+        printf("Совпадений не найдено.\n");
 }
 
-// Search customers... but now we have a doubly linked list :D
-void SearchCustomers(struct customer *head)
+// Search customers through the trigram index
+void SearchCustomers(struct book *b)
 {
     char query[QUERY_FOR_SEARCH_INPUT_ARRAY];
-    int found = 0;
+    struct slotList found = {0};
 
     printf("Введите текст для поиска: ");
     ReadString(query, sizeof(query));
 
-    int index = 1;
+    if (BookSearch(b, query, &found) != 0)
+        fprintf(stderr, "Поиск не удался: %s\n", strerror(errno));
+    else
+        PrintSlots(b, &found);
+    free(found.slots);
+}
 
-    while (head)
-    {
-        if (strstr(head->name, query) || strstr(head->secondName, query)
-            || strstr(head->tel, query))
-        {
-            printf("%d. %s %s %s\n", index, head->name, head->secondName, head->tel);
-            found = 1;
-        }
-        head = head->next;
-        index++;
-    }
+// Exact phone number lookup through the hash index
+void SearchByPhone(struct book *b)
+{
+    char tel[QUERY_FOR_SEARCH_INPUT_ARRAY];
+    struct slotList found = {0};
 
-    if (!found)
-        printf("Совпадений не найдено.\n");
+    printf("Введите телефон: ");
+    ReadString(tel, sizeof(tel));
+
+    if (BookFindPhone(b, tel, &found) != 0)
+        fprintf(stderr, "Поиск не удался: %s\n", strerror(errno));
+    else
+        PrintSlots(b, &found);
+    free(found.slots);
 }
 
 // List output
-void OutputAllCustomers(struct customer *head)
+void OutputAllCustomers(struct book *b)
 {
-    int index = 1;
-    while (head)
+    int index = 0;
+    for (uint32_t slot = 0; slot < b->h->count; slot++)
     {
-        printf("%d. %s %s %s\n", index++, head->name, head->secondName, head->tel);
-        head = head->next;
+        if (b->first[slot] == NO_STRING)
+            continue;
+        struct customer c;
+        BookGet(b, slot, &c);
+        PrintCustomer(index++, &c);
     }
 }
 
@@ -228,4 +378,847 @@ int IsDigitsOnly(const char *s)
         s++;
     }
     return 1;
-}
\ No newline at end of file
+}
+
+/* Storage */
+
+static uint64_t HashBytes(const char *s, size_t n)
+{
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+    return h ^ (h >> 29);
+}
+
+static uint32_t GramBucket(const char *s)
+{
+    uint32_t g = (unsigned char)s[0] | (unsigned char)s[1] << 8 | (unsigned char)s[2] << 16;
+    return (g * 2654435761u) >> 16;
+}
+
+static uint64_t AlignUp(uint64_t n)
+{
+    return (n + BOOK_ALIGN - 1) & ~(uint64_t)(BOOK_ALIGN - 1);
+}
+
+// offsets of the sections for the given capacities; returns the file size
+static uint64_t Layout(const uint32_t *cap, uint64_t *off)
+{
+    uint64_t pos = AlignUp(sizeof(struct bookHeader));
+    for (int s = 0; s < SEC_COUNT; s++)
+    {
+        off[s] = pos;
+        pos = AlignUp(pos + (uint64_t)cap[s] * sectionElem[s]);
+    }
+    return pos;
+}
+
+static void Bind(struct book *b)
+{
+    struct bookHeader *h = (struct bookHeader *)b->base;
+    b->h = h;
+    b->first = (uint32_t *)(b->base + h->off[SEC_FIRST]);
+    b->last = (uint32_t *)(b->base + h->off[SEC_LAST]);
+    b->tel = (char (*)[TEL_SIZE])(b->base + h->off[SEC_TEL]);
+    b->fenwick = (uint32_t *)(b->base + h->off[SEC_FENWICK]);
+    b->strings = (struct stringEntry *)(b->base + h->off[SEC_STRINGS]);
+    b->pool = b->base + h->off[SEC_POOL];
+    b->intern = (uint32_t *)(b->base + h->off[SEC_INTERN]);
+    b->phone = (uint32_t *)(b->base + h->off[SEC_PHONE]);
+    b->grams = (struct postingList *)(b->base + h->off[SEC_GRAMS]);
+    b->blocks = (struct postingBlock *)(b->base + h->off[SEC_BLOCKS]);
+}
+
+static void InternInsert(struct book *b, uint32_t id)
+{
+    uint32_t mask = b->h->cap[SEC_INTERN] - 1;
+    const struct stringEntry *e = &b->strings[id];
+    uint32_t i = HashBytes(b->pool + e->offset, e->length) & mask;
+    while (b->intern[i])
+        i = (i + 1) & mask;
+    b->intern[i] = id + 1;
+}
+
+static void PhoneInsert(struct book *b, uint32_t slot)
+{
+    uint32_t mask = b->h->cap[SEC_PHONE] - 1;
+    uint32_t i = HashBytes(b->tel[slot], strlen(b->tel[slot])) & mask;
+    while (b->phone[i] && b->phone[i] != TOMBSTONE)
+        i = (i + 1) & mask;
+    if (b->phone[i] == 0)
+        b->h->phoneUsed++;
+    b->phone[i] = slot + 1;
+}
+
+static void FenwickAdd(struct book *b, uint32_t slot, int32_t delta)
+{
+    uint32_t n = b->h->cap[SEC_FENWICK] - 1;
+    for (uint32_t i = slot + 1; i <= n; i += i & -i)
+        b->fenwick[i] += delta;
+}
+
+// the hash tables and the Fenwick tree depend on their capacity and are
+// built again after growing instead of being moved
+static int Rebuilt(int s)
+{
+    return s == SEC_INTERN || s == SEC_PHONE || s == SEC_FENWICK;
+}
+
+/*
+ * Grows the file to the capacities in cap. Every section keeps or grows
+ * its size, so none moves towards the start: moving them from the last
+ * to the first never overwrites one that has not moved yet.
+ */
+static int Relayout(struct book *b, const uint32_t *cap)
+{
+    uint64_t off[SEC_COUNT];
+    uint64_t size = Layout(cap, off);
+    uint64_t oldSize = b->h->fileSize;
+
+    if (ftruncate(b->fd, size) != 0)
+        return -1;
+    char *base = mremap(b->base, oldSize, size, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED)
+        return -1;
+    b->base = base;
+    b->h = (struct bookHeader *)base;
+
+    int changed[SEC_COUNT];
+    for (int s = SEC_COUNT - 1; s >= 0; s--)
+    {
+        uint64_t oldBytes = (uint64_t)b->h->cap[s] * sectionElem[s];
+        uint64_t newBytes = (uint64_t)cap[s] * sectionElem[s];
+        changed[s] = cap[s] != b->h->cap[s];
+
+        if (Rebuilt(s) && changed[s])
+        {
+            memset(base + off[s], 0, newBytes);
+            continue;
+        }
+        memmove(base + off[s], base + b->h->off[s], oldBytes);
+        memset(base + off[s] + oldBytes, 0, newBytes - oldBytes);
+    }
+
+    memcpy(b->h->cap, cap, sizeof(b->h->cap));
+    memcpy(b->h->off, off, sizeof(b->h->off));
+    b->h->fileSize = size;
+    Bind(b);
+
+    if (changed[SEC_INTERN])
+        for (uint32_t id = 0; id < b->h->strings; id++)
+            InternInsert(b, id);
+
+    if (changed[SEC_PHONE])
+    {
+        b->h->phoneUsed = 0;
+        for (uint32_t slot = 0; slot < b->h->count; slot++)
+            if (b->first[slot] != NO_STRING)
+                PhoneInsert(b, slot);
+    }
+
+    if (changed[SEC_FENWICK])
+    {
+        // O(n) build: each node passes its sum on to its parent
+        uint32_t n = cap[SEC_FENWICK] - 1;
+        for (uint32_t i = 1; i <= n; i++)
+        {
+            if (i - 1 < b->h->count && b->first[i - 1] != NO_STRING)
+                b->fenwick[i]++;
+            uint32_t parent = i + (i & -i);
+            if (parent <= n)
+                b->fenwick[parent] += b->fenwick[i];
+        }
+    }
+    return 0;
+}
+
+// makes room for one more record with two new names
+static int Reserve(struct book *b)
+{
+    const struct bookHeader *h = b->h;
+    uint32_t cap[SEC_COUNT];
+    memcpy(cap, h->cap, sizeof(cap));
+
+    if (h->count + 1 > cap[SEC_FIRST])
+    {
+        cap[SEC_FIRST] = cap[SEC_LAST] = cap[SEC_TEL] = cap[SEC_FIRST] * 2;
+        cap[SEC_FENWICK] = cap[SEC_FIRST] + 1;
+    }
+    if (h->strings + 2 > cap[SEC_STRINGS])
+        cap[SEC_STRINGS] *= 2;
+    while (h->poolUsed + 2 * NAME_SIZE > cap[SEC_POOL])
+        cap[SEC_POOL] *= 2;
+    while ((uint64_t)(h->strings + 2) * 2 > cap[SEC_INTERN])
+        cap[SEC_INTERN] *= 2;
+    while ((uint64_t)(h->phoneUsed + 1) * 2 > cap[SEC_PHONE])
+        cap[SEC_PHONE] *= 2;
+    // two names of up to 17 trigrams, 8 phone trigrams, 2 name references
+    while (h->blocks + 2 * (NAME_SIZE - 3) + (TEL_SIZE - 3) + 2 > cap[SEC_BLOCKS])
+        cap[SEC_BLOCKS] *= 2;
+
+    if (memcmp(cap, h->cap, sizeof(cap)) == 0)
+        return 0;
+    return Relayout(b, cap);
+}
+
+static void ListAppend(struct book *b, struct postingList *list, uint32_t id)
+{
+    struct postingBlock *blk = list->tail ? &b->blocks[list->tail] : NULL;
+
+    // a name with a repeated trigram lands in the same list twice in a row
+    if (blk && blk->count && blk->ids[blk->count - 1] == id)
+        return;
+
+    if (!blk || blk->count == BLOCK_IDS)
+    {
+        uint32_t n = b->h->blocks++;
+        b->blocks[n].next = 0;
+        b->blocks[n].count = 0;
+        if (blk)
+            blk->next = n;
+        else
+            list->head = n;
+        list->tail = n;
+        blk = &b->blocks[n];
+    }
+    blk->ids[blk->count++] = id;
+    list->count++;
+}
+
+static struct postingList *GramList(struct book *b, int kind, const char *s)
+{
+    return &b->grams[kind * GRAM_BUCKETS + GramBucket(s)];
+}
+
+static uint32_t Intern(struct book *b, const char *s)
+{
+    size_t len = strlen(s);
+    uint32_t mask = b->h->cap[SEC_INTERN] - 1;
+    uint32_t i = HashBytes(s, len) & mask;
+
+    for (; b->intern[i]; i = (i + 1) & mask)
+    {
+        const struct stringEntry *e = &b->strings[b->intern[i] - 1];
+        if (e->length == len && memcmp(b->pool + e->offset, s, len) == 0)
+            return b->intern[i] - 1;
+    }
+
+    uint32_t id = b->h->strings++;
+    struct stringEntry *e = &b->strings[id];
+    e->offset = b->h->poolUsed;
+    e->length = len;
+    memcpy(b->pool + e->offset, s, len + 1);
+    b->h->poolUsed += len + 1;
+    b->intern[i] = id + 1;
+
+    for (size_t k = 0; k + 3 <= len; k++)
+        ListAppend(b, GramList(b, GRAM_NAME, s + k), id);
+    return id;
+}
+
+static int CreateBook(struct book *b)
+{
+    struct bookHeader h = {0};
+    h.magic = BOOK_MAGIC;
+    h.version = BOOK_VERSION;
+    h.blocks = 1;
+    h.cap[SEC_FIRST] = h.cap[SEC_LAST] = h.cap[SEC_TEL] = 1024;
+    h.cap[SEC_FENWICK] = 1024 + 1;
+    h.cap[SEC_STRINGS] = 1024;
+    h.cap[SEC_POOL] = 16384;
+    h.cap[SEC_INTERN] = 4096;
+    h.cap[SEC_PHONE] = 4096;
+    h.cap[SEC_GRAMS] = 2 * GRAM_BUCKETS;
+    h.cap[SEC_BLOCKS] = 4096;
+    h.fileSize = Layout(h.cap, h.off);
+
+    if (ftruncate(b->fd, h.fileSize) != 0)
+        return -1;
+    b->base = mmap(NULL, h.fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, b->fd, 0);
+    if (b->base == MAP_FAILED)
+        return -1;
+    memcpy(b->base, &h, sizeof(h));
+    Bind(b);
+    return 0;
+}
+
+// Opens the directory file, creating it if needed; nothing is read up front
+struct book *OpenBook(const char *path)
+{
+    struct book *b = calloc(1, sizeof(struct book));
+    if (b == NULL)
+        return NULL;
+
+    b->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat st;
+    if (b->fd == -1 || fstat(b->fd, &st) != 0)
+        goto fail;
+
+    if (st.st_size == 0)
+    {
+        if (CreateBook(b) != 0)
+            goto fail;
+        return b;
+    }
+
+    struct bookHeader h;
+    if ((size_t)st.st_size < sizeof(h) || pread(b->fd, &h, sizeof(h), 0) != sizeof(h) ||
+        h.magic != BOOK_MAGIC || h.version != BOOK_VERSION ||
+        h.fileSize != (uint64_t)st.st_size)
+    {
+        errno = EINVAL;
+        goto fail;
+    }
+
+    b->base = mmap(NULL, h.fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, b->fd, 0);
+    if (b->base == MAP_FAILED)
+        goto fail;
+    Bind(b);
+    return b;
+
+fail:
+    {
+        int err = errno;
+        if (b->fd != -1)
+            close(b->fd);
+        free(b);
+        errno = err;
+        return NULL;
+    }
+}
+
+static void UnmapBook(struct book *b)
+{
+    munmap(b->base, b->h->fileSize);
+    close(b->fd);
+    free(b);
+}
+
+/*
+ * Closes the directory. When most slots belong to deleted records the
+ * live ones are copied into a fresh file first, which also drops the
+ * names and index entries nobody uses any more.
+ */
+int CloseBook(struct book *b, const char *path)
+{
+    uint32_t dead = b->h->count - b->h->live;
+    if (path == NULL || dead < COMPACT_MIN || dead < b->h->live)
+    {
+        UnmapBook(b);
+        return 0;
+    }
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    unlink(tmp);
+
+    struct book *fresh = OpenBook(tmp);
+    int rc = fresh ? 0 : -1;
+    for (uint32_t slot = 0; rc == 0 && slot < b->h->count; slot++)
+    {
+        if (b->first[slot] == NO_STRING)
+            continue;
+        struct customer c;
+        BookGet(b, slot, &c);
+        rc = BookAdd(fresh, &c);
+    }
+    UnmapBook(b);
+
+    if (fresh)
+        UnmapBook(fresh);
+    if (rc == 0)
+        rc = rename(tmp, path);
+    if (rc != 0)
+        unlink(tmp);
+    return rc;
+}
+
+// Appends a record; the strings are cut to the field sizes
+int BookAdd(struct book *b, const struct customer *c)
+{
+    if (Reserve(b) != 0)
+        return -1;
+
+    char name[NAME_SIZE], secondName[NAME_SIZE];
+    snprintf(name, sizeof(name), "%s", c->name);
+    snprintf(secondName, sizeof(secondName), "%s", c->secondName);
+
+    uint32_t slot = b->h->count++;
+    b->first[slot] = Intern(b, name);
+    b->last[slot] = Intern(b, secondName);
+    snprintf(b->tel[slot], TEL_SIZE, "%s", c->tel);
+
+    ListAppend(b, &b->strings[b->first[slot]].refs, slot);
+    ListAppend(b, &b->strings[b->last[slot]].refs, slot);
+    for (size_t k = 0; k + 3 <= strlen(b->tel[slot]); k++)
+        ListAppend(b, GramList(b, GRAM_TEL, b->tel[slot] + k), slot);
+
+    PhoneInsert(b, slot);
+    FenwickAdd(b, slot, 1);
+    b->h->live++;
+    return 0;
+}
+
+// Deletes the record in slot; its index entries are skipped from now on
+int BookDelete(struct book *b, uint32_t slot)
+{
+    if (slot >= b->h->count || b->first[slot] == NO_STRING)
+        return -1;
+
+    uint32_t mask = b->h->cap[SEC_PHONE] - 1;
+    uint32_t i = HashBytes(b->tel[slot], strlen(b->tel[slot])) & mask;
+    for (; b->phone[i]; i = (i + 1) & mask)
+    {
+        if (b->phone[i] == slot + 1)
+        {
+            b->phone[i] = TOMBSTONE;
+            break;
+        }
+    }
+
+    b->first[slot] = NO_STRING;
+    FenwickAdd(b, slot, -1);
+    b->h->live--;
+    return 0;
+}
+
+void BookGet(struct book *b, uint32_t slot, struct customer *c)
+{
+    snprintf(c->name, sizeof(c->name), "%s", b->pool + b->strings[b->first[slot]].offset);
+    snprintf(c->secondName, sizeof(c->secondName), "%s", b->pool + b->strings[b->last[slot]].offset);
+    memcpy(c->tel, b->tel[slot], TEL_SIZE);
+}
+
+// 1-based position of a live record in the list
+uint32_t BookPosition(struct book *b, uint32_t slot)
+{
+    uint32_t sum = 0;
+    for (uint32_t i = slot + 1; i > 0; i -= i & -i)
+        sum += b->fenwick[i];
+    return sum;
+}
+
+// slot of the record at 1-based position, which must exist
+uint32_t BookSlotAt(struct book *b, uint32_t position)
+{
+    uint32_t n = b->h->cap[SEC_FENWICK] - 1;
+    uint32_t step = 1;
+    while (step * 2 <= n)
+        step *= 2;
+
+    uint32_t i = 0;
+    for (; step; step /= 2)
+    {
+        if (i + step <= n && b->fenwick[i + step] < position)
+        {
+            i += step;
+            position -= b->fenwick[i];
+        }
+    }
+    return i;
+}
+
+static int SlotPush(struct slotList *out, uint32_t slot)
+{
+    if (out->count == out->capacity)
+    {
+        size_t cap = out->capacity ? out->capacity * 2 : 64;
+        uint32_t *slots = realloc(out->slots, cap * sizeof(*slots));
+        if (slots == NULL)
+            return -1;
+        out->slots = slots;
+        out->capacity = cap;
+    }
+    out->slots[out->count++] = slot;
+    return 0;
+}
+
+static int CompareSlots(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// sorts the slots into list order and drops the repeats
+static void SlotFinish(struct slotList *out)
+{
+    qsort(out->slots, out->count, sizeof(uint32_t), CompareSlots);
+    size_t n = 0;
+    for (size_t i = 0; i < out->count; i++)
+        if (n == 0 || out->slots[n - 1] != out->slots[i])
+            out->slots[n++] = out->slots[i];
+    out->count = n;
+}
+
+static int PushName(struct book *b, uint32_t id, struct slotList *out)
+{
+    for (uint32_t k = b->strings[id].refs.head; k; k = b->blocks[k].next)
+    {
+        const struct postingBlock *blk = &b->blocks[k];
+        for (uint32_t j = 0; j < blk->count; j++)
+        {
+            uint32_t slot = blk->ids[j];
+            if (b->first[slot] != NO_STRING && SlotPush(out, slot) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+// the shortest list among the trigrams of the query
+static const struct postingList *RarestGram(struct book *b, int kind, const char *q, size_t len)
+{
+    const struct postingList *best = NULL;
+    for (size_t k = 0; k + 3 <= len; k++)
+    {
+        const struct postingList *l = GramList(b, kind, q + k);
+        if (best == NULL || l->count < best->count)
+            best = l;
+    }
+    return best;
+}
+
+/*
+ * Records whose name, second name or phone contains query, in list
+ * order. Queries of three bytes or more are answered from the rarest
+ * trigram's list; shorter ones scan the distinct names and the phone
+ * column, which is still far less than the old walk over every node.
+ */
+int BookSearch(struct book *b, const char *query, struct slotList *out)
+{
+    size_t len = strlen(query);
+    out->count = 0;
+
+    if (len == 0)
+    {
+        for (uint32_t slot = 0; slot < b->h->count; slot++)
+            if (b->first[slot] != NO_STRING && SlotPush(out, slot) != 0)
+                return -1;
+        return 0;
+    }
+
+    if (len < 3)
+    {
+        for (uint32_t id = 0; id < b->h->strings; id++)
+            if (strstr(b->pool + b->strings[id].offset, query) && PushName(b, id, out) != 0)
+                return -1;
+        if (IsDigitsOnly(query))
+            for (uint32_t slot = 0; slot < b->h->count; slot++)
+                if (b->first[slot] != NO_STRING && strstr(b->tel[slot], query) &&
+                    SlotPush(out, slot) != 0)
+                    return -1;
+        SlotFinish(out);
+        return 0;
+    }
+
+    const struct postingList *names = RarestGram(b, GRAM_NAME, query, len);
+    for (uint32_t k = names->head; k; k = b->blocks[k].next)
+    {
+        const struct postingBlock *blk = &b->blocks[k];
+        for (uint32_t j = 0; j < blk->count; j++)
+        {
+            uint32_t id = blk->ids[j];
+            if (strstr(b->pool + b->strings[id].offset, query) && PushName(b, id, out) != 0)
+                return -1;
+        }
+    }
+
+    // phone numbers are digits only, nothing else can be in them
+    if (IsDigitsOnly(query))
+    {
+        const struct postingList *tels = RarestGram(b, GRAM_TEL, query, len);
+        for (uint32_t k = tels->head; k; k = b->blocks[k].next)
+        {
+            const struct postingBlock *blk = &b->blocks[k];
+            for (uint32_t j = 0; j < blk->count; j++)
+            {
+                uint32_t slot = blk->ids[j];
+                if (b->first[slot] != NO_STRING && strstr(b->tel[slot], query) &&
+                    SlotPush(out, slot) != 0)
+                    return -1;
+            }
+        }
+    }
+
+    SlotFinish(out);
+    return 0;
+}
+
+// Records with exactly this phone number, in list order
+int BookFindPhone(struct book *b, const char *tel, struct slotList *out)
+{
+    out->count = 0;
+    uint32_t mask = b->h->cap[SEC_PHONE] - 1;
+    uint32_t i = HashBytes(tel, strlen(tel)) & mask;
+
+    for (; b->phone[i]; i = (i + 1) & mask)
+    {
+        uint32_t v = b->phone[i];
+        if (v != TOMBSTONE && strcmp(b->tel[v - 1], tel) == 0 && SlotPush(out, v - 1) != 0)
+            return -1;
+    }
+    SlotFinish(out);
+    return 0;
+}
+
+/* Benchmark */
+
+#define BENCH_RECORDS 1000000
+#define BENCH_LOOKUPS 100000
+#define BENCH_DELETES 100000
+#define LEGACY_INSERTS 20000
+#define LEGACY_DELETES 1000
+
+// the old layout: one malloc per record in a doubly linked list
+struct legacyCustomer
+{
+    char name[NAME_SIZE];
+    char secondName[NAME_SIZE];
+    char tel[TEL_SIZE];
+
+    struct legacyCustomer *prev;
+    struct legacyCustomer *next;
+};
+
+static double NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint64_t benchSeed = 88172645463325252ull;
+
+static uint64_t BenchRandom(void)
+{
+    benchSeed ^= benchSeed << 13;
+    benchSeed ^= benchSeed >> 7;
+    benchSeed ^= benchSeed << 17;
+    return benchSeed;
+}
+
+static const char *syllables[] = {
+    "an", "na", "iv", "ov", "ser", "gei", "ol", "ga", "ma", "ri", "ya", "dmi",
+    "tri", "ka", "te", "ni", "ko", "la", "pe", "tr", "vo", "ev", "ale", "xe",
+    "ro", "man", "sve", "ta", "yu", "li", "bo", "ris", "ku", "zne", "tso", "va"
+};
+
+static void BenchName(char *buf, int parts)
+{
+    buf[0] = '\0';
+    for (int i = 0; i < parts; i++)
+        strcat(buf, syllables[BenchRandom() % (sizeof(syllables) / sizeof(syllables[0]))]);
+    buf[0] = toupper((unsigned char)buf[0]);
+}
+
+static void BenchCustomer(struct customer *c)
+{
+    BenchName(c->name, 2 + BenchRandom() % 2);
+    BenchName(c->secondName, 3 + BenchRandom() % 2);
+    snprintf(c->tel, sizeof(c->tel), "9%09llu", (unsigned long long)(BenchRandom() % 1000000000ull));
+}
+
+// the old append walks to the tail every time
+static struct legacyCustomer *LegacyAdd(struct legacyCustomer **head, const struct customer *c)
+{
+    struct legacyCustomer *node = malloc(sizeof(struct legacyCustomer));
+    memcpy(node->name, c->name, NAME_SIZE);
+    memcpy(node->secondName, c->secondName, NAME_SIZE);
+    memcpy(node->tel, c->tel, TEL_SIZE);
+    node->next = node->prev = NULL;
+
+    if (*head == NULL)
+    {
+        *head = node;
+        return node;
+    }
+    struct legacyCustomer *cur = *head;
+    while (cur->next)
+        cur = cur->next;
+    cur->next = node;
+    node->prev = cur;
+    return node;
+}
+
+static size_t LegacySearch(struct legacyCustomer *head, const char *query)
+{
+    size_t found = 0;
+    for (; head; head = head->next)
+        if (strstr(head->name, query) || strstr(head->secondName, query) || strstr(head->tel, query))
+            found++;
+    return found;
+}
+
+static void LegacyDelete(struct legacyCustomer **head, int n)
+{
+    struct legacyCustomer *current = *head;
+    for (int i = 1; current && i < n; i++)
+        current = current->next;
+    if (!current)
+        return;
+    if (current->prev)
+        current->prev->next = current->next;
+    else
+        *head = current->next;
+    if (current->next)
+        current->next->prev = current->prev;
+    free(current);
+}
+
+/*
+ * Inserts, searches and deletes on `records` generated subscribers, in
+ * the mapped directory and in the old linked list. The old list is
+ * built with a tail pointer; its own append (a walk to the tail) is
+ * timed separately on LEGACY_INSERTS records, as it is quadratic.
+ */
+int BenchBook(int records, const char *path)
+{
+    if (records <= 0)
+        records = BENCH_RECORDS;
+
+    char tmpPath[64];
+    if (path == NULL)
+    {
+        snprintf(tmpPath, sizeof(tmpPath), "/tmp/task6_bench_%d.db", (int)getpid());
+        path = tmpPath;
+    }
+    unlink(path);
+
+    struct customer *input = malloc((size_t)records * sizeof(struct customer));
+    if (input == NULL)
+    {
+        perror("malloc");
+        return 1;
+    }
+    for (int i = 0; i < records; i++)
+        BenchCustomer(&input[i]);
+
+    printf("%d записей, файл %s\n\n", records, path);
+
+    // insert
+    struct book *b = OpenBook(path);
+    if (b == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+    double t0 = NowMs();
+    for (int i = 0; i < records; i++)
+        BookAdd(b, &input[i]);
+    double bookInsert = NowMs() - t0;
+
+    struct legacyCustomer *head = NULL;
+    t0 = NowMs();
+    for (int i = 0; i < LEGACY_INSERTS && i < records; i++)
+        LegacyAdd(&head, &input[i]);
+    double legacyInsert = NowMs() - t0;
+    int legacyInserted = LEGACY_INSERTS < records ? LEGACY_INSERTS : records;
+
+    struct legacyCustomer *tail = head;
+    while (tail && tail->next)
+        tail = tail->next;
+    for (int i = legacyInserted; i < records; i++)
+    {
+        struct legacyCustomer *node = malloc(sizeof(struct legacyCustomer));
+        memcpy(node->name, input[i].name, NAME_SIZE);
+        memcpy(node->secondName, input[i].secondName, NAME_SIZE);
+        memcpy(node->tel, input[i].tel, TEL_SIZE);
+        node->next = NULL;
+        node->prev = tail;
+        if (tail)
+            tail->next = node;
+        else
+            head = node;
+        tail = node;
+    }
+
+    printf("%10.3f us/запись  вставка в файл, всего %.1f ms\n",
+        bookInsert * 1e3 / records, bookInsert);
+    printf("%10.3f us/запись  вставка в старый список (первые %d, растёт с длиной)\n",
+        legacyInsert * 1e3 / legacyInserted, legacyInserted);
+
+    // reopen
+    CloseBook(b, NULL);
+    t0 = NowMs();
+    b = OpenBook(path);
+    double reopen = NowMs() - t0;
+    if (b == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+    printf("%10.3f ms         открытие файла: %u записей, %.1f MiB\n", reopen,
+        b->h->live, b->h->fileSize / 1048576.0);
+
+    // substring search, checked against the old walk
+    const char *queries[] = { "ov", "Ivan", "ser", "olgavo", "trikan", "4242", "9123456", "xyz" };
+    int same = 1;
+    struct slotList found = {0};
+    printf("\n   найдено  индекс ms  список ms  запрос\n");
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++)
+    {
+        t0 = NowMs();
+        BookSearch(b, queries[q], &found);
+        double fast = NowMs() - t0;
+        t0 = NowMs();
+        size_t expect = LegacySearch(head, queries[q]);
+        double slow = NowMs() - t0;
+        same = same && found.count == expect;
+        printf("%10zu %10.3f %10.3f  %s%s\n", found.count, fast, slow, queries[q],
+            found.count == expect ? "" : "   (РАСХОЖДЕНИЕ)");
+    }
+
+    // exact phone lookups
+    t0 = NowMs();
+    size_t hits = 0;
+    for (int i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        BookFindPhone(b, input[BenchRandom() % records].tel, &found);
+        hits += found.count > 0;
+    }
+    double lookups = NowMs() - t0;
+    same = same && hits == BENCH_LOOKUPS;
+    printf("\n%10.3f us/запрос  поиск по телефону через хеш: %zu из %d найдено\n",
+        lookups * 1e3 / BENCH_LOOKUPS, hits, BENCH_LOOKUPS);
+
+    // deletes by position
+    int deletes = BENCH_DELETES < records / 2 ? BENCH_DELETES : records / 2;
+    t0 = NowMs();
+    for (int i = 0; i < deletes; i++)
+        BookDelete(b, BookSlotAt(b, 1 + BenchRandom() % b->h->live));
+    double bookDelete = NowMs() - t0;
+
+    int legacyDeletes = LEGACY_DELETES < deletes ? LEGACY_DELETES : deletes;
+    t0 = NowMs();
+    for (int i = 0; i < legacyDeletes; i++)
+        LegacyDelete(&head, 1 + BenchRandom() % (records - i));
+    double legacyDelete = NowMs() - t0;
+
+    printf("%10.3f us/запись  удаление по позиции из файла: %d удалений\n",
+        bookDelete * 1e3 / deletes, deletes);
+    printf("%10.3f us/запись  удаление из старого списка: %d удалений\n",
+        legacyDelete * 1e3 / legacyDeletes, legacyDeletes);
+
+    // the list must still read back in order after the deletes
+    uint32_t expectLive = records - deletes;
+    same = same && b->h->live == expectLive && BookPosition(b, BookSlotAt(b, expectLive)) == expectLive;
+
+    t0 = NowMs();
+    BookSearch(b, "Ivan", &found);
+    printf("%10.3f ms         поиск после удалений: %zu найдено\n", NowMs() - t0, found.count);
+
+    free(found.slots);
+    CloseBook(b, NULL);
+    while (head)
+    {
+        struct legacyCustomer *next = head->next;
+        free(head);
+        head = next;
+    }
+    free(input);
+    if (path == tmpPath)
+        unlink(path);
+
+    printf("\nрезультаты совпадают: %s\n", same ? "да" : "НЕТ");
+    return same ? 0 : 1;
+}
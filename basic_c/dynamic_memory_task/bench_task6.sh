@@ -0,0 +1,12 @@
+#!/bin/sh
+# Task6.c: insert, substring search, phone lookup and delete by position
+# on COUNT generated subscribers in the mapped directory, against the old
+# linked list (its quadratic append timed on the first 20000 only).
+# usage: ./bench_task6.sh [count] [file]
+
+COUNT=${1:-1000000}
+BIN=/tmp/task6.out
+
+gcc -std=c11 -O2 -o "$BIN" Task6.c || exit 1
+
+"$BIN" --bench "$COUNT" $2
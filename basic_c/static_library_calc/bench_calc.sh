@@ -0,0 +1,16 @@
+#!/bin/sh
+# Batch calls (add_n, sub_n, mul_n, superdiv_n) with every kernel the CPU
+# has, against a loop of single calls, on 4096 and 4M elements, linked
+# with the static libcalc.a.
+# usage: ./bench_calc.sh
+
+DIR=/tmp/calc_static
+mkdir -p "$DIR" || exit 1
+
+for f in add sub mul div batch; do
+    gcc -std=gnu11 -O2 -c "lib/$f.c" -o "$DIR/$f.o" || exit 1
+done
+ar rcs "$DIR/libcalc.a" "$DIR"/*.o || exit 1
+gcc -std=gnu11 -O2 -o "$DIR/bench" src/bench.c "$DIR/libcalc.a" || exit 1
+
+"$DIR/bench"
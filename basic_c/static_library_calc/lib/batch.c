@@ -0,0 +1,420 @@
+#include <limits.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CALC_X86 1
+#endif
+
+#include "calc.h"
+
+typedef void (*int_kernel)(const int *a, const int *b, int *out, uint8_t *ovf, size_t n);
+typedef void (*div_kernel)(const int *a, const int *b, double *out, uint8_t *ovf, size_t n);
+
+struct kernels
+{
+    const char *name;
+    int_kernel add;
+    int_kernel sub;
+    int_kernel mul;
+    div_kernel div;
+};
+
+/* Scalar: the single-value functions themselves, so every other kernel
+ * is checked against exactly what add() & co. answer */
+
+static void add_scalar(const int *a, const int *b, int *out, uint8_t *ovf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        ovf[i] = !add(a[i], b[i], &out[i]);
+        if (ovf[i])
+            out[i] = 0;
+    }
+}
+
+static void sub_scalar(const int *a, const int *b, int *out, uint8_t *ovf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        ovf[i] = !sub(a[i], b[i], &out[i]);
+        if (ovf[i])
+            out[i] = 0;
+    }
+}
+
+static void mul_scalar(const int *a, const int *b, int *out, uint8_t *ovf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        ovf[i] = !mul(a[i], b[i], &out[i]);
+        if (ovf[i])
+            out[i] = 0;
+    }
+}
+
+static void div_scalar(const int *a, const int *b, double *out, uint8_t *ovf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        ovf[i] = !superdiv(a[i], b[i], &out[i]);
+        if (ovf[i])
+            out[i] = 0.0;
+    }
+}
+
+#ifdef CALC_X86
+
+/*
+ * Overflow without branches, on wrapped results:
+ * - add: r = a + b overflowed iff a and b have the same sign and r does
+ *   not, i.e. the sign bit of (a ^ r) & (b ^ r)
+ * - sub: r = a - b overflowed iff the sign bit of (a ^ b) & (a ^ r)
+ * - mul: the 64-bit product does not fit iff its high half is not the
+ *   sign extension of its low half
+ * Each op returns its lanes' flags as 0 / -1 and the result zeroed there.
+ */
+
+__attribute__((target("sse4.1")))
+static inline __m128i add4(__m128i a, __m128i b, __m128i *bad)
+{
+    __m128i r = _mm_add_epi32(a, b);
+    *bad = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(a, r), _mm_xor_si128(b, r)), 31);
+    return _mm_andnot_si128(*bad, r);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i sub4(__m128i a, __m128i b, __m128i *bad)
+{
+    __m128i r = _mm_sub_epi32(a, b);
+    *bad = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(a, b), _mm_xor_si128(a, r)), 31);
+    return _mm_andnot_si128(*bad, r);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i mul4(__m128i a, __m128i b, __m128i *bad)
+{
+    // _mm_mul_epi32 multiplies lanes 0 and 2; shifting brings 1 and 3 down
+    __m128i even = _mm_mul_epi32(a, b);
+    __m128i odd = _mm_mul_epi32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    __m128i lo = _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC);
+    __m128i hi = _mm_blend_epi16(_mm_srli_epi64(even, 32), odd, 0xCC);
+    *bad = _mm_xor_si128(_mm_cmpeq_epi32(hi, _mm_srai_epi32(lo, 31)), _mm_set1_epi32(-1));
+    return _mm_andnot_si128(*bad, lo);
+}
+
+// 16 flags of 0 / -1 in four vectors to 16 bytes of 0 / 1
+__attribute__((target("sse4.1")))
+static inline void store_flags16(uint8_t *ovf, const __m128i *bad)
+{
+    __m128i flags = _mm_packs_epi16(_mm_packs_epi32(bad[0], bad[1]), _mm_packs_epi32(bad[2], bad[3]));
+    _mm_storeu_si128((__m128i *)ovf, _mm_and_si128(flags, _mm_set1_epi8(1)));
+}
+
+#define SSE41_KERNEL(name, op, tail)                                              \
+    __attribute__((target("sse4.1")))                                            \
+    static void name(const int *a, const int *b, int *out, uint8_t *ovf, size_t n) \
+    {                                                                              \
+        size_t i = 0;                                                              \
+        for (; i + 16 <= n; i += 16)                                               \
+        {                                                                          \
+            __m128i bad[4];                                                        \
+            for (int k = 0; k < 4; k++)                                            \
+            {                                                                      \
+                __m128i va = _mm_loadu_si128((const __m128i *)(a + i + 4 * k));    \
+                __m128i vb = _mm_loadu_si128((const __m128i *)(b + i + 4 * k));    \
+                _mm_storeu_si128((__m128i *)(out + i + 4 * k), op(va, vb, &bad[k])); \
+            }                                                                      \
+            store_flags16(ovf + i, bad);                                           \
+        }                                                                          \
+        tail(a + i, b + i, out + i, ovf + i, n - i);                               \
+    }
+
+SSE41_KERNEL(add_sse41, add4, add_scalar)
+SSE41_KERNEL(sub_sse41, sub4, sub_scalar)
+SSE41_KERNEL(mul_sse41, mul4, mul_scalar)
+
+// b == 0, or INT_MIN / -1, as 0 / -1 per lane
+__attribute__((target("sse4.1")))
+static inline __m128i div_bad4(__m128i a, __m128i b)
+{
+    __m128i zero = _mm_cmpeq_epi32(b, _mm_setzero_si128());
+    __m128i edge = _mm_and_si128(_mm_cmpeq_epi32(a, _mm_set1_epi32(INT_MIN)),
+        _mm_cmpeq_epi32(b, _mm_set1_epi32(-1)));
+    return _mm_or_si128(zero, edge);
+}
+
+__attribute__((target("sse4.1")))
+static void div_sse41(const int *a, const int *b, double *out, uint8_t *ovf, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i bad[4];
+        for (int k = 0; k < 4; k++)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + i + 4 * k));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + i + 4 * k));
+            bad[k] = div_bad4(va, vb);
+
+            // two doubles at a time; the flags widened to 64-bit masks
+            for (int h = 0; h < 2; h++)
+            {
+                __m128d q = _mm_div_pd(_mm_cvtepi32_pd(va), _mm_cvtepi32_pd(vb));
+                __m128d keep = _mm_castsi128_pd(_mm_cvtepi32_epi64(bad[k]));
+                _mm_storeu_pd(out + i + 4 * k + 2 * h, _mm_andnot_pd(keep, q));
+                va = _mm_srli_si128(va, 8);
+                vb = _mm_srli_si128(vb, 8);
+                bad[k] = _mm_alignr_epi8(bad[k], bad[k], 8);
+            }
+        }
+        store_flags16(ovf + i, bad);
+    }
+    div_scalar(a + i, b + i, out + i, ovf + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i add8(__m256i a, __m256i b, __m256i *bad)
+{
+    __m256i r = _mm256_add_epi32(a, b);
+    *bad = _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(a, r), _mm256_xor_si256(b, r)), 31);
+    return _mm256_andnot_si256(*bad, r);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i sub8(__m256i a, __m256i b, __m256i *bad)
+{
+    __m256i r = _mm256_sub_epi32(a, b);
+    *bad = _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(a, r)), 31);
+    return _mm256_andnot_si256(*bad, r);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mul8(__m256i a, __m256i b, __m256i *bad)
+{
+    __m256i even = _mm256_mul_epi32(a, b);
+    __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    __m256i lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    __m256i hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    *bad = _mm256_xor_si256(_mm256_cmpeq_epi32(hi, _mm256_srai_epi32(lo, 31)), _mm256_set1_epi32(-1));
+    return _mm256_andnot_si256(*bad, lo);
+}
+
+// 32 flags to 32 bytes; the packs work per 128-bit lane, the permute
+// puts the four-byte groups back in order
+__attribute__((target("avx2")))
+static inline void store_flags32(uint8_t *ovf, const __m256i *bad)
+{
+    __m256i flags = _mm256_packs_epi16(_mm256_packs_epi32(bad[0], bad[1]),
+        _mm256_packs_epi32(bad[2], bad[3]));
+    flags = _mm256_permutevar8x32_epi32(flags, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm256_storeu_si256((__m256i *)ovf, _mm256_and_si256(flags, _mm256_set1_epi8(1)));
+}
+
+#define AVX2_KERNEL(name, op, tail)                                               \
+    __attribute__((target("avx2")))                                              \
+    static void name(const int *a, const int *b, int *out, uint8_t *ovf, size_t n) \
+    {                                                                              \
+        size_t i = 0;                                                              \
+        for (; i + 32 <= n; i += 32)                                               \
+        {                                                                          \
+            __m256i bad[4];                                                        \
+            for (int k = 0; k < 4; k++)                                            \
+            {                                                                      \
+                __m256i va = _mm256_loadu_si256((const __m256i *)(a + i + 8 * k)); \
+                __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i + 8 * k)); \
+                _mm256_storeu_si256((__m256i *)(out + i + 8 * k), op(va, vb, &bad[k])); \
+            }                                                                      \
+            store_flags32(ovf + i, bad);                                           \
+        }                                                                          \
+        tail(a + i, b + i, out + i, ovf + i, n - i);                               \
+    }
+
+AVX2_KERNEL(add_avx2, add8, add_sse41)
+AVX2_KERNEL(sub_avx2, sub8, sub_sse41)
+AVX2_KERNEL(mul_avx2, mul8, mul_sse41)
+
+__attribute__((target("avx2")))
+static void div_avx2(const int *a, const int *b, double *out, uint8_t *ovf, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i bad[4];
+        for (int k = 0; k < 4; k++)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + i + 4 * k));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + i + 4 * k));
+            bad[k] = div_bad4(va, vb);
+
+            __m256d q = _mm256_div_pd(_mm256_cvtepi32_pd(va), _mm256_cvtepi32_pd(vb));
+            __m256d keep = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(bad[k]));
+            _mm256_storeu_pd(out + i + 4 * k, _mm256_andnot_pd(keep, q));
+        }
+        store_flags16(ovf + i, bad);
+    }
+    div_scalar(a + i, b + i, out + i, ovf + i, n - i);
+}
+
+/* AVX-512: the compares give the flags in a mask register, and masked
+ * loads and stores take the tail, so there is no scalar loop at the end */
+
+#define AVX512_TARGET __attribute__((target("avx512f,avx512bw,avx512vl")))
+
+AVX512_TARGET
+static inline __m512i add16(__m512i a, __m512i b, __mmask16 *bad)
+{
+    __m512i r = _mm512_add_epi32(a, b);
+    *bad = _mm512_cmplt_epi32_mask(_mm512_and_si512(_mm512_xor_si512(a, r), _mm512_xor_si512(b, r)),
+        _mm512_setzero_si512());
+    return _mm512_maskz_mov_epi32((__mmask16)~*bad, r);
+}
+
+AVX512_TARGET
+static inline __m512i sub16(__m512i a, __m512i b, __mmask16 *bad)
+{
+    __m512i r = _mm512_sub_epi32(a, b);
+    *bad = _mm512_cmplt_epi32_mask(_mm512_and_si512(_mm512_xor_si512(a, b), _mm512_xor_si512(a, r)),
+        _mm512_setzero_si512());
+    return _mm512_maskz_mov_epi32((__mmask16)~*bad, r);
+}
+
+AVX512_TARGET
+static inline __m512i mul16(__m512i a, __m512i b, __mmask16 *bad)
+{
+    __m512i even = _mm512_mul_epi32(a, b);
+    __m512i odd = _mm512_mul_epi32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+    __m512i lo = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+    __m512i hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+    *bad = _mm512_cmpneq_epi32_mask(hi, _mm512_srai_epi32(lo, 31));
+    return _mm512_maskz_mov_epi32((__mmask16)~*bad, lo);
+}
+
+AVX512_TARGET
+static inline __mmask16 tail_mask16(size_t left)
+{
+    return left >= 16 ? 0xFFFF : (__mmask16)((1u << left) - 1);
+}
+
+#define AVX512_KERNEL(name, op)                                                    \
+    AVX512_TARGET                                                                  \
+    static void name(const int *a, const int *b, int *out, uint8_t *ovf, size_t n) \
+    {                                                                              \
+        for (size_t i = 0; i < n; i += 16)                                         \
+        {                                                                          \
+            __mmask16 m = tail_mask16(n - i);                                      \
+            __m512i va = _mm512_maskz_loadu_epi32(m, a + i);                       \
+            __m512i vb = _mm512_maskz_loadu_epi32(m, b + i);                       \
+            __mmask16 bad;                                                         \
+            _mm512_mask_storeu_epi32(out + i, m, op(va, vb, &bad));                \
+            _mm_mask_storeu_epi8(ovf + i, m, _mm_maskz_set1_epi8(bad, 1));         \
+        }                                                                          \
+    }
+
+AVX512_KERNEL(add_avx512, add16)
+AVX512_KERNEL(sub_avx512, sub16)
+AVX512_KERNEL(mul_avx512, mul16)
+
+AVX512_TARGET
+static void div_avx512(const int *a, const int *b, double *out, uint8_t *ovf, size_t n)
+{
+    for (size_t i = 0; i < n; i += 16)
+    {
+        __mmask16 m = tail_mask16(n - i);
+        __m512i va = _mm512_maskz_loadu_epi32(m, a + i);
+        __m512i vb = _mm512_maskz_loadu_epi32(m, b + i);
+        __mmask16 bad = _mm512_cmpeq_epi32_mask(vb, _mm512_setzero_si512())
+            | (_mm512_cmpeq_epi32_mask(va, _mm512_set1_epi32(INT_MIN))
+                & _mm512_cmpeq_epi32_mask(vb, _mm512_set1_epi32(-1)));
+        __mmask16 keep = (__mmask16)~bad;
+
+        // eight doubles per half; bad lanes are not divided at all
+        __m512d lo = _mm512_maskz_div_pd((__mmask8)keep,
+            _mm512_cvtepi32_pd(_mm512_castsi512_si256(va)), _mm512_cvtepi32_pd(_mm512_castsi512_si256(vb)));
+        __m512d hi = _mm512_maskz_div_pd((__mmask8)(keep >> 8),
+            _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(va, 1)), _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(vb, 1)));
+        _mm512_mask_storeu_pd(out + i, (__mmask8)m, lo);
+        _mm512_mask_storeu_pd(out + i + 8, (__mmask8)(m >> 8), hi);
+        _mm_mask_storeu_epi8(ovf + i, m, _mm_maskz_set1_epi8(bad, 1));
+    }
+}
+
+#endif
+
+static const struct kernels table[] = {
+#ifdef CALC_X86
+    { "avx512", add_avx512, sub_avx512, mul_avx512, div_avx512 },
+    { "avx2", add_avx2, sub_avx2, mul_avx2, div_avx2 },
+    { "sse4.1", add_sse41, sub_sse41, mul_sse41, div_sse41 },
+#endif
+    { "scalar", add_scalar, sub_scalar, mul_scalar, div_scalar },
+};
+
+static const struct kernels *active = &table[sizeof(table) / sizeof(table[0]) - 1];
+
+static int supported(const struct kernels *k)
+{
+#ifdef CALC_X86
+    __builtin_cpu_init();
+    if (strcmp(k->name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vl");
+    if (strcmp(k->name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if (strcmp(k->name, "sse4.1") == 0)
+        return __builtin_cpu_supports("sse4.1");
+#endif
+    return 1;
+}
+
+// the table is ordered best first
+__attribute__((constructor))
+static void pick_kernel(void)
+{
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        if (supported(&table[i]))
+        {
+            active = &table[i];
+            return;
+        }
+    }
+}
+
+const char *calc_kernel(void)
+{
+    return active->name;
+}
+
+int calc_use_kernel(const char *name)
+{
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        if (strcmp(table[i].name, name) == 0 && supported(&table[i]))
+        {
+            active = &table[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void add_n(const int *a, const int *b, int *out, uint8_t *ovf, size_t n)
+{
+    active->add(a, b, out, ovf, n);
+}
+
+void sub_n(const int *a, const int *b, int *out, uint8_t *ovf, size_t n)
+{
+    active->sub(a, b, out, ovf, n);
+}
+
+void mul_n(const int *a, const int *b, int *out, uint8_t *ovf, size_t n)
+{
+    active->mul(a, b, out, ovf, n);
+}
+
+void superdiv_n(const int *a, const int *b, double *out, uint8_t *ovf, size_t n)
+{
+    active->div(a, b, out, ovf, n);
+}
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../lib/calc.h"
+
+// Batch calls against a loop of single calls, on an array that fits in
+// the cache and on one that does not; every kernel must give the same
+// results as the loop.
+
+#define SMALL_N 4096
+#define LARGE_N (1 << 22)
+#define TOTAL_ELEMENTS (64 << 20)
+
+static const char *kernelNames[] = { "scalar", "sse4.1", "avx2", "avx512" };
+
+static double NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static unsigned long long seed = 88172645463325252ull;
+
+// half the values small, so that some products fit and some sums do not
+static int RandomInt(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    int v = (int)(seed >> 32);
+    return (seed & 1) ? v : v % 40000;
+}
+
+static void LoopInt(int op, const int *a, const int *b, int *out, uint8_t *ovf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        int r;
+        int ok = op == 0 ? add(a[i], b[i], &r) : op == 1 ? sub(a[i], b[i], &r) : mul(a[i], b[i], &r);
+        out[i] = ok ? r : 0;
+        ovf[i] = !ok;
+    }
+}
+
+static void LoopDiv(const int *a, const int *b, double *out, uint8_t *ovf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        double r;
+        int ok = superdiv(a[i], b[i], &r);
+        out[i] = ok ? r : 0.0;
+        ovf[i] = !ok;
+    }
+}
+
+static void Batch(int op, const int *a, const int *b, void *out, uint8_t *ovf, size_t n)
+{
+    if (op == 0)
+        add_n(a, b, out, ovf, n);
+    else if (op == 1)
+        sub_n(a, b, out, ovf, n);
+    else if (op == 2)
+        mul_n(a, b, out, ovf, n);
+    else
+        superdiv_n(a, b, out, ovf, n);
+}
+
+// runs one method over n elements until TOTAL_ELEMENTS are done; ns per element
+static double Time(int op, int batch, const int *a, const int *b, void *out, uint8_t *ovf, size_t n)
+{
+    int reps = TOTAL_ELEMENTS / n;
+    double t0 = NowMs();
+    for (int r = 0; r < reps; r++)
+    {
+        if (batch)
+            Batch(op, a, b, out, ovf, n);
+        else if (op == 3)
+            LoopDiv(a, b, out, ovf, n);
+        else
+            LoopInt(op, a, b, out, ovf, n);
+    }
+    return (NowMs() - t0) * 1e6 / ((double)reps * n);
+}
+
+int main(void)
+{
+    const char *opNames[] = { "add", "sub", "mul", "superdiv" };
+    size_t sizes[] = { SMALL_N, LARGE_N };
+
+    int *a = malloc(LARGE_N * sizeof(int));
+    int *b = malloc(LARGE_N * sizeof(int));
+    double *out = malloc(LARGE_N * sizeof(double));
+    double *expect = malloc(LARGE_N * sizeof(double));
+    uint8_t *ovf = malloc(LARGE_N);
+    uint8_t *expectOvf = malloc(LARGE_N);
+    if (!a || !b || !out || !expect || !ovf || !expectOvf)
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    for (size_t i = 0; i < LARGE_N; i++)
+    {
+        a[i] = RandomInt();
+        b[i] = RandomInt();
+    }
+    // the edge cases, somewhere inside a vector
+    a[5] = -2147483647 - 1; b[5] = -1;
+    a[6] = 7; b[6] = 0;
+    a[7] = 2147483647; b[7] = 1;
+
+    printf("ядро по умолчанию: %s\n\n", calc_kernel());
+    printf("операция   элементов    нс/элем      млн/с   ускор.  способ\n");
+
+    int same = 1;
+    for (int op = 0; op < 4; op++)
+    {
+        size_t width = op == 3 ? sizeof(double) : sizeof(int);
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            size_t n = sizes[s];
+            double loop = Time(op, 0, a, b, expect, expectOvf, n);
+            printf("%-9s %10zu %10.3f %10.1f %8.2f  цикл\n", opNames[op], n, loop, 1e3 / loop, 1.0);
+
+            for (size_t k = 0; k < sizeof(kernelNames) / sizeof(kernelNames[0]); k++)
+            {
+                if (!calc_use_kernel(kernelNames[k]))
+                    continue;
+                memset(out, 0x55, n * width);
+                double ns = Time(op, 1, a, b, out, ovf, n);
+                int ok = memcmp(out, expect, n * width) == 0 && memcmp(ovf, expectOvf, n) == 0;
+                same = same && ok;
+                printf("%-9s %10zu %10.3f %10.1f %8.2f  %s%s\n", opNames[op], n, ns, 1e3 / ns, loop / ns,
+                    kernelNames[k], ok ? "" : " (РАСХОЖДЕНИЕ)");
+            }
+        }
+    }
+
+    printf("\nрезультаты совпадают: %s\n", same ? "да" : "НЕТ");
+    free(a);
+    free(b);
+    free(out);
+    free(expect);
+    free(ovf);
+    free(expectOvf);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,8 @@
+#ifndef CPU_H
+#define CPU_H
+
+// placement names: none, same, sibling (other core, same socket), cross (other socket)
+int cpu_pick_pair(const char *placement, int *cpu_a, int *cpu_b);
+int cpu_pin(int cpu);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stddef.h>
+
+#define SIDE_PARENT 0
+#define SIDE_CHILD 1
+
+typedef struct transport transport_t;
+
+// One IPC mechanism. open() runs before fork(), attach() in both processes
+// after it, destroy() in the parent once the child has exited.
+// send()/recv() move one unit of at most t->chunk bytes in the direction
+// implied by t->side; recv() buffers are always at least t->chunk bytes.
+typedef struct 
+{
+    const char *name;
+    int (*open)(transport_t *t, size_t msg_size);
+    int (*attach)(transport_t *t, int side);
+    int (*send)(transport_t *t, const void *buf, size_t len);
+    int (*recv)(transport_t *t, void *buf, size_t len);
+    void (*close)(transport_t *t);
+    void (*destroy)(transport_t *t);
+} transport_ops_t;
+
+struct transport 
+{
+    const transport_ops_t *ops;
+    int side;
+    size_t chunk;
+    void *priv;
+};
+
+extern const transport_ops_t transport_pipe;
+extern const transport_ops_t transport_fifo;
+extern const transport_ops_t transport_unix_stream;
+extern const transport_ops_t transport_unix_dgram;
+extern const transport_ops_t transport_posix_mq;
+extern const transport_ops_t transport_sysv_msg;
+extern const transport_ops_t transport_posix_shm;
+extern const transport_ops_t transport_sysv_shm;
+
+// whole message, split into chunk-sized units
+int transport_send_msg(transport_t *t, const void *buf, size_t len);
+int transport_recv_msg(transport_t *t, void *buf, size_t len);
+
+// helpers for byte-stream fds
+int write_all(int fd, const void *buf, size_t len);
+int read_all(int fd, void *buf, size_t len);
+
+#endif
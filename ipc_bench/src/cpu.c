@@ -0,0 +1,79 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+
+#include "cpu.h"
+
+static int read_topology(int cpu, const char *field) 
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, field);
+    FILE *f = fopen(path, "r");
+    int v = -1;
+    if (f) 
+    {
+        if (fscanf(f, "%d", &v) != 1) 
+            v = -1;
+        fclose(f);
+    }
+    return v;
+}
+
+// pick two allowed cpus matching the placement; -1/-1 for "none"
+int cpu_pick_pair(const char *placement, int *cpu_a, int *cpu_b) 
+{
+    *cpu_a = *cpu_b = -1;
+    if (strcmp(placement, "none") == 0) 
+        return 0;
+
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == -1) 
+        return -1;
+
+    int first = -1;
+    for (int c = 0; c < CPU_SETSIZE; c++) 
+    {
+        if (CPU_ISSET(c, &set)) 
+        {
+            first = c;
+            break;
+        }
+    }
+    if (first == -1) 
+        return -1;
+
+    if (strcmp(placement, "same") == 0) 
+    {
+        *cpu_a = *cpu_b = first;
+        return 0;
+    }
+
+    int pkg = read_topology(first, "physical_package_id");
+    int core = read_topology(first, "core_id");
+    for (int c = first + 1; c < CPU_SETSIZE; c++) 
+    {
+        if (!CPU_ISSET(c, &set)) 
+            continue;
+        int c_pkg = read_topology(c, "physical_package_id");
+        int c_core = read_topology(c, "core_id");
+        if ((strcmp(placement, "sibling") == 0 && c_pkg == pkg && c_core != core) 
+            || (strcmp(placement, "cross") == 0 && c_pkg != pkg)) 
+        {
+            *cpu_a = first;
+            *cpu_b = c;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int cpu_pin(int cpu) 
+{
+    if (cpu < 0) 
+        return 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
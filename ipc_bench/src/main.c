@@ -0,0 +1,402 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "transport.h"
+#include "cpu.h"
+
+#define MAX_LIST 32
+#define ACK_SIZE 8
+#define PINGPONG_MAX_BYTES (1UL << 30)
+#define PINGPONG_MIN_ROUNDS 20
+#define STREAM_WINDOW 64
+
+#define MODE_PINGPONG 0x1
+#define MODE_STREAM 0x2
+
+static const transport_ops_t *all_transports[] = 
+{
+    &transport_pipe, &transport_fifo, &transport_unix_stream, &transport_unix_dgram,
+    &transport_posix_mq, &transport_sysv_msg, &transport_posix_shm, &transport_sysv_shm
+};
+#define TRANSPORTS_COUNT (sizeof(all_transports) / sizeof(all_transports[0]))
+
+typedef struct 
+{
+    const transport_ops_t *transports[TRANSPORTS_COUNT];
+    int transports_count;
+    size_t sizes[MAX_LIST];
+    int sizes_count;
+    size_t batches[MAX_LIST];
+    int batches_count;
+    const char *placements[MAX_LIST];
+    int placements_count;
+    int modes;
+    unsigned long iterations;
+    unsigned long stream_mb;
+    size_t window;
+    FILE *out;
+} bench_cfg_t;
+
+typedef struct 
+{
+    const transport_ops_t *ops;
+    const char *placement;
+    int cpu_a;
+    int cpu_b;
+    size_t size;
+    size_t batch;       // pingpong: messages per round trip
+    size_t window;      // stream: messages per ack, 0 = one ack at the end
+    int mode;
+    unsigned long rounds;
+} run_t;
+
+static double now_sec(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b) 
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void child_loop(transport_t *t, const run_t *r, char *buf) 
+{
+    if (r->mode == MODE_PINGPONG) 
+    {
+        for (unsigned long i = 0; i < r->rounds; i++) 
+        {
+            for (size_t b = 0; b < r->batch; b++) 
+                if (transport_recv_msg(t, buf, r->size) == -1) 
+                    return;
+            for (size_t b = 0; b < r->batch; b++) 
+                if (transport_send_msg(t, buf, r->size) == -1) 
+                    return;
+        }
+        return;
+    }
+
+    for (unsigned long i = 0; i < r->rounds; i++) 
+    {
+        if (transport_recv_msg(t, buf, r->size) == -1) 
+            return;
+        if (r->window && (i + 1) % r->window == 0) 
+            transport_send_msg(t, buf, ACK_SIZE);
+    }
+    transport_send_msg(t, buf, ACK_SIZE);
+}
+
+// returns elapsed seconds, fills per-round latencies for pingpong
+static double parent_loop(transport_t *t, const run_t *r, char *buf, double *lat) 
+{
+    double t0 = now_sec();
+    if (r->mode == MODE_PINGPONG) 
+    {
+        for (unsigned long i = 0; i < r->rounds; i++) 
+        {
+            double s = now_sec();
+            for (size_t b = 0; b < r->batch; b++) 
+                if (transport_send_msg(t, buf, r->size) == -1) 
+                    return -1;
+            for (size_t b = 0; b < r->batch; b++) 
+                if (transport_recv_msg(t, buf, r->size) == -1) 
+                    return -1;
+            lat[i] = now_sec() - s;
+        }
+        return now_sec() - t0;
+    }
+
+    for (unsigned long i = 0; i < r->rounds; i++) 
+    {
+        if (transport_send_msg(t, buf, r->size) == -1) 
+            return -1;
+        if (r->window && (i + 1) % r->window == 0) 
+            if (transport_recv_msg(t, buf, ACK_SIZE) == -1) 
+                return -1;
+    }
+    if (transport_recv_msg(t, buf, ACK_SIZE) == -1) 
+        return -1;
+    return now_sec() - t0;
+}
+
+static int run_one(const run_t *r, FILE *out) 
+{
+    transport_t t = {0};
+    t.ops = r->ops;
+    if (t.ops->open(&t, r->size) == -1) 
+        return -1;
+
+    size_t buf_size = (r->size > t.chunk ? r->size : t.chunk) + ACK_SIZE;
+    char *buf = calloc(1, buf_size);
+    double *lat = (r->mode == MODE_PINGPONG) ? calloc(r->rounds, sizeof(double)) : NULL;
+    if (!buf || (r->mode == MODE_PINGPONG && !lat)) 
+    {
+        free(buf);
+        free(lat);
+        t.ops->destroy(&t);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) 
+    {
+        perror("fork");
+        free(buf);
+        free(lat);
+        t.ops->destroy(&t);
+        return -1;
+    }
+    if (pid == 0) 
+    {
+        t.side = SIDE_CHILD;
+        cpu_pin(r->cpu_b);
+        if (t.ops->attach(&t, SIDE_CHILD) == 0) 
+            child_loop(&t, r, buf);
+        t.ops->close(&t);
+        _exit(0);
+    }
+
+    t.side = SIDE_PARENT;
+    cpu_pin(r->cpu_a);
+    double sec = -1;
+    if (t.ops->attach(&t, SIDE_PARENT) == 0) 
+        sec = parent_loop(&t, r, buf, lat);
+    t.ops->close(&t);
+    waitpid(pid, NULL, 0);
+    t.ops->destroy(&t);
+    cpu_pin(-1);
+
+    if (sec > 0) 
+    {
+        // data messages one way: acks are not counted, and the batch
+        // column holds the window for a stream
+        unsigned long msgs = r->mode == MODE_PINGPONG ? r->rounds * r->batch : r->rounds;
+        size_t batch = r->mode == MODE_PINGPONG ? r->batch : r->window;
+        char lat_cols[96] = ",,";
+        if (lat) 
+        {
+            qsort(lat, r->rounds, sizeof(double), cmp_double);
+            snprintf(lat_cols, sizeof(lat_cols), "%.3f,%.3f,%.3f", sec / r->rounds * 1e6, 
+                     lat[r->rounds / 2] * 1e6, lat[(r->rounds * 99) / 100] * 1e6);
+        }
+        fprintf(out, "%s,%s,%s,%d,%d,%zu,%zu,%lu,%.6f,%.0f,%.2f,%s\n",
+                r->ops->name, r->mode == MODE_PINGPONG ? "pingpong" : "stream", r->placement,
+                r->cpu_a, r->cpu_b, r->size, batch, msgs, sec, msgs / sec, 
+                (double)msgs * r->size / sec / 1e6, lat_cols);
+        fflush(out);
+    } 
+    else 
+    {
+        fprintf(stderr, "%s: run failed (size %zu)\n", r->ops->name, r->size);
+    }
+
+    free(buf);
+    free(lat);
+    return sec > 0 ? 0 : -1;
+}
+
+static void usage(const char *prog) 
+{
+    fprintf(stderr, 
+        "Usage: %s [options]\n"
+        "  -t LIST   transports (default all):", prog);
+    for (size_t i = 0; i < TRANSPORTS_COUNT; i++) 
+        fprintf(stderr, " %s", all_transports[i]->name);
+    fprintf(stderr, "\n"
+        "  -s LIST   message sizes in bytes, k/m suffix allowed (default 8,64,512,4k,64k,1m)\n"
+        "  -p LIST   cpu placement: none,same,sibling,cross (default all)\n"
+        "  -b LIST   pingpong: messages per round trip (default 1)\n"
+        "  -w N      stream: messages per ack, 0 for one ack at the end (default 64)\n"
+        "  -m MODE   pingpong, stream or both (default both)\n"
+        "  -i N      pingpong rounds (default 10000, capped at 1 GB per run)\n"
+        "  -T MB     bytes streamed per run (default 256)\n"
+        "  -o FILE   csv output (default stdout)\n");
+}
+
+static size_t parse_size(const char *s) 
+{
+    char *end;
+    size_t v = strtoull(s, &end, 10);
+    if (*end == 'k' || *end == 'K') 
+        v *= 1024;
+    else if (*end == 'm' || *end == 'M') 
+        v *= 1024 * 1024;
+    return v;
+}
+
+static int parse_sizes(char *arg, size_t *list, int *count) 
+{
+    *count = 0;
+    for (char *tok = strtok(arg, ","); tok && *count < MAX_LIST; tok = strtok(NULL, ",")) 
+    {
+        list[*count] = parse_size(tok);
+        if (list[*count] == 0) 
+            return -1;
+        (*count)++;
+    }
+    return *count > 0 ? 0 : -1;
+}
+
+static int parse_transports(char *arg, bench_cfg_t *cfg) 
+{
+    cfg->transports_count = 0;
+    for (char *tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) 
+    {
+        size_t i;
+        for (i = 0; i < TRANSPORTS_COUNT; i++) 
+        {
+            if (strcmp(tok, all_transports[i]->name) == 0) 
+                break;
+        }
+        if (i == TRANSPORTS_COUNT || cfg->transports_count == (int)TRANSPORTS_COUNT) 
+            return -1;
+        cfg->transports[cfg->transports_count++] = all_transports[i];
+    }
+    return cfg->transports_count > 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) 
+{
+    bench_cfg_t cfg = {0};
+    char default_sizes[] = "8,64,512,4k,64k,1m";
+    char default_placements[] = "none,same,sibling,cross";
+    char *placements_arg = default_placements;
+
+    for (size_t i = 0; i < TRANSPORTS_COUNT; i++) 
+        cfg.transports[cfg.transports_count++] = all_transports[i];
+    parse_sizes(default_sizes, cfg.sizes, &cfg.sizes_count);
+    cfg.batches[0] = 1;
+    cfg.batches_count = 1;
+    cfg.modes = MODE_PINGPONG | MODE_STREAM;
+    cfg.iterations = 10000;
+    cfg.stream_mb = 256;
+    cfg.window = STREAM_WINDOW;
+    cfg.out = stdout;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:s:p:b:w:m:i:T:o:h")) != -1) 
+    {
+        switch (opt) 
+        {
+            case 't':
+                if (parse_transports(optarg, &cfg) == -1) 
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 's':
+                if (parse_sizes(optarg, cfg.sizes, &cfg.sizes_count) == -1) 
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'p':
+                placements_arg = optarg;
+                break;
+            case 'b':
+                if (parse_sizes(optarg, cfg.batches, &cfg.batches_count) == -1) 
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'w':
+                cfg.window = strtoul(optarg, NULL, 10);
+                break;
+            case 'm':
+                if (strcmp(optarg, "pingpong") == 0) 
+                    cfg.modes = MODE_PINGPONG;
+                else if (strcmp(optarg, "stream") == 0) 
+                    cfg.modes = MODE_STREAM;
+                else if (strcmp(optarg, "both") == 0) 
+                    cfg.modes = MODE_PINGPONG | MODE_STREAM;
+                else 
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'i':
+                cfg.iterations = strtoul(optarg, NULL, 10);
+                break;
+            case 'T':
+                cfg.stream_mb = strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                cfg.out = fopen(optarg, "w");
+                if (!cfg.out) 
+                {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    for (char *tok = strtok(placements_arg, ","); tok && cfg.placements_count < MAX_LIST; tok = strtok(NULL, ",")) 
+        cfg.placements[cfg.placements_count++] = tok;
+
+    fprintf(cfg.out, "transport,mode,placement,cpu_a,cpu_b,msg_size,batch,messages,seconds,"
+                     "msgs_per_sec,mb_per_sec,rtt_avg_us,rtt_p50_us,rtt_p99_us\n");
+
+    for (int pi = 0; pi < cfg.placements_count; pi++) 
+    {
+        run_t r = {0};
+        r.placement = cfg.placements[pi];
+        if (cpu_pick_pair(r.placement, &r.cpu_a, &r.cpu_b) == -1) 
+        {
+            fprintf(stderr, "placement %s: no suitable cpus, skipped\n", r.placement);
+            continue;
+        }
+        for (int ti = 0; ti < cfg.transports_count; ti++) 
+        {
+            r.ops = cfg.transports[ti];
+            for (int si = 0; si < cfg.sizes_count; si++) 
+            {
+                r.size = cfg.sizes[si] < ACK_SIZE ? ACK_SIZE : cfg.sizes[si];
+                for (int bi = 0; (cfg.modes & MODE_PINGPONG) && bi < cfg.batches_count; bi++) 
+                {
+                    r.batch = cfg.batches[bi];
+                    fprintf(stderr, "%s %s size=%zu batch=%zu\n", r.ops->name, r.placement, r.size, r.batch);
+
+                    r.mode = MODE_PINGPONG;
+                    r.rounds = PINGPONG_MAX_BYTES / (r.size * r.batch);
+                    if (r.rounds > cfg.iterations) 
+                        r.rounds = cfg.iterations;
+                    if (r.rounds < PINGPONG_MIN_ROUNDS) 
+                        r.rounds = PINGPONG_MIN_ROUNDS;
+                    run_one(&r, cfg.out);
+                }
+                if (cfg.modes & MODE_STREAM) 
+                {
+                    r.window = cfg.window;
+                    fprintf(stderr, "%s %s size=%zu window=%zu\n", r.ops->name, r.placement, r.size, r.window);
+
+                    r.mode = MODE_STREAM;
+                    r.rounds = cfg.stream_mb * 1024 * 1024 / r.size;
+                    if (r.rounds == 0) 
+                        r.rounds = 1;
+                    run_one(&r, cfg.out);
+                }
+            }
+        }
+    }
+
+    if (cfg.out != stdout) 
+        fclose(cfg.out);
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include "transport.h"
+
+int transport_send_msg(transport_t *t, const void *buf, size_t len) 
+{
+    const char *p = buf;
+    size_t off = 0;
+    do 
+    {
+        size_t n = len - off < t->chunk ? len - off : t->chunk;
+        if (t->ops->send(t, p + off, n) == -1) 
+            return -1;
+        off += n;
+    } while (off < len);
+    return 0;
+}
+
+int transport_recv_msg(transport_t *t, void *buf, size_t len) 
+{
+    char *p = buf;
+    size_t off = 0;
+    do 
+    {
+        size_t n = len - off < t->chunk ? len - off : t->chunk;
+        if (t->ops->recv(t, p + off, n) == -1) 
+            return -1;
+        off += n;
+    } while (off < len);
+    return 0;
+}
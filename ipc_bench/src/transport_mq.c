@@ -0,0 +1,202 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <mqueue.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+
+#include "transport.h"
+
+static long read_limit(const char *path, long fallback) 
+{
+    FILE *f = fopen(path, "r");
+    long v = fallback;
+    if (f) 
+    {
+        if (fscanf(f, "%ld", &v) != 1) 
+            v = fallback;
+        fclose(f);
+    }
+    return v;
+}
+
+// POSIX mqueue: queue 0 parent -> child, queue 1 child -> parent
+typedef struct 
+{
+    char name[2][64];
+    mqd_t q[2];
+} mq_priv_t;
+
+static int mq_t_open(transport_t *t, size_t msg_size) 
+{
+    mq_priv_t *p = calloc(1, sizeof(*p));
+    if (!p) 
+        return -1;
+
+    long max_size = read_limit("/proc/sys/fs/mqueue/msgsize_max", 8192);
+    long max_msgs = read_limit("/proc/sys/fs/mqueue/msg_max", 10);
+    struct mq_attr attr = {0};
+    attr.mq_msgsize = (long)msg_size < max_size ? (long)msg_size : max_size;
+    attr.mq_maxmsg = max_msgs < 10 ? max_msgs : 10;
+
+    for (int i = 0; i < 2; i++) 
+    {
+        snprintf(p->name[i], sizeof(p->name[i]), "/ipc_bench_%d_%d", (int)getpid(), i);
+        mq_unlink(p->name[i]);
+        p->q[i] = mq_open(p->name[i], O_CREAT | O_RDWR, 0600, &attr);
+        if (p->q[i] == (mqd_t)-1) 
+        {
+            perror("mq_open");
+            if (i == 1) 
+            {
+                mq_close(p->q[0]);
+                mq_unlink(p->name[0]);
+            }
+            free(p);
+            return -1;
+        }
+    }
+    t->priv = p;
+    t->chunk = (size_t)attr.mq_msgsize;
+    return 0;
+}
+
+static int mq_t_attach(transport_t *t, int side) 
+{
+    (void)t;
+    (void)side;
+    return 0;
+}
+
+static int mq_t_send(transport_t *t, const void *buf, size_t len) 
+{
+    mq_priv_t *p = t->priv;
+    mqd_t q = p->q[t->side == SIDE_PARENT ? 0 : 1];
+    while (mq_send(q, buf, len, 0) == -1) 
+    {
+        if (errno != EINTR) 
+            return -1;
+    }
+    return 0;
+}
+
+static int mq_t_recv(transport_t *t, void *buf, size_t len) 
+{
+    mq_priv_t *p = t->priv;
+    mqd_t q = p->q[t->side == SIDE_PARENT ? 1 : 0];
+    ssize_t n;
+    while ((n = mq_receive(q, buf, t->chunk, NULL)) == -1) 
+    {
+        if (errno != EINTR) 
+            return -1;
+    }
+    return (size_t)n == len ? 0 : -1;
+}
+
+static void mq_t_close(transport_t *t) 
+{
+    mq_priv_t *p = t->priv;
+    mq_close(p->q[0]);
+    mq_close(p->q[1]);
+}
+
+static void mq_t_destroy(transport_t *t) 
+{
+    mq_priv_t *p = t->priv;
+    mq_unlink(p->name[0]);
+    mq_unlink(p->name[1]);
+    free(p);
+    t->priv = NULL;
+}
+
+const transport_ops_t transport_posix_mq = 
+{
+    "posix_mq", mq_t_open, mq_t_attach, mq_t_send, mq_t_recv, mq_t_close, mq_t_destroy
+};
+
+// System V queues; two of them, one shared queue can deadlock when full
+typedef struct 
+{
+    int msqid[2];
+    struct msgbuf_hdr 
+    {
+        long mtype;
+        char mtext[];
+    } *buf;
+} msg_priv_t;
+
+static int msg_open(transport_t *t, size_t msg_size) 
+{
+    msg_priv_t *p = calloc(1, sizeof(*p));
+    if (!p) 
+        return -1;
+
+    long max_size = read_limit("/proc/sys/kernel/msgmax", 8192);
+    t->chunk = (long)msg_size < max_size ? msg_size : (size_t)max_size;
+
+    for (int i = 0; i < 2; i++) 
+    {
+        p->msqid[i] = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+        if (p->msqid[i] == -1) 
+        {
+            perror("msgget");
+            if (i == 1) 
+                msgctl(p->msqid[0], IPC_RMID, NULL);
+            free(p);
+            return -1;
+        }
+    }
+    p->buf = malloc(sizeof(*p->buf) + t->chunk);
+    t->priv = p;
+    return 0;
+}
+
+static int msg_send(transport_t *t, const void *buf, size_t len) 
+{
+    msg_priv_t *p = t->priv;
+    p->buf->mtype = 1;
+    memcpy(p->buf->mtext, buf, len);
+    while (msgsnd(p->msqid[t->side == SIDE_PARENT ? 0 : 1], p->buf, len, 0) == -1) 
+    {
+        if (errno != EINTR) 
+            return -1;
+    }
+    return 0;
+}
+
+static int msg_recv(transport_t *t, void *buf, size_t len) 
+{
+    msg_priv_t *p = t->priv;
+    ssize_t n;
+    while ((n = msgrcv(p->msqid[t->side == SIDE_PARENT ? 1 : 0], p->buf, t->chunk, 0, 0)) == -1) 
+    {
+        if (errno != EINTR) 
+            return -1;
+    }
+    memcpy(buf, p->buf->mtext, (size_t)n);
+    return (size_t)n == len ? 0 : -1;
+}
+
+static void msg_close(transport_t *t) 
+{
+    (void)t;
+}
+
+static void msg_destroy(transport_t *t) 
+{
+    msg_priv_t *p = t->priv;
+    msgctl(p->msqid[0], IPC_RMID, NULL);
+    msgctl(p->msqid[1], IPC_RMID, NULL);
+    free(p->buf);
+    free(p);
+    t->priv = NULL;
+}
+
+const transport_ops_t transport_sysv_msg = 
+{
+    "sysv_msg", msg_open, mq_t_attach, msg_send, msg_recv, msg_close, msg_destroy
+};
@@ -0,0 +1,185 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "transport.h"
+
+// down: parent -> child, up: child -> parent
+typedef struct 
+{
+    int down[2];
+    int up[2];
+    int rfd;
+    int wfd;
+    char path[2][64];
+} pipe_priv_t;
+
+int write_all(int fd, const void *buf, size_t len) 
+{
+    const char *p = buf;
+    while (len > 0) 
+    {
+        ssize_t n = write(fd, p, len);
+        if (n == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int read_all(int fd, void *buf, size_t len) 
+{
+    char *p = buf;
+    while (len > 0) 
+    {
+        ssize_t n = read(fd, p, len);
+        if (n == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            return -1;
+        }
+        if (n == 0) 
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int fd_send(transport_t *t, const void *buf, size_t len) 
+{
+    pipe_priv_t *p = t->priv;
+    return write_all(p->wfd, buf, len);
+}
+
+static int fd_recv(transport_t *t, void *buf, size_t len) 
+{
+    pipe_priv_t *p = t->priv;
+    return read_all(p->rfd, buf, len);
+}
+
+static void fd_close(transport_t *t) 
+{
+    pipe_priv_t *p = t->priv;
+    if (p->rfd != -1) 
+        close(p->rfd);
+    if (p->wfd != -1) 
+        close(p->wfd);
+    p->rfd = p->wfd = -1;
+}
+
+static void priv_free(transport_t *t) 
+{
+    free(t->priv);
+    t->priv = NULL;
+}
+
+static int pipe_open(transport_t *t, size_t msg_size) 
+{
+    pipe_priv_t *p = calloc(1, sizeof(*p));
+    if (!p) 
+        return -1;
+    if (pipe(p->down) == -1 || pipe(p->up) == -1) 
+    {
+        perror("pipe");
+        free(p);
+        return -1;
+    }
+    t->priv = p;
+    t->chunk = msg_size;
+    return 0;
+}
+
+static int pipe_attach(transport_t *t, int side) 
+{
+    pipe_priv_t *p = t->priv;
+    if (side == SIDE_PARENT) 
+    {
+        close(p->down[0]);
+        close(p->up[1]);
+        p->wfd = p->down[1];
+        p->rfd = p->up[0];
+    } 
+    else 
+    {
+        close(p->down[1]);
+        close(p->up[0]);
+        p->rfd = p->down[0];
+        p->wfd = p->up[1];
+    }
+    return 0;
+}
+
+const transport_ops_t transport_pipe = 
+{
+    "pipe", pipe_open, pipe_attach, fd_send, fd_recv, fd_close, priv_free
+};
+
+// named pipes, same layout as pipes/pipes_server-client
+static int fifo_open(transport_t *t, size_t msg_size) 
+{
+    pipe_priv_t *p = calloc(1, sizeof(*p));
+    if (!p) 
+        return -1;
+    for (int i = 0; i < 2; i++) 
+    {
+        snprintf(p->path[i], sizeof(p->path[i]), "/tmp/ipc_bench_fifo_%d_%d", (int)getpid(), i);
+        unlink(p->path[i]);
+        if (mkfifo(p->path[i], 0600) == -1) 
+        {
+            perror("mkfifo");
+            free(p);
+            return -1;
+        }
+    }
+    p->rfd = p->wfd = -1;
+    t->priv = p;
+    t->chunk = msg_size;
+    return 0;
+}
+
+// both sides open the down fifo first, so the blocking opens pair up
+static int fifo_attach(transport_t *t, int side) 
+{
+    pipe_priv_t *p = t->priv;
+    if (side == SIDE_PARENT) 
+    {
+        p->wfd = open(p->path[0], O_WRONLY);
+        p->rfd = open(p->path[1], O_RDONLY);
+    } 
+    else 
+    {
+        p->rfd = open(p->path[0], O_RDONLY);
+        p->wfd = open(p->path[1], O_WRONLY);
+    }
+    if (p->rfd == -1 || p->wfd == -1) 
+    {
+        perror("open fifo");
+        return -1;
+    }
+    return 0;
+}
+
+static void fifo_destroy(transport_t *t) 
+{
+    pipe_priv_t *p = t->priv;
+    unlink(p->path[0]);
+    unlink(p->path[1]);
+    priv_free(t);
+}
+
+const transport_ops_t transport_fifo = 
+{
+    "fifo", fifo_open, fifo_attach, fd_send, fd_recv, fd_close, fifo_destroy
+};
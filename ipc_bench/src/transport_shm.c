@@ -0,0 +1,239 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/sem.h>
+
+#include "transport.h"
+
+#define SHM_SLOTS 8
+#define SHM_MAX_CHUNK 65536
+#define SHM_ALIGN 64
+
+// semaphore numbers inside one direction
+#define SEM_ITEMS 0
+#define SEM_SPACES 1
+
+// bounded buffer per direction; dir 0 parent -> child, dir 1 child -> parent.
+// POSIX flavour keeps process-shared sem_t in the mapping, SysV uses semop.
+typedef struct 
+{
+    sem_t items;
+    sem_t spaces;
+    size_t len[SHM_SLOTS];
+} shm_dir_t;
+
+typedef struct 
+{
+    int sysv;
+    char name[64];
+    int shmid;
+    int semid;
+    char *base;
+    size_t map_size;
+    size_t dir_size;
+    unsigned long head;
+    unsigned long tail;
+} shm_priv_t;
+
+static size_t align_up(size_t v) 
+{
+    return (v + SHM_ALIGN - 1) / SHM_ALIGN * SHM_ALIGN;
+}
+
+static shm_dir_t *dir_hdr(shm_priv_t *p, int dir) 
+{
+    return (shm_dir_t *)(p->base + (size_t)dir * p->dir_size);
+}
+
+static char *dir_slot(shm_priv_t *p, int dir, size_t chunk, unsigned long pos) 
+{
+    return (char *)dir_hdr(p, dir) + align_up(sizeof(shm_dir_t)) + (pos % SHM_SLOTS) * chunk;
+}
+
+static int sync_op(shm_priv_t *p, int dir, int which, int op) 
+{
+    if (p->sysv) 
+    {
+        struct sembuf sb = {(unsigned short)(dir * 2 + which), (short)op, 0};
+        while (semop(p->semid, &sb, 1) == -1) 
+        {
+            if (errno != EINTR) 
+                return -1;
+        }
+        return 0;
+    }
+
+    shm_dir_t *h = dir_hdr(p, dir);
+    sem_t *s = (which == SEM_ITEMS) ? &h->items : &h->spaces;
+    if (op > 0) 
+        return sem_post(s);
+    while (sem_wait(s) == -1) 
+    {
+        if (errno != EINTR) 
+            return -1;
+    }
+    return 0;
+}
+
+static int shm_common_open(transport_t *t, size_t msg_size, int sysv) 
+{
+    shm_priv_t *p = calloc(1, sizeof(*p));
+    if (!p) 
+        return -1;
+    p->sysv = sysv;
+    p->shmid = -1;
+    p->semid = -1;
+    t->chunk = align_up(msg_size < SHM_MAX_CHUNK ? msg_size : SHM_MAX_CHUNK);
+    p->dir_size = align_up(sizeof(shm_dir_t)) + SHM_SLOTS * t->chunk;
+    p->map_size = 2 * p->dir_size;
+
+    if (sysv) 
+    {
+        p->shmid = shmget(IPC_PRIVATE, p->map_size, IPC_CREAT | 0600);
+        p->semid = semget(IPC_PRIVATE, 4, IPC_CREAT | 0600);
+        if (p->shmid == -1 || p->semid == -1) 
+        {
+            perror("shmget/semget");
+            goto fail;
+        }
+        p->base = shmat(p->shmid, NULL, 0);
+        if (p->base == (void *)-1) 
+        {
+            perror("shmat");
+            p->base = NULL;
+            goto fail;
+        }
+        unsigned short init[4] = {0, SHM_SLOTS, 0, SHM_SLOTS};
+        semctl(p->semid, 0, SETALL, init);
+    } 
+    else 
+    {
+        snprintf(p->name, sizeof(p->name), "/ipc_bench_shm_%d", (int)getpid());
+        int fd = shm_open(p->name, O_CREAT | O_RDWR | O_TRUNC, 0600);
+        if (fd == -1) 
+        {
+            perror("shm_open");
+            goto fail;
+        }
+        if (ftruncate(fd, (off_t)p->map_size) == -1) 
+        {
+            perror("ftruncate");
+            close(fd);
+            goto fail;
+        }
+        p->base = mmap(NULL, p->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p->base == MAP_FAILED) 
+        {
+            perror("mmap");
+            p->base = NULL;
+            goto fail;
+        }
+        for (int d = 0; d < 2; d++) 
+        {
+            sem_init(&dir_hdr(p, d)->items, 1, 0);
+            sem_init(&dir_hdr(p, d)->spaces, 1, SHM_SLOTS);
+        }
+    }
+    t->priv = p;
+    return 0;
+
+fail:
+    if (p->shmid != -1) 
+        shmctl(p->shmid, IPC_RMID, NULL);
+    if (p->semid != -1) 
+        semctl(p->semid, 0, IPC_RMID);
+    if (p->name[0]) 
+        shm_unlink(p->name);
+    free(p);
+    return -1;
+}
+
+static int posix_shm_open(transport_t *t, size_t msg_size) 
+{
+    return shm_common_open(t, msg_size, 0);
+}
+
+static int sysv_shm_open(transport_t *t, size_t msg_size) 
+{
+    return shm_common_open(t, msg_size, 1);
+}
+
+static int shm_attach(transport_t *t, int side) 
+{
+    (void)t;
+    (void)side;
+    return 0;
+}
+
+static int shm_send(transport_t *t, const void *buf, size_t len) 
+{
+    shm_priv_t *p = t->priv;
+    int dir = (t->side == SIDE_PARENT) ? 0 : 1;
+    if (sync_op(p, dir, SEM_SPACES, -1) == -1) 
+        return -1;
+    memcpy(dir_slot(p, dir, t->chunk, p->head), buf, len);
+    dir_hdr(p, dir)->len[p->head % SHM_SLOTS] = len;
+    p->head++;
+    return sync_op(p, dir, SEM_ITEMS, 1);
+}
+
+static int shm_recv(transport_t *t, void *buf, size_t len) 
+{
+    shm_priv_t *p = t->priv;
+    int dir = (t->side == SIDE_PARENT) ? 1 : 0;
+    if (sync_op(p, dir, SEM_ITEMS, -1) == -1) 
+        return -1;
+    size_t n = dir_hdr(p, dir)->len[p->tail % SHM_SLOTS];
+    memcpy(buf, dir_slot(p, dir, t->chunk, p->tail), n);
+    p->tail++;
+    if (sync_op(p, dir, SEM_SPACES, 1) == -1) 
+        return -1;
+    return n == len ? 0 : -1;
+}
+
+static void shm_close(transport_t *t) 
+{
+    (void)t;
+}
+
+static void shm_destroy(transport_t *t) 
+{
+    shm_priv_t *p = t->priv;
+    if (p->sysv) 
+    {
+        shmdt(p->base);
+        shmctl(p->shmid, IPC_RMID, NULL);
+        semctl(p->semid, 0, IPC_RMID);
+    } 
+    else 
+    {
+        for (int d = 0; d < 2; d++) 
+        {
+            sem_destroy(&dir_hdr(p, d)->items);
+            sem_destroy(&dir_hdr(p, d)->spaces);
+        }
+        munmap(p->base, p->map_size);
+        shm_unlink(p->name);
+    }
+    free(p);
+    t->priv = NULL;
+}
+
+const transport_ops_t transport_posix_shm = 
+{
+    "posix_shm", posix_shm_open, shm_attach, shm_send, shm_recv, shm_close, shm_destroy
+};
+
+const transport_ops_t transport_sysv_shm = 
+{
+    "sysv_shm", sysv_shm_open, shm_attach, shm_send, shm_recv, shm_close, shm_destroy
+};
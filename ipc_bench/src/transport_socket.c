@@ -0,0 +1,120 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "transport.h"
+
+#define DGRAM_CHUNK 65536
+
+// one socketpair carries both directions
+typedef struct 
+{
+    int sv[2];
+    int fd;
+} sock_priv_t;
+
+static int sock_open(transport_t *t, int type, size_t chunk) 
+{
+    sock_priv_t *p = calloc(1, sizeof(*p));
+    if (!p) 
+        return -1;
+    if (socketpair(AF_UNIX, type, 0, p->sv) == -1) 
+    {
+        perror("socketpair");
+        free(p);
+        return -1;
+    }
+    if (type == SOCK_DGRAM) 
+    {
+        int sz = (int)(chunk * 4);
+        for (int i = 0; i < 2; i++) 
+        {
+            setsockopt(p->sv[i], SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+            setsockopt(p->sv[i], SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+        }
+    }
+    p->fd = -1;
+    t->priv = p;
+    t->chunk = chunk;
+    return 0;
+}
+
+static int stream_open(transport_t *t, size_t msg_size) 
+{
+    return sock_open(t, SOCK_STREAM, msg_size);
+}
+
+static int dgram_open(transport_t *t, size_t msg_size) 
+{
+    return sock_open(t, SOCK_DGRAM, msg_size < DGRAM_CHUNK ? msg_size : DGRAM_CHUNK);
+}
+
+static int sock_attach(transport_t *t, int side) 
+{
+    sock_priv_t *p = t->priv;
+    close(p->sv[side == SIDE_PARENT ? 1 : 0]);
+    p->fd = p->sv[side == SIDE_PARENT ? 0 : 1];
+    return 0;
+}
+
+static int stream_send(transport_t *t, const void *buf, size_t len) 
+{
+    sock_priv_t *p = t->priv;
+    return write_all(p->fd, buf, len);
+}
+
+static int stream_recv(transport_t *t, void *buf, size_t len) 
+{
+    sock_priv_t *p = t->priv;
+    return read_all(p->fd, buf, len);
+}
+
+static int dgram_send(transport_t *t, const void *buf, size_t len) 
+{
+    sock_priv_t *p = t->priv;
+    while (send(p->fd, buf, len, 0) == -1) 
+    {
+        if (errno != EINTR) 
+            return -1;
+    }
+    return 0;
+}
+
+static int dgram_recv(transport_t *t, void *buf, size_t len) 
+{
+    sock_priv_t *p = t->priv;
+    ssize_t n;
+    while ((n = recv(p->fd, buf, t->chunk, 0)) == -1) 
+    {
+        if (errno != EINTR) 
+            return -1;
+    }
+    return (size_t)n == len ? 0 : -1;
+}
+
+static void sock_close(transport_t *t) 
+{
+    sock_priv_t *p = t->priv;
+    if (p->fd != -1) 
+        close(p->fd);
+    p->fd = -1;
+}
+
+static void sock_destroy(transport_t *t) 
+{
+    free(t->priv);
+    t->priv = NULL;
+}
+
+const transport_ops_t transport_unix_stream = 
+{
+    "unix_stream", stream_open, sock_attach, stream_send, stream_recv, sock_close, sock_destroy
+};
+
+const transport_ops_t transport_unix_dgram = 
+{
+    "unix_dgram", dgram_open, sock_attach, dgram_send, dgram_recv, sock_close, sock_destroy
+};
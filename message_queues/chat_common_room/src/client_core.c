@@ -6,6 +6,79 @@
 #include <errno.h>
 #include <unistd.h>
 
+// add one received line to the UI buffer and track join/leave notices
+static void handle_line(client_state_t *st, const char *line) 
+{
+    pthread_mutex_lock(&st->lines_lock);
+    if (st->lines_count < MAX_DISPLAY_LINES) 
+    {
+        strncpy(st->lines[st->lines_count].text, line, sizeof(st->lines[st->lines_count].text)-1);
+        st->lines[st->lines_count].text[sizeof(st->lines[st->lines_count].text)-1] = '\0';
+        st->lines_count++;
+    } 
+    else 
+    {
+        memmove(&st->lines[0], &st->lines[1], sizeof(display_line_t)*(MAX_DISPLAY_LINES-1));
+        strncpy(st->lines[MAX_DISPLAY_LINES-1].text, line, sizeof(st->lines[0].text)-1);
+        st->lines[MAX_DISPLAY_LINES-1].text[sizeof(st->lines[0].text)-1] = '\0';
+    }
+    pthread_mutex_unlock(&st->lines_lock);
+
+    if (strncmp(line, "[SERVER]:User ", 12) == 0) 
+    {
+        const char *p = line + 12;
+        char pidstr[32];
+        int i = 0;
+        while (*p && *p != ' ' && i < (int)sizeof(pidstr)-1) 
+            pidstr[i++] = *p++;
+        pidstr[i] = '\0';
+        if (strstr(line, "joined")) 
+        {
+            pthread_mutex_lock(&st->clients_lock);
+
+            int exists = 0;
+            for (int k=0;k<st->clients_count;k++)
+            {
+                if (strcmp(st->clients[k], (char[]){'/', 'c','l','i','e','n','t','_','\0'})==0) { /* never */ }
+            }
+
+            char cname[CLIENT_NAME_LEN];
+            snprintf(cname, sizeof(cname), "/client_%s", pidstr);
+            exists = 0;
+            for (int k=0;k<st->clients_count;k++) if (strcmp(st->clients[k], cname)==0) 
+            { 
+                exists = 1; break; 
+            }
+            if (!exists && st->clients_count < MAX_CLIENTS) 
+            {
+                strncpy(st->clients[st->clients_count], cname, CLIENT_NAME_LEN-1);
+                st->clients[st->clients_count][CLIENT_NAME_LEN-1] = '\0';
+                st->clients_count++;
+            }
+            pthread_mutex_unlock(&st->clients_lock);
+        } 
+        else if (strstr(line, "left")) 
+        {
+            char cname[CLIENT_NAME_LEN];
+            snprintf(cname, sizeof(cname), "/client_%s", pidstr);
+            pthread_mutex_lock(&st->clients_lock);
+            int pos = -1;
+            for (int k=0;k<st->clients_count;k++) if (strcmp(st->clients[k], cname)==0) 
+            { 
+                pos = k; 
+                break; 
+            }
+            if (pos != -1) 
+            {
+                for (int k=pos;k<st->clients_count-1;k++) 
+                    strcpy(st->clients[k], st->clients[k+1]);
+                st->clients_count--;
+            }
+            pthread_mutex_unlock(&st->clients_lock);
+        }
+    }
+}
+
 // Thread: retrieving messages from its own queue and adding them to the UI buffer
 static void *mq_reader_thread(void *arg) 
 {
@@ -19,75 +92,15 @@ static void *mq_reader_thread(void *arg)
         if (r >= 0) 
         {
             buf[r] = '\0';
-            pthread_mutex_lock(&st->lines_lock);
-            if (st->lines_count < MAX_DISPLAY_LINES) 
+            // history replay packs several NUL-terminated lines into one message
+            char *line = buf;
+            while (line < buf + r) 
             {
-                strncpy(st->lines[st->lines_count].text, buf, sizeof(st->lines[st->lines_count].text)-1);
-                st->lines[st->lines_count].text[sizeof(st->lines[st->lines_count].text)-1] = '\0';
-                st->lines_count++;
-            } 
-            else 
-            {
-                memmove(&st->lines[0], &st->lines[1], sizeof(display_line_t)*(MAX_DISPLAY_LINES-1));
-                strncpy(st->lines[MAX_DISPLAY_LINES-1].text, buf, sizeof(st->lines[0].text)-1);
-                st->lines[MAX_DISPLAY_LINES-1].text[sizeof(st->lines[0].text)-1] = '\0';
+                size_t len = strlen(line);
+                if (len > 0) 
+                    handle_line(st, line);
+                line += len + 1;
             }
-            pthread_mutex_unlock(&st->lines_lock);
-
-            if (strncmp(buf, "[SERVER]:User ", 12) == 0) 
-            {
-                char *p = buf + 12;
-                char pidstr[32];
-                int i = 0;
-                while (*p && *p != ' ' && i < (int)sizeof(pidstr)-1) 
-                    pidstr[i++] = *p++;
-                pidstr[i] = '\0';
-                if (strstr(buf, "joined")) 
-                {
-                    pthread_mutex_lock(&st->clients_lock);
-
-                    int exists = 0;
-                    for (int k=0;k<st->clients_count;k++)
-                    {
-                        if (strcmp(st->clients[k], (char[]){'/', 'c','l','i','e','n','t','_','\0'})==0) { /* never */ }
-                    }
-
-                    char cname[CLIENT_NAME_LEN];
-                    snprintf(cname, sizeof(cname), "/client_%s", pidstr);
-                    exists = 0;
-                    for (int k=0;k<st->clients_count;k++) if (strcmp(st->clients[k], cname)==0) 
-                    { 
-                        exists = 1; break; 
-                    }
-                    if (!exists && st->clients_count < MAX_CLIENTS) 
-                    {
-                        strncpy(st->clients[st->clients_count], cname, CLIENT_NAME_LEN-1);
-                        st->clients[st->clients_count][CLIENT_NAME_LEN-1] = '\0';
-                        st->clients_count++;
-                    }
-                    pthread_mutex_unlock(&st->clients_lock);
-                } 
-                else if (strstr(buf, "left")) 
-                {
-                    char cname[CLIENT_NAME_LEN];
-                    snprintf(cname, sizeof(cname), "/client_%s", pidstr);
-                    pthread_mutex_lock(&st->clients_lock);
-                    int pos = -1;
-                    for (int k=0;k<st->clients_count;k++) if (strcmp(st->clients[k], cname)==0) 
-                    { 
-                        pos = k; 
-                        break; 
-                    }
-                    if (pos != -1) 
-                    {
-                        for (int k=pos;k<st->clients_count-1;k++) 
-                            strcpy(st->clients[k], st->clients[k+1]);
-                        st->clients_count--;
-                    }
-                    pthread_mutex_unlock(&st->clients_lock);
-                }
-            }
-
         } 
         else 
         {
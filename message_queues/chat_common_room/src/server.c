@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 #include <mqueue.h>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -9,24 +10,34 @@
 #include <errno.h>
 #include <signal.h>
 #include <pthread.h>
+#include <sys/mman.h>
 
 #define SERVER_QUEUE_NAME "/server_queue"
 #define MAX_MSG_SIZE 1024
 #define MAX_MESSAGES 10
 #define CLIENT_NAME_LEN 64
-#define MAX_HISTORY 256
+#define DEFAULT_HISTORY_DEPTH 256
+#define HISTORY_AVG_RECORD 256
+#define HISTORY_MAGIC 0x48495354u
 
-// struct for storage messages in history
+// history ring header; lives at the start of the storage (anonymous or file mapping)
 typedef struct 
 {
-    char sender[CLIENT_NAME_LEN];
-    char text[MAX_MSG_SIZE];
-} hist_entry_t;
-
-// history array
-static hist_entry_t history[MAX_HISTORY];
-static int history_start = 0;
-static int history_count = 0;
+    unsigned int magic;
+    unsigned int depth;     // max records
+    size_t capacity;        // bytes in data area
+    size_t head;            // offset of the oldest record
+    size_t used;            // bytes occupied by records
+    unsigned int first;     // index of the oldest length slot
+    unsigned int count;     // records stored
+} hist_header_t;
+
+// history: records are stored pre-serialized as "sender:text\0" in a byte ring,
+// lens[] keeps record sizes in the same order so eviction is O(1)
+static hist_header_t *history = NULL;
+static unsigned short *history_lens = NULL;
+static char *history_data = NULL;
+static size_t history_map_size = 0;
 static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
 
 // Client struct: storage queue name and descryptor
@@ -47,26 +58,111 @@ static struct mq_attr server_attr;
 // stop flag
 static volatile sig_atomic_t stop_requested = 0;
 
+// map history storage: anonymous memory, or a shared file mapping when spill_path is set
+static int history_init(unsigned int depth, size_t capacity, const char *spill_path) 
+{
+    size_t lens_size = (sizeof(unsigned short) * depth + 7) & ~(size_t)7;
+    history_map_size = sizeof(hist_header_t) + lens_size + capacity;
+
+    void *mem;
+    int reuse = 0;
+    if (spill_path) 
+    {
+        int fd = open(spill_path, O_RDWR | O_CREAT, 0644);
+        if (fd == -1) 
+        {
+            fprintf(stderr, "history: cannot open %s: %s\n", spill_path, strerror(errno));
+            return -1;
+        }
+        struct stat sb;
+        if (fstat(fd, &sb) == 0 && (size_t)sb.st_size == history_map_size) 
+            reuse = 1;
+        else if (ftruncate(fd, (off_t)history_map_size) == -1) 
+        {
+            fprintf(stderr, "history: ftruncate failed: %s\n", strerror(errno));
+            close(fd);
+            return -1;
+        }
+        mem = mmap(NULL, history_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    } 
+    else 
+    {
+        mem = mmap(NULL, history_map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (mem == MAP_FAILED) 
+    {
+        fprintf(stderr, "history: mmap failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    history = mem;
+    history_lens = (unsigned short *)((char *)mem + sizeof(hist_header_t));
+    history_data = (char *)mem + sizeof(hist_header_t) + lens_size;
+
+    // keep history from a previous run if the file layout matches
+    if (!reuse || history->magic != HISTORY_MAGIC || history->depth != depth 
+        || history->capacity != capacity || history->used > capacity || history->count > depth) 
+    {
+        memset(history, 0, sizeof(*history));
+        history->magic = HISTORY_MAGIC;
+        history->depth = depth;
+        history->capacity = capacity;
+    }
+    return 0;
+}
+
+static void history_destroy(void) 
+{
+    if (history) 
+    {
+        munmap(history, history_map_size);
+        history = NULL;
+    }
+}
+
+// drop the oldest record
+static void history_evict(void) 
+{
+    unsigned short len = history_lens[history->first];
+    history->head = (history->head + len) % history->capacity;
+    history->used -= len;
+    history->first = (history->first + 1) % history->depth;
+    history->count--;
+}
+
 // add message, del older
 static void push_history(const char *sender, const char *text) 
 {
+    // serialize once here, replay copies bytes as they are; a record must fit one client message
+    char rec[MAX_MSG_SIZE];
+    int n = snprintf(rec, sizeof(rec), "%s:%s", sender, text);
+    size_t len = (n < 0) ? 1 : ((size_t)n >= sizeof(rec) ? sizeof(rec) : (size_t)n + 1);
+    rec[len - 1] = '\0';
+
     pthread_mutex_lock(&history_lock);
-    int idx = (history_start + history_count) % MAX_HISTORY;
+    if (len > history->capacity) 
+    {
+        pthread_mutex_unlock(&history_lock);
+        return;
+    }
+    while (history->count == history->depth || history->capacity - history->used < len) 
+        history_evict();
 
-    if (history_count == MAX_HISTORY) 
+    size_t tail = (history->head + history->used) % history->capacity;
+    size_t part = history->capacity - tail;
+    if (part >= len) 
     {
-        history_start = (history_start + 1) % MAX_HISTORY;
-        idx = (history_start + history_count - 1) % MAX_HISTORY;
+        memcpy(history_data + tail, rec, len);
     } 
     else 
     {
-        history_count++;
+        memcpy(history_data + tail, rec, part);
+        memcpy(history_data, rec + part, len - part);
     }
-
-    strncpy(history[idx].sender, sender, CLIENT_NAME_LEN-1);
-    history[idx].sender[CLIENT_NAME_LEN-1] = '\0';
-    strncpy(history[idx].text, text, MAX_MSG_SIZE-1);
-    history[idx].text[MAX_MSG_SIZE-1] = '\0';
+    history->used += len;
+    history_lens[(history->first + history->count) % history->depth] = (unsigned short)len;
+    history->count++;
     pthread_mutex_unlock(&history_lock);
 }
 
@@ -93,21 +189,74 @@ static void broadcast_message(const char *label, const char *text)
 }
 
 // send history of messages to client :)
+// the ring is copied under the lock, packing and mq_send run without it
 static void send_history_to_client(mqd_t client_mqd) 
 {
+    struct mq_attr attr;
+    if (mq_getattr(client_mqd, &attr) == -1) 
+    {
+        fprintf(stderr, "send_history_to_client: mq_getattr failed: %s\n", strerror(errno));
+        return;
+    }
+    size_t msgsize = (size_t)attr.mq_msgsize;
+
     pthread_mutex_lock(&history_lock);
-    for (int i = 0; i < history_count; ++i) 
+    size_t used = history->used;
+    char *snap = malloc(used ? used : 1);
+    if (!snap) 
     {
-        int idx = (history_start + i) % MAX_HISTORY;
-        char buf[MAX_MSG_SIZE + CLIENT_NAME_LEN + 8];
-        snprintf(buf, sizeof(buf), "%s:%s", history[idx].sender, history[idx].text);
-        if (mq_send(client_mqd, buf, strlen(buf) + 1, 0) == -1) 
+        pthread_mutex_unlock(&history_lock);
+        return;
+    }
+    size_t part = history->capacity - history->head;
+    if (part >= used) 
+    {
+        memcpy(snap, history_data + history->head, used);
+    } 
+    else 
+    {
+        memcpy(snap, history_data + history->head, part);
+        memcpy(snap + part, history_data, used - part);
+    }
+    pthread_mutex_unlock(&history_lock);
+
+    // pack whole NUL-terminated records into each message up to mq_msgsize
+    char *out = malloc(msgsize);
+    if (!out) 
+    {
+        free(snap);
+        return;
+    }
+    size_t out_len = 0;
+    size_t pos = 0;
+    while (pos < used) 
+    {
+        size_t len = strnlen(snap + pos, used - pos) + 1;
+        const char *rec = snap + pos;
+        pos += len;
+        if (len > msgsize || pos > used) 
+            continue;
+
+        if (out_len + len > msgsize) 
         {
-            fprintf(stderr, "send_history_to_client: mq_send failed: %s\n", strerror(errno));
-            break;
+            if (mq_send(client_mqd, out, out_len, 0) == -1) 
+            {
+                fprintf(stderr, "send_history_to_client: mq_send failed: %s\n", strerror(errno));
+                out_len = 0;
+                break;
+            }
+            out_len = 0;
         }
+        memcpy(out + out_len, rec, len);
+        out_len += len;
     }
-    pthread_mutex_unlock(&history_lock);
+    if (out_len > 0 && mq_send(client_mqd, out, out_len, 0) == -1) 
+    {
+        fprintf(stderr, "send_history_to_client: mq_send failed: %s\n", strerror(errno));
+    }
+
+    free(out);
+    free(snap);
 }
 
 static client_t *find_client_by_name(const char *qname) 
@@ -192,8 +341,51 @@ static void sigint_handler(int signo)
     stop_requested = 1;
 }
 
-int main(void) 
+static void usage(const char *prog) 
 {
+    fprintf(stderr, "Usage: %s [-n history_depth] [-b history_bytes] [-f history_file]\n", prog);
+}
+
+int main(int argc, char *argv[]) 
+{
+    unsigned int depth = DEFAULT_HISTORY_DEPTH;
+    size_t capacity = 0;
+    const char *spill_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:f:")) != -1) 
+    {
+        switch (opt) 
+        {
+            case 'n':
+                depth = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                capacity = (size_t)strtoull(optarg, NULL, 10);
+                break;
+            case 'f':
+                spill_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (depth == 0) 
+    {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (capacity == 0) 
+        capacity = (size_t)depth * HISTORY_AVG_RECORD;
+    if (capacity < MAX_MSG_SIZE) 
+        capacity = MAX_MSG_SIZE;
+
+    if (history_init(depth, capacity, spill_path) == -1) 
+    {
+        exit(EXIT_FAILURE);
+    }
+
     struct sigaction sa;
     sa.sa_handler = sigint_handler;
     sigemptyset(&sa.sa_mask);
@@ -212,7 +404,8 @@ int main(void)
         exit(EXIT_FAILURE);
     }
 
-    printf("Server started, queue: %s\n", SERVER_QUEUE_NAME);
+    printf("Server started, queue: %s, history: %u records / %zu bytes%s%s\n", 
+           SERVER_QUEUE_NAME, depth, capacity, spill_path ? ", file " : "", spill_path ? spill_path : "");
 
     char buf[MAX_MSG_SIZE];
     unsigned int prio;
@@ -299,5 +492,6 @@ int main(void)
 
     printf("Server shutting down...\n");
     cleanup();
+    history_destroy();
     return 0;
 }
\ No newline at end of file
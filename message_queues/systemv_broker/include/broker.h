@@ -0,0 +1,48 @@
+#ifndef BROKER_H
+#define BROKER_H
+
+#include <sys/types.h>
+
+// queues are found by ftok() on this path
+#define BROKER_FTOK_PATH "/tmp"
+#define BROKER_IN_ID 'B'     // clients -> broker, mtype = priority lane
+#define BROKER_OUT_ID 'b'    // broker -> clients, mtype = client id
+
+// priority lanes on the inbound queue; lower mtype is served first, both
+// when the broker reads and when its sender pool picks the next delivery
+#define LANE_HIGH 1
+#define LANE_NORMAL 2
+#define LANE_LOW 3
+#define BROKER_LANES 3
+
+#define BROKER_MAX_TEXT 1024
+#define BROKER_MAX_CLIENTS 4096
+
+enum broker_op 
+{
+    OP_JOIN = 1,    // register src as a client, broker answers OP_ACK
+    OP_LEAVE,       // unregister src
+    OP_PUB,         // deliver text to every client except src
+    OP_DIRECT,      // deliver text to dst only
+    OP_ACK
+};
+
+typedef struct 
+{
+    int op;
+    int src;
+    int dst;
+    int len;
+} broker_hdr_t;
+
+typedef struct 
+{
+    long mtype;
+    broker_hdr_t hdr;
+    char text[BROKER_MAX_TEXT];
+} broker_msg_t;
+
+// bytes passed to msgsnd()/msgrcv() for a message with len bytes of text
+#define BROKER_MSG_SIZE(len) (sizeof(broker_hdr_t) + (size_t)(len))
+
+#endif
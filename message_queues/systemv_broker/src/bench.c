@@ -0,0 +1,310 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <mqueue.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+
+#include "broker.h"
+
+// fan-out benchmark: one publisher, N subscribers, same load against the
+// SysV broker and the POSIX mqueue chat server (message_queues/chat_common_room)
+
+#define CHAT_SERVER_QUEUE "/server_queue"
+#define CHAT_MSG_SIZE 1024
+#define CHAT_MAX_MESSAGES 10
+#define MAX_SUBSCRIBERS 4095
+
+typedef struct 
+{
+    int id;
+    pthread_t tid;
+    unsigned long got;
+    double done_at;
+} sub_t;
+
+static int mode_posix = 0;
+static int subscribers = 16;
+static unsigned long messages = 10000;
+static size_t payload = 64;
+static int nonce;
+static char tag[32];
+
+static int in_qid = -1;
+static int out_qid = -1;
+
+// subscribers keep draining their queue after joining, so readiness is a
+// counter rather than a barrier (the chat server blocks on full client queues)
+static int ready_count = 0;
+static pthread_mutex_t ready_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+
+static double now_sec(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void mark_ready(void) 
+{
+    pthread_mutex_lock(&ready_lock);
+    ready_count++;
+    pthread_cond_signal(&ready_cond);
+    pthread_mutex_unlock(&ready_lock);
+}
+
+static size_t make_payload(char *buf, unsigned long seq) 
+{
+    int n = snprintf(buf, payload + 1, "%s%lu:", tag, seq);
+    size_t len = (size_t)n < payload ? payload : (size_t)n;
+    if ((size_t)n < len) 
+        memset(buf + n, 'x', len - (size_t)n);
+    buf[len] = '\0';
+    return len;
+}
+
+static void sysv_send(int lane, int op, int src, const char *text, size_t len) 
+{
+    broker_msg_t m;
+    m.mtype = lane;
+    m.hdr.op = op;
+    m.hdr.src = src;
+    m.hdr.dst = 0;
+    m.hdr.len = (int)len;
+    if (len) 
+        memcpy(m.text, text, len);
+    while (msgsnd(in_qid, &m, BROKER_MSG_SIZE(len), 0) == -1 && errno == EINTR)
+        ;
+}
+
+static void *sysv_subscriber(void *arg) 
+{
+    sub_t *s = arg;
+    broker_msg_t m;
+
+    sysv_send(LANE_HIGH, OP_JOIN, s->id, NULL, 0);
+    for (;;) 
+    {
+        if (msgrcv(out_qid, &m, sizeof(m) - sizeof(long), s->id, 0) == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            perror("msgrcv");
+            mark_ready();
+            return NULL;
+        }
+        if (m.hdr.op == OP_ACK) 
+            break;
+    }
+    mark_ready();
+
+    size_t tag_len = strlen(tag);
+    while (s->got < messages) 
+    {
+        ssize_t r = msgrcv(out_qid, &m, sizeof(m) - sizeof(long), s->id, 0);
+        if (r == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            break;
+        }
+        if (m.hdr.op == OP_PUB && m.hdr.len >= (int)tag_len && memcmp(m.text, tag, tag_len) == 0) 
+            s->got++;
+    }
+    s->done_at = now_sec();
+    sysv_send(LANE_HIGH, OP_LEAVE, s->id, NULL, 0);
+    return NULL;
+}
+
+static void *posix_subscriber(void *arg) 
+{
+    sub_t *s = arg;
+    char qname[64], name[32], joined[96], buf[CHAT_MSG_SIZE + 1];
+    snprintf(name, sizeof(name), "bench%d", s->id);
+    snprintf(qname, sizeof(qname), "/client_%s", name);
+    snprintf(joined, sizeof(joined), "SERVER:User %s joined", name);
+
+    struct mq_attr attr = {0};
+    attr.mq_maxmsg = CHAT_MAX_MESSAGES;
+    attr.mq_msgsize = CHAT_MSG_SIZE;
+    mq_unlink(qname);
+    mqd_t q = mq_open(qname, O_CREAT | O_RDONLY, 0600, &attr);
+    mqd_t srv = mq_open(CHAT_SERVER_QUEUE, O_WRONLY);
+    if (q == (mqd_t)-1 || srv == (mqd_t)-1) 
+    {
+        perror("mq_open");
+        mark_ready();
+        return NULL;
+    }
+
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "JOIN:%s", name);
+    mq_send(srv, cmd, strlen(cmd) + 1, 0);
+
+    // history replay may pack several lines into one message
+    int is_ready = 0;
+    while (s->got < messages) 
+    {
+        ssize_t r = mq_receive(q, buf, CHAT_MSG_SIZE, NULL);
+        if (r == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            break;
+        }
+        buf[r] = '\0';
+        for (char *line = buf; line < buf + r; line += strlen(line) + 1) 
+        {
+            if (!is_ready) 
+            {
+                if (strcmp(line, joined) == 0) 
+                {
+                    is_ready = 1;
+                    mark_ready();
+                }
+                continue;
+            }
+            char *colon = strchr(line, ':');
+            if (colon && strncmp(colon + 1, tag, strlen(tag)) == 0) 
+                s->got++;
+        }
+    }
+    s->done_at = now_sec();
+
+    snprintf(cmd, sizeof(cmd), "LEAVE:%s", name);
+    mq_send(srv, cmd, strlen(cmd) + 1, 0);
+
+    // keep draining "left" notices until the room goes quiet, the server
+    // blocks on full client queues
+    for (;;) 
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 200000000L;
+        if (ts.tv_nsec >= 1000000000L) 
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        if (mq_timedreceive(q, buf, CHAT_MSG_SIZE, NULL, &ts) == -1 && errno != EINTR) 
+            break;
+    }
+    mq_close(srv);
+    mq_close(q);
+    mq_unlink(qname);
+    return NULL;
+}
+
+static void publish(void) 
+{
+    char text[BROKER_MAX_TEXT + 1];
+    if (mode_posix) 
+    {
+        mqd_t srv = mq_open(CHAT_SERVER_QUEUE, O_WRONLY);
+        char out[CHAT_MSG_SIZE];
+        for (unsigned long i = 0; i < messages; i++) 
+        {
+            make_payload(text, i);
+            snprintf(out, sizeof(out), "MSG:benchpub:%s", text);
+            mq_send(srv, out, strlen(out) + 1, 0);
+        }
+        mq_close(srv);
+        return;
+    }
+    for (unsigned long i = 0; i < messages; i++) 
+    {
+        size_t len = make_payload(text, i);
+        sysv_send(LANE_NORMAL, OP_PUB, nonce, text, len);
+    }
+}
+
+static void usage(const char *prog) 
+{
+    fprintf(stderr, "Usage: %s [-m sysv|posix] [-c subscribers] [-n messages] [-s payload]\n", prog);
+}
+
+int main(int argc, char *argv[]) 
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "m:c:n:s:")) != -1) 
+    {
+        switch (opt) 
+        {
+            case 'm':
+                mode_posix = strcmp(optarg, "posix") == 0;
+                break;
+            case 'c':
+                subscribers = atoi(optarg);
+                break;
+            case 'n':
+                messages = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                payload = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (subscribers <= 0 || subscribers > MAX_SUBSCRIBERS || payload >= CHAT_MSG_SIZE - 64) 
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    nonce = (getpid() & 0xffff) * (MAX_SUBSCRIBERS + 1);
+    snprintf(tag, sizeof(tag), "bench:%d:", nonce);
+
+    if (!mode_posix) 
+    {
+        in_qid = msgget(ftok(BROKER_FTOK_PATH, BROKER_IN_ID), 0666);
+        out_qid = msgget(ftok(BROKER_FTOK_PATH, BROKER_OUT_ID), 0666);
+        if (in_qid == -1 || out_qid == -1) 
+        {
+            perror("msgget (is the broker running?)");
+            return 1;
+        }
+    }
+
+    sub_t *subs = calloc((size_t)subscribers, sizeof(sub_t));
+    for (int i = 0; i < subscribers; i++) 
+    {
+        subs[i].id = nonce + i + 1;
+        pthread_create(&subs[i].tid, NULL, mode_posix ? posix_subscriber : sysv_subscriber, &subs[i]);
+    }
+    pthread_mutex_lock(&ready_lock);
+    while (ready_count < subscribers) 
+        pthread_cond_wait(&ready_cond, &ready_lock);
+    pthread_mutex_unlock(&ready_lock);
+
+    double t0 = now_sec();
+    publish();
+    double published = now_sec();
+
+    double end = t0;
+    unsigned long delivered = 0;
+    for (int i = 0; i < subscribers; i++) 
+    {
+        pthread_join(subs[i].tid, NULL);
+        delivered += subs[i].got;
+        if (subs[i].done_at > end) 
+            end = subs[i].done_at;
+    }
+
+    double sec = end - t0;
+    printf("%s: %d subscribers, %lu messages x %zu B, publish %.3f s, all delivered %.3f s, "
+           "%.0f deliveries/s, %.1f MB/s\n", 
+           mode_posix ? "posix_mq chat" : "sysv broker", subscribers, messages, payload,
+           published - t0, sec, delivered / sec, delivered * (double)payload / sec / 1e6);
+
+    free(subs);
+    return 0;
+}
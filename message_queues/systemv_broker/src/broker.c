@@ -0,0 +1,567 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+
+#include "broker.h"
+
+#define DEFAULT_WORKERS 4
+#define BATCH_MAX 64
+#define JOB_QUEUE_LEN 1024
+#define JOB_DESTS 64
+#define QBYTES_HIGH_WATER 75    // percent of msg_qbytes that triggers growth
+#define STALL_MS 1000           // how long a full out queue is waited on
+
+// one received message shared by all delivery jobs that carry it
+typedef struct 
+{
+    atomic_int refs;
+    size_t size;
+    broker_msg_t msg;
+} shared_msg_t;
+
+// deliver msg to up to JOB_DESTS clients
+typedef struct 
+{
+    shared_msg_t *msg;
+    int ndest;
+    int dest[JOB_DESTS];
+} job_t;
+
+static int in_qid = -1;
+static int out_qid = -1;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+// client table, touched only by the receiver thread
+static int clients[BROKER_MAX_CLIENTS];
+static int clients_count = 0;
+
+// clients the sender pool evicted: nothing more is delivered to them,
+// jobs already queued included, until they OP_JOIN again
+static int evicted[BROKER_MAX_CLIENTS];
+static atomic_int evicted_count;
+static pthread_mutex_t evict_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// bounded job queue per priority lane between the receiver and the
+// sender pool; senders always take from the most urgent lane with work,
+// so a backlog of low fan-out never holds up a high message
+typedef struct 
+{
+    job_t jobs[JOB_QUEUE_LEN];
+    int head;
+    int count;
+} job_lane_t;
+
+static job_lane_t lanes[BROKER_LANES];
+static int jobs_count = 0;      // over all lanes
+static int jobs_closed = 0;
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobs_not_full = PTHREAD_COND_INITIALIZER;
+
+static atomic_ulong stat_received;
+static atomic_ulong stat_batches;
+static atomic_ulong stat_delivered;
+static atomic_ulong stat_send_errors;
+static atomic_ulong stat_evicted;
+static atomic_long last_delivery_ms;
+
+static void sigint_handler(int signo) 
+{
+    (void)signo;
+    stop_requested = 1;
+}
+
+static void msg_put(shared_msg_t *m) 
+{
+    if (atomic_fetch_sub(&m->refs, 1) == 1) 
+        free(m);
+}
+
+// lane is the inbound mtype, LANE_HIGH..LANE_LOW
+static void job_push(const job_t *job, int lane) 
+{
+    job_lane_t *l = &lanes[lane - 1];
+    pthread_mutex_lock(&jobs_lock);
+    while (l->count == JOB_QUEUE_LEN && !jobs_closed) 
+        pthread_cond_wait(&jobs_not_full, &jobs_lock);
+    l->jobs[(l->head + l->count) % JOB_QUEUE_LEN] = *job;
+    l->count++;
+    jobs_count++;
+    pthread_cond_signal(&jobs_not_empty);
+    pthread_mutex_unlock(&jobs_lock);
+}
+
+static int job_pop(job_t *job) 
+{
+    pthread_mutex_lock(&jobs_lock);
+    while (jobs_count == 0 && !jobs_closed) 
+        pthread_cond_wait(&jobs_not_empty, &jobs_lock);
+    if (jobs_count == 0) 
+    {
+        pthread_mutex_unlock(&jobs_lock);
+        return -1;
+    }
+    job_lane_t *l = lanes;
+    while (l->count == 0) 
+        l++;
+    *job = l->jobs[l->head];
+    l->head = (l->head + 1) % JOB_QUEUE_LEN;
+    l->count--;
+    jobs_count--;
+    pthread_cond_signal(&jobs_not_full);
+    pthread_mutex_unlock(&jobs_lock);
+    return 0;
+}
+
+// drops whatever the out queue holds for client id
+static unsigned long purge_client(long id) 
+{
+    broker_msg_t m;
+    unsigned long purged = 0;
+    while (msgrcv(out_qid, &m, sizeof(m) - sizeof(long), id, IPC_NOWAIT | MSG_NOERROR) != -1) 
+        purged++;
+    return purged;
+}
+
+// with evict_lock held
+static int find_evicted(int id) 
+{
+    int n = atomic_load(&evicted_count);
+    for (int i = 0; i < n; i++) 
+        if (evicted[i] == id) 
+            return i;
+    return -1;
+}
+
+static int is_evicted(int id) 
+{
+    if (atomic_load(&evicted_count) == 0) 
+        return 0;
+    pthread_mutex_lock(&evict_lock);
+    int found = find_evicted(id) != -1;
+    pthread_mutex_unlock(&evict_lock);
+    return found;
+}
+
+// The out queue stayed full: the oldest message in it belongs to the
+// client furthest behind, most likely one that died without OP_LEAVE.
+// Purge everything queued for it and stop delivering to it. Called with
+// evict_lock held.
+static void evict_slowest(void) 
+{
+    broker_msg_t m;
+    if (msgrcv(out_qid, &m, sizeof(m) - sizeof(long), 0, IPC_NOWAIT | MSG_NOERROR) == -1) 
+        return;
+
+    long id = m.mtype;
+    unsigned long purged = 1 + purge_client(id);
+
+    int n = atomic_load(&evicted_count);
+    if (find_evicted((int)id) == -1 && n < BROKER_MAX_CLIENTS) 
+    {
+        evicted[n] = (int)id;
+        atomic_store(&evicted_count, n + 1);
+    }
+    atomic_fetch_add(&stat_evicted, 1);
+    fprintf(stderr, "broker: out queue full, evicted client %ld (%lu messages purged)\n", id, purged);
+}
+
+static long now_ms(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+// A full queue is waited on. Only when no message at all went out for
+// STALL_MS is the slowest client evicted, so a queue that is full but
+// draining just holds the senders back. A message for a client evicted
+// meanwhile is skipped.
+static int deliver(broker_msg_t *out, size_t size) 
+{
+    long start = now_ms();
+    while (1) 
+    {
+        if (msgsnd(out_qid, out, size, IPC_NOWAIT) == 0) 
+        {
+            atomic_store(&last_delivery_ms, now_ms());
+            return 0;
+        }
+        if ((errno != EAGAIN && errno != EINTR) || stop_requested) 
+            return -1;
+        if (is_evicted((int)out->mtype)) 
+            return 0;
+
+        long last = atomic_load(&last_delivery_ms);
+        if (now_ms() - (last > start ? last : start) >= STALL_MS) 
+        {
+            // one eviction per stall: it counts as progress for the others
+            pthread_mutex_lock(&evict_lock);
+            if (now_ms() - atomic_load(&last_delivery_ms) >= STALL_MS) 
+            {
+                evict_slowest();
+                atomic_store(&last_delivery_ms, now_ms());
+            }
+            pthread_mutex_unlock(&evict_lock);
+            continue;
+        }
+        usleep(1000);
+    }
+}
+
+// sender pool: every worker msgsnd()s to the outbound queue with mtype = client id
+static void *sender_thread(void *arg) 
+{
+    (void)arg;
+    broker_msg_t out;
+    job_t job;
+
+    while (job_pop(&job) == 0) 
+    {
+        size_t size = job.msg->size;
+        memcpy(&out.hdr, &job.msg->msg.hdr, size);
+        for (int i = 0; i < job.ndest; i++) 
+        {
+            if (is_evicted(job.dest[i])) 
+                continue;
+            out.mtype = job.dest[i];
+            int rc = deliver(&out, size);
+            if (rc == -1) 
+                atomic_fetch_add(&stat_send_errors, 1);
+            else 
+                atomic_fetch_add(&stat_delivered, 1);
+        }
+        msg_put(job.msg);
+    }
+    return NULL;
+}
+
+static int find_client(int id) 
+{
+    for (int i = 0; i < clients_count; i++) 
+        if (clients[i] == id) 
+            return i;
+    return -1;
+}
+
+// split a delivery into jobs of JOB_DESTS clients so the pool shares fan-out
+static void schedule(shared_msg_t *m, const int *dest, int ndest) 
+{
+    int njobs = (ndest + JOB_DESTS - 1) / JOB_DESTS;
+    if (njobs == 0) 
+    {
+        free(m);
+        return;
+    }
+    atomic_init(&m->refs, njobs);
+
+    job_t job;
+    job.msg = m;
+    for (int off = 0; off < ndest; off += JOB_DESTS) 
+    {
+        job.ndest = (ndest - off < JOB_DESTS) ? ndest - off : JOB_DESTS;
+        memcpy(job.dest, dest + off, sizeof(int) * (size_t)job.ndest);
+        job_push(&job, (int)m->msg.mtype);
+    }
+}
+
+static void remove_client(int id) 
+{
+    int pos = find_client(id);
+    if (pos != -1) 
+        clients[pos] = clients[--clients_count];
+}
+
+static void apply_evictions(void) 
+{
+    if (atomic_load(&evicted_count) == 0) 
+        return;
+    pthread_mutex_lock(&evict_lock);
+    for (int i = 0; i < atomic_load(&evicted_count); i++) 
+        remove_client(evicted[i]);
+    pthread_mutex_unlock(&evict_lock);
+}
+
+// an evicted client that joins again is delivered to again, without
+// what was still queued for it from before
+static void readmit(int id) 
+{
+    if (atomic_load(&evicted_count) == 0) 
+        return;
+    pthread_mutex_lock(&evict_lock);
+    int pos = find_evicted(id);
+    if (pos != -1) 
+    {
+        int n = atomic_load(&evicted_count) - 1;
+        evicted[pos] = evicted[n];
+        atomic_store(&evicted_count, n);
+        purge_client(id);
+    }
+    pthread_mutex_unlock(&evict_lock);
+}
+
+static void dispatch(shared_msg_t *m) 
+{
+    broker_hdr_t *h = &m->msg.hdr;
+    int src = h->src;
+
+    switch (h->op) 
+    {
+        case OP_JOIN:
+            readmit(src);
+            if (src > 0 && find_client(src) == -1 && clients_count < BROKER_MAX_CLIENTS) 
+                clients[clients_count++] = src;
+            h->op = OP_ACK;
+            h->len = 0;
+            m->size = BROKER_MSG_SIZE(0);
+            schedule(m, &src, 1);
+            break;
+        case OP_LEAVE:
+            remove_client(src);
+            free(m);
+            break;
+        case OP_PUB:
+        {
+            // everyone except the sender
+            int dest[BROKER_MAX_CLIENTS];
+            int n = 0;
+            for (int i = 0; i < clients_count; i++) 
+                if (clients[i] != src) 
+                    dest[n++] = clients[i];
+            schedule(m, dest, n);
+            break;
+        }
+        case OP_DIRECT:
+            if (h->dst > 0) 
+                schedule(m, &h->dst, 1);
+            else 
+                free(m);
+            break;
+        default:
+            fprintf(stderr, "broker: unknown op %d from %d\n", h->op, src);
+            free(m);
+            break;
+    }
+}
+
+// one blocking msgrcv, then drain with IPC_NOWAIT; -BROKER_LANES picks the
+// lowest (most urgent) lane first on every call
+static int receive_batch(shared_msg_t **batch) 
+{
+    int n = 0;
+    while (n < BATCH_MAX) 
+    {
+        shared_msg_t *m = malloc(sizeof(*m));
+        if (!m) 
+            break;
+        ssize_t r = msgrcv(in_qid, &m->msg, sizeof(m->msg) - sizeof(long), -BROKER_LANES, 
+                           n == 0 ? 0 : IPC_NOWAIT);
+        if (r == -1) 
+        {
+            free(m);
+            if (errno == ENOMSG || errno == EINTR) 
+                break;
+            perror("msgrcv");
+            stop_requested = 1;
+            break;
+        }
+        if ((size_t)r < sizeof(broker_hdr_t) || m->msg.mtype < LANE_HIGH) 
+        {
+            free(m);
+            continue;
+        }
+        m->size = (size_t)r;
+        if (m->msg.hdr.len < 0 || BROKER_MSG_SIZE(m->msg.hdr.len) > m->size) 
+            m->msg.hdr.len = (int)(m->size - sizeof(broker_hdr_t));
+        batch[n++] = m;
+    }
+    return n;
+}
+
+static unsigned long read_msgmnb(void) 
+{
+    unsigned long v = 0;
+    FILE *f = fopen("/proc/sys/kernel/msgmnb", "r");
+    if (f) 
+    {
+        if (fscanf(f, "%lu", &v) != 1) 
+            v = 0;
+        fclose(f);
+    }
+    return v;
+}
+
+static int set_qbytes(int qid, unsigned long bytes) 
+{
+    struct msqid_ds ds;
+    if (msgctl(qid, IPC_STAT, &ds) == -1) 
+        return -1;
+    if (ds.msg_qbytes >= bytes) 
+        return 0;
+    ds.msg_qbytes = bytes;
+    return msgctl(qid, IPC_SET, &ds);
+}
+
+typedef struct 
+{
+    unsigned long qbytes_max;
+    int verbose;
+} monitor_cfg_t;
+
+// watch queue fill level once a second; double msg_qbytes while a queue stays
+// above the high-water mark (needs CAP_SYS_RESOURCE past msgmnb)
+static void *monitor_thread(void *arg) 
+{
+    monitor_cfg_t *cfg = arg;
+    int qids[2] = {in_qid, out_qid};
+    int can_grow = 1;
+    unsigned long last_rx = 0, last_tx = 0;
+
+    while (!stop_requested) 
+    {
+        sleep(1);
+        for (int i = 0; i < 2 && can_grow; i++) 
+        {
+            struct msqid_ds ds;
+            if (msgctl(qids[i], IPC_STAT, &ds) == -1) 
+                continue;
+            if (ds.msg_cbytes * 100 >= ds.msg_qbytes * QBYTES_HIGH_WATER && ds.msg_qbytes < cfg->qbytes_max) 
+            {
+                unsigned long want = ds.msg_qbytes * 2;
+                if (want > cfg->qbytes_max) 
+                    want = cfg->qbytes_max;
+                if (set_qbytes(qids[i], want) == -1) 
+                {
+                    fprintf(stderr, "broker: cannot raise msg_qbytes to %lu: %s\n", want, strerror(errno));
+                    can_grow = 0;
+                } 
+                else if (cfg->verbose) 
+                {
+                    printf("broker: %s queue msg_qbytes -> %lu\n", i == 0 ? "in" : "out", want);
+                }
+            }
+        }
+
+        if (cfg->verbose) 
+        {
+            unsigned long rx = atomic_load(&stat_received), tx = atomic_load(&stat_delivered);
+            unsigned long batches = atomic_load(&stat_batches);
+            printf("broker: clients %d, in %lu/s, out %lu/s, avg batch %.1f, send errors %lu, evicted %lu\n", 
+                   clients_count, rx - last_rx, tx - last_tx, batches ? (double)rx / batches : 0.0, 
+                   atomic_load(&stat_send_errors), atomic_load(&stat_evicted));
+            fflush(stdout);
+            last_rx = rx;
+            last_tx = tx;
+        }
+    }
+    return NULL;
+}
+
+static void usage(const char *prog) 
+{
+    fprintf(stderr, "Usage: %s [-w workers] [-q qbytes] [-Q max_qbytes] [-v]\n", prog);
+}
+
+int main(int argc, char *argv[]) 
+{
+    int workers = DEFAULT_WORKERS;
+    unsigned long qbytes = 0;
+    monitor_cfg_t mon = {0, 0};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:q:Q:v")) != -1) 
+    {
+        switch (opt) 
+        {
+            case 'w':
+                workers = atoi(optarg);
+                break;
+            case 'q':
+                qbytes = strtoul(optarg, NULL, 10);
+                break;
+            case 'Q':
+                mon.qbytes_max = strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                mon.verbose = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (workers <= 0) 
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (qbytes == 0) 
+        qbytes = read_msgmnb();
+    if (mon.qbytes_max == 0) 
+        mon.qbytes_max = qbytes * 16;
+
+    struct sigaction sa;
+    sa.sa_handler = sigint_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    in_qid = msgget(ftok(BROKER_FTOK_PATH, BROKER_IN_ID), IPC_CREAT | 0666);
+    out_qid = msgget(ftok(BROKER_FTOK_PATH, BROKER_OUT_ID), IPC_CREAT | 0666);
+    if (in_qid == -1 || out_qid == -1) 
+    {
+        perror("msgget");
+        return 1;
+    }
+    if (qbytes && (set_qbytes(in_qid, qbytes) == -1 || set_qbytes(out_qid, qbytes) == -1)) 
+        fprintf(stderr, "broker: cannot set msg_qbytes to %lu: %s\n", qbytes, strerror(errno));
+
+    pthread_t *senders = calloc((size_t)workers, sizeof(pthread_t));
+    for (int i = 0; i < workers; i++) 
+        pthread_create(&senders[i], NULL, sender_thread, NULL);
+    pthread_t mon_tid;
+    pthread_create(&mon_tid, NULL, monitor_thread, &mon);
+
+    printf("Broker started: in queue %d, out queue %d, %d sender workers\n", in_qid, out_qid, workers);
+    fflush(stdout);
+
+    shared_msg_t *batch[BATCH_MAX];
+    while (!stop_requested) 
+    {
+        int n = receive_batch(batch);
+        if (n == 0) 
+            continue;
+        atomic_fetch_add(&stat_received, (unsigned long)n);
+        atomic_fetch_add(&stat_batches, 1);
+        apply_evictions();
+        for (int i = 0; i < n; i++) 
+            dispatch(batch[i]);
+    }
+
+    printf("Broker shutting down...\n");
+    pthread_mutex_lock(&jobs_lock);
+    jobs_closed = 1;
+    pthread_cond_broadcast(&jobs_not_empty);
+    pthread_cond_broadcast(&jobs_not_full);
+    pthread_mutex_unlock(&jobs_lock);
+
+    // removing the queues ends workers waiting on a full one
+    msgctl(in_qid, IPC_RMID, NULL);
+    msgctl(out_qid, IPC_RMID, NULL);
+    for (int i = 0; i < workers; i++) 
+        pthread_join(senders[i], NULL);
+    pthread_join(mon_tid, NULL);
+    free(senders);
+    return 0;
+}
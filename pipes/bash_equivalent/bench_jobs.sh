@@ -0,0 +1,30 @@
+#!/bin/sh
+# Wall time for N short jobs through the `parallel` builtin at concurrency
+# 1, 4 and 16: an exec-bound job (/bin/true) and a wait-bound one (sleep).
+# usage: ./bench_jobs.sh [jobs] [sleep_seconds]
+
+COUNT=${1:-1000}
+NAP=${2:-0.01}
+SHELL_BIN=./bin/shell_for_poor
+
+[ -x "$SHELL_BIN" ] || make >/dev/null || exit 1
+
+ITEMS=$(seq 1 "$COUNT" | tr '\n' ' ')
+NAPS=$(yes "$NAP" | head -n "$COUNT" | tr '\n' ' ')
+
+run() {
+    label=$1
+    line=$2
+    start=$(date +%s.%N)
+    echo "$line" | "$SHELL_BIN" > /dev/null
+    end=$(date +%s.%N)
+    awk -v l="$label" -v s="$start" -v e="$end" -v n="$COUNT" \
+        'BEGIN { printf "%-28s %8.3f s %10.0f jobs/s\n", l, e - s, n / (e - s) }'
+}
+
+for j in 1 4 16; do
+    run "/bin/true, -j $j" "parallel -j $j /bin/true {} ::: $ITEMS"
+done
+for j in 1 4 16; do
+    run "sleep $NAP, -j $j" "parallel -j $j sleep ::: $NAPS"
+done
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Launch cost of fork + execvp against posix_spawn: a script of `true`
+# commands and a script of 4-stage `true | true | true | true` pipelines,
+# with a small and a large shell address space.
+# usage: ./bench_launch.sh [commands] [pipelines] [ballast_MB]
+
+COUNT=${1:-100000}
+PIPELINES=${2:-10000}
+BALLAST=${3:-1024}
+SHELL_BIN=./bin/shell_for_poor
+SCRIPT=/tmp/bench_launch_script.txt
+
+[ -x "$SHELL_BIN" ] || make >/dev/null || exit 1
+
+run() {
+    label=$1
+    n=$2
+    shift 2
+    start=$(date +%s.%N)
+    "$SHELL_BIN" "$@" < "$SCRIPT" > /dev/null
+    end=$(date +%s.%N)
+    awk -v l="$label" -v s="$start" -v e="$end" -v n="$n" \
+        'BEGIN { printf "%-36s %8.3f s %10.0f /s %10.1f us each\n", l, e - s, n / (e - s), (e - s) / n * 1e6 }'
+}
+
+yes true | head -n "$COUNT" > "$SCRIPT"
+echo exit >> "$SCRIPT"
+echo "$COUNT x true"
+run "fork" "$COUNT" -f
+run "posix_spawn" "$COUNT"
+run "fork, ${BALLAST} MB shell" "$COUNT" -f -m "$BALLAST"
+run "posix_spawn, ${BALLAST} MB shell" "$COUNT" -m "$BALLAST"
+
+yes "true | true | true | true" | head -n "$PIPELINES" > "$SCRIPT"
+echo exit >> "$SCRIPT"
+echo "$PIPELINES x 4-stage pipeline"
+run "fork" "$PIPELINES" -f
+run "posix_spawn" "$PIPELINES"
+run "fork, ${BALLAST} MB shell" "$PIPELINES" -f -m "$BALLAST"
+run "posix_spawn, ${BALLAST} MB shell" "$PIPELINES" -m "$BALLAST"
+
+rm -f "$SCRIPT"
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Times a data-heavy pipeline through the shell: exec'd cat with default
+# pipes (old behaviour) against the splice builtins with 1 MB pipes.
+# usage: [PIPELINE="..."] ./bench_pipeline.sh [size_MB] [file]
+
+SIZE_MB=${1:-1024}
+FILE=${2:-/tmp/bench_pipeline.dat}
+SHELL_BIN=./bin/shell_for_poor
+PIPELINE=${PIPELINE:-"cat $FILE | grep x | wc -l"}
+
+[ -x "$SHELL_BIN" ] || make >/dev/null || exit 1
+
+if [ ! -f "$FILE" ] || [ "$(stat -c %s "$FILE")" -ne $((SIZE_MB * 1024 * 1024)) ]; then
+    echo "generating $FILE ($SIZE_MB MB)"
+    yes "abcdefghijklmnopqrstuvwxyz 0123456789 x" | head -c $((SIZE_MB * 1024 * 1024)) > "$FILE"
+fi
+
+run() {
+    label=$1
+    shift
+    start=$(date +%s.%N)
+    printf '%s\nexit\n' "$PIPELINE" | "$SHELL_BIN" "$@" > /dev/null
+    end=$(date +%s.%N)
+    awk -v l="$label" -v s="$start" -v e="$end" 'BEGIN { printf "%s: %.3f s\n", l, e - s }'
+}
+
+# warm the page cache so both runs read from memory
+cat "$FILE" > /dev/null
+
+run "exec cat, default pipes " -n
+run "exec cat, 1 MB pipes    " -n -p 1048576
+run "splice cat, default pipes"
+run "splice cat, 1 MB pipes  " -p 1048576
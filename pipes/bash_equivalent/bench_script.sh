@@ -0,0 +1,43 @@
+#!/bin/sh
+# Script time (and syscalls per command when strace is installed) for a mix
+# of builtins and PATH commands: in-process builtins + hash cache against
+# the old behaviour (-e: everything exec'd through posix_spawnp's PATH walk).
+# usage: ./bench_script.sh [repeats]
+
+REPEATS=${1:-5000}
+SHELL_BIN=${SHELL_BIN:-./bin/shell_for_poor}
+SCRIPT=/tmp/bench_script_mix.txt
+
+[ -x "$SHELL_BIN" ] || make >/dev/null || exit 1
+
+: > "$SCRIPT"
+i=0
+while [ "$i" -lt "$REPEATS" ]; do
+    printf 'echo "line %d"\ntrue\nls -d /tmp\ncat /dev/null\n' "$i" >> "$SCRIPT"
+    i=$((i + 1))
+done
+echo exit >> "$SCRIPT"
+COMMANDS=$((REPEATS * 4))
+
+run() {
+    label=$1
+    shift
+    start=$(date +%s.%N)
+    "$SHELL_BIN" "$@" < "$SCRIPT" > /dev/null
+    end=$(date +%s.%N)
+    awk -v l="$label" -v s="$start" -v e="$end" -v n="$COMMANDS" \
+        'BEGIN { printf "%-28s %8.3f s %10.0f commands/s\n", l, e - s, n / (e - s) }'
+
+    if command -v strace >/dev/null 2>&1; then
+        strace -f -c -o /tmp/bench_script_strace.txt "$SHELL_BIN" "$@" < "$SCRIPT" > /dev/null
+        awk -v n="$COMMANDS" '$NF == "total" { printf "%-28s %8.1f syscalls/command\n", "", $4 / n }' \
+            /tmp/bench_script_strace.txt
+        rm -f /tmp/bench_script_strace.txt
+    fi
+}
+
+command -v strace >/dev/null 2>&1 || echo "strace not found, timing only"
+run "exec everything (-e)" -e
+run "builtins + hash cache"
+
+rm -f "$SCRIPT"
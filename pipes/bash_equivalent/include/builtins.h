@@ -0,0 +1,12 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+// echo, true, false, cd, exit, hash, jobs, wait: run inside the shell,
+// no fork or exec
+int is_builtin(const char *name);
+int run_builtin(char **args, int out_fd);
+
+// set by `exit`; the shell leaves its loop with *status
+int builtin_exit_requested(int *status);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <sys/types.h>
+
+// Job table: every pipeline the shell launches, foreground or background,
+// is a job of one or more pids. Each pid gets a pidfd, and job_poll() waits
+// on all of them with one poll(), so a foreground wait also notices
+// background jobs finishing. Without pidfd support it falls back to
+// waitpid(-1).
+
+// pids[i] == -1 is a stage that failed to launch (exit status 127);
+// cmd is copied. Returns the job number (%n), -1 on allocation failure.
+int job_add(const pid_t *pids, int n, const char *cmd, int background);
+
+// reap whatever has exited; block until at least one pid exits if asked
+void job_poll(int block);
+
+int job_done(int id);
+
+// block until the job finishes, release it and return its exit status
+int job_wait(int id);
+// wait for every job; returns the status of the last one released
+int job_wait_all(void);
+
+// number of jobs that still have running pids
+int job_running(void);
+
+// print and release finished background jobs ("[n] Done  cmd")
+void job_notify(void);
+// `jobs` listing
+void job_list(int out_fd);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef SPLICE_IO_H
+#define SPLICE_IO_H
+
+// move everything from in to out; splice() when either side is a pipe,
+// sendfile() between plain files, read/write as the last resort
+int forward_fd(int in, int out);
+
+// data-forwarding builtins that run in the pipeline child instead of exec
+int is_forward_builtin(const char *name);
+int run_forward_builtin(char **args);
+
+#endif
@@ -0,0 +1,163 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "command_hash.h"
+
+#define HASH_INITIAL 64
+
+typedef struct 
+{
+    uint32_t hash;
+    char *name;
+    char *path;
+    unsigned hits;
+} hash_entry_t;
+
+static hash_entry_t *table = NULL;
+static size_t table_size = 0;
+static size_t table_used = 0;
+
+static uint32_t fnv1a(const char *s) 
+{
+    uint32_t h = 2166136261u;
+    while (*s) 
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+void cmd_hash_clear(void) 
+{
+    for (size_t i = 0; i < table_size; i++) 
+    {
+        free(table[i].name);
+        free(table[i].path);
+    }
+    free(table);
+    table = NULL;
+    table_size = 0;
+    table_used = 0;
+}
+
+static hash_entry_t *find_slot(hash_entry_t *tab, size_t size, const char *name, uint32_t h) 
+{
+    size_t i = h & (size - 1);
+    while (tab[i].name && (tab[i].hash != h || strcmp(tab[i].name, name) != 0)) 
+        i = (i + 1) & (size - 1);
+    return &tab[i];
+}
+
+static int grow(void) 
+{
+    size_t size = table_size ? table_size * 2 : HASH_INITIAL;
+    hash_entry_t *tab = calloc(size, sizeof(*tab));
+    if (!tab) 
+        return -1;
+    for (size_t i = 0; i < table_size; i++) 
+        if (table[i].name) 
+            *find_slot(tab, size, table[i].name, table[i].hash) = table[i];
+    free(table);
+    table = tab;
+    table_size = size;
+    return 0;
+}
+
+// one stat() per PATH entry, only on a cache miss
+static char *search_path(const char *name, const char *path_env) 
+{
+    char buf[PATH_MAX];
+    const char *dir = path_env;
+    for (;;) 
+    {
+        const char *end = strchr(dir, ':');
+        size_t len = end ? (size_t)(end - dir) : strlen(dir);
+        int n = (len == 0) ? snprintf(buf, sizeof(buf), "./%s", name) 
+                           : snprintf(buf, sizeof(buf), "%.*s/%s", (int)len, dir, name);
+        struct stat st;
+        if (n > 0 && (size_t)n < sizeof(buf) && stat(buf, &st) == 0 
+            && S_ISREG(st.st_mode) && (st.st_mode & 0111)) 
+            return strdup(buf);
+        if (!end) 
+            return NULL;
+        dir = end + 1;
+    }
+}
+
+const char *cmd_hash_lookup(const char *name) 
+{
+    if (strchr(name, '/')) 
+        return name;
+
+    uint32_t h = fnv1a(name);
+    if (table_size) 
+    {
+        hash_entry_t *e = find_slot(table, table_size, name, h);
+        if (e->name) 
+        {
+            e->hits++;
+            return e->path;
+        }
+    }
+
+    const char *path_env = getenv("PATH");
+    char *path = search_path(name, path_env ? path_env : "/bin:/usr/bin");
+    if (!path) 
+        return NULL;
+    if ((table_used + 1) * 2 > table_size && grow() == -1) 
+    {
+        free(path);
+        return NULL;
+    }
+    hash_entry_t *e = find_slot(table, table_size, name, h);
+    e->hash = h;
+    e->name = strdup(name);
+    e->path = path;
+    e->hits = 1;
+    table_used++;
+    return e->path;
+}
+
+// drop one entry (e.g. the binary moved); rebuilt so probe chains stay intact
+void cmd_hash_forget(const char *name) 
+{
+    if (!table_size) 
+        return;
+    hash_entry_t *e = find_slot(table, table_size, name, fnv1a(name));
+    if (!e->name) 
+        return;
+    free(e->name);
+    free(e->path);
+    e->name = NULL;
+    e->path = NULL;
+    table_used--;
+
+    hash_entry_t *old = table;
+    size_t old_size = table_size;
+    table = calloc(old_size, sizeof(*table));
+    if (!table) 
+    {
+        table = old;
+        return;
+    }
+    for (size_t i = 0; i < old_size; i++) 
+        if (old[i].name) 
+            *find_slot(table, table_size, old[i].name, old[i].hash) = old[i];
+    free(old);
+}
+
+void cmd_hash_print(int out_fd) 
+{
+    if (table_used == 0) 
+    {
+        dprintf(out_fd, "hash: hash table empty\n");
+        return;
+    }
+    dprintf(out_fd, "hits\tcommand\n");
+    for (size_t i = 0; i < table_size; i++) 
+        if (table[i].name) 
+            dprintf(out_fd, "%4u\t%s\n", table[i].hits, table[i].path);
+}
@@ -0,0 +1,308 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include "jobs.h"
+
+typedef struct 
+{
+    int id;             // 0 = free slot
+    int background;
+    int npids;
+    int live;
+    pid_t *pids;
+    int *pidfds;
+    int status;         // wait status of the last stage
+    char *cmd;
+} job_t;
+
+static job_t *jobs = NULL;
+static int jobs_cap = 0;
+static int next_id = 1;
+// cleared the first time pidfd_open() reports ENOSYS
+static int have_pidfd = 1;
+
+// poll set rebuilt on every job_poll(), grows with the number of live pids
+static struct pollfd *fds = NULL;
+static int *fd_job = NULL;
+static int *fd_stage = NULL;
+static int fds_cap = 0;
+
+static int pidfd_open(pid_t pid) 
+{
+#ifdef SYS_pidfd_open
+    if (have_pidfd) 
+    {
+        int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+        if (fd == -1 && errno == ENOSYS) 
+            have_pidfd = 0;
+        return fd;
+    }
+#endif
+    (void)pid;
+    have_pidfd = 0;
+    return -1;
+}
+
+static int exit_code(int status) 
+{
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+static job_t *find_job(int id) 
+{
+    for (int i = 0; i < jobs_cap; i++) 
+        if (jobs[i].id == id) 
+            return &jobs[i];
+    return NULL;
+}
+
+static void release(job_t *j) 
+{
+    free(j->pids);
+    free(j->pidfds);
+    free(j->cmd);
+    memset(j, 0, sizeof(*j));
+
+    // job numbers restart once the table is empty, like bash
+    for (int i = 0; i < jobs_cap; i++) 
+        if (jobs[i].id) 
+            return;
+    next_id = 1;
+}
+
+static void stage_exited(job_t *j, int stage, int status) 
+{
+    if (j->pidfds[stage] != -1) 
+        close(j->pidfds[stage]);
+    j->pidfds[stage] = -1;
+    j->pids[stage] = -1;
+    j->live--;
+    if (stage == j->npids - 1) 
+        j->status = status;
+}
+
+int job_add(const pid_t *pids, int n, const char *cmd, int background) 
+{
+    job_t *j = NULL;
+    for (int i = 0; i < jobs_cap; i++) 
+    {
+        if (jobs[i].id == 0) 
+        {
+            j = &jobs[i];
+            break;
+        }
+    }
+    if (!j) 
+    {
+        int cap = jobs_cap ? jobs_cap * 2 : 16;
+        job_t *t = realloc(jobs, cap * sizeof(job_t));
+        if (!t) 
+            return -1;
+        memset(t + jobs_cap, 0, (cap - jobs_cap) * sizeof(job_t));
+        jobs = t;
+        j = &jobs[jobs_cap];
+        jobs_cap = cap;
+    }
+
+    j->pids = malloc(n * sizeof(pid_t));
+    j->pidfds = malloc(n * sizeof(int));
+    j->cmd = strdup(cmd);
+    if (!j->pids || !j->pidfds || !j->cmd) 
+    {
+        release(j);
+        return -1;
+    }
+
+    j->npids = n;
+    j->live = 0;
+    j->background = background;
+    j->status = 0;
+    for (int i = 0; i < n; i++) 
+    {
+        j->pids[i] = pids[i];
+        j->pidfds[i] = -1;
+        if (pids[i] > 0) 
+        {
+            j->pidfds[i] = pidfd_open(pids[i]);
+            j->live++;
+        }
+    }
+    if (pids[n - 1] <= 0) 
+        j->status = 127 << 8;
+
+    j->id = next_id++;
+    return j->id;
+}
+
+// no pidfds: reap with waitpid(-1) and match the pid in the table
+static void poll_waitpid(int block) 
+{
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, block ? 0 : WNOHANG)) > 0) 
+    {
+        for (int i = 0; i < jobs_cap; i++) 
+            for (int s = 0; jobs[i].id && s < jobs[i].npids; s++) 
+                if (jobs[i].pids[s] == pid) 
+                    stage_exited(&jobs[i], s, status);
+        block = 0;
+    }
+}
+
+// pids whose pidfd_open() failed (EMFILE, ENOMEM...) while pidfds work:
+// reaped by pid without blocking; returns how many still run
+static int reap_unpolled(void) 
+{
+    int running = 0;
+    for (int i = 0; i < jobs_cap; i++) 
+    {
+        for (int s = 0; jobs[i].id && s < jobs[i].npids; s++) 
+        {
+            if (jobs[i].pidfds[s] != -1 || jobs[i].pids[s] <= 0) 
+                continue;
+            int status = 0;
+            pid_t r = waitpid(jobs[i].pids[s], &status, WNOHANG);
+            if (r == 0) 
+                running++;
+            else if (r > 0 || errno == ECHILD) 
+                stage_exited(&jobs[i], s, status);
+        }
+    }
+    return running;
+}
+
+void job_poll(int block) 
+{
+    if (!have_pidfd) 
+    {
+        poll_waitpid(block);
+        return;
+    }
+
+    int unpolled = reap_unpolled();
+
+    int n = 0;
+    for (int i = 0; i < jobs_cap; i++) 
+    {
+        for (int s = 0; jobs[i].id && s < jobs[i].npids; s++) 
+        {
+            if (jobs[i].pidfds[s] == -1) 
+                continue;
+            if (n == fds_cap) 
+            {
+                int cap = fds_cap ? fds_cap * 2 : 64;
+                struct pollfd *f = realloc(fds, cap * sizeof(*f));
+                if (f) 
+                    fds = f;
+                int *fj = realloc(fd_job, cap * sizeof(int));
+                if (fj) 
+                    fd_job = fj;
+                int *fs = realloc(fd_stage, cap * sizeof(int));
+                if (fs) 
+                    fd_stage = fs;
+                if (!f || !fj || !fs) 
+                    return;
+                fds_cap = cap;
+            }
+            fds[n].fd = jobs[i].pidfds[s];
+            fds[n].events = POLLIN;
+            fd_job[n] = i;
+            fd_stage[n] = s;
+            n++;
+        }
+    }
+    if (n == 0 && unpolled == 0) 
+        return;
+
+    // pids without a pidfd are looked at again every 10 ms
+    int ready = poll(fds, n, !block ? 0 : unpolled ? 10 : -1);
+    if (ready <= 0) 
+        return;
+
+    for (int k = 0; k < n && ready > 0; k++) 
+    {
+        if (!fds[k].revents) 
+            continue;
+        ready--;
+        job_t *j = &jobs[fd_job[k]];
+        int status = 0;
+        // readable pidfd: the child has exited, waitpid does not block
+        if (waitpid(j->pids[fd_stage[k]], &status, 0) == -1 && errno != ECHILD) 
+            continue;
+        stage_exited(j, fd_stage[k], status);
+    }
+}
+
+int job_done(int id) 
+{
+    job_t *j = find_job(id);
+    return !j || j->live == 0;
+}
+
+int job_wait(int id) 
+{
+    job_t *j = find_job(id);
+    if (!j) 
+        return 127;
+
+    while (j->live > 0) 
+        job_poll(1);
+
+    int status = exit_code(j->status);
+    release(j);
+    return status;
+}
+
+int job_wait_all(void) 
+{
+    int status = 0;
+    for (int i = 0; i < jobs_cap; i++) 
+        if (jobs[i].id) 
+            status = job_wait(jobs[i].id);
+    return status;
+}
+
+int job_running(void) 
+{
+    int n = 0;
+    for (int i = 0; i < jobs_cap; i++) 
+        if (jobs[i].id && jobs[i].live > 0) 
+            n++;
+    return n;
+}
+
+void job_notify(void) 
+{
+    job_poll(0);
+    for (int i = 0; i < jobs_cap; i++) 
+    {
+        job_t *j = &jobs[i];
+        if (!j->id || !j->background || j->live > 0) 
+            continue;
+        int code = exit_code(j->status);
+        if (code == 0) 
+            fprintf(stderr, "[%d] Done\t%s\n", j->id, j->cmd);
+        else 
+            fprintf(stderr, "[%d] Exit %d\t%s\n", j->id, code, j->cmd);
+        release(j);
+    }
+}
+
+void job_list(int out_fd) 
+{
+    job_poll(0);
+    for (int i = 0; i < jobs_cap; i++) 
+    {
+        job_t *j = &jobs[i];
+        if (!j->id || !j->background) 
+            continue;
+        dprintf(out_fd, "[%d] %s\t%s\n", j->id, j->live > 0 ? "Running" : "Done", j->cmd);
+    }
+}
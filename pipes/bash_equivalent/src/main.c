@@ -1,133 +1,462 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/wait.h>
+#include <spawn.h>
 
-#define MAX_LINE 1024
-#define MAX_ARGS 64
+#include "splice_io.h"
+#include "tokenizer.h"
+#include "command_hash.h"
+#include "builtins.h"
+#include "jobs.h"
 
-void parse_input(char *input, char **args)
+// pipe capacity for F_SETPIPE_SZ, 0 keeps the kernel default
+static int pipe_size = 0;
+// cat/tee run in-process with splice()/tee() instead of exec
+static int forward_builtins = 1;
+// launch stages with posix_spawn instead of fork + execvp
+static int use_spawn = 1;
+// echo/true/false run in the shell, commands resolve through the hash cache
+static int use_builtins = 1;
+static int use_cache = 1;
+
+extern char **environ;
+
+// touch MB of heap so fork() has a large address space to copy (benchmarks)
+static void *ballast = NULL;
+
+typedef struct
+{
+    char **args;
+    size_t first;
+    char *infile;
+    char *outfile;
+    int append;
+} stage_t;
+
+// word and stage arrays are reused for every line and only ever grow
+static char **words = NULL;
+static size_t words_count = 0;
+static size_t words_cap = 0;
+static stage_t *stages = NULL;
+static size_t stages_cap = 0;
+
+// a line is a list of pipelines joined by ; && || or ended by &
+typedef struct
+{
+    int first;
+    int count;
+    int sep;
+} pipeline_t;
+
+static pipeline_t *pipelines = NULL;
+static size_t pipelines_cap = 0;
+
+static int push_word(char *word)
+{
+    if (words_count == words_cap)
+    {
+        size_t cap = words_cap ? words_cap * 2 : 64;
+        char **w = realloc(words, cap * sizeof(char *));
+        if (!w)
+            return -1;
+        words = w;
+        words_cap = cap;
+    }
+    words[words_count++] = word;
+    return 0;
+}
+
+static stage_t *new_stage(int n)
+{
+    if ((size_t)n == stages_cap)
+    {
+        size_t cap = stages_cap ? stages_cap * 2 : 8;
+        stage_t *s = realloc(stages, cap * sizeof(stage_t));
+        if (!s)
+            return NULL;
+        stages = s;
+        stages_cap = cap;
+    }
+    stage_t *st = &stages[n];
+    memset(st, 0, sizeof(*st));
+    st->first = words_count;
+    return st;
+}
+
+static int push_pipeline(int n, int first, int count, int sep)
+{
+    if ((size_t)n == pipelines_cap)
+    {
+        size_t cap = pipelines_cap ? pipelines_cap * 2 : 8;
+        pipeline_t *p = realloc(pipelines, cap * sizeof(pipeline_t));
+        if (!p)
+            return -1;
+        pipelines = p;
+        pipelines_cap = cap;
+    }
+    pipelines[n].first = first;
+    pipelines[n].count = count;
+    pipelines[n].sep = sep;
+    return 0;
+}
+
+static int is_list_op(int type)
+{
+    return type == TOK_SEMI || type == TOK_AND || type == TOK_OR || type == TOK_BG;
+}
+
+// split a line into pipelines of stages; returns the pipeline count, 0 for
+// an empty line, -1 on a syntax error
+static int parse_line(char *line)
 {
-    int i = 0;
+    tokenizer_t tok;
+    tok_init(&tok, line);
+    words_count = 0;
 
-    args[i] = strtok(input, " \n");
-    while(args[i] !=  NULL && i < MAX_ARGS - 1)
+    int n = 0;
+    int npipes = 0;
+    int first = 0;
+    stage_t *st = new_stage(n);
+    if (!st)
+        return -1;
+
+    for (;;)
     {
-        i++;
-        args[i] = strtok(NULL, " \n");
+        char *word;
+        int type = tok_next(&tok, &word);
+
+        if (type == TOK_WORD)
+        {
+            if (push_word(word) == -1)
+                return -1;
+        }
+        else if (type == TOK_IN || type == TOK_OUT || type == TOK_APPEND)
+        {
+            if (tok_next(&tok, &word) != TOK_WORD)
+            {
+                fprintf(stderr, "syntax error: missing file name after redirection\n");
+                return -1;
+            }
+            if (type == TOK_IN)
+                st->infile = word;
+            else
+            {
+                st->outfile = word;
+                st->append = (type == TOK_APPEND);
+            }
+        }
+        else if (type == TOK_PIPE || type == TOK_END || is_list_op(type))
+        {
+            int empty = (words_count == st->first);
+            if (push_word(NULL) == -1)
+                return -1;
+            n++;
+
+            if (empty)
+            {
+                // only a line that is empty or ends in ; or & may end here
+                if (type == TOK_END && n - 1 == first)
+                    break;
+                fprintf(stderr, "syntax error near unexpected token\n");
+                return -1;
+            }
+            if (type != TOK_PIPE)
+            {
+                if (push_pipeline(npipes++, first, n - first, type) == -1)
+                    return -1;
+                first = n;
+                if (type == TOK_END)
+                    break;
+            }
+            st = new_stage(n);
+            if (!st)
+                return -1;
+        }
+        else
+        {
+            fprintf(stderr, "syntax error: unterminated quote\n");
+            return -1;
+        }
     }
-    args[i] = NULL;
+
+    if (npipes > 0 && pipelines[npipes - 1].sep != TOK_SEMI && pipelines[npipes - 1].sep != TOK_BG
+        && pipelines[npipes - 1].sep != TOK_END)
+    {
+        fprintf(stderr, "syntax error: unexpected end of line\n");
+        return -1;
+    }
+
+    // words may have moved while growing
+    for (int i = 0; i < n; i++)
+        stages[i].args = words + stages[i].first;
+    return npipes;
+}
+
+// cd/exit/hash/jobs/wait always use shell state; echo/true/false unless -e
+static int runs_in_shell(const char *name)
+{
+    if (!is_builtin(name))
+        return 0;
+    return use_builtins || strcmp(name, "cd") == 0 || strcmp(name, "exit") == 0
+        || strcmp(name, "hash") == 0 || strcmp(name, "jobs") == 0 
+        || strcmp(name, "wait") == 0;
 }
 
-char **parse_pipeline(char *input, int *count)
+static int run_parallel(char **args);
+
+// posix_spawn() (vfork-style clone in glibc) with the pipe ends and
+// redirections as file actions; the shell's page tables are never copied
+static pid_t spawn_stage(const stage_t *st, const char *path, int in_fd, int out_fd)
 {
-    int capacity = 4;
-    char **commands = malloc(capacity * sizeof(char*));
+    char **args = st->args;
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+
+    // redirections are opened here, not as file actions: a missing file
+    // is reported by name and never taken for a stale cache entry
+    int file_in = -1;
+    int file_out = -1;
+    if (st->infile && (file_in = open(st->infile, O_RDONLY | O_CLOEXEC)) == -1)
+    {
+        fprintf(stderr, "%s: %s\n", st->infile, strerror(errno));
+        posix_spawn_file_actions_destroy(&fa);
+        return -1;
+    }
+    if (st->outfile && (file_out = open(st->outfile, O_WRONLY | O_CREAT | O_CLOEXEC 
+            | (st->append ? O_APPEND : O_TRUNC), 0644)) == -1)
+    {
+        fprintf(stderr, "%s: %s\n", st->outfile, strerror(errno));
+        if (file_in != -1)
+            close(file_in);
+        posix_spawn_file_actions_destroy(&fa);
+        return -1;
+    }
 
-    int i = 0;
-    char *token = strtok(input, "|");
+    if (in_fd != -1)
+        posix_spawn_file_actions_adddup2(&fa, in_fd, STDIN_FILENO);
+    if (out_fd != -1)
+        posix_spawn_file_actions_adddup2(&fa, out_fd, STDOUT_FILENO);
+    if (file_in != -1)
+        posix_spawn_file_actions_adddup2(&fa, file_in, STDIN_FILENO);
+    if (file_out != -1)
+        posix_spawn_file_actions_adddup2(&fa, file_out, STDOUT_FILENO);
 
-    while (token != NULL)
+    pid_t pid;
+    int rc;
+    if (path)
     {
-        if (i >= capacity)
+        rc = posix_spawn(&pid, path, &fa, NULL, args, environ);
+        // stale cache entry: the cached file is gone, so forget it and
+        // search PATH once more
+        if (rc == ENOENT && path != args[0] && access(path, X_OK) != 0)
         {
-            capacity *= 2;
-            commands = realloc(commands, capacity * sizeof(char*));
+            cmd_hash_forget(args[0]);
+            path = cmd_hash_lookup(args[0]);
+            rc = path ? posix_spawn(&pid, path, &fa, NULL, args, environ) : ENOENT;
         }
+    }
+    else
+    {
+        rc = posix_spawnp(&pid, args[0], &fa, NULL, args, environ);
+    }
+    posix_spawn_file_actions_destroy(&fa);
+    if (file_in != -1)
+        close(file_in);
+    if (file_out != -1)
+        close(file_out);
 
-        commands[i++] = token;
-        token = strtok(NULL, "|");
+    if (rc != 0)
+    {
+        fprintf(stderr, "%s: %s\n", args[0], strerror(rc));
+        return -1;
     }
+    return pid;
+}
 
-    *count = i;
-    return commands;
+// errno of the child's failed exec, 0 once it exec'd: the report pipe is
+// close-on-exec, so a successful exec reads as end of file
+static int exec_error(int report[2])
+{
+    int err = 0;
+    close(report[1]);
+    if (read(report[0], &err, sizeof(err)) != sizeof(err))
+        err = 0;
+    close(report[0]);
+    return err;
 }
 
-void parse_redirection(char **args, char **infile, char **outfile, 
-    int *append)
+// read_fd is the read end of the child's own output pipe; builtins never
+// exec, so close-on-exec does not close it, or the originals of the
+// dup2'd ends, and the writer would never see EPIPE. retried: a stale
+// cache entry was already dropped once for this stage
+static pid_t fork_stage(const stage_t *st, const char *path, int in_fd, int out_fd, int read_fd, int retried)
 {
-    for (int i = 0; args[i] != NULL; i++)
+    char **args = st->args;
+
+    // a cached path the child cannot exec is reported back, like the
+    // ENOENT from posix_spawn in spawn_stage()
+    int report[2] = {-1, -1};
+    if (path && path != args[0] && pipe2(report, O_CLOEXEC) == -1)
+        report[0] = -1;
+
+    pid_t pid = fork();
+
+    if (pid != 0)
+    {
+        if (report[0] == -1)
+            return pid;
+        if (pid < 0)
+        {
+            close(report[0]);
+            close(report[1]);
+            return pid;
+        }
+        // ENOENT with the file still there is a missing interpreter
+        if (exec_error(report) != ENOENT || retried || access(path, X_OK) == 0)
+            return pid;
+
+        waitpid(pid, NULL, 0);
+        cmd_hash_forget(args[0]);
+        path = cmd_hash_lookup(args[0]);
+        if (!path)
+        {
+            fprintf(stderr, "%s: command not found\n", args[0]);
+            return -1;
+        }
+        return fork_stage(st, path, in_fd, out_fd, read_fd, 1);
+    }
+
+    if (in_fd != -1)
+    {
+        dup2(in_fd, STDIN_FILENO);
+        close(in_fd);
+    }
+
+    if (out_fd != -1)
     {
-        if (strcmp(args[i], "<") == 0)
+        dup2(out_fd, STDOUT_FILENO);
+        close(out_fd);
+    }
+
+    if (read_fd != -1)
+        close(read_fd);
+
+    if (st->infile)
+    {
+        int fd_in = open(st->infile, O_RDONLY);
+        if (fd_in == -1)
         {
-            *infile = args[i + 1];
-            args[i] = NULL;
+            fprintf(stderr, "%s: %s\n", st->infile, strerror(errno));
+            _exit(1);
         }
-        else if (strcmp(args[i], ">") == 0)
+        dup2(fd_in, STDIN_FILENO);
+        close(fd_in);
+    }
+
+    if (st->outfile)
+    {
+        int fd_out;
+        if (st->append)
+            fd_out = open(st->outfile, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        else
+            fd_out = open(st->outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_out == -1)
         {
-            *outfile = args[i + 1];
-            *append = 0;
-            args[i] = NULL;
+            fprintf(stderr, "%s: %s\n", st->outfile, strerror(errno));
+            _exit(1);
         }
-        else if (strcmp(args[i], ">>") == 0)
+
+        dup2(fd_out, STDOUT_FILENO);
+        close(fd_out);
+    }
+
+    if (runs_in_shell(args[0]))
+        _exit(run_builtin(args, STDOUT_FILENO));
+
+    if (strcmp(args[0], "parallel") == 0)
+        _exit(run_parallel(args));
+
+    if (forward_builtins && is_forward_builtin(args[0]))
+    {
+        int rc = run_forward_builtin(args);
+        if (rc != -1)
+            _exit(rc);
+    }
+
+    if (path)
+        execv(path, args);
+    else
+        execvp(args[0], args);
+    if (report[0] != -1)
+    {
+        int err = errno;
+        write(report[1], &err, sizeof(err));
+    }
+    _exit(127);
+}
+
+// single builtin command: no child at all, > and >> still honoured
+static int run_in_shell(const stage_t *st)
+{
+    int out_fd = STDOUT_FILENO;
+    if (st->outfile)
+    {
+        out_fd = open(st->outfile, O_WRONLY | O_CREAT | O_CLOEXEC 
+            | (st->append ? O_APPEND : O_TRUNC), 0644);
+        if (out_fd == -1)
         {
-            *outfile = args[i + 1];
-            *append = 1;
-            args[i] = NULL;
+            fprintf(stderr, "%s: %s\n", st->outfile, strerror(errno));
+            return 1;
         }
     }
+    int status = run_builtin(st->args, out_fd);
+    if (out_fd != STDOUT_FILENO)
+        close(out_fd);
+    return status;
 }
 
-int execute_pipeline(char *commands[], int n)
+// start every stage of a pipeline; pids[i] is -1 for a stage that failed
+static void launch_pipeline(stage_t *st, int n, pid_t *pids)
 {
     int prev_fd = -1;
 
     for (int i = 0; i < n; i++)
     {
-        int fd[2];
+        // pipes are close-on-exec, only the dup2'd copies reach the child
+        int fd[2] = {-1, -1};
 
         if (i < n - 1)
-            pipe(fd);
-
-        pid_t pid = fork();
-
-        if (pid == 0)
         {
-            if (prev_fd != -1)
-            {
-                dup2(prev_fd, STDIN_FILENO);
-                close(prev_fd);
-            }
-            
-            if (i < n - 1)
-            {
-                dup2(fd[1], STDOUT_FILENO);
-                close(fd[0]);
-                close(fd[1]);
-            }
-
-            char *args[MAX_ARGS];
-            parse_input(commands[i], args);
-
-            char *infile = NULL;
-            char *outfile = NULL;
-            int append = 0;
+            pipe2(fd, O_CLOEXEC);
+            if (pipe_size > 0 && fcntl(fd[1], F_SETPIPE_SZ, pipe_size) == -1)
+                perror("F_SETPIPE_SZ");
+        }
 
-            parse_redirection(args, &infile, &outfile, &append);
+        char **args = st[i].args;
+        // builtins run shell code in the child, so they need fork
+        int needs_fork = runs_in_shell(args[0]) || strcmp(args[0], "parallel") == 0
+            || (forward_builtins && is_forward_builtin(args[0]));
+        const char *path = NULL;
 
-            if (infile)
-            {
-                int fd_in = open(infile, O_RDONLY);
-                dup2(fd_in, STDIN_FILENO);
-                close(fd_in);
-            }
+        pids[i] = -1;
+        if (!needs_fork && use_cache)
+        {
+            path = cmd_hash_lookup(args[0]);
+            if (!path)
+                fprintf(stderr, "%s: command not found\n", args[0]);
+        }
 
-            if (outfile)
-            {
-                int fd_out;
-                if (append)
-                    fd_out = open(outfile, O_WRONLY | O_CREAT | O_APPEND, 0644);
-                else
-                    fd_out = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-
-                dup2(fd_out, STDOUT_FILENO);
-                close(fd_out);
-            }
-            
-            execvp(args[0], args);
-            _exit(1);
+        if (needs_fork || !use_cache || path)
+        {
+            if (use_spawn && !needs_fork)
+                pids[i] = spawn_stage(&st[i], path, prev_fd, fd[1]);
+            else
+                pids[i] = fork_stage(&st[i], path, prev_fd, fd[1], fd[0], 0);
         }
         
         if (prev_fd != -1)
@@ -138,44 +467,297 @@ int execute_pipeline(char *commands[], int n)
             close(fd[1]);
             prev_fd = fd[0];
         }
-        
     }
-    
-    for (int i = 0; i < n; i++)
+}
+
+// command text for the job table, truncated to fit
+static void format_job(const stage_t *st, int n, char *buf, size_t cap)
+{
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < n && len + 1 < cap; i++)
     {
-        wait(NULL);
+        for (char **a = st[i].args; *a && len + 1 < cap; a++)
+        {
+            int w = snprintf(buf + len, cap - len, "%s%s", 
+                (i > 0 && a == st[i].args) ? " | " : (len ? " " : ""), *a);
+            if (w < 0)
+                break;
+            len += (size_t)w;
+        }
+    }
+    if (len >= cap)
+        buf[cap - 1] = '\0';
+}
+
+// start a pipeline as a job; foreground jobs are waited for here
+int execute_pipeline(stage_t *st, int n, int background)
+{
+    if (n == 1 && !background && runs_in_shell(st[0].args[0]))
+        return run_in_shell(&st[0]);
+
+    if (n == 1 && !background && strcmp(st[0].args[0], "parallel") == 0)
+        return run_parallel(st[0].args);
+
+    pid_t *pids = calloc(n, sizeof(pid_t));
+    if (!pids)
+        return 1;
+    launch_pipeline(st, n, pids);
+
+    char cmd[256];
+    format_job(st, n, cmd, sizeof(cmd));
+    int id = job_add(pids, n, cmd, background);
+
+    int status = 0;
+    if (id == -1)
+    {
+        // no job slot: reap directly, exactly our stages, in order
+        int wstatus = 0;
+        for (int i = 0; i < n; i++)
+            if (pids[i] > 0)
+                waitpid(pids[i], &wstatus, 0);
+        status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+    }
+    else if (background)
+    {
+        fprintf(stderr, "[%d] %d\n", id, (int)pids[n - 1]);
+    }
+    else
+    {
+        status = job_wait(id);
+    }
+
+    free(pids);
+    return status;
+}
+
+// argv for one parallel item: every {} in the command words becomes item;
+// substituted words live in a scratch buffer sized before any pointer
+// into it is taken
+static int substitute(char **cmd, int cmd_len, const char *item, char **argv,
+    char **scratch, size_t *scratch_cap, size_t slot_bytes)
+{
+    size_t item_len = strlen(item);
+    size_t need = slot_bytes;
+    for (int i = 0; i < cmd_len; i++)
+        for (const char *p = strstr(cmd[i], "{}"); p; p = strstr(p + 2, "{}"))
+            need += item_len;
+
+    if (need > *scratch_cap)
+    {
+        char *b = realloc(*scratch, need);
+        if (!b)
+            return -1;
+        *scratch = b;
+        *scratch_cap = need;
+    }
+
+    char *out = *scratch;
+    for (int i = 0; i < cmd_len; i++)
+    {
+        const char *w = cmd[i];
+        const char *p = strstr(w, "{}");
+        if (!p)
+        {
+            argv[i] = cmd[i];
+            continue;
+        }
+        argv[i] = out;
+        for (; p; w = p + 2, p = strstr(w, "{}"))
+        {
+            memcpy(out, w, p - w);
+            out += p - w;
+            memcpy(out, item, item_len);
+            out += item_len;
+        }
+        size_t rest = strlen(w) + 1;
+        memcpy(out, w, rest);
+        out += rest;
     }
-    
     return 0;
 }
 
-int main()
+// parallel [-j N] command [args...] ::: item...
+// runs the command once per item ({} is replaced by the item, otherwise it
+// is appended) with at most N running; returns the number of failures
+static int run_parallel(char **args)
 {
-    char input[MAX_LINE];
+    int limit = 4;
+    int a = 1;
 
-    while (1)
+    if (args[a] && strcmp(args[a], "-j") == 0 && args[a + 1])
     {
+        limit = atoi(args[a + 1]);
+        a += 2;
+    }
+    else if (args[a] && strncmp(args[a], "-j", 2) == 0 && args[a][2])
+    {
+        limit = atoi(args[a] + 2);
+        a++;
+    }
+
+    int cmd_first = a;
+    while (args[a] && strcmp(args[a], ":::") != 0)
+        a++;
+    int cmd_len = a - cmd_first;
+    if (limit < 1 || cmd_len == 0 || !args[a])
+    {
+        fprintf(stderr, "usage: parallel [-j N] command [args...] ::: item...\n");
+        return 2;
+    }
+    char **items = &args[a + 1];
+    int nitems = 0;
+    while (items[nitems])
+        nitems++;
+
+    int has_slot = 0;
+    size_t slot_bytes = 0;
+    for (int i = 0; i < cmd_len; i++)
+    {
+        if (strstr(args[cmd_first + i], "{}"))
+        {
+            has_slot = 1;
+            slot_bytes += strlen(args[cmd_first + i]) + 1;
+        }
+    }
+
+    // one argv reused for every item: posix_spawn and fork both copy it
+    char **argv = malloc((cmd_len + 2) * sizeof(char *));
+    int *ids = malloc((nitems ? nitems : 1) * sizeof(int));
+    char *scratch = NULL;
+    size_t scratch_cap = 0;
+    if (!argv || !ids)
+    {
+        free(argv);
+        free(ids);
+        return 1;
+    }
+
+    int next = 0;
+    int oldest = 0;
+    int running = 0;
+    int failures = 0;
+
+    while (oldest < nitems)
+    {
+        while (next < nitems && running < limit)
+        {
+            if (has_slot && substitute(&args[cmd_first], cmd_len, items[next], argv,
+                    &scratch, &scratch_cap, slot_bytes) == -1)
+            {
+                ids[next++] = -1;
+                failures++;
+                continue;
+            }
+            if (!has_slot)
+                memcpy(argv, &args[cmd_first], cmd_len * sizeof(char *));
+            argv[cmd_len] = has_slot ? NULL : items[next];
+            argv[cmd_len + 1] = NULL;
+
+            stage_t st = {.args = argv};
+            pid_t pid;
+            launch_pipeline(&st, 1, &pid);
+            ids[next] = job_add(&pid, 1, argv[0], 0);
+            if (ids[next] == -1)
+            {
+                int wstatus = 0;
+                if (pid > 0)
+                    waitpid(pid, &wstatus, 0);
+                failures += (pid <= 0 || wstatus != 0);
+            }
+            else
+            {
+                running++;
+            }
+            next++;
+        }
+
+        job_poll(1);
+        for (int i = oldest; i < next; i++)
+        {
+            if (ids[i] != -1 && job_done(ids[i]))
+            {
+                failures += (job_wait(ids[i]) != 0);
+                ids[i] = -1;
+                running--;
+            }
+        }
+        while (oldest < next && ids[oldest] == -1)
+            oldest++;
+    }
+
+    free(argv);
+    free(ids);
+    free(scratch);
+    return failures > 100 ? 101 : failures;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "p:nfem:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p':
+                pipe_size = atoi(optarg);
+                break;
+            case 'n':
+                forward_builtins = 0;
+                break;
+            case 'f':
+                use_spawn = 0;
+                break;
+            case 'e':
+                use_builtins = 0;
+                use_cache = 0;
+                break;
+            case 'm':
+            {
+                size_t bytes = (size_t)atol(optarg) << 20;
+                ballast = malloc(bytes);
+                if (ballast)
+                    memset(ballast, 1, bytes);
+                break;
+            }
+            default:
+                fprintf(stderr, "Usage: %s [-p pipe_size] [-n] [-f] [-e] [-m ballast_MB]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // getline() grows the buffer, so lines have no length limit
+    char *input = NULL;
+    size_t input_cap = 0;
+    int status = 0;
+
+    while (!builtin_exit_requested(&status))
+    {
+        job_notify();
         printf("> ");
         fflush(stdout);
 
-        if (!fgets(input, sizeof(input), stdin))
+        if (getline(&input, &input_cap, stdin) == -1)
             break;
-        
-        if (strcmp(input, "\n") == 0)
-            continue;
 
-        input[strcspn(input, "\n")] = '\0';
+        int n = parse_line(input);
+        if (n <= 0)
+            continue;
 
-        if (strcmp(input, "exit") == 0)
-            break;
-        
-        int n; 
-        char **commands = parse_pipeline(input, &n);
-        
-        execute_pipeline(commands, n); 
-        
-        free(commands);
+        // && and || look at the status of the pipeline before them
+        for (int i = 0; i < n && !builtin_exit_requested(NULL); i++)
+        {
+            int prev_sep = i > 0 ? pipelines[i - 1].sep : TOK_SEMI;
+            if ((prev_sep == TOK_AND && status != 0) || (prev_sep == TOK_OR && status == 0))
+                continue;
+            pipeline_t *p = &pipelines[i];
+            status = execute_pipeline(&stages[p->first], p->count, p->sep == TOK_BG);
+        }
     }
     
-    return 0;
-}
\ No newline at end of file
+    free(input);
+    free(words);
+    free(stages);
+    free(pipelines);
+    return status;
+}
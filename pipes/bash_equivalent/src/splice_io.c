@@ -0,0 +1,206 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#include "splice_io.h"
+
+#define SPLICE_CHUNK (1 << 20)
+#define COPY_BUF (128 * 1024)
+
+static int is_pipe(int fd) 
+{
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+static int copy_rw(int in, int out) 
+{
+    char *buf = malloc(COPY_BUF);
+    if (!buf) 
+        return -1;
+    for (;;) 
+    {
+        ssize_t n = read(in, buf, COPY_BUF);
+        if (n == 0) 
+            break;
+        if (n == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            free(buf);
+            return -1;
+        }
+        for (ssize_t off = 0; off < n; ) 
+        {
+            ssize_t w = write(out, buf + off, (size_t)(n - off));
+            if (w == -1) 
+            {
+                if (errno == EINTR) 
+                    continue;
+                free(buf);
+                return -1;
+            }
+            off += w;
+        }
+    }
+    free(buf);
+    return 0;
+}
+
+// returns 1 when the fast path is not supported for this fd pair
+static int copy_splice(int in, int out) 
+{
+    int moved = 0;
+    for (;;) 
+    {
+        ssize_t n = splice(in, NULL, out, NULL, SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n == 0) 
+            return 0;
+        if (n == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            return (!moved && errno == EINVAL) ? 1 : -1;
+        }
+        moved = 1;
+    }
+}
+
+static int copy_sendfile(int in, int out) 
+{
+    int moved = 0;
+    for (;;) 
+    {
+        ssize_t n = sendfile(out, in, NULL, SPLICE_CHUNK);
+        if (n == 0) 
+            return 0;
+        if (n == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            return (!moved && (errno == EINVAL || errno == ENOSYS)) ? 1 : -1;
+        }
+        moved = 1;
+    }
+}
+
+int forward_fd(int in, int out) 
+{
+    int rc = 1;
+    if (is_pipe(in) || is_pipe(out)) 
+        rc = copy_splice(in, out);
+    if (rc == 1) 
+        rc = copy_sendfile(in, out);
+    if (rc == 1) 
+        rc = copy_rw(in, out);
+    return rc;
+}
+
+// cat [file...]: no options, anything else goes to the real cat
+static int builtin_cat(char **args) 
+{
+    int status = 0;
+    if (args[1] == NULL) 
+        return forward_fd(STDIN_FILENO, STDOUT_FILENO) == 0 ? 0 : 1;
+
+    for (int i = 1; args[i] != NULL; i++) 
+    {
+        int fd = (strcmp(args[i], "-") == 0) ? STDIN_FILENO : open(args[i], O_RDONLY);
+        if (fd == -1) 
+        {
+            fprintf(stderr, "cat: %s: %s\n", args[i], strerror(errno));
+            status = 1;
+            continue;
+        }
+        if (forward_fd(fd, STDOUT_FILENO) == -1) 
+        {
+            fprintf(stderr, "cat: %s: %s\n", args[i], strerror(errno));
+            status = 1;
+        }
+        if (fd != STDIN_FILENO) 
+            close(fd);
+    }
+    return status;
+}
+
+// tee [-a] file: tee() duplicates the stdin pipe into the stdout pipe, then
+// the same bytes are spliced into the file, nothing is copied to userspace
+static int builtin_tee(char **args) 
+{
+    int append = 0;
+    int i = 1;
+    if (args[i] && strcmp(args[i], "-a") == 0) 
+    {
+        append = 1;
+        i++;
+    }
+    if (args[i] == NULL || args[i + 1] != NULL) 
+        return -1;
+
+    int fd = open(args[i], O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+    if (fd == -1) 
+    {
+        fprintf(stderr, "tee: %s: %s\n", args[i], strerror(errno));
+        return 1;
+    }
+
+    for (;;) 
+    {
+        ssize_t n = tee(STDIN_FILENO, STDOUT_FILENO, SPLICE_CHUNK, 0);
+        if (n == 0) 
+            break;
+        if (n == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            fprintf(stderr, "tee: %s\n", strerror(errno));
+            close(fd);
+            return 1;
+        }
+        while (n > 0) 
+        {
+            ssize_t m = splice(STDIN_FILENO, NULL, fd, NULL, (size_t)n, SPLICE_F_MOVE);
+            if (m == -1) 
+            {
+                if (errno == EINTR) 
+                    continue;
+                fprintf(stderr, "tee: %s: %s\n", args[i], strerror(errno));
+                close(fd);
+                return 1;
+            }
+            n -= m;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+int is_forward_builtin(const char *name) 
+{
+    return name && (strcmp(name, "cat") == 0 || strcmp(name, "tee") == 0);
+}
+
+// -1 means "not handled here, exec the real program"
+int run_forward_builtin(char **args) 
+{
+    if (strcmp(args[0], "cat") == 0) 
+    {
+        for (int i = 1; args[i] != NULL; i++) 
+            if (args[i][0] == '-' && args[i][1] != '\0') 
+                return -1;
+        return builtin_cat(args);
+    }
+    if (strcmp(args[0], "tee") == 0) 
+    {
+        if (!is_pipe(STDIN_FILENO) || !is_pipe(STDOUT_FILENO)) 
+            return -1;
+        return builtin_tee(args);
+    }
+    return -1;
+}
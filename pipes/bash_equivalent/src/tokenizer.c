@@ -0,0 +1,138 @@
+#include <stddef.h>
+
+#include "tokenizer.h"
+
+static int is_space(char c) 
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// operator starting at p, its length in *len, TOK_END if none
+static int op_at(const char *p, int *len) 
+{
+    *len = 1;
+    switch (*p) 
+    {
+        case '|':
+            if (p[1] == '|') 
+            {
+                *len = 2;
+                return TOK_OR;
+            }
+            return TOK_PIPE;
+        case '&':
+            if (p[1] == '&') 
+            {
+                *len = 2;
+                return TOK_AND;
+            }
+            return TOK_BG;
+        case ';':
+            return TOK_SEMI;
+        case '<':
+            return TOK_IN;
+        case '>':
+            if (p[1] == '>') 
+            {
+                *len = 2;
+                return TOK_APPEND;
+            }
+            return TOK_OUT;
+        default:
+            return TOK_END;
+    }
+}
+
+void tok_init(tokenizer_t *t, char *line) 
+{
+    t->pos = line;
+    t->pending = TOK_END;
+}
+
+int tok_next(tokenizer_t *t, char **word) 
+{
+    *word = NULL;
+
+    // an operator that ended the previous word and was overwritten by its NUL
+    if (t->pending != TOK_END) 
+    {
+        int type = t->pending;
+        t->pending = TOK_END;
+        return type;
+    }
+
+    char *r = t->pos;
+    while (is_space(*r)) 
+        r++;
+    if (*r == '\0') 
+    {
+        t->pos = r;
+        return TOK_END;
+    }
+
+    int len;
+    int op = op_at(r, &len);
+    if (op != TOK_END) 
+    {
+        t->pos = r + len;
+        return op;
+    }
+
+    char *w = r;
+    *word = w;
+    for (;;) 
+    {
+        char c = *r;
+        if (c == '\0') 
+        {
+            *w = '\0';
+            t->pos = r;
+            return TOK_WORD;
+        }
+        if (is_space(c)) 
+        {
+            *w = '\0';
+            t->pos = r + 1;
+            return TOK_WORD;
+        }
+        op = op_at(r, &len);
+        if (op != TOK_END) 
+        {
+            t->pending = op;
+            t->pos = r + len;
+            *w = '\0';
+            return TOK_WORD;
+        }
+        if (c == '\'') 
+        {
+            r++;
+            while (*r && *r != '\'') 
+                *w++ = *r++;
+            if (*r != '\'') 
+                return TOK_ERROR;
+            r++;
+        } 
+        else if (c == '"') 
+        {
+            r++;
+            while (*r && *r != '"') 
+            {
+                if (*r == '\\' && (r[1] == '"' || r[1] == '\\' || r[1] == '$' || r[1] == '`')) 
+                    r++;
+                *w++ = *r++;
+            }
+            if (*r != '"') 
+                return TOK_ERROR;
+            r++;
+        } 
+        else if (c == '\\' && r[1] != '\0') 
+        {
+            r++;
+            *w++ = *r++;
+        } 
+        else 
+        {
+            *w++ = *r++;
+        }
+    }
+}
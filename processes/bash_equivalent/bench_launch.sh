@@ -0,0 +1,31 @@
+#!/bin/sh
+# Commands/sec for a script of `true` invocations, fork + execvp against
+# posix_spawn, with a small and a large shell address space.
+# usage: ./bench_launch.sh [commands] [ballast_MB]
+
+COUNT=${1:-100000}
+BALLAST=${2:-1024}
+SHELL_BIN=./bin/bash_eqvnt
+SCRIPT=/tmp/bench_launch_true.txt
+
+[ -x "$SHELL_BIN" ] || make >/dev/null || exit 1
+
+yes true | head -n "$COUNT" > "$SCRIPT"
+echo exit >> "$SCRIPT"
+
+run() {
+    label=$1
+    shift
+    start=$(date +%s.%N)
+    "$SHELL_BIN" "$@" < "$SCRIPT" > /dev/null
+    end=$(date +%s.%N)
+    awk -v l="$label" -v s="$start" -v e="$end" -v n="$COUNT" \
+        'BEGIN { printf "%-28s %8.3f s %10.0f commands/s\n", l, e - s, n / (e - s) }'
+}
+
+run "fork" -f
+run "posix_spawn"
+run "fork, ${BALLAST} MB shell" -f -m "$BALLAST"
+run "posix_spawn, ${BALLAST} MB shell" -m "$BALLAST"
+
+rm -f "$SCRIPT"
@@ -0,0 +1,11 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+// echo, true, false, cd, exit, hash: run inside the shell, no fork or exec
+int is_builtin(const char *name);
+int run_builtin(char **args, int out_fd);
+
+// set by `exit`; the shell leaves its loop with *status
+int builtin_exit_requested(int *status);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef COMMAND_HASH_H
+#define COMMAND_HASH_H
+
+// name -> full path cache, like bash's `hash`; PATH is searched on a miss,
+// and an entry whose exec fails with ENOENT is dropped with cmd_hash_forget()
+const char *cmd_hash_lookup(const char *name);
+void cmd_hash_forget(const char *name);
+void cmd_hash_clear(void);
+void cmd_hash_print(int out_fd);
+
+#endif
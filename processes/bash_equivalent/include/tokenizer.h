@@ -0,0 +1,27 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+enum tok_type 
+{
+    TOK_END = 0,
+    TOK_WORD,
+    TOK_PIPE,       // |
+    TOK_IN,         // <
+    TOK_OUT,        // >
+    TOK_APPEND,     // >>
+    TOK_ERROR       // unterminated quote
+};
+
+// Splits a line in place: quotes and backslashes are removed by shifting
+// the word left, so every word is a NUL-terminated slice of the line.
+// No allocation, no hidden state; one tokenizer_t per line being parsed.
+typedef struct 
+{
+    char *pos;
+    int pending;
+} tokenizer_t;
+
+void tok_init(tokenizer_t *t, char *line);
+int tok_next(tokenizer_t *t, char **word);
+
+#endif
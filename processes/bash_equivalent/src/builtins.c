@@ -0,0 +1,144 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "builtins.h"
+#include "command_hash.h"
+
+#define ECHO_BUF 4096
+
+static int exit_requested = 0;
+static int exit_status = 0;
+
+static int write_all(int fd, const char *buf, size_t len) 
+{
+    while (len > 0) 
+    {
+        ssize_t n = write(fd, buf, len);
+        if (n == -1) 
+        {
+            if (errno == EINTR) 
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// one write() for the usual short line
+static int builtin_echo(char **args, int out_fd) 
+{
+    char buf[ECHO_BUF];
+    size_t len = 0;
+    int newline = 1;
+    int i = 1;
+
+    if (args[i] && strcmp(args[i], "-n") == 0) 
+    {
+        newline = 0;
+        i++;
+    }
+    for (int first = 1; args[i] != NULL; i++, first = 0) 
+    {
+        size_t alen = strlen(args[i]);
+        if (len + alen + 2 > sizeof(buf)) 
+        {
+            if (write_all(out_fd, buf, len) == -1) 
+                return 1;
+            len = 0;
+        }
+        if (!first) 
+            buf[len++] = ' ';
+        if (alen + 2 > sizeof(buf)) 
+        {
+            if (write_all(out_fd, buf, len) == -1 || write_all(out_fd, args[i], alen) == -1) 
+                return 1;
+            len = 0;
+            continue;
+        }
+        memcpy(buf + len, args[i], alen);
+        len += alen;
+    }
+    if (newline) 
+        buf[len++] = '\n';
+    return write_all(out_fd, buf, len) == -1 ? 1 : 0;
+}
+
+static int builtin_cd(char **args) 
+{
+    const char *dir = args[1] ? args[1] : getenv("HOME");
+    if (!dir) 
+    {
+        fprintf(stderr, "cd: HOME not set\n");
+        return 1;
+    }
+    if (chdir(dir) == -1) 
+    {
+        fprintf(stderr, "cd: %s: %s\n", dir, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+static int builtin_hash(char **args, int out_fd) 
+{
+    if (args[1] && strcmp(args[1], "-r") == 0) 
+    {
+        cmd_hash_clear();
+        return 0;
+    }
+    for (int i = 1; args[i] != NULL; i++) 
+    {
+        if (!cmd_hash_lookup(args[i])) 
+        {
+            fprintf(stderr, "hash: %s: not found\n", args[i]);
+            return 1;
+        }
+    }
+    if (!args[1]) 
+        cmd_hash_print(out_fd);
+    return 0;
+}
+
+int is_builtin(const char *name) 
+{
+    static const char *names[] = {"echo", "true", "false", "cd", "exit", "hash"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) 
+        if (strcmp(name, names[i]) == 0) 
+            return 1;
+    return 0;
+}
+
+int run_builtin(char **args, int out_fd) 
+{
+    const char *name = args[0];
+    if (strcmp(name, "echo") == 0) 
+        return builtin_echo(args, out_fd);
+    if (strcmp(name, "true") == 0) 
+        return 0;
+    if (strcmp(name, "false") == 0) 
+        return 1;
+    if (strcmp(name, "cd") == 0) 
+        return builtin_cd(args);
+    if (strcmp(name, "hash") == 0) 
+        return builtin_hash(args, out_fd);
+    if (strcmp(name, "exit") == 0) 
+    {
+        exit_requested = 1;
+        exit_status = args[1] ? atoi(args[1]) : 0;
+        return exit_status;
+    }
+    return 127;
+}
+
+int builtin_exit_requested(int *status) 
+{
+    if (exit_requested && status) 
+        *status = exit_status;
+    return exit_requested;
+}
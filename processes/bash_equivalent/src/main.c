@@ -1,64 +1,240 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
+#include <spawn.h>
 
-#define MAX_LINE 1024
-#define MAX_ARGS 64
+#include "tokenizer.h"
+#include "command_hash.h"
+#include "builtins.h"
 
-void parse_input(char *input, char **args)
+// launch with posix_spawn instead of fork + execvp
+static int use_spawn = 1;
+// echo/true/false run in the shell, commands resolve through the hash cache
+static int use_builtins = 1;
+static int use_cache = 1;
+
+// touch MB of heap so fork() has a large address space to copy (benchmarks)
+static void *ballast = NULL;
+
+extern char **environ;
+
+// argument array reused for every line, grows as needed
+static char **args = NULL;
+static size_t args_cap = 0;
+
+// split a line into words in place; returns the word count or -1
+int parse_input(char *input)
 {
-    int i = 0;
+    tokenizer_t tok;
+    tok_init(&tok, input);
+    size_t n = 0;
 
-    args[i] = strtok(input, " \n");
-    while(args[i] !=  NULL && i < MAX_ARGS - 1)
+    for (;;)
     {
-        i++;
-        args[i] = strtok(NULL, " \n");
+        char *word;
+        int type = tok_next(&tok, &word);
+
+        if (type == TOK_ERROR)
+        {
+            fprintf(stderr, "syntax error: unterminated quote\n");
+            return -1;
+        }
+        if (type != TOK_WORD && type != TOK_END)
+        {
+            fprintf(stderr, "pipes and redirections are not supported\n");
+            return -1;
+        }
+
+        if (n == args_cap)
+        {
+            size_t cap = args_cap ? args_cap * 2 : 64;
+            char **a = realloc(args, cap * sizeof(char *));
+            if (!a)
+                return -1;
+            args = a;
+            args_cap = cap;
+        }
+
+        if (type == TOK_END)
+        {
+            args[n] = NULL;
+            return (int)n;
+        }
+        args[n++] = word;
     }
-    args[i] = NULL;
 }
 
-int main()
+// cd/exit/hash always change shell state; echo/true/false unless -e
+static int runs_in_shell(const char *name)
+{
+    if (!is_builtin(name))
+        return 0;
+    return use_builtins || strcmp(name, "cd") == 0 || strcmp(name, "exit") == 0
+        || strcmp(name, "hash") == 0;
+}
+
+// errno of the child's failed exec, 0 once it exec'd: the report pipe is
+// close-on-exec, so a successful exec reads as end of file
+static int exec_error(int report[2])
+{
+    int err = 0;
+    close(report[1]);
+    if (read(report[0], &err, sizeof(err)) != sizeof(err))
+        err = 0;
+    close(report[0]);
+    return err;
+}
+
+// retried: a stale cache entry was already dropped once for this command
+static pid_t launch(char **args, int retried)
 {
-    char input[MAX_LINE];
-    char *args[MAX_ARGS];
+    const char *path = NULL;
+    pid_t pid;
 
-    while (1)
+    if (use_cache)
     {
-        printf("> ");
-        fflush(stdout);
+        path = cmd_hash_lookup(args[0]);
+        if (!path)
+        {
+            fprintf(stderr, "%s: command not found\n", args[0]);
+            return -1;
+        }
+    }
 
-        if (fgets(input, sizeof(input), stdin) == NULL)
-            break;
-        
-        if (strcmp(input, "\n") == 0)
-            continue;
+    if (use_spawn)
+    {
+        int rc;
+        if (path)
+        {
+            rc = posix_spawn(&pid, path, NULL, NULL, args, environ);
+            // stale cache entry: the cached file is gone, so forget it
+            // and search PATH once more
+            if (rc == ENOENT && path != args[0] && access(path, X_OK) != 0)
+            {
+                cmd_hash_forget(args[0]);
+                path = cmd_hash_lookup(args[0]);
+                rc = path ? posix_spawn(&pid, path, NULL, NULL, args, environ) : ENOENT;
+            }
+        }
+        else
+        {
+            rc = posix_spawnp(&pid, args[0], NULL, NULL, args, environ);
+        }
 
-        input[strcspn(input, "\n")] = '\0';
+        if (rc != 0)
+        {
+            fprintf(stderr, "%s: %s\n", args[0], strerror(rc));
+            return -1;
+        }
+        return pid;
+    }
 
-        if (strcmp(input, "exit") == 0)
-            break;
-        
-        parse_input(input, args);
+    // a cached path the child cannot exec is reported back, like the
+    // ENOENT from posix_spawn above
+    int report[2] = {-1, -1};
+    if (path && path != args[0] && pipe2(report, O_CLOEXEC) == -1)
+        report[0] = -1;
 
-        pid_t pid = fork();
+    pid = fork();
 
-        if (pid < 0)
+    if (pid == 0)
+    {
+        if (path)
+            execv(path, args);
+        else
+            execvp(args[0], args);
+        if (report[0] != -1)
+        {
+            int err = errno;
+            write(report[1], &err, sizeof(err));
+        }
+        _exit(127);
+    }
+
+    // ENOENT with the file still there is a missing interpreter
+    if (report[0] != -1 && pid > 0 && exec_error(report) == ENOENT && !retried
+        && access(path, X_OK) != 0)
+    {
+        waitpid(pid, NULL, 0);
+        cmd_hash_forget(args[0]);
+        return launch(args, 1);
+    }
+    if (report[0] != -1 && pid <= 0)
+    {
+        close(report[0]);
+        close(report[1]);
+    }
+    return pid;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "fem:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f':
+                use_spawn = 0;
+                break;
+            case 'e':
+                use_builtins = 0;
+                use_cache = 0;
+                break;
+            case 'm':
+            {
+                size_t bytes = (size_t)atol(optarg) << 20;
+                ballast = malloc(bytes);
+                if (ballast)
+                    memset(ballast, 1, bytes);
+                break;
+            }
+            default:
+                fprintf(stderr, "Usage: %s [-f] [-e] [-m ballast_MB]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // getline() grows the buffer, so lines have no length limit
+    char *input = NULL;
+    size_t input_cap = 0;
+    int status = 0;
+
+    while (!builtin_exit_requested(&status))
+    {
+        printf("> ");
+        fflush(stdout);
+
+        if (getline(&input, &input_cap, stdin) == -1)
+            break;
+
+        if (parse_input(input) <= 0)
             continue;
 
-        if (pid == 0)
+        if (runs_in_shell(args[0]))
         {
-            execvp(args[0], args);
-            _exit(1);
+            status = run_builtin(args, STDOUT_FILENO);
+            continue;
         }
-        else
+
+        pid_t pid = launch(args, 0);
+        if (pid < 0)
         {
-            int status;
-            wait(&status);
-        }   
+            status = 127;
+            continue;
+        }
+
+        int wstatus;
+        waitpid(pid, &wstatus, 0);
+        status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
     }
-    
-    return 0;
-}
\ No newline at end of file
+
+    free(input);
+    free(args);
+    return status;
+}
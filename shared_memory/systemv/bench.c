@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/sem.h>
+#include <sys/wait.h>
+
+#include "shm_ring.h"
+
+#define MIN_SLOTS 4
+
+static const size_t slot_sizes[] = {64, 512, 4096, 65536, 1048576};
+
+static double now_sec(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *mode, size_t slot, unsigned long msgs, double sec) 
+{
+    double bytes = (double)slot * msgs;
+    printf("%-10s %8zu %10lu %10.3f %12.0f\n", mode, slot, msgs, bytes / sec / 1e9, msgs / sec);
+}
+
+// ring of slots, semaphores only when empty/full
+static void bench_ring(size_t slot, unsigned long msgs, size_t ring_bytes, int flags) 
+{
+    size_t nslots = ring_bytes / slot;
+    if (nslots < MIN_SLOTS) 
+        nslots = MIN_SLOTS;
+
+    shm_ring_t ring;
+    if (shm_ring_create(&ring, IPC_PRIVATE, slot, nslots, flags) == -1) 
+        exit(EXIT_FAILURE);
+
+    char *src = malloc(slot);
+    char *dst = malloc(slot);
+    memset(src, 'x', slot);
+
+    double t0 = now_sec();
+    pid_t pid = fork();
+    if (pid == 0) 
+    {
+        while (shm_ring_recv(&ring, dst, slot) >= 0)
+            ;
+        _exit(0);
+    }
+    for (unsigned long i = 0; i < msgs; i++) 
+        shm_ring_send(&ring, src, slot);
+    shm_ring_close(&ring);
+    waitpid(pid, NULL, 0);
+    report("ring", slot, msgs, now_sec() - t0);
+
+    free(src);
+    free(dst);
+    shm_ring_destroy(&ring);
+}
+
+// the original one-shot protocol: one buffer, two semop per hand-off
+static void bench_handshake(size_t slot, unsigned long msgs) 
+{
+    int shmid = shmget(IPC_PRIVATE, slot, IPC_CREAT | 0666);
+    int semid = semget(IPC_PRIVATE, 2, IPC_CREAT | 0666);
+    if (shmid == -1 || semid == -1) 
+    {
+        perror("shmget/semget");
+        exit(EXIT_FAILURE);
+    }
+    unsigned short init[2] = {0, 1};
+    semctl(semid, 0, SETALL, init);
+    char *buf = shmat(shmid, NULL, 0);
+
+    char *src = malloc(slot);
+    char *dst = malloc(slot);
+    memset(src, 'x', slot);
+
+    struct sembuf wait_data = {0, -1, 0}, post_data = {0, 1, 0};
+    struct sembuf wait_space = {1, -1, 0}, post_space = {1, 1, 0};
+
+    double t0 = now_sec();
+    pid_t pid = fork();
+    if (pid == 0) 
+    {
+        for (unsigned long i = 0; i < msgs; i++) 
+        {
+            semop(semid, &wait_data, 1);
+            memcpy(dst, buf, slot);
+            semop(semid, &post_space, 1);
+        }
+        _exit(0);
+    }
+    for (unsigned long i = 0; i < msgs; i++) 
+    {
+        semop(semid, &wait_space, 1);
+        memcpy(buf, src, slot);
+        semop(semid, &post_data, 1);
+    }
+    waitpid(pid, NULL, 0);
+    report("handshake", slot, msgs, now_sec() - t0);
+
+    free(src);
+    free(dst);
+    shmdt(buf);
+    shmctl(shmid, IPC_RMID, NULL);
+    semctl(semid, 0, IPC_RMID);
+}
+
+int main(int argc, char *argv[]) 
+{
+    unsigned long total_mb = 1024;
+    size_t ring_kb = 1024;
+    int flags = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:r:H")) != -1) 
+    {
+        switch (opt) 
+        {
+            case 't':
+                total_mb = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                ring_kb = strtoul(optarg, NULL, 10);
+                break;
+            case 'H':
+                flags |= SHM_RING_HUGETLB;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t total_MB] [-r ring_KB] [-H]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    printf("%-10s %8s %10s %10s %12s\n", "mode", "slot", "messages", "GB/s", "msg/s");
+    for (size_t i = 0; i < sizeof(slot_sizes) / sizeof(slot_sizes[0]); i++) 
+    {
+        size_t slot = slot_sizes[i];
+        unsigned long msgs = total_mb * 1024 * 1024 / slot;
+        bench_handshake(slot, msgs);
+        bench_ring(slot, msgs, ring_kb * 1024, flags);
+    }
+    return 0;
+}
@@ -0,0 +1,302 @@
+#define _GNU_SOURCE
+#include "shm_ring.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/shm.h>
+#include <sys/sem.h>
+
+#define RING_MAGIC 0x52494e47u
+#define RING_CACHELINE 64
+#define RING_HUGEPAGE (2UL * 1024 * 1024)
+#define RING_WAIT_NS 100000000L
+
+// semaphore numbers
+#define SEM_DATA 0
+#define SEM_SPACE 1
+
+// segment header; producer and consumer counters sit on separate cache lines
+struct shm_ring_hdr 
+{
+    uint32_t magic;
+    uint32_t pad;
+    uint64_t slot_size;
+    uint64_t nslots;
+    _Alignas(RING_CACHELINE) atomic_ulong head;
+    atomic_int consumer_waiting;
+    _Alignas(RING_CACHELINE) atomic_ulong tail;
+    atomic_int producer_waiting;
+    _Alignas(RING_CACHELINE) atomic_int closed;
+};
+
+// slot = length word padded to a cache line + payload
+#define SLOT_HDR RING_CACHELINE
+
+static size_t round_up(size_t v, size_t a) 
+{
+    return (v + a - 1) / a * a;
+}
+
+static size_t slot_stride(size_t slot_size) 
+{
+    return SLOT_HDR + round_up(slot_size, RING_CACHELINE);
+}
+
+static size_t *slot_len(shm_ring_t *r, unsigned long pos) 
+{
+    return (size_t *)(r->slots + (pos % r->nslots) * slot_stride(r->slot_size));
+}
+
+static void *slot_data(shm_ring_t *r, unsigned long pos) 
+{
+    return (char *)slot_len(r, pos) + SLOT_HDR;
+}
+
+static int sem_change(int semid, unsigned short num, short op, int timed) 
+{
+    struct sembuf sb = {num, op, 0};
+    struct timespec ts = {0, RING_WAIT_NS};
+    while (semtimedop(semid, &sb, 1, timed ? &ts : NULL) == -1) 
+    {
+        if (errno == EAGAIN) 
+            return 0;
+        if (errno != EINTR) 
+            return -1;
+    }
+    return 0;
+}
+
+// block on a semaphore after announcing it through *waiting; the recheck
+// after the announcement pairs with the post side in wake_peer()
+static int wait_peer(shm_ring_t *r, atomic_int *waiting, unsigned short semnum, 
+                     int (*ready)(shm_ring_t *)) 
+{
+    atomic_store(waiting, 1);
+    if (ready(r)) 
+    {
+        atomic_store(waiting, 0);
+        return 0;
+    }
+    int rc = sem_change(r->semid, semnum, -1, 1);
+    atomic_store(waiting, 0);
+    return rc;
+}
+
+static void wake_peer(shm_ring_t *r, atomic_int *waiting, unsigned short semnum) 
+{
+    if (atomic_load(waiting) && atomic_exchange(waiting, 0)) 
+        sem_change(r->semid, semnum, 1, 0);
+}
+
+static int has_space(shm_ring_t *r) 
+{
+    return atomic_load(&r->hdr->head) - atomic_load(&r->hdr->tail) < r->nslots;
+}
+
+static int has_data(shm_ring_t *r) 
+{
+    return atomic_load(&r->hdr->head) != atomic_load(&r->hdr->tail) || atomic_load(&r->hdr->closed);
+}
+
+static int map_segment(shm_ring_t *r) 
+{
+    void *p = shmat(r->shmid, NULL, 0);
+    if (p == (void *)-1) 
+    {
+        perror("shmat");
+        return -1;
+    }
+    r->hdr = p;
+    r->slots = (char *)p + round_up(sizeof(shm_ring_hdr_t), RING_CACHELINE);
+    return 0;
+}
+
+int shm_ring_create(shm_ring_t *r, key_t key, size_t slot_size, size_t nslots, int flags) 
+{
+    memset(r, 0, sizeof(*r));
+    if (slot_size == 0 || nslots == 0) 
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t size = round_up(sizeof(shm_ring_hdr_t), RING_CACHELINE) + slot_stride(slot_size) * nslots;
+    r->shmid = -1;
+    if (flags & SHM_RING_HUGETLB) 
+    {
+        r->shmid = shmget(key, round_up(size, RING_HUGEPAGE), IPC_CREAT | SHM_HUGETLB | 0666);
+        if (r->shmid == -1) 
+            fprintf(stderr, "shm_ring: SHM_HUGETLB unavailable (%s), using normal pages\n", strerror(errno));
+    }
+    if (r->shmid == -1) 
+        r->shmid = shmget(key, size, IPC_CREAT | 0666);
+    if (r->shmid == -1) 
+    {
+        perror("shmget");
+        return -1;
+    }
+
+    r->semid = semget(key, 2, IPC_CREAT | 0666);
+    if (r->semid == -1) 
+    {
+        perror("semget");
+        shmctl(r->shmid, IPC_RMID, NULL);
+        return -1;
+    }
+    unsigned short init[2] = {0, 0};
+    semctl(r->semid, 0, SETALL, init);
+
+    if (map_segment(r) == -1) 
+    {
+        shmctl(r->shmid, IPC_RMID, NULL);
+        semctl(r->semid, 0, IPC_RMID);
+        return -1;
+    }
+
+    r->slot_size = slot_size;
+    r->nslots = nslots;
+    r->owner = 1;
+
+    shm_ring_hdr_t *h = r->hdr;
+    h->slot_size = slot_size;
+    h->nslots = nslots;
+    atomic_init(&h->head, 0);
+    atomic_init(&h->tail, 0);
+    atomic_init(&h->consumer_waiting, 0);
+    atomic_init(&h->producer_waiting, 0);
+    atomic_init(&h->closed, 0);
+    atomic_thread_fence(memory_order_release);
+    h->magic = RING_MAGIC;
+    return 0;
+}
+
+int shm_ring_attach(shm_ring_t *r, key_t key) 
+{
+    memset(r, 0, sizeof(*r));
+    r->shmid = shmget(key, 0, 0666);
+    if (r->shmid == -1) 
+    {
+        perror("shmget");
+        return -1;
+    }
+    r->semid = semget(key, 2, 0666);
+    if (r->semid == -1) 
+    {
+        perror("semget");
+        return -1;
+    }
+    if (map_segment(r) == -1) 
+        return -1;
+
+    if (r->hdr->magic != RING_MAGIC) 
+    {
+        fprintf(stderr, "shm_ring: segment is not initialized\n");
+        shmdt(r->hdr);
+        r->hdr = NULL;
+        return -1;
+    }
+    r->slot_size = r->hdr->slot_size;
+    r->nslots = r->hdr->nslots;
+    return 0;
+}
+
+void shm_ring_detach(shm_ring_t *r) 
+{
+    if (r->hdr) 
+    {
+        shmdt(r->hdr);
+        r->hdr = NULL;
+    }
+}
+
+void shm_ring_destroy(shm_ring_t *r) 
+{
+    shm_ring_detach(r);
+    if (r->owner) 
+    {
+        shmctl(r->shmid, IPC_RMID, NULL);
+        semctl(r->semid, 0, IPC_RMID);
+        r->owner = 0;
+    }
+}
+
+void *shm_ring_reserve(shm_ring_t *r) 
+{
+    while (!has_space(r)) 
+    {
+        if (wait_peer(r, &r->hdr->producer_waiting, SEM_SPACE, has_space) == -1) 
+            return NULL;
+    }
+    return slot_data(r, atomic_load_explicit(&r->hdr->head, memory_order_relaxed));
+}
+
+void shm_ring_commit(shm_ring_t *r, size_t len) 
+{
+    unsigned long head = atomic_load_explicit(&r->hdr->head, memory_order_relaxed);
+    *slot_len(r, head) = len < r->slot_size ? len : r->slot_size;
+    atomic_store(&r->hdr->head, head + 1);
+    wake_peer(r, &r->hdr->consumer_waiting, SEM_DATA);
+}
+
+const void *shm_ring_peek(shm_ring_t *r, size_t *len) 
+{
+    while (!has_data(r)) 
+    {
+        if (wait_peer(r, &r->hdr->consumer_waiting, SEM_DATA, has_data) == -1) 
+            return NULL;
+    }
+    unsigned long tail = atomic_load_explicit(&r->hdr->tail, memory_order_relaxed);
+    if (atomic_load(&r->hdr->head) == tail) 
+    {
+        errno = EPIPE;  // closed and drained
+        return NULL;
+    }
+    *len = *slot_len(r, tail);
+    return slot_data(r, tail);
+}
+
+void shm_ring_release(shm_ring_t *r) 
+{
+    unsigned long tail = atomic_load_explicit(&r->hdr->tail, memory_order_relaxed);
+    atomic_store(&r->hdr->tail, tail + 1);
+    wake_peer(r, &r->hdr->producer_waiting, SEM_SPACE);
+}
+
+int shm_ring_send(shm_ring_t *r, const void *data, size_t len) 
+{
+    if (len > r->slot_size) 
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    void *slot = shm_ring_reserve(r);
+    if (!slot) 
+        return -1;
+    memcpy(slot, data, len);
+    shm_ring_commit(r, len);
+    return 0;
+}
+
+ssize_t shm_ring_recv(shm_ring_t *r, void *data, size_t cap) 
+{
+    size_t len;
+    const void *slot = shm_ring_peek(r, &len);
+    if (!slot) 
+        return -1;
+    if (len > cap) 
+        len = cap;
+    memcpy(data, slot, len);
+    shm_ring_release(r);
+    return (ssize_t)len;
+}
+
+void shm_ring_close(shm_ring_t *r) 
+{
+    atomic_store(&r->hdr->closed, 1);
+    atomic_store(&r->hdr->consumer_waiting, 0);
+    sem_change(r->semid, SEM_DATA, 1, 0);
+}
@@ -0,0 +1,51 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+
+// flags for shm_ring_create()
+#define SHM_RING_HUGETLB 0x1
+
+// SysV shared memory segment split into a ring of fixed-size slots.
+// One producer and one consumer; semaphores are touched only when
+// the ring is full (producer) or empty (consumer).
+typedef struct shm_ring_hdr shm_ring_hdr_t;
+
+typedef struct 
+{
+    int shmid;
+    int semid;
+    shm_ring_hdr_t *hdr;
+    char *slots;
+    size_t slot_size;
+    size_t nslots;
+    int owner;
+} shm_ring_t;
+
+int shm_ring_create(shm_ring_t *r, key_t key, size_t slot_size, size_t nslots, int flags);
+int shm_ring_attach(shm_ring_t *r, key_t key);
+void shm_ring_detach(shm_ring_t *r);
+void shm_ring_destroy(shm_ring_t *r);
+
+// zero-copy producer side: get a free slot, fill it, publish len bytes
+void *shm_ring_reserve(shm_ring_t *r);
+void shm_ring_commit(shm_ring_t *r, size_t len);
+
+// zero-copy consumer side: NULL with errno EPIPE once the ring is closed
+// and drained
+const void *shm_ring_peek(shm_ring_t *r, size_t *len);
+void shm_ring_release(shm_ring_t *r);
+
+// copying helpers on top of reserve/commit and peek/release; send fails
+// with EMSGSIZE for more than slot_size bytes, recv returns the length
+// cut to cap (0 for an empty message) or -1, with EPIPE once closed and
+// drained
+int shm_ring_send(shm_ring_t *r, const void *data, size_t len);
+ssize_t shm_ring_recv(shm_ring_t *r, void *data, size_t cap);
+
+// producer is done, consumer gets NULL/-1 after draining
+void shm_ring_close(shm_ring_t *r);
+
+#endif
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Copy throughput and CPU time per copy engine method against the old
+# 8 KiB read/write loop, for 1 MiB, 1 GiB and 10 GiB files plus a 1 GiB
+# sparse file with 16 MiB of data. Files are created in DIR and removed.
+# usage: ./bench_copy.sh [dir] [sizes in MiB...]
+
+DIR=${1:-/tmp/kfm_bench_copy}
+shift 2>/dev/null
+SIZES=${*:-1 1024 10240}
+
+[ -x ./kfm.out ] || make >/dev/null || exit 1
+mkdir -p "$DIR" || exit 1
+
+for mib in $SIZES; do
+    f="$DIR/src_${mib}M"
+    head -c $((mib * 1048576)) /dev/urandom > "$f"
+    sync
+    ./kfm.out --bench-copy "$f" "$DIR"
+    rm -f "$f"
+    echo
+done
+
+f="$DIR/sparse_1G"
+rm -f "$f"
+truncate -s 1G "$f"
+head -c $((16 * 1048576)) /dev/urandom | dd of="$f" bs=1M seek=512 conv=notrunc status=none
+sync
+./kfm.out --bench-copy "$f" "$DIR"
+rm -f "$f"
@@ -0,0 +1,10 @@
+#!/bin/sh
+# Type-to-filter on a huge directory: time per keystroke while typing and
+# erasing queries over COUNT names held in memory (no files are created).
+# usage: ./bench_filter.sh [count]
+
+COUNT=${1:-1000000}
+
+[ -x ./kfm.out ] || make >/dev/null || exit 1
+
+./kfm.out --bench-filter "$COUNT"
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Redraw latency while scrolling a 50k-file directory: per-frame stat() +
+# libmagic against the cached classifier. Builds the directory on first
+# use: a third known extensions, a third extensionless text, a third
+# extensionless binary (the ambiguous files libmagic has to look at).
+# usage: ./bench_redraw.sh [dir] [files]
+
+DIR=${1:-/tmp/kfm_bench_50k}
+FILES=${2:-50000}
+
+[ -x ./kfm.out ] || make >/dev/null || exit 1
+
+if [ ! -d "$DIR" ]; then
+    mkdir -p "$DIR" || exit 1
+    i=0
+    while [ "$i" -lt "$FILES" ]; do
+        case $((i % 3)) in
+            0) printf 'note %d\n' "$i" > "$DIR/f$i.txt" ;;
+            1) printf 'plain text %d\n' "$i" > "$DIR/f$i" ;;
+            2) printf '\177ELF\002\001\001\000%d' "$i" > "$DIR/b$i" ;;
+        esac
+        i=$((i + 1))
+    done
+fi
+
+./kfm.out --bench-redraw "$DIR"
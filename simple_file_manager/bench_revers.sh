@@ -0,0 +1,22 @@
+#!/bin/sh
+# outrput_revers.c: byte and line reversal of a large text file against
+# the old byte-at-a-time loop (estimated from its last MiB) and tac.
+# Builds FILE of SIZE MiB of base64 lines on first use.
+# usage: ./bench_revers.sh [file] [size in MiB]
+
+FILE=${1:-/tmp/kfm_bench_revers.txt}
+SIZE=${2:-1024}
+BIN=/tmp/outrput_revers.out
+
+gcc -O2 -o "$BIN" outrput_revers.c || exit 1
+
+if [ ! -f "$FILE" ]; then
+    head -c $((SIZE * 1048576 * 3 / 4)) /dev/urandom | base64 > "$FILE" || exit 1
+fi
+
+# the output must match tac byte for byte
+tac "$FILE" > "$FILE.tac"
+"$BIN" -l "$FILE" | cmp - "$FILE.tac" && echo "lines: same as tac"
+rm -f "$FILE.tac"
+
+"$BIN" --bench "$FILE"
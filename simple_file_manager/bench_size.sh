@@ -0,0 +1,11 @@
+#!/bin/sh
+# Directory sizes: du -s against the size walk on a large tree, cold and
+# warm page cache, then a repeat answered from the size cache.
+# Cold rounds drop the page cache, which needs root.
+# usage: ./bench_size.sh [dir]
+
+DIR=${1:-/usr}
+
+[ -x ./kfm.out ] || make >/dev/null || exit 1
+
+./kfm.out --bench-size "$DIR"
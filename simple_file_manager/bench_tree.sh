@@ -0,0 +1,29 @@
+#!/bin/sh
+# Recursive copy and delete of a tree of small files: the old walk on
+# the UI thread against the tree_op pool. Builds the tree on first use,
+# DIRS directories of 1000 files of 1-4 KiB (200k files by default).
+# usage: ./bench_tree.sh [dir] [dirs]
+
+DIR=${1:-/tmp/kfm_bench_tree}
+DIRS=${2:-200}
+
+[ -x ./kfm.out ] || make >/dev/null || exit 1
+
+SRC="$DIR/src"
+if [ ! -d "$SRC" ]; then
+    mkdir -p "$SRC" || exit 1
+    block=$(head -c 4096 /dev/urandom | base64 -w 0 | head -c 4096)
+    d=0
+    while [ "$d" -lt "$DIRS" ]; do
+        mkdir -p "$SRC/d$((d % 10))/d$d"
+        i=0
+        while [ "$i" -lt 1000 ]; do
+            printf '%.*s' $((1024 + (i * 37) % 3072)) "$block" > "$SRC/d$((d % 10))/d$d/f$i"
+            i=$((i + 1))
+        done
+        d=$((d + 1))
+    done
+    sync
+fi
+
+./kfm.out --bench-tree "$SRC" "$DIR"
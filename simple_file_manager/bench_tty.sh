@@ -0,0 +1,23 @@
+#!/bin/sh
+# Bytes written to the terminal per keypress on a 200x60 pty: moving the
+# selection, scrolling and switching panels, plus output and CPU while
+# idle. Builds a directory of 2000 .txt files with names of random
+# letters, 4 to 60 long, on first use. A second
+# binary (e.g. an older build) can be measured with the same driver.
+# usage: ./bench_tty.sh [dir] [program]
+
+DIR=${1:-/tmp/kfm_bench_tty}
+
+[ -x ./kfm.out ] || make >/dev/null || exit 1
+
+if [ ! -d "$DIR" ]; then
+    mkdir -p "$DIR" || exit 1
+    awk 'BEGIN { srand(1); for (i = 0; i < 2000; i++) { n = 4 + int(rand() * 57); s = "";
+        for (j = 0; j < n; j++) s = s substr("abcdefghijklmnopqrstuvwxyz_", 1 + int(rand() * 27), 1);
+        print s "_" i ".txt" } }' |
+    while read -r name; do
+        printf 'note\n' > "$DIR/$name"
+    done
+fi
+
+./kfm.out --bench-tty "$DIR" $2
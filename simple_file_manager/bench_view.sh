@@ -0,0 +1,44 @@
+#!/bin/sh
+# Viewer on a big log: open and first screen against reading the whole
+# file, the line index (cold and warm, vector and memchr scan), random
+# jumps, paging and a full search each way.
+# Without an existing FILE a log of SIZE MiB (2048 by default) is made
+# there first and removed afterwards.
+# Cold rounds drop the page cache, which needs root.
+# usage: ./bench_view.sh [file] [size_mib]
+
+FILE=${1:-/tmp/kfm_bench_view.log}
+SIZE=${2:-2048}
+
+[ -x ./kfm.out ] || make >/dev/null || exit 1
+
+MADE=
+if [ ! -f "$FILE" ]; then
+    # 64 MiB of varied log lines, repeated up to SIZE
+    awk 'BEGIN {
+        srand(1);
+        split("INFO INFO INFO WARN ERROR DEBUG", lvl, " ");
+        while (n < 64 * 1048576) {
+            line = sprintf("2026-10-18 %02d:%02d:%02d.%03d %-5s [worker-%d] request id=%d path=/api/v1/items/%d took %d ms",
+                int(n / 2400000) % 24, int(n / 40000) % 60, int(n / 700) % 60, n % 1000,
+                lvl[int(rand() * 6) + 1], int(rand() * 16), n, int(rand() * 100000), int(rand() * 500));
+            if (rand() < 0.05)
+                line = line "\tdetail=" sprintf("%0" int(rand() * 300) + 1 "d", 0);
+            print line;
+            n += length(line) + 1;
+        }
+    }' > "$FILE.part" || exit 1
+    i=0
+    while [ $((i * 64)) -lt "$SIZE" ]; do
+        cat "$FILE.part"
+        i=$((i + 1))
+    done > "$FILE"
+    rm -f "$FILE.part"
+    MADE=1
+fi
+
+./kfm.out --bench-view "$FILE"
+STATUS=$?
+
+[ -n "$MADE" ] && rm -f "$FILE"
+exit $STATUS
@@ -0,0 +1,17 @@
+#!/bin/sh
+# A log directory that keeps churning: a watched panel applies batches of
+# creates and deletes in place, compared with re-reading the directory.
+# Builds a directory of FILES empty .log files on first use.
+# usage: ./bench_watch.sh [dir] [files]
+
+DIR=${1:-/tmp/kfm_bench_watch}
+FILES=${2:-100000}
+
+[ -x ./kfm.out ] || make >/dev/null || exit 1
+
+if [ ! -d "$DIR" ]; then
+    mkdir -p "$DIR" || exit 1
+    (cd "$DIR" && seq -f "app_%06g.log" 0 $((FILES - 1)) | xargs touch)
+fi
+
+./kfm.out --bench-watch "$DIR"
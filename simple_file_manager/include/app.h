@@ -12,9 +12,22 @@
 #include <dirent.h>
 #include <linux/limits.h>
 #include <wchar.h>
+#include <stdint.h>
 
 typedef struct App App; 
 
+/**
+ * @struct PanelRow
+ * @brief What one visible row of a panel showed in the last frame.
+ */
+typedef struct PanelRow
+{
+    const struct dirent *entry; /**< NULL for a blank row */
+    short color;
+    short size_state;
+    uint64_t size;
+} PanelRow;
+
 /**
  * @struct Panel
  * @brief Represents a single file panel.
@@ -28,6 +41,22 @@ typedef struct Panel
 
     struct dirent **entries;
     int count;
+    int capacity;
+
+    struct DirLoader *loader; /**< Background reader owning the entries */
+    int loading;
+
+    struct TypeCache *types; /**< libmagic results, see file_type.c */
+
+    struct DirWatch *watch; /**< inotify on cwd, NULL: reload by hand */
+    int watching;
+    char reselect[NAME_MAX + 1]; /**< Entry to select once loading ends */
+
+    struct PanelFilter *filter; /**< Type-to-filter state, see filter.c */
+
+    struct TreeOp *sizing;        /**< Size walk in progress, see dir_size.c */
+    struct dirent *sizing_entry;  /**< The entry it is sizing */
+    uint64_t sizing_bytes;        /**< Its total so far */
 
     int selected;
     int scroll;
@@ -35,6 +64,11 @@ typedef struct Panel
     int x, y;
     int w, h;
 
+    PanelRow *drawn; /**< Last frame, one per visible row, see draw_panel */
+    int drawn_rows;
+    int drawn_valid; /**< 0: border, title and every row are repainted */
+    char drawn_title[PATH_MAX + 32];
+
 } Panel;
 
 /**
@@ -77,6 +111,8 @@ typedef struct App
 
     int active;
 
+    int damaged; /**< Window must be repainted from scratch */
+
 } App;
 
 int run_app(void);
@@ -0,0 +1,14 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+int bench_load(const char *dir);
+int bench_redraw(const char *dir);
+int bench_copy(const char *file, const char *dir);
+int bench_tree(const char *src, const char *dir);
+int bench_tty(const char *dir, const char *program);
+int bench_watch(const char *dir);
+int bench_filter(int count);
+int bench_size(const char *dir);
+int bench_view(const char *file);
+
+#endif
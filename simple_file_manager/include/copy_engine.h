@@ -0,0 +1,34 @@
+/**
+ * @file copy_engine.h
+ * @brief File copy with the fastest method the filesystems allow.
+ */
+#ifndef COPY_ENGINE_H
+#define COPY_ENGINE_H
+
+#include <sys/types.h>
+
+/** Methods, tried in this order; a mask of them limits the choice. */
+#define COPY_CLONE    0x1  /**< FICLONE reflink, no data copied */
+#define COPY_RANGE    0x2  /**< copy_file_range(), in-kernel */
+#define COPY_SENDFILE 0x4  /**< sendfile(), in-kernel */
+#define COPY_BUFFER   0x8  /**< pread()/pwrite() with a 1 MiB aligned buffer */
+#define COPY_ALL      0xf
+
+struct stat;
+
+/**
+ * @brief Progress callback: bytes done out of total (holes count as done).
+ *
+ * Returning non-zero stops the copy, which then fails with ECANCELED.
+ */
+typedef int (*copy_progress_fn)(off_t done, off_t total, void *arg);
+
+int copy_file_fast(const char *src, const char *dst,
+    copy_progress_fn progress, void *arg);
+int copy_file_with(const char *src, const char *dst, int methods,
+    copy_progress_fn progress, void *arg, int *used);
+int copy_fd_with(int in, int out, const struct stat *st, int methods,
+    copy_progress_fn progress, void *arg, int *used);
+const char *copy_method_name(int method);
+
+#endif
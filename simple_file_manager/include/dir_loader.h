@@ -0,0 +1,63 @@
+/**
+ * @file dir_loader.h
+ * @brief Background directory reader.
+ *
+ * A loader reads one directory with getdents64() on its own thread,
+ * publishes entries in batches as they arrive and sorts the full list
+ * once reading is done. The panel polls it from the UI loop.
+ */
+#ifndef DIR_LOADER_H
+#define DIR_LOADER_H
+
+#include <dirent.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct DirLoader DirLoader;
+
+/**
+ * @struct FileKey
+ * @brief Identity of a file version: same key, same contents type.
+ */
+typedef struct FileKey
+{
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_ns;
+} FileKey;
+
+/**
+ * @struct EntryMeta
+ * @brief Per-entry metadata stored right before each dirent record.
+ *
+ * Zeroed by the loader; filled lazily by the file type classifier and
+ * the directory size display.
+ */
+typedef struct EntryMeta
+{
+    FileKey key;
+    uint8_t state;
+    uint8_t color;
+    uint8_t size_state; /**< see dir_size.c */
+    uint64_t bytes;     /**< disk usage once size_state says so */
+} EntryMeta;
+
+static inline EntryMeta *dir_entry_meta(struct dirent *e)
+{
+    return (EntryMeta *)((char *)e - sizeof(EntryMeta));
+}
+
+DirLoader *dir_loader_start(int dirfd);
+int dir_loader_poll(DirLoader *l, struct dirent ***entries, int *count,
+    int *capacity, int *error);
+void dir_loader_release(DirLoader *l);
+struct dirent *dir_loader_add(DirLoader *l, const char *name, uint64_t ino,
+    unsigned char type);
+void dir_loader_drop(DirLoader *l, const struct dirent *e);
+int dir_loader_mostly_dead(const DirLoader *l);
+
+/** Order of the sorted list, a qsort() comparator on struct dirent *. */
+int dir_entry_compare(const void *a, const void *b);
+
+#endif
@@ -0,0 +1,26 @@
+/**
+ * @file dir_size.h
+ * @brief Directory sizes in the panels.
+ */
+#ifndef DIR_SIZE_H
+#define DIR_SIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "app.h"
+
+/** What dir_size_of() knows about an entry */
+enum
+{
+    DIR_SIZE_NONE = 0, /**< nothing to show */
+    DIR_SIZE_PARTIAL,  /**< still counting */
+    DIR_SIZE_DONE
+};
+
+int dir_size_start(Panel *p);
+int dir_size_poll(Panel *p);
+void dir_size_stop(Panel *p);
+int dir_size_of(Panel *p, struct dirent *e, uint64_t *bytes);
+void dir_size_format(uint64_t bytes, char *buf, size_t len);
+
+#endif
@@ -0,0 +1,27 @@
+/**
+ * @file dir_watch.h
+ * @brief inotify watch on a panel's directory.
+ *
+ * The watch only records which names changed; the panel looks each one
+ * up again when it applies them, so the order and pairing of events
+ * does not matter.
+ */
+#ifndef DIR_WATCH_H
+#define DIR_WATCH_H
+
+typedef struct DirWatch DirWatch;
+
+/** dir_watch_read() results, or-ed together. */
+#define WATCH_CHANGED  0x1  /**< names are waiting in dir_watch_take() */
+#define WATCH_OVERFLOW 0x2  /**< events were lost: re-read the directory */
+#define WATCH_GONE     0x4  /**< the directory was deleted or moved away */
+
+DirWatch *dir_watch_open(void);
+void dir_watch_close(DirWatch *w);
+int dir_watch_fd(const DirWatch *w);
+int dir_watch_set(DirWatch *w, const char *path);
+int dir_watch_read(DirWatch *w);
+int dir_watch_take(DirWatch *w, char ***names, int *count);
+void dir_watch_free_names(char **names, int count);
+
+#endif
@@ -0,0 +1,18 @@
+/**
+ * @file file_type.h
+ * @brief Cached file type classification for panel colours.
+ */
+#ifndef FILE_TYPE_H
+#define FILE_TYPE_H
+
+#include <dirent.h>
+#include "app.h"
+
+int file_types_init(void);
+void file_types_shutdown(void);
+int file_type_color(Panel *p, struct dirent *e);
+void file_types_forget(Panel *p);
+void file_types_free(Panel *p);
+int color_for_mime(const char *mime);
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * @file file_view.h
+ * @brief Read-only access to a file of any size by lines.
+ *
+ * The file is mapped, not read, so opening it costs the same for a few
+ * bytes and for many gigabytes. Line numbers come from a sparse index a
+ * background thread builds while the file is already on screen.
+ */
+#ifndef FILE_VIEW_H
+#define FILE_VIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct FileView FileView;
+
+/**
+ * @struct FileViewProgress
+ * @brief How far the line index has got.
+ */
+typedef struct FileViewProgress
+{
+    uint64_t bytes; /**< bytes indexed so far */
+    uint64_t lines; /**< lines in those bytes, all lines once done */
+    int done;
+} FileViewProgress;
+
+/** file_view_search() results */
+enum
+{
+    FILE_VIEW_NOT_FOUND = 0,
+    FILE_VIEW_FOUND,
+    FILE_VIEW_MORE     /**< budget spent, call again from *at */
+};
+
+FileView *file_view_open(const char *path);
+void file_view_close(FileView *v);
+const char *file_view_data(const FileView *v);
+uint64_t file_view_size(const FileView *v);
+void file_view_progress(FileView *v, FileViewProgress *progress);
+int file_view_wait(FileView *v, int timeout_ms);
+
+uint64_t file_view_line_start(const FileView *v, uint64_t off);
+uint64_t file_view_line_end(const FileView *v, uint64_t off);
+uint64_t file_view_next_line(const FileView *v, uint64_t off);
+uint64_t file_view_prev_line(const FileView *v, uint64_t off);
+int file_view_line_offset(FileView *v, uint64_t line, uint64_t *off);
+int file_view_line_number(FileView *v, uint64_t off, uint64_t *line);
+int file_view_search(const FileView *v, const char *needle, size_t len,
+    uint64_t from, int backward, uint64_t *at);
+
+const char *file_view_method(void);
+void file_view_force_scalar(int on);
+
+#endif
@@ -0,0 +1,16 @@
+/**
+ * @file filter.h
+ * @brief Type-to-filter mode of a panel.
+ */
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "app.h"
+
+int filter_start(Panel *p);
+int filter_append(Panel *p, int ch);
+void filter_backspace(Panel *p);
+void filter_end(Panel *p, int keep_selection);
+const char *filter_query(const Panel *p);
+
+#endif
@@ -0,0 +1,23 @@
+/**
+ * @file name_index.h
+ * @brief Case-insensitive substring search over a panel's names.
+ *
+ * The names are copied once, lower-cased, into one contiguous block so
+ * a search is a single vectorised scan instead of a million small ones.
+ */
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <dirent.h>
+#include <stddef.h>
+
+typedef struct NameIndex NameIndex;
+
+NameIndex *name_index_build(struct dirent **entries, int count);
+void name_index_free(NameIndex *ix);
+int name_index_search(const NameIndex *ix, const char *needle, size_t len,
+    const int *candidates, int ncandidates, int *out);
+const char *name_index_method(void);
+void name_index_force_scalar(int on);
+
+#endif
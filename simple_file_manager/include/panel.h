@@ -5,6 +5,8 @@
 
 void free_panel(Panel *p);
 int load_directory(Panel *p);
+int panel_poll(Panel *p);
+void panel_refresh(Panel *p);
 void enter_directory(Panel *p);
 void move_selection(Panel *p, int dir);
 
@@ -0,0 +1,16 @@
+/**
+ * @file size_cache.h
+ * @brief Directory sizes remembered across visits.
+ */
+#ifndef SIZE_CACHE_H
+#define SIZE_CACHE_H
+
+#include <stdint.h>
+#include "dir_loader.h"
+
+int size_cache_find(const FileKey *key, uint64_t *bytes);
+void size_cache_store(const FileKey *key, uint64_t bytes);
+int size_cache_empty(void);
+void size_cache_clear(void);
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file tree_op.h
+ * @brief Background recursive copy, move and delete.
+ *
+ * An operation walks the tree on a pool of worker threads that steal
+ * directories from each other, works relative to directory descriptors
+ * and reports progress through counters the UI polls. The same walk
+ * adds up disk usage for the panel's directory sizes.
+ */
+#ifndef TREE_OP_H
+#define TREE_OP_H
+
+#include <stdint.h>
+
+typedef struct TreeOp TreeOp;
+
+/**
+ * @enum TreeOpKind
+ * @brief What a tree operation does.
+ */
+typedef enum
+{
+    TREE_COPY,   /**< Copy src to dst */
+    TREE_MOVE,   /**< rename(), or copy then delete across filesystems */
+    TREE_DELETE, /**< Delete src, dst unused */
+    TREE_SIZE    /**< Add up the disk usage of src, dst unused */
+} TreeOpKind;
+
+/**
+ * @struct TreeProgress
+ * @brief Snapshot of an operation's counters.
+ *
+ * Totals grow while the walk is still finding entries (scanning set).
+ * For TREE_SIZE bytes_done is the disk usage found so far, each hard
+ * linked file counted once.
+ */
+typedef struct TreeProgress
+{
+    uint64_t entries_done;
+    uint64_t entries_total;
+    uint64_t bytes_done;
+    uint64_t errors;
+    int first_error; /**< errno of the first failure, 0 if none */
+    int scanning;
+} TreeProgress;
+
+TreeOp *tree_op_start(TreeOpKind kind, const char *src, const char *dst,
+    int threads);
+int tree_op_poll(TreeOp *op, TreeProgress *progress);
+void tree_op_cancel(TreeOp *op);
+int tree_op_finish(TreeOp *op);
+int tree_op_default_threads(void);
+
+#endif
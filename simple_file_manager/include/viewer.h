@@ -0,0 +1,20 @@
+/**
+ * @file viewer.h
+ * @brief Full-screen file viewer.
+ */
+#ifndef VIEWER_H
+#define VIEWER_H
+
+#include "app.h"
+
+/** What the viewer was left with */
+enum
+{
+    VIEWER_CLOSED = 0,
+    VIEWER_EDIT,     /**< the user asked to edit the file */
+    VIEWER_ERROR     /**< the file could not be opened, errno set */
+};
+
+int view_file(App *app, const char *path);
+
+#endif
@@ -1,23 +1,96 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <limits.h>
 #include <string.h>
+#include <time.h>
 // linlibs
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Без аргументов - меню, как раньше. С аргументами - потоковый
+ * переворот файла в stdout:
+ *   outrput_revers [-b] FILE   байты в обратном порядке
+ *   outrput_revers -l FILE     строки в обратном порядке (как tac)
+ *   outrput_revers --bench FILE
+ * FILE "-" или его отсутствие - stdin (канал сначала сохраняется во
+ * временный файл). Файл читается блоками по BLOCK_SIZE с конца через
+ * pread(), поэтому может быть больше оперативной памяти.
+ */
 
+#define BLOCK_SIZE (4 << 20)
+#define OUT_SIZE (1 << 20)
+#define LEGACY_BYTES (1 << 20)
 
 int readInt(const char *prompt, int *out);
 int writeStringToFile();
 int readStringFromFile();
 
+int reverseBytes(int in, int out);
+int reverseLines(int in, int out);
+int benchReverse(const char *path);
+
 void testCursedFunc();
 
-int main()
+static void reverseScalar(char *p, size_t n);
+static void (*reverseBlock)(char *p, size_t n) = reverseScalar;
+static const char *reverseKernel = "scalar";
+
+static void pickKernel(void);
+static int openInput(const char *path);
+
+int main(int argc, char **argv)
 {
     int choice;
 
+    pickKernel();
+
+    if (argc > 1)
+    {
+        int lines = 0;
+        const char *path = NULL;
+
+        if (argc == 3 && strcmp(argv[1], "--bench") == 0)
+            return benchReverse(argv[2]);
+
+        for (int i = 1; i < argc; i++)
+        {
+            if (strcmp(argv[i], "-l") == 0)
+                lines = 1;
+            else if (strcmp(argv[i], "-b") == 0)
+                lines = 0;
+            else if (!path)
+                path = argv[i];
+            else
+            {
+                fprintf(stderr, "Использование: %s [-b | -l] [FILE]\n", argv[0]);
+                return 2;
+            }
+        }
+
+        int fd = openInput(path);
+        if (fd == -1)
+        {
+            perror(path ? path : "stdin");
+            return 1;
+        }
+
+        int rc = lines ? reverseLines(fd, STDOUT_FILENO) : reverseBytes(fd, STDOUT_FILENO);
+        if (rc != 0)
+            perror("reverse");
+        close(fd);
+        return rc != 0;
+    }
+
     while(1)
     {
         printf("\nФайловая система:\n");
@@ -40,6 +113,7 @@ int main()
 
             case 2:
                 printf("Чтение файла... В файле записано:\n");
+                fflush(stdout);
                 readStringFromFile();
                 break;
         }
@@ -74,32 +148,503 @@ int readStringFromFile()
     if (fd == -1)
         return 1;
 
-    off_t file_size = lseek(fd, 0, SEEK_END);
-    if (file_size == -1)
+    if (reverseBytes(fd, STDOUT_FILENO) != 0)
     {
         close(fd);
         return 2;
     }
-    
-    for (off_t p = file_size - 1; p >= 0; --p)
+    write(STDOUT_FILENO, "\n", 1);
+    close(fd);
+    return 0;
+}
+
+/* ---------- ядра переворота блока ---------- */
+
+static void reverseScalar(char *p, size_t n)
+{
+    size_t i = 0, j = n;
+    while (j - i >= 2)
     {
-        char c;
-        if (lseek(fd, p, SEEK_SET) == -1)
+        char c = p[i];
+        p[i++] = p[--j];
+        p[j] = c;
+    }
+}
+
+#if defined(__x86_64__)
+
+// меняем местами 16 байт с начала и 16 с конца, каждые перевёрнутые pshufb
+__attribute__((target("ssse3")))
+static void reverseSsse3(char *p, size_t n)
+{
+    const __m128i rev = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t i = 0, j = n;
+
+    while (j - i >= 32)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + j - 16));
+        _mm_storeu_si128((__m128i *)(p + i), _mm_shuffle_epi8(b, rev));
+        _mm_storeu_si128((__m128i *)(p + j - 16), _mm_shuffle_epi8(a, rev));
+        i += 16;
+        j -= 16;
+    }
+    reverseScalar(p + i, j - i);
+}
+
+// vpshufb переворачивает каждую 128-битную половину, vpermq меняет их местами
+__attribute__((target("avx2")))
+static void reverseAvx2(char *p, size_t n)
+{
+    const __m256i rev = _mm256_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t i = 0, j = n;
+
+    while (j - i >= 64)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + j - 32));
+        a = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(a, rev), 0x4E);
+        b = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(b, rev), 0x4E);
+        _mm256_storeu_si256((__m256i *)(p + i), b);
+        _mm256_storeu_si256((__m256i *)(p + j - 32), a);
+        i += 32;
+        j -= 32;
+    }
+    reverseScalar(p + i, j - i);
+}
+
+#endif
+
+static void pickKernel(void)
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        reverseBlock = reverseAvx2;
+        reverseKernel = "avx2";
+    }
+    else if (__builtin_cpu_supports("ssse3"))
+    {
+        reverseBlock = reverseSsse3;
+        reverseKernel = "ssse3";
+    }
+#endif
+}
+
+/* ---------- ввод-вывод ---------- */
+
+static int writeAll(int fd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t w = write(fd, p, n);
+        if (w < 0)
         {
-            close(fd);
-            return 3;
+            if (errno == EINTR)
+                continue;
+            return -1;
         }
-        
-        if (read(fd, &c, 1) != 1)
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static int readAt(int fd, char *p, size_t n, off_t off)
+{
+    while (n > 0)
+    {
+        ssize_t r = pread(fd, p, n, off);
+        if (r < 0)
         {
-            close(fd);
-            return 4;
+            if (errno == EINTR)
+                continue;
+            return -1;
         }
+        if (r == 0)
+        {
+            errno = EIO; // файл укоротили на ходу
+            return -1;
+        }
+        p += r;
+        off += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+/*
+ * Канал нельзя читать с конца: сохраняем его во временный файл,
+ * как это делает tac.
+ */
+static int spoolInput(int in)
+{
+    int fd = open(P_tmpdir, O_TMPFILE | O_RDWR, 0600);
+    if (fd == -1)
+        return -1;
 
-        write(STDOUT_FILENO, &c, 1);
+    char *buf = malloc(BLOCK_SIZE);
+    if (!buf)
+    {
+        close(fd);
+        return -1;
     }
-    write(STDOUT_FILENO, "\n", 1);
+
+    for (;;)
+    {
+        ssize_t r = read(in, buf, BLOCK_SIZE);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0 || writeAll(fd, buf, (size_t)r) != 0)
+        {
+            int err = errno;
+            free(buf);
+            if (r == 0)
+                return fd;
+            close(fd);
+            errno = err;
+            return -1;
+        }
+    }
+}
+
+static int openInput(const char *path)
+{
+    int fd = (!path || strcmp(path, "-") == 0) ? dup(STDIN_FILENO) : open(path, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        return fd;
+
+    int spooled = spoolInput(fd);
     close(fd);
+    return spooled;
+}
+
+/*
+ * Файл больше половины памяти: прочитанные блоки выбрасываем из кэша,
+ * иначе они вытеснят всё остальное.
+ */
+static int dropBehind(off_t size)
+{
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page = sysconf(_SC_PAGESIZE);
+    return pages > 0 && page > 0 && size > (off_t)pages * page / 2;
+}
+
+/*
+ * Первый блок - хвост файла до границы BLOCK_SIZE, дальше все чтения
+ * выровнены. Пока блок переворачивается и пишется, ядро уже читает
+ * предыдущий (WILLNEED): readahead назад само не работает.
+ */
+static off_t firstBlock(off_t size)
+{
+    off_t len = size % BLOCK_SIZE;
+    return len ? len : (size ? BLOCK_SIZE : 0);
+}
+
+int reverseBytes(int in, int out)
+{
+    off_t pos = lseek(in, 0, SEEK_END);
+    if (pos == -1)
+        return -1;
+
+    char *buf = aligned_alloc(4096, BLOCK_SIZE);
+    if (!buf)
+        return -1;
+
+    int drop = dropBehind(pos);
+    off_t len = firstBlock(pos);
+
+    while (pos > 0)
+    {
+        off_t off = pos - len;
+        if (off > 0)
+            posix_fadvise(in, off - BLOCK_SIZE, BLOCK_SIZE, POSIX_FADV_WILLNEED);
+
+        if (readAt(in, buf, (size_t)len, off) != 0)
+            break;
+        reverseBlock(buf, (size_t)len);
+        if (writeAll(out, buf, (size_t)len) != 0)
+            break;
+
+        if (drop)
+            posix_fadvise(in, off, len, POSIX_FADV_DONTNEED);
+        pos = off;
+        len = BLOCK_SIZE;
+    }
+
+    free(buf);
+    return pos > 0 ? -1 : 0;
+}
+
+/*
+ * Буфер вывода: мелкие строки копируются и уходят одним write(),
+ * длинные пишутся напрямую.
+ */
+typedef struct
+{
+    int fd;
+    char *buf;
+    size_t len;
+} Output;
+
+static int flushOutput(Output *o)
+{
+    int rc = writeAll(o->fd, o->buf, o->len);
+    o->len = 0;
+    return rc;
+}
+
+static int emit(Output *o, const char *p, size_t n)
+{
+    if (o->len + n > OUT_SIZE && flushOutput(o) != 0)
+        return -1;
+    if (n >= OUT_SIZE)
+        return writeAll(o->fd, p, n);
+    memcpy(o->buf + o->len, p, n);
+    o->len += n;
+    return 0;
+}
+
+/*
+ * Строка - текст вместе с '\n' в конце (у последней его может не быть),
+ * вывод - строки в обратном порядке, байт в байт как у GNU tac.
+ *
+ * Начало строки, которая тянется из предыдущего блока, остаётся в конце
+ * буфера (carry), а предыдущий блок читается прямо перед ним, так что
+ * строка всегда лежит в памяти целиком. В carry нет '\n', кроме,
+ * может быть, последнего байта, поэтому ищем только в новом блоке.
+ * Поиск - memrchr(), в glibc он векторный.
+ */
+int reverseLines(int in, int out)
+{
+    off_t pos = lseek(in, 0, SEEK_END);
+    if (pos == -1)
+        return -1;
+
+    size_t cap = 2 * (size_t)BLOCK_SIZE;
+    char *buf = malloc(cap);
+    Output o = { out, malloc(OUT_SIZE), 0 };
+    if (!buf || !o.buf)
+    {
+        free(buf);
+        free(o.buf);
+        return -1;
+    }
+
+    int drop = dropBehind(pos);
+    off_t len = firstBlock(pos);
+    size_t carry = 0;
+    int rc = 0;
+
+    while (pos > 0 && rc == 0)
+    {
+        off_t off = pos - len;
+
+        // очень длинная строка: растим буфер, carry остаётся в конце
+        if ((size_t)len + carry > cap)
+        {
+            size_t bigger = 2 * ((size_t)len + carry);
+            char *grown = malloc(bigger);
+            if (!grown)
+            {
+                rc = -1;
+                break;
+            }
+            memcpy(grown + bigger - carry, buf + cap - carry, carry);
+            free(buf);
+            buf = grown;
+            cap = bigger;
+        }
+
+        char *start = buf + cap - carry - len;
+        char *end = buf + cap;
+
+        if (off > 0)
+            posix_fadvise(in, off - BLOCK_SIZE, BLOCK_SIZE, POSIX_FADV_WILLNEED);
+        if (readAt(in, start, (size_t)len, off) != 0)
+        {
+            rc = -1;
+            break;
+        }
+        if (drop)
+            posix_fadvise(in, off, len, POSIX_FADV_DONTNEED);
+
+        // '\n' в конце текущей строки принадлежит ей самой
+        char *rec_end = end;
+        char *limit = carry ? start + len : end - 1;
+        char *nl;
+
+        while (limit > start && (nl = memrchr(start, '\n', limit - start)) != NULL)
+        {
+            if (emit(&o, nl + 1, rec_end - (nl + 1)) != 0)
+            {
+                rc = -1;
+                break;
+            }
+            rec_end = nl + 1;
+            limit = nl;
+        }
+
+        carry = rec_end - start;
+        memmove(buf + cap - carry, start, carry);
+        pos = off;
+        len = BLOCK_SIZE;
+    }
+
+    // первая строка файла
+    if (rc == 0 && carry > 0)
+        rc = emit(&o, buf + cap - carry, carry);
+    if (flushOutput(&o) != 0)
+        rc = -1;
+
+    free(buf);
+    free(o.buf);
+    return rc;
+}
+
+/* ---------- замеры ---------- */
+
+static double nowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static double cpuMs(void)
+{
+    struct rusage self, kids;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &kids);
+    return (self.ru_utime.tv_sec + self.ru_stime.tv_sec +
+            kids.ru_utime.tv_sec + kids.ru_stime.tv_sec) * 1e3 +
+        (self.ru_utime.tv_usec + self.ru_stime.tv_usec +
+            kids.ru_utime.tv_usec + kids.ru_stime.tv_usec) / 1e3;
+}
+
+// под root сбрасываем кэш страниц, чтобы замер шёл с диска
+static void dropCaches(void)
+{
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd >= 0)
+    {
+        if (write(fd, "3", 1) < 0)
+            perror("drop_caches");
+        close(fd);
+    }
+}
+
+// старый readStringFromFile(): lseek + read + write на каждый байт
+static int legacyReverse(int in, int out, off_t size, off_t limit)
+{
+    for (off_t p = size - 1; p >= 0 && p >= size - limit; --p)
+    {
+        char c;
+        if (lseek(in, p, SEEK_SET) == -1 || read(in, &c, 1) != 1)
+            return -1;
+        write(out, &c, 1);
+    }
+    return 0;
+}
+
+static void report(const char *label, const char *cache, double ms, double cpu, off_t bytes)
+{
+    printf("%-26s %-4s %9.1f ms   cpu %8.1f ms   %8.1f MiB/s\n", label, cache, ms, cpu,
+        bytes / 1048576.0 / (ms / 1e3));
+}
+
+int benchReverse(const char *path)
+{
+    int in = open(path, O_RDONLY);
+    int null = open("/dev/null", O_WRONLY);
+    if (in == -1 || null == -1)
+    {
+        perror(path);
+        return 1;
+    }
+
+    off_t size = lseek(in, 0, SEEK_END);
+    printf("%s: %.1f MiB\n", path, size / 1048576.0);
+
+    // старый способ целиком занял бы часы: меряем хвост и пересчитываем
+    off_t part = size < LEGACY_BYTES ? size : LEGACY_BYTES;
+    double c0 = cpuMs(), t0 = nowMs();
+    legacyReverse(in, null, size, part);
+    double ms = (nowMs() - t0) * size / (part ? part : 1);
+    double cpu = (cpuMs() - c0) * size / (part ? part : 1);
+    report("byte by byte (old, est.)", "warm", ms, cpu, size);
+
+    struct
+    {
+        const char *label;
+        void (*kernel)(char *, size_t);
+        int lines;
+        int cold;
+    } runs[] = {
+        { "bytes, scalar", reverseScalar, 0, 0 },
+#if defined(__x86_64__)
+        { "bytes, ssse3", reverseSsse3, 0, 0 },
+        { "bytes, avx2", reverseAvx2, 0, 0 },
+#endif
+        { "bytes", NULL, 0, 1 },
+        { "lines", NULL, 1, 0 },
+        { "lines", NULL, 1, 1 },
+    };
+
+    void (*best)(char *, size_t) = reverseBlock;
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++)
+    {
+#if defined(__x86_64__)
+        if (runs[i].kernel == reverseAvx2 && !__builtin_cpu_supports("avx2"))
+            continue;
+        if (runs[i].kernel == reverseSsse3 && !__builtin_cpu_supports("ssse3"))
+            continue;
+#endif
+        reverseBlock = runs[i].kernel ? runs[i].kernel : best;
+        if (runs[i].cold)
+            dropCaches();
+
+        c0 = cpuMs();
+        t0 = nowMs();
+        int rc = runs[i].lines ? reverseLines(in, null) : reverseBytes(in, null);
+        ms = nowMs() - t0;
+        cpu = cpuMs() - c0;
+
+        // у строк нет ядра: их ищет memrchr()
+        char label[64];
+        if (runs[i].kernel || runs[i].lines)
+            snprintf(label, sizeof(label), "%s", runs[i].label);
+        else
+            snprintf(label, sizeof(label), "%s, %s", runs[i].label, reverseKernel);
+        report(label, runs[i].cold ? "cold" : "warm", ms, cpu, size);
+        if (rc != 0)
+            perror(label);
+    }
+    reverseBlock = best;
+
+    char cmd[PATH_MAX + 32];
+    snprintf(cmd, sizeof(cmd), "tac '%s' > /dev/null", path);
+    for (int cold = 0; cold <= 1; cold++)
+    {
+        if (cold)
+            dropCaches();
+        c0 = cpuMs();
+        t0 = nowMs();
+        if (system(cmd) != 0)
+            fprintf(stderr, "tac failed\n");
+        report("tac", cold ? "cold" : "warm", nowMs() - t0, cpuMs() - c0, size);
+    }
+
+    close(in);
+    close(null);
     return 0;
 }
 
@@ -9,11 +9,15 @@
  * - starting the main event processing loop
  * - correct termination
  */
+#include <stdlib.h>
 #include <unistd.h>
+#include <poll.h>
 #include "app.h"
 #include "ui.h"
 #include "panel.h"
 #include "dialog.h"
+#include "file_type.h"
+#include "dir_watch.h"
 
 /**
  * @brief Starts the application and the main file manager loop.
@@ -24,7 +28,8 @@
  * - get current directories for panels
  * - configure control buttons
  * - load directory contents
- * - start input processing and rendering loop
+ * - start input processing and rendering loop, which sleeps in poll()
+ *   on the terminal and both directory watches, at most one frame
  * - free resources on exit
  *
  * @return 0 if programme exits correctly.
@@ -43,7 +48,23 @@ int run_app(void)
 
     app.left.entries = NULL;
     app.right.entries = NULL;
+    app.left.count = app.right.count = 0;
+    app.left.capacity = app.right.capacity = 0;
+    app.left.loader = app.right.loader = NULL;
+    app.left.loading = app.right.loading = 0;
+    app.left.types = app.right.types = NULL;
+    app.left.drawn = app.right.drawn = NULL;
+    app.left.drawn_rows = app.right.drawn_rows = 0;
+    app.left.drawn_valid = app.right.drawn_valid = 0;
+    app.left.watch = dir_watch_open();
+    app.right.watch = dir_watch_open();
+    app.left.watching = app.right.watching = 0;
+    app.left.reselect[0] = app.right.reselect[0] = '\0';
+    app.left.filter = app.right.filter = NULL;
+    app.left.sizing = app.right.sizing = NULL;
+    app.left.sizing_entry = app.right.sizing_entry = NULL;
     app.active = 0;
+    app.damaged = 1;
 
     app.button_count = 6;
 
@@ -81,17 +102,33 @@ int run_app(void)
     load_directory(&app.left);
     load_directory(&app.right);
 
+    struct pollfd fds[3] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = dir_watch_fd(app.left.watch), .events = POLLIN },
+        { .fd = dir_watch_fd(app.right.watch), .events = POLLIN },
+    };
+
     int running = 1;
     while(running)
     {
         running = handle_input(&app);
+        panel_poll(&app.left);
+        panel_poll(&app.right);
         draw_ui(&app);
-        napms(16);
+
+        // loaders, size walks and the type worker have no fd: still wake every frame
+        poll(fds, 3, 16);
     }
 
     free_panel(&app.left);
     free_panel(&app.right);
+    free(app.left.drawn);
+    free(app.right.drawn);
+    dir_watch_close(app.left.watch);
+    dir_watch_close(app.right.watch);
     delwin(app.wnd);
     cleanup_curses();
+    file_types_free(&app.left);
+    file_types_free(&app.right);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,1205 @@
+/**
+ * @file bench.c
+ * @brief Benchmarks that run without ncurses.
+ *
+ * kfm.out --bench-load DIR compares the old synchronous scandir() +
+ * alphasort load with the background loader: time until a screenful of
+ * entries is available (first paint) and until the sorted list is in
+ * place.
+ *
+ * kfm.out --bench-redraw DIR scrolls a panel one row per frame and
+ * times the colour lookups of each frame, stat() + libmagic per visible
+ * row (as draw_panel used to) against the cached classifier.
+ *
+ * kfm.out --bench-copy FILE DIR copies FILE into DIR with each copy
+ * engine method and with the old 8 KiB read/write loop, best of three.
+ *
+ * kfm.out --bench-tree SRC DIR copies the tree SRC into DIR and deletes
+ * the copy again, first with the old recursive stat() + readdir() walk
+ * on the calling thread, then with the tree_op pool at one thread and
+ * at its default size.
+ *
+ * kfm.out --bench-tty DIR [PROGRAM] runs the file manager (or PROGRAM)
+ * in DIR on a 200x60 pseudo-terminal, presses keys and counts the bytes
+ * written to the terminal after each one, and the CPU the UI burns
+ * while idle.
+ *
+ * kfm.out --bench-watch DIR loads DIR into a watched panel, then keeps
+ * creating and deleting files in it and times how long the panel takes
+ * to apply each batch, against re-reading the whole directory.
+ *
+ * kfm.out --bench-size DIR adds up the disk usage of DIR with du -s and
+ * with the size walk at one thread and at its default size, cold and
+ * warm, then once more with the size cache filled by the last walk.
+ *
+ * kfm.out --bench-filter [COUNT] types queries into the filter of a
+ * panel holding COUNT made-up names (a million by default) and times
+ * every keystroke, with the vectorised and the plain memmem() search,
+ * against running strcasestr() over every name on each key.
+ *
+ * kfm.out --bench-view FILE opens FILE in the viewer's model: time to
+ * the first screen and to a complete line index (vector and memchr()
+ * scan), against reading the whole file; then random jumps to lines and
+ * to percentages, paging, and a search through the whole file each way.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <dirent.h>
+#include <magic.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "panel.h"
+#include "file_type.h"
+#include "copy_engine.h"
+#include "tree_op.h"
+#include "dir_watch.h"
+#include "dir_loader.h"
+#include "filter.h"
+#include "name_index.h"
+#include "size_cache.h"
+#include "file_view.h"
+
+#define SCREEN_ROWS 50
+#define REDRAW_FRAMES 2000
+#define COPY_RUNS 3
+#define VIEW_JUMPS 10000
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * @brief Runs both loads on @p dir and prints the timings.
+ *
+ * @param dir Directory to read.
+ * @return 0 on success, 1 on error.
+ */
+int bench_load(const char *dir)
+{
+    Panel p;
+    memset(&p, 0, sizeof(p));
+    snprintf(p.cwd, sizeof(p.cwd), "%s", dir);
+    p.h = SCREEN_ROWS + 2;
+
+    // poll every 1 ms; the UI polls once per 16 ms frame
+    struct timespec tick = {0, 1000000};
+    double t_first = -1;
+    double t0 = now_ms();
+    if (load_directory(&p) == -1)
+    {
+        perror(dir);
+        return 1;
+    }
+    while (p.loading)
+    {
+        panel_poll(&p);
+        if (t_first < 0 && (p.count >= SCREEN_ROWS || !p.loading))
+            t_first = now_ms() - t0;
+        if (p.loading)
+            nanosleep(&tick, NULL);
+    }
+    double t_sorted = now_ms() - t0;
+    int loaded = p.count;
+    free_panel(&p);
+
+    // second, so freeing its million allocations cannot slow the loader
+    struct dirent **list;
+    t0 = now_ms();
+    int n = scandir(dir, &list, NULL, alphasort);
+    double t_scandir = now_ms() - t0;
+    if (n < 0)
+    {
+        perror(dir);
+        return 1;
+    }
+    for (int i = 0; i < n; i++)
+        free(list[i]);
+    free(list);
+
+    printf("entries: %d (loader %d)\n", n, loaded);
+    printf("scandir + alphasort:   first paint %9.1f ms   sorted %9.1f ms\n",
+        t_scandir, t_scandir);
+    printf("background getdents64: first paint %9.1f ms   sorted %9.1f ms\n",
+        t_first, t_sorted);
+    return 0;
+}
+
+/**
+ * @brief The per-redraw classification draw_panel used to do.
+ */
+static int legacy_file_color(magic_t cookie, const char *dir, const char *name)
+{
+    char path[PATH_MAX];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", dir, name) >= sizeof(path))
+        return 7;
+
+    struct stat st;
+    if (stat(path, &st) == 0)
+    {
+        if (S_ISDIR(st.st_mode))
+            return 7;
+
+        if (st.st_mode & S_IXUSR)
+            return 3;
+    }
+
+    return color_for_mime(magic_file(cookie, path));
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void report_frames(const char *label, double *ms, int frames)
+{
+    double total = 0;
+    for (int i = 0; i < frames; i++)
+        total += ms[i];
+    qsort(ms, frames, sizeof(double), compare_double);
+    printf("%-22s frames %5d   total %9.1f ms   p50 %8.3f ms   p99 %8.3f ms   max %8.3f ms\n",
+        label, frames, total, ms[frames / 2], ms[(int)(frames * 0.99)], ms[frames - 1]);
+}
+
+/**
+ * @brief Times colour lookups while scrolling @p dir row by row.
+ *
+ * @param dir Directory to scroll through.
+ * @return 0 on success, 1 on error.
+ */
+int bench_redraw(const char *dir)
+{
+    Panel p;
+    memset(&p, 0, sizeof(p));
+    snprintf(p.cwd, sizeof(p.cwd), "%s", dir);
+    p.h = SCREEN_ROWS + 2;
+
+    if (load_directory(&p) == -1)
+    {
+        perror(dir);
+        return 1;
+    }
+    struct timespec tick = {0, 1000000};
+    while (p.loading)
+    {
+        panel_poll(&p);
+        if (p.loading)
+            nanosleep(&tick, NULL);
+    }
+
+    int frames = p.count - SCREEN_ROWS;
+    if (frames > REDRAW_FRAMES)
+        frames = REDRAW_FRAMES;
+    if (frames < 1)
+        frames = 1;
+    double *ms = malloc(frames * sizeof(double));
+    magic_t cookie = magic_open(MAGIC_MIME_TYPE);
+    if (!ms || !cookie)
+        return 1;
+    magic_load(cookie, NULL);
+
+    volatile int sink = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        double t0 = now_ms();
+        for (int i = f; i < f + SCREEN_ROWS && i < p.count; i++)
+            sink += legacy_file_color(cookie, p.cwd, p.entries[i]->d_name);
+        ms[f] = now_ms() - t0;
+    }
+    magic_close(cookie);
+    report_frames("stat + libmagic", ms, frames);
+
+    // same walk twice: first every row is new, then only cache hits and
+    // lookups of results the magic thread has delivered meanwhile
+    file_types_init();
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int f = 0; f < frames; f++)
+        {
+            double t0 = now_ms();
+            for (int i = f; i < f + SCREEN_ROWS && i < p.count; i++)
+                sink += file_type_color(&p, p.entries[i]);
+            ms[f] = now_ms() - t0;
+        }
+        report_frames(pass ? "cached, second pass" : "cached, first pass", ms, frames);
+
+        if (!pass)
+        {
+            // give the magic thread some time, as a user would
+            struct timespec pause = {0, 200000000};
+            nanosleep(&pause, NULL);
+        }
+    }
+    file_types_shutdown();
+    file_types_free(&p);
+
+    free(ms);
+    free_panel(&p);
+    return 0;
+}
+
+/**
+ * @brief The copy loop dialog.c used before the copy engine.
+ */
+static int legacy_copy(const char *src, const char *dst)
+{
+    int in = open(src, O_RDONLY);
+    if (in < 0)
+        return -1;
+
+    struct stat st;
+    fstat(in, &st);
+
+    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, st.st_mode);
+    if (out < 0)
+    {
+        close(in);
+        return -1;
+    }
+
+    char buf[8192];
+    ssize_t r;
+
+    while ((r = read(in, buf, sizeof(buf))) > 0)
+        if (write(out, buf, r) != r)
+            break;
+
+    close(in);
+    close(out);
+    return 0;
+}
+
+static double cpu_ms(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 +
+        (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+/**
+ * @brief Copies @p file into @p dir once per method and prints the timings.
+ *
+ * @param file Source file.
+ * @param dir Destination directory (the copy is removed afterwards).
+ * @return 0 on success, 1 on error.
+ */
+int bench_copy(const char *file, const char *dir)
+{
+    static const int methods[] = {COPY_RANGE, COPY_SENDFILE, COPY_BUFFER, 0, COPY_ALL};
+    char dst[PATH_MAX];
+    snprintf(dst, sizeof(dst), "%s/kfm_bench_copy.tmp", dir);
+
+    struct stat st;
+    if (stat(file, &st) != 0)
+    {
+        perror(file);
+        return 1;
+    }
+    double mb = st.st_size / 1048576.0;
+    printf("%s: %.1f MiB, %.1f MiB allocated\n", file, mb, st.st_blocks * 512 / 1048576.0);
+
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+    {
+        const char *name = methods[i] ? copy_method_name(methods[i]) : "read/write 8 KiB";
+        double best = -1, best_cpu = 0;
+        int used = 0;
+        int ok = 1;
+        struct stat out;
+
+        // best of COPY_RUNS: the first copy after writing the source is noisy
+        for (int run = 0; run < COPY_RUNS && ok; run++)
+        {
+            unlink(dst);
+            double c0 = cpu_ms();
+            double t0 = now_ms();
+            int rc = methods[i] ? copy_file_with(file, dst, methods[i], NULL, NULL, &used)
+                                : legacy_copy(file, dst);
+            double t = now_ms() - t0;
+            double c = cpu_ms() - c0;
+
+            ok = rc == 0 && stat(dst, &out) == 0 && out.st_size == st.st_size;
+            if (ok && (best < 0 || t < best))
+            {
+                best = t;
+                best_cpu = c;
+            }
+        }
+        if (!ok)
+        {
+            printf("%-24s failed\n", name);
+            continue;
+        }
+
+        char label[64];
+        if (methods[i] == COPY_ALL)
+            snprintf(label, sizeof(label), "auto (%s)", copy_method_name(used));
+        else
+            snprintf(label, sizeof(label), "%s", name);
+
+        printf("%-24s %9.1f ms %9.0f MiB/s   cpu %8.1f ms   allocated %.1f MiB\n",
+            label, best, best > 0 ? mb / (best / 1e3) : 0.0, best_cpu,
+            out.st_blocks * 512 / 1048576.0);
+    }
+    unlink(dst);
+    return 0;
+}
+
+/**
+ * @brief The recursive copy/delete dialog.c used before tree_op.
+ */
+static int legacy_tree(const char *src, const char *dst)
+{
+    struct stat st;
+
+    if (stat(src, &st) != 0)
+        return -1;
+
+    if (S_ISDIR(st.st_mode))
+    {
+        if (dst && mkdir(dst, 0755) != 0)
+            return -1;
+
+        DIR *dir = opendir(src);
+        if (!dir)
+            return -1;
+
+        struct dirent *e;
+
+        while ((e = readdir(dir)) != NULL)
+        {
+            if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+                continue;
+
+            char src_path[PATH_MAX];
+            char dst_path[PATH_MAX];
+
+            snprintf(src_path, sizeof(src_path), "%s/%s", src, e->d_name);
+            snprintf(dst_path, sizeof(dst_path), "%s/%s", dst ? dst : "", e->d_name);
+
+            legacy_tree(src_path, dst ? dst_path : NULL);
+        }
+
+        closedir(dir);
+        if (!dst)
+            rmdir(src);
+        return 0;
+    }
+
+    if (dst)
+        return legacy_copy(src, dst);
+    return unlink(src);
+}
+
+/**
+ * @brief Runs one tree_op to the end, polling like the UI does.
+ */
+static int run_op(TreeOpKind kind, const char *src, const char *dst, int threads)
+{
+    TreeOp *op = tree_op_start(kind, src, dst, threads);
+    if (!op)
+        return -1;
+    while (!tree_op_poll(op, NULL))
+        usleep(10000);
+    return tree_op_finish(op);
+}
+
+static long count_entries(const char *path)
+{
+    DIR *dir = opendir(path);
+    if (!dir)
+        return 1;
+
+    long n = 1;
+    struct dirent *e;
+    while ((e = readdir(dir)) != NULL)
+    {
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+            continue;
+        if (e->d_type == DT_DIR)
+        {
+            char sub[PATH_MAX];
+            snprintf(sub, sizeof(sub), "%s/%s", path, e->d_name);
+            n += count_entries(sub);
+        }
+        else
+            n++;
+    }
+    closedir(dir);
+    return n;
+}
+
+/**
+ * @brief Writes back dirty data and, when run as root, drops the caches
+ * so each round starts cold: after a round of 200k creates and deletes
+ * every create in the next one can be several times slower.
+ */
+static void settle(void)
+{
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd >= 0)
+    {
+        if (write(fd, "3", 1) < 0)
+            perror("drop_caches");
+        close(fd);
+    }
+}
+
+/**
+ * @brief Copies @p src into @p dir and deletes the copy, old walk
+ * against the pool, and prints entries per second for each.
+ *
+ * @param src Tree to copy.
+ * @param dir Destination directory, on the filesystem to measure.
+ * @return 0 on success, 1 on error.
+ */
+int bench_tree(const char *src, const char *dir)
+{
+    char dst[PATH_MAX];
+    snprintf(dst, sizeof(dst), "%s/kfm_bench_tree.tmp", dir);
+
+    long entries = count_entries(src);
+    printf("%s: %ld entries\n", src, entries);
+
+    int variants[] = {-1, 1, tree_op_default_threads()};
+
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++)
+    {
+        char label[64];
+        if (variants[i] < 0)
+            snprintf(label, sizeof(label), "recursive (old)");
+        else
+            snprintf(label, sizeof(label), "tree_op %d thread%s",
+                variants[i], variants[i] == 1 ? "" : "s");
+
+        run_op(TREE_DELETE, dst, NULL, 0);
+        settle();
+
+        double c0 = cpu_ms();
+        double t0 = now_ms();
+        int rc = variants[i] < 0 ? legacy_tree(src, dst)
+                                 : run_op(TREE_COPY, src, dst, variants[i]);
+        double copy = now_ms() - t0;
+        double copy_cpu = cpu_ms() - c0;
+        long copied = count_entries(dst);
+
+        settle();
+
+        c0 = cpu_ms();
+        t0 = now_ms();
+        rc |= variants[i] < 0 ? legacy_tree(dst, NULL)
+                              : run_op(TREE_DELETE, dst, NULL, variants[i]);
+        double del = now_ms() - t0;
+        double del_cpu = cpu_ms() - c0;
+
+        struct stat st;
+        int left = lstat(dst, &st) == 0;
+
+        printf("%-20s copy %8.0f ms %8.0f/s cpu %7.0f ms   "
+            "delete %8.0f ms %8.0f/s cpu %7.0f ms%s\n",
+            label, copy, entries / (copy / 1e3), copy_cpu,
+            del, entries / (del / 1e3), del_cpu,
+            rc || copied != entries || left ? "   (FAILED)" : "");
+    }
+    return 0;
+}
+
+#define TTY_ROWS 60
+#define TTY_COLS 200
+#define TTY_QUIET_MS 60
+
+/**
+ * @brief Reads everything the UI writes until it has been quiet for
+ * @p quiet_ms; returns the byte count.
+ */
+static long drain(int fd, int quiet_ms)
+{
+    char buf[65536];
+    long total = 0;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    while (poll(&pfd, 1, quiet_ms) > 0)
+    {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0)
+            break;
+        total += n;
+    }
+    return total;
+}
+
+static double proc_cpu_ms(pid_t pid);
+
+/**
+ * @brief Presses @p key @p times times and prints the mean bytes and
+ * CPU of @p pid per press.
+ */
+static void press(const char *label, int fd, pid_t pid, const char *key, int times)
+{
+    long total = 0;
+    double c0 = proc_cpu_ms(pid);
+
+    for (int i = 0; i < times; i++)
+    {
+        if (write(fd, key, strlen(key)) < 0)
+            return;
+        total += drain(fd, TTY_QUIET_MS);
+    }
+
+    if (label)
+        printf("%-20s %8.0f bytes/key   cpu %6.2f ms/key\n", label,
+            (double)total / times, (proc_cpu_ms(pid) - c0) / times);
+}
+
+/**
+ * @brief CPU time (user + system) of process @p pid in ms, from /proc.
+ */
+static double proc_cpu_ms(pid_t pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+
+    unsigned long utime = 0, stime = 0;
+    int r = fscanf(f, "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+        &utime, &stime);
+    fclose(f);
+    return r == 2 ? (utime + stime) * 1e3 / sysconf(_SC_CLK_TCK) : 0;
+}
+
+/**
+ * @brief Drives the UI on a pseudo-terminal and prints the bytes it
+ * writes per keypress.
+ *
+ * @param dir Directory to start in; needs more than two screens of entries.
+ * @param program File manager binary, NULL for this one.
+ * @return 0 on success, 1 on error.
+ */
+int bench_tty(const char *dir, const char *program)
+{
+    // cursor keys as sent in keypad-transmit mode
+    static const char down[] = "\033OB";
+    static const char up[] = "\033OA";
+    static const char tab[] = "\t";
+
+    struct winsize ws = { .ws_row = TTY_ROWS, .ws_col = TTY_COLS };
+    int fd;
+    pid_t pid = forkpty(&fd, NULL, NULL, &ws);
+    if (pid < 0)
+    {
+        perror("forkpty");
+        return 1;
+    }
+    if (pid == 0)
+    {
+        if (chdir(dir) != 0)
+            _exit(127);
+        setenv("TERM", "xterm-256color", 1);
+        if (program)
+            execl(program, program, (char *)NULL);
+        else
+            execl("/proc/self/exe", "kfm.out", (char *)NULL);
+        _exit(127);
+    }
+
+    long first = drain(fd, 500);
+    int visible = TTY_ROWS - 4 - 2;
+
+    printf("%dx%d terminal, %s\n", TTY_COLS, TTY_ROWS, program ? program : "kfm.out");
+    printf("%-20s %8ld bytes\n", "first paint", first);
+
+    // idle: nothing changes, anything written or burnt is waste
+    double c0 = proc_cpu_ms(pid);
+    long idle = drain(fd, 2000);
+    printf("%-20s %8ld bytes       cpu %6.1f ms\n", "idle 2 s", idle,
+        proc_cpu_ms(pid) - c0);
+
+    press("down, no scroll", fd, pid, down, visible - 2);
+    press("down, scrolling", fd, pid, down, 100);
+    press(NULL, fd, pid, up, visible - 1);
+    press("up, scrolling", fd, pid, up, 50);
+    press("tab (switch panel)", fd, pid, tab, 20);
+
+    if (write(fd, "q", 1) < 0)
+        perror("write");
+    drain(fd, 200);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    close(fd);
+    return 0;
+}
+
+#define WATCH_ROUNDS 200
+#define WATCH_BATCH 16
+
+static void wait_loaded(Panel *p)
+{
+    while (p->loading)
+    {
+        panel_poll(p);
+        if (p->loading)
+            usleep(1000);
+    }
+}
+
+/**
+ * @brief Churns files in @p dir under a watched panel and prints the
+ * time to apply each batch of changes and to re-read the directory.
+ *
+ * @param dir Directory, ideally with many entries; the files the
+ * benchmark creates are removed again.
+ * @return 0 on success, 1 on error or if the panel ends up different
+ * from a fresh read.
+ */
+int bench_watch(const char *dir)
+{
+    Panel p, check;
+    memset(&p, 0, sizeof(p));
+    memset(&check, 0, sizeof(check));
+    snprintf(p.cwd, sizeof(p.cwd), "%s", dir);
+    snprintf(check.cwd, sizeof(check.cwd), "%s", dir);
+    p.h = check.h = SCREEN_ROWS + 2;
+
+    p.watch = dir_watch_open();
+    if (!p.watch)
+    {
+        perror("inotify");
+        return 1;
+    }
+
+    load_directory(&p);
+    wait_loaded(&p);
+
+    // what every change used to cost: a full re-read
+    double t0 = now_ms();
+    load_directory(&p);
+    wait_loaded(&p);
+    double full = now_ms() - t0;
+    int entries = p.count;
+
+    double *ms = malloc(WATCH_ROUNDS * sizeof(double));
+    char path[PATH_MAX];
+    for (int r = 0; r < WATCH_ROUNDS; r++)
+    {
+        for (int i = 0; i < WATCH_BATCH; i++)
+        {
+            snprintf(path, sizeof(path), "%s/kfm_watch_%d_%d.log", dir, r, i);
+            int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0)
+                close(fd);
+            if (r >= 2)
+            {
+                snprintf(path, sizeof(path), "%s/kfm_watch_%d_%d.log", dir, r - 2, i);
+                unlink(path);
+            }
+        }
+
+        t0 = now_ms();
+        panel_poll(&p);
+        ms[r] = now_ms() - t0;
+    }
+
+    for (int r = WATCH_ROUNDS - 2; r < WATCH_ROUNDS; r++)
+        for (int i = 0; i < WATCH_BATCH; i++)
+        {
+            snprintf(path, sizeof(path), "%s/kfm_watch_%d_%d.log", dir, r, i);
+            unlink(path);
+        }
+    panel_poll(&p);
+
+    // the panel must now match the directory exactly
+    load_directory(&check);
+    wait_loaded(&check);
+    int same = p.count == check.count;
+    for (int i = 0; same && i < p.count; i++)
+        same = strcmp(p.entries[i]->d_name, check.entries[i]->d_name) == 0;
+
+    printf("%s: %d entries\n", dir, entries);
+    printf("full re-read                %9.2f ms\n", full);
+    printf("%d changes per batch (create %d, delete %d), %d batches:\n",
+        2 * WATCH_BATCH, WATCH_BATCH, WATCH_BATCH, WATCH_ROUNDS);
+    report_frames("incremental apply", ms, WATCH_ROUNDS);
+    printf("panel matches a fresh read: %s\n", same ? "yes" : "NO");
+
+    free(ms);
+    free_panel(&p);
+    free_panel(&check);
+    file_types_free(&p);
+    file_types_free(&check);
+    dir_watch_close(p.watch);
+    return same ? 0 : 1;
+}
+
+#define FILTER_NAMES 1000000
+
+static const char *filter_queries[] = {
+    "img_2024", "report fin", "backup.tar", "e", "zzqx", ".jpg 07",
+};
+
+/**
+ * @brief Makes @p count plausible file names, sorted like a panel.
+ */
+static struct dirent **make_names(int count)
+{
+    static const char *words[] = {
+        "IMG", "img", "report", "Report", "backup", "draft", "invoice",
+        "notes", "photo", "scan", "final", "data", "export", "Meeting",
+    };
+    static const char *exts[] = {
+        ".jpg", ".png", ".txt", ".pdf", ".tar.gz", ".log", ".c", ".md",
+    };
+    int nwords = sizeof(words) / sizeof(words[0]);
+    int nexts = sizeof(exts) / sizeof(exts[0]);
+
+    struct dirent **entries = malloc(count * sizeof(*entries));
+    if (!entries)
+        return NULL;
+
+    unsigned seed = 12345;
+    for (int i = 0; i < count; i++)
+    {
+        char name[NAME_MAX + 1];
+        seed = seed * 1103515245 + 12345;
+        unsigned r = seed >> 8;
+        int n = snprintf(name, sizeof(name), "%s_%04u%02u%02u_%s_%06d%s",
+            words[r % nwords], 2015 + r / 7 % 11, 1 + r / 77 % 12,
+            1 + r / 924 % 28, words[r / 25872 % nwords], i,
+            exts[r / 362208 % nexts]);
+
+        struct dirent *e = malloc(offsetof(struct dirent, d_name) + n + 1);
+        if (!e)
+            return NULL;
+        memset(e, 0, offsetof(struct dirent, d_name));
+        e->d_type = DT_REG;
+        memcpy(e->d_name, name, n + 1);
+        entries[i] = e;
+    }
+    qsort(entries, count, sizeof(*entries), dir_entry_compare);
+    return entries;
+}
+
+/**
+ * @brief What a straightforward filter does on every key: test each
+ * name against each word of the query with strcasestr().
+ */
+static int naive_filter(struct dirent **entries, int count, const char *query)
+{
+    char words[NAME_MAX + 1];
+    int matches = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(words, sizeof(words), "%s", query);
+        char *save, *w;
+        int ok = 1;
+        for (w = strtok_r(words, " ", &save); ok && w; w = strtok_r(NULL, " ", &save))
+            ok = strcasestr(entries[i]->d_name, w) != NULL;
+        matches += ok;
+    }
+    return matches;
+}
+
+/**
+ * @brief Types every query into the filter of @p p, then erases it,
+ * timing each key.
+ *
+ * @return Keys pressed; their times are in @p ms.
+ */
+static int type_queries(Panel *p, double *ms, int *matches)
+{
+    int keys = 0;
+    int nq = sizeof(filter_queries) / sizeof(filter_queries[0]);
+
+    for (int q = 0; q < nq; q++)
+    {
+        const char *query = filter_queries[q];
+        filter_start(p);
+        for (const char *c = query; *c; c++)
+        {
+            double t0 = now_ms();
+            filter_append(p, *c);
+            ms[keys++] = now_ms() - t0;
+        }
+        matches[q] = p->count;
+        for (size_t i = 0; i < strlen(query); i++)
+        {
+            double t0 = now_ms();
+            filter_backspace(p);
+            ms[keys++] = now_ms() - t0;
+        }
+        filter_end(p, 0);
+    }
+    return keys;
+}
+
+/**
+ * @brief Times type-to-filter on @p count generated names.
+ *
+ * @param count Number of names, FILTER_NAMES if 0 or less.
+ * @return 0 on success, 1 on error or if the searches disagree.
+ */
+int bench_filter(int count)
+{
+    if (count <= 0)
+        count = FILTER_NAMES;
+
+    struct dirent **names = make_names(count);
+    if (!names)
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    Panel p;
+    memset(&p, 0, sizeof(p));
+    p.entries = names;
+    p.count = p.capacity = count;
+    p.h = SCREEN_ROWS + 2;
+
+    int nq = sizeof(filter_queries) / sizeof(filter_queries[0]);
+    int keys = 0;
+    for (int q = 0; q < nq; q++)
+        keys += 2 * strlen(filter_queries[q]);
+
+    double *ms = malloc(keys * sizeof(double));
+    int fast[nq], plain[nq];
+
+    double t0 = now_ms();
+    NameIndex *ix = name_index_build(names, count);
+    double build = now_ms() - t0;
+    name_index_free(ix);
+
+    printf("%d names, index build %.1f ms (once per '/')\n", count, build);
+
+    char label[32];
+    snprintf(label, sizeof(label), "filter, %s", name_index_method());
+    type_queries(&p, ms, fast);
+    report_frames(label, ms, keys);
+
+    name_index_force_scalar(1);
+    type_queries(&p, ms, plain);
+    report_frames("filter, memmem", ms, keys);
+    name_index_force_scalar(0);
+
+    // the old way recomputes everything on each key, erasing included
+    int same = 1;
+    int k = 0;
+    for (int q = 0; q < nq; q++)
+    {
+        const char *query = filter_queries[q];
+        size_t len = strlen(query);
+        char prefix[NAME_MAX + 1];
+        int found = 0;
+        for (size_t i = 1; i <= len; i++)
+        {
+            snprintf(prefix, sizeof(prefix), "%.*s", (int)i, query);
+            t0 = now_ms();
+            found = naive_filter(names, count, prefix);
+            ms[k++] = now_ms() - t0;
+        }
+        for (size_t i = len; i > 0; i--)
+        {
+            snprintf(prefix, sizeof(prefix), "%.*s", (int)(i - 1), query);
+            t0 = now_ms();
+            naive_filter(names, count, prefix);
+            ms[k++] = now_ms() - t0;
+        }
+        same = same && found == fast[q] && found == plain[q];
+        printf("  \"%s\": %d matches\n", query, fast[q]);
+    }
+    report_frames("strcasestr every key", ms, keys);
+    printf("searches agree: %s\n", same ? "yes" : "NO");
+
+    free(ms);
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+    return same ? 0 : 1;
+}
+
+/**
+ * @brief CPU time of this process and its waited-for children (du).
+ */
+static double cpu_with_children_ms(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_CHILDREN, &ru);
+    return cpu_ms() + (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 +
+        (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+/**
+ * @brief Runs du -s on @p dir; returns its total in bytes, 0 on error.
+ */
+static uint64_t du_bytes(const char *dir)
+{
+    char cmd[PATH_MAX + 32];
+    snprintf(cmd, sizeof(cmd), "du -s -B1 '%s'", dir);
+
+    FILE *f = popen(cmd, "r");
+    if (!f)
+        return 0;
+    unsigned long long bytes = 0;
+    if (fscanf(f, "%llu", &bytes) != 1)
+        bytes = 0;
+    pclose(f);
+    return bytes;
+}
+
+/**
+ * @brief Sizes @p dir with the tree_op pool, polling like the panel.
+ */
+static uint64_t walk_bytes(const char *dir, int threads)
+{
+    TreeProgress progress = { 0 };
+    TreeOp *op = tree_op_start(TREE_SIZE, dir, NULL, threads);
+    if (!op)
+        return 0;
+    while (!tree_op_poll(op, &progress))
+        usleep(1000);
+    tree_op_poll(op, &progress);
+    tree_op_finish(op);
+    return progress.bytes_done;
+}
+
+/**
+ * @brief Times du -s against the size walk on @p dir.
+ *
+ * @param dir Tree to size, ideally large and with some hard links.
+ * @return 0 on success, 1 on error or if the totals disagree.
+ */
+int bench_size(const char *dir)
+{
+    struct
+    {
+        const char *label;
+        int threads; /* 0: du */
+        int cold;
+        int keep_cache;
+    } runs[] = {
+        { "du -s", 0, 1, 0 },
+        { "size walk", 1, 1, 0 },
+        { "size walk", tree_op_default_threads(), 1, 0 },
+        { "du -s", 0, 0, 0 },
+        { "size walk", 1, 0, 0 },
+        { "size walk", tree_op_default_threads(), 0, 0 },
+        { "size walk, cached", tree_op_default_threads(), 0, 1 },
+    };
+
+    long entries = count_entries(dir);
+    printf("%s: %ld entries\n", dir, entries);
+
+    uint64_t expect = 0;
+    int same = 1;
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++)
+    {
+        if (runs[i].cold)
+            settle();
+        if (!runs[i].keep_cache)
+            size_cache_clear();
+
+        double c0 = cpu_with_children_ms();
+        double t0 = now_ms();
+        uint64_t bytes = runs[i].threads ? walk_bytes(dir, runs[i].threads) : du_bytes(dir);
+        double ms = now_ms() - t0;
+        double cpu = cpu_with_children_ms() - c0;
+
+        if (i == 0)
+            expect = bytes;
+        same = same && bytes == expect;
+
+        char label[64];
+        if (runs[i].threads)
+            snprintf(label, sizeof(label), "%s, %d thread%s", runs[i].label,
+                runs[i].threads, runs[i].threads == 1 ? "" : "s");
+        else
+            snprintf(label, sizeof(label), "%s", runs[i].label);
+
+        printf("%-28s %-4s %9.1f ms   cpu %8.1f ms   %llu bytes%s\n", label,
+            runs[i].cold ? "cold" : "warm", ms, cpu, (unsigned long long)bytes,
+            bytes == expect ? "" : "   (DIFFERS)");
+    }
+    printf("totals agree with du: %s\n", same ? "yes" : "NO");
+    return same ? 0 : 1;
+}
+
+/**
+ * @brief Reads all of @p file the way an editor loads it; returns the
+ * byte count, -1 on error.
+ */
+static long long read_whole(const char *file)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    static char buf[1 << 20];
+    long long total = 0;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        total += n;
+    close(fd);
+    return n < 0 ? -1 : total;
+}
+
+/**
+ * @brief Opens @p file, waits for the whole line index and prints how
+ * long each step took.
+ *
+ * @return The number of lines, 0 on error.
+ */
+static uint64_t time_index(const char *file, int cold)
+{
+    if (cold)
+        settle();
+
+    double t0 = now_ms();
+    FileView *v = file_view_open(file);
+    if (!v)
+    {
+        perror(file);
+        return 0;
+    }
+    double opened = now_ms() - t0;
+
+    // first screen: the lines a terminal of SCREEN_ROWS shows
+    uint64_t off = 0;
+    for (int i = 0; i < SCREEN_ROWS; i++)
+        off = file_view_next_line(v, off);
+    double first = now_ms() - t0;
+
+    file_view_wait(v, -1);
+    double indexed = now_ms() - t0;
+
+    FileViewProgress pr;
+    file_view_progress(v, &pr);
+    file_view_close(v);
+
+    char label[32];
+    snprintf(label, sizeof(label), "index, %s", file_view_method());
+    printf("%-16s %-4s open %7.3f ms   first screen %7.3f ms   all lines %9.1f ms  %6.2f GB/s   %llu lines\n",
+        label, cold ? "cold" : "warm", opened, first, indexed,
+        pr.bytes / indexed / 1e6, (unsigned long long)pr.lines);
+    return pr.lines;
+}
+
+/**
+ * @brief Times the viewer's model on @p file: opening, indexing, jumps,
+ * paging and searches.
+ *
+ * @param file A large text file, a log for instance.
+ * @return 0 on success, 1 on error or if the indexes disagree.
+ */
+int bench_view(const char *file)
+{
+    settle();
+    double t0 = now_ms();
+    long long bytes = read_whole(file);
+    double ms = now_ms() - t0;
+    if (bytes < 0)
+    {
+        perror(file);
+        return 1;
+    }
+    printf("%s: %lld bytes\n", file, bytes);
+    printf("%-16s cold %9.1f ms  %6.2f GB/s (what loading it into an editor costs)\n",
+        "read whole file", ms, bytes / ms / 1e6);
+
+    uint64_t lines = time_index(file, 1);
+    if (!lines)
+        return 1;
+    time_index(file, 0);
+
+    file_view_force_scalar(1);
+    uint64_t plain = time_index(file, 0);
+    file_view_force_scalar(0);
+
+    FileView *v = file_view_open(file);
+    if (!v)
+        return 1;
+    file_view_wait(v, -1);
+    uint64_t size = file_view_size(v);
+    const char *data = file_view_data(v);
+
+    // random line jumps; every one must land on a line start whose
+    // number comes back unchanged
+    double *times = malloc(VIEW_JUMPS * sizeof(double));
+    int same = plain == lines;
+    srand(1);
+    for (int i = 0; i < VIEW_JUMPS; i++)
+    {
+        uint64_t line = ((uint64_t)rand() << 31 | rand()) % lines;
+        uint64_t off = 0, back = 0;
+        t0 = now_ms();
+        file_view_line_offset(v, line, &off);
+        times[i] = now_ms() - t0;
+        file_view_line_number(v, off, &back);
+        same = same && back == line && (off == 0 || data[off - 1] == '\n');
+    }
+    report_frames("jump to line", times, VIEW_JUMPS);
+
+    for (int i = 0; i < VIEW_JUMPS; i++)
+    {
+        uint64_t off = ((uint64_t)rand() << 31 | rand()) % size;
+        uint64_t line;
+        t0 = now_ms();
+        off = file_view_line_start(v, off);
+        file_view_line_number(v, off, &line);
+        times[i] = now_ms() - t0;
+    }
+    report_frames("jump to percent", times, VIEW_JUMPS);
+
+    // paging down from a random place, one screen per frame
+    uint64_t top = file_view_line_start(v, size / 3);
+    for (int i = 0; i < VIEW_JUMPS; i++)
+    {
+        t0 = now_ms();
+        for (int r = 0; r < SCREEN_ROWS && top < size; r++)
+            top = file_view_next_line(v, top);
+        times[i] = now_ms() - t0;
+    }
+    report_frames("page down", times, VIEW_JUMPS);
+    free(times);
+
+    // a needle that is not there: the whole file, a step at a time
+    const char *needle = "kfm-bench-no-such-text";
+    for (int backward = 0; backward < 2; backward++)
+    {
+        uint64_t at = backward ? size : 0;
+        int steps = 0;
+        int r;
+        t0 = now_ms();
+        while ((r = file_view_search(v, needle, strlen(needle), at, backward, &at)) == FILE_VIEW_MORE)
+            steps++;
+        ms = now_ms() - t0;
+        printf("%-16s warm %9.1f ms  %6.2f GB/s   %d steps%s\n",
+            backward ? "search backward" : "search forward", ms, size / ms / 1e6,
+            steps + 1, r == FILE_VIEW_NOT_FOUND ? "" : "   (FOUND?)");
+        same = same && r == FILE_VIEW_NOT_FOUND;
+    }
+
+    file_view_close(v);
+    printf("indexes agree: %s\n", same ? "yes" : "NO");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,323 @@
+/**
+ * @file copy_engine.c
+ * @brief File copy with the fastest method the filesystems allow.
+ *
+ * Responsible for:
+ * - reflinking with FICLONE where the filesystem shares extents
+ * - otherwise copying in the kernel (copy_file_range, then sendfile)
+ * - falling back to large aligned buffers with full-write loops
+ * - preallocating dense destinations, keeping holes in sparse ones
+ * - progress reporting
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#include "copy_engine.h"
+
+#define COPY_CHUNK (64L << 20)
+#define BUFFER_SIZE (1 << 20)
+#define BUFFER_ALIGN 4096
+
+/**
+ * @brief Returns a printable name for one COPY_* method.
+ */
+const char *copy_method_name(int method)
+{
+    switch (method)
+    {
+        case COPY_CLONE: return "FICLONE";
+        case COPY_RANGE: return "copy_file_range";
+        case COPY_SENDFILE: return "sendfile";
+        case COPY_BUFFER: return "buffer";
+        default: return "none";
+    }
+}
+
+/**
+ * @brief True for errors meaning "this method does not work here".
+ */
+static int unsupported(int err)
+{
+    return err == ENOSYS || err == EOPNOTSUPP || err == EXDEV ||
+        err == EINVAL || err == ENOTTY || err == EBADF;
+}
+
+/**
+ * @brief Calls the progress callback; -1 with ECANCELED if it asks to stop.
+ */
+static int report(copy_progress_fn progress, void *arg, off_t done, off_t total)
+{
+    if (progress && progress(done, total, arg) != 0)
+    {
+        errno = ECANCELED;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies [off, off + len) with the buffer method.
+ */
+static int copy_buffered(int in, int out, off_t off, off_t len, char **buf,
+    copy_progress_fn progress, void *arg, off_t *done, off_t total)
+{
+    if (!*buf && posix_memalign((void **)buf, BUFFER_ALIGN, BUFFER_SIZE) != 0)
+    {
+        *buf = NULL;
+        return -1;
+    }
+
+    while (len > 0)
+    {
+        ssize_t r = pread(in, *buf, len < BUFFER_SIZE ? (size_t)len : BUFFER_SIZE, off);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (r == 0)
+            break;
+
+        for (ssize_t w = 0; w < r;)
+        {
+            ssize_t n = pwrite(out, *buf + w, r - w, off + w);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            w += n;
+        }
+
+        off += r;
+        len -= r;
+        *done += r;
+        if (report(progress, arg, *done, total) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies one data segment, downgrading *method on "unsupported".
+ */
+static int copy_segment(int in, int out, off_t off, off_t len, int *method,
+    int methods, char **buf, copy_progress_fn progress, void *arg,
+    off_t *done, off_t total)
+{
+    while (len > 0)
+    {
+        ssize_t n;
+
+        if (*method == COPY_RANGE)
+        {
+            loff_t off_in = off, off_out = off;
+            n = copy_file_range(in, &off_in, out, &off_out,
+                len < COPY_CHUNK ? (size_t)len : COPY_CHUNK, 0);
+        }
+        else if (*method == COPY_SENDFILE)
+        {
+            off_t off_in = off;
+            if (lseek(out, off, SEEK_SET) < 0)
+                return -1;
+            n = sendfile(out, in, &off_in, len < COPY_CHUNK ? (size_t)len : COPY_CHUNK);
+        }
+        else
+        {
+            return copy_buffered(in, out, off, len, buf, progress, arg, done, total);
+        }
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // nothing written by this method yet at this offset: try the next one
+            if (!unsupported(errno))
+                return -1;
+            int next = *method << 1;
+            while (next <= COPY_BUFFER && !(methods & next))
+                next <<= 1;
+            if (next > COPY_BUFFER)
+                return -1;
+            *method = next;
+            continue;
+        }
+        if (n == 0)
+            break;
+
+        off += n;
+        len -= n;
+        *done += n;
+        if (report(progress, arg, *done, total) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies an open regular file using only the methods in @p methods.
+ *
+ * @param in Source, opened for reading.
+ * @param out Destination, opened for writing and empty.
+ * @param st fstat() of @p in.
+ * @param methods Mask of COPY_* methods allowed.
+ * @param progress Optional progress callback.
+ * @param arg Passed to @p progress.
+ * @param used Optional, set to the method that copied the last bytes.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int copy_fd_with(int in, int out, const struct stat *st, int methods,
+    copy_progress_fn progress, void *arg, int *used)
+{
+    off_t total = st->st_size;
+    off_t done = 0;
+    int rc = 0;
+    int method = 0;
+    char *buf = NULL;
+
+    if ((methods & COPY_CLONE) && total > 0 && ioctl(out, FICLONE, in) == 0)
+    {
+        method = COPY_CLONE;
+        done = total;
+        rc = report(progress, arg, done, total);
+        goto out;
+    }
+
+    method = COPY_RANGE;
+    while (method <= COPY_BUFFER && !(methods & method))
+        method <<= 1;
+    if (method > COPY_BUFFER)
+    {
+        errno = EINVAL;
+        rc = -1;
+        goto out;
+    }
+
+    // fewer allocated blocks than the size says: keep the holes
+    int sparse = (off_t)st->st_blocks * 512 < total;
+
+    if (sparse)
+    {
+        if (ftruncate(out, total) < 0)
+        {
+            rc = -1;
+            goto out;
+        }
+    }
+    // small files fit one extent anyway: not worth a syscall each
+    else if (total >= BUFFER_SIZE && fallocate(out, 0, 0, total) < 0 &&
+        errno != EOPNOTSUPP && errno != ENOSYS)
+    {
+        rc = -1;
+        goto out;
+    }
+
+    off_t off = 0;
+    while (off < total)
+    {
+        off_t data = off, hole = total;
+
+        if (sparse)
+        {
+            data = lseek(in, off, SEEK_DATA);
+            if (data < 0)
+            {
+                if (errno == ENXIO)
+                    break;      // only a hole is left
+                data = off;     // no SEEK_DATA here: copy everything
+                sparse = 0;
+            }
+            else
+            {
+                hole = lseek(in, data, SEEK_HOLE);
+                if (hole < 0)
+                    hole = total;
+            }
+            done += data - off;
+        }
+
+        if (copy_segment(in, out, data, hole - data, &method, methods,
+                &buf, progress, arg, &done, total) < 0)
+        {
+            rc = -1;
+            goto out;
+        }
+        off = hole;
+    }
+
+    done = total;
+    rc = report(progress, arg, done, total);
+
+out:
+    if (used)
+        *used = method;
+    free(buf);
+    return rc;
+}
+
+/**
+ * @brief Copies a regular file using only the methods in @p methods.
+ *
+ * @param src Source file.
+ * @param dst Destination file, created or truncated with the source mode.
+ * @param methods Mask of COPY_* methods allowed.
+ * @param progress Optional progress callback.
+ * @param arg Passed to @p progress.
+ * @param used Optional, set to the method that copied the last bytes.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int copy_file_with(const char *src, const char *dst, int methods,
+    copy_progress_fn progress, void *arg, int *used)
+{
+    int in = open(src, O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(in, &st) < 0)
+    {
+        close(in);
+        return -1;
+    }
+
+    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode);
+    if (out < 0)
+    {
+        close(in);
+        return -1;
+    }
+
+    int rc = copy_fd_with(in, out, &st, methods, progress, arg, used);
+
+    close(in);
+    if (close(out) < 0)
+        rc = -1;
+    return rc;
+}
+
+/**
+ * @brief Copies a regular file with the fastest method that works.
+ *
+ * @param src Source file.
+ * @param dst Destination file.
+ * @param progress Optional progress callback.
+ * @param arg Passed to @p progress.
+ * @return 0 on success, -1 on error.
+ */
+int copy_file_fast(const char *src, const char *dst,
+    copy_progress_fn progress, void *arg)
+{
+    return copy_file_with(src, dst, COPY_ALL, progress, arg, NULL);
+}
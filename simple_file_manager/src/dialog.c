@@ -7,7 +7,7 @@
  * - deletion
  * - copying
  * - moving
- * - opening files
+ * - opening files, in the viewer or in an editor
  */
 #define _GNU_SOURCE
 
@@ -22,22 +22,15 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <time.h>
 
 #include "dialog.h"
 #include "panel.h"
 #include "ui.h"
 #include "modal.h"
-
-/**
- * @enum Operation
- * @brief File operation type.
- */
-typedef enum
-{
-    OP_COPY, /**< Copy */
-    OP_DELETE, /**< Delete */
-    OP_MOVE /**< Move */
-} Operation;
+#include "tree_op.h"
+#include "viewer.h"
 
 void create_directory_dialog(App *app);
 void delete_directory_dialog(App *app);
@@ -45,8 +38,8 @@ void copy_dialog(App *app);
 void open_file_dialog(App *app);
 void move_dialog(App *app);
 
-static int process_tree(const char *src, const char *dst, Operation op);
-static int copy_file(const char *src, const char *dst);
+static int run_tree_op(App *app, const char *title, TreeOpKind kind,
+    const char *src, const char *dst);
 static char *build_path_alloc(const char *dir, const char *name);
 
 /**
@@ -74,43 +67,7 @@ void create_directory_dialog(App *app)
 
     free(fullpath);
 
-    load_directory(p);
-}
-
-/**
- * @brief Copies a file block by block.
- *
- * Uses open(), read(), write().
- *
- * @param src Source file.
- * @param dst Destination file.
- * @return 0 on success, -1 on error.
- */
-static int copy_file(const char *src, const char *dst)
-{
-    int in = open(src, O_RDONLY);
-    if (in < 0)
-        return -1;
-
-    struct stat st;
-    fstat(in, &st);
-
-    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, st.st_mode);
-    if (out < 0)
-    {
-        close(in);
-        return -1;
-    }
-
-    char buf[8192];
-    ssize_t r;
-
-    while ((r = read(in, buf, sizeof(buf))) > 0)
-        write(out, buf, r);
-
-    close(in);
-    close(out);
-    return 0;
+    panel_refresh(p);
 }
 
 /**
@@ -150,12 +107,12 @@ void copy_dialog(App *app)
         return;
     }
 
-    process_tree(src_path, dst_path, OP_COPY);
+    run_tree_op(app, "Copying", TREE_COPY, src_path, dst_path);
 
     free(src_path);
     free(dst_path);
 
-    load_directory(dst);
+    panel_refresh(dst);
 }
 
 /**
@@ -205,172 +162,179 @@ void delete_directory_dialog(App *app)
         return;
     }
 
-    process_tree(path, NULL, OP_DELETE);
+    run_tree_op(app, "Deleting", TREE_DELETE, path, NULL);
 
     free(path);
 
-    load_directory(p);
+    panel_refresh(p);
+}
+
+#define PROGRESS_DELAY_MS 150
+#define PROGRESS_W 60
+#define PROGRESS_H 9
+
+static long elapsed_ms(const struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 +
+        (now.tv_nsec - since->tv_nsec) / 1000000;
 }
 
 /**
- * @brief Recursive processing of the file tree.
+ * @brief Draws the progress window: counters, a bar and one button.
+ */
+static void draw_progress(WINDOW *win, const char *title,
+    const TreeProgress *pr, const char *status, const char *button)
+{
+    werase(win);
+    box(win, 0, 0);
+
+    int title_x = (PROGRESS_W - (int)strlen(title)) / 2;
+    mvwprintw(win, 1, title_x > 1 ? title_x : 1, "%s", title);
+
+    mvwprintw(win, 3, 2, "%llu of %llu%s entries, %.1f MiB",
+        (unsigned long long)pr->entries_done,
+        (unsigned long long)pr->entries_total,
+        pr->scanning ? "+" : "", pr->bytes_done / 1048576.0);
+
+    int width = PROGRESS_W - 11;
+    int pct = pr->entries_total ? (int)(pr->entries_done * 100 / pr->entries_total) : 0;
+    int fill = width * pct / 100;
+    mvwaddch(win, 4, 2, '[');
+    for (int i = 0; i < width; i++)
+        waddch(win, i < fill ? '#' : ' ');
+    wprintw(win, "] %3d%%", pct);
+
+    if (status)
+        mvwprintw(win, 5, 2, "%.*s", PROGRESS_W - 4, status);
+
+    int button_x = (PROGRESS_W - (int)strlen(button) - 4) / 2;
+    wattron(win, COLOR_PAIR(2));
+    mvwprintw(win, PROGRESS_H - 2, button_x, "[ %s ]", button);
+    wattroff(win, COLOR_PAIR(2));
+
+    wrefresh(win);
+}
+
+/**
+ * @brief Runs a tree operation with a progress window.
  *
- * Performs copying, deletion, or moving
- * depending on the value of op.
+ * The work happens on the tree_op pool; this loop only polls its
+ * counters and the keyboard. Esc, Enter or a click on the button
+ * cancels. The window appears only if the operation is still running
+ * after PROGRESS_DELAY_MS, so renames and small copies do not flash
+ * it, and stays up with the first error if anything failed.
  *
+ * @param app Pointer to the application.
+ * @param title Window title.
+ * @param kind Operation.
  * @param src Source path.
- * @param dst Destination path (can be NULL for deletion).
- * @param op Type of operation.
- * @return 0 on success, -1 on error.
+ * @param dst Destination path (NULL for deletion).
+ * @return 0 on success, -1 on error or cancel.
  */
-static int process_tree(const char *src, const char *dst, Operation op)
+static int run_tree_op(App *app, const char *title, TreeOpKind kind,
+    const char *src, const char *dst)
 {
-    struct stat st;
-
-    if (stat(src, &st) != 0)
-        return -1;
-
-    if (op == OP_MOVE)
-    {
-        if (!dst)
-            return -1;
-
-        if (strcmp(src, dst) == 0)
-            return 0;
-
-        if (rename(src, dst) == 0)
-            return 0;
-
-
-        if (S_ISDIR(st.st_mode))
-        {
-            if (mkdir(dst, 0755) != 0)
-                return -1;
-
-            DIR *dir = opendir(src);
-            if (!dir)
-                return -1;
-
-            struct dirent *e;
-
-            while ((e = readdir(dir)) != NULL)
-            {
-                if (!strcmp(e->d_name, ".") ||
-                    !strcmp(e->d_name, ".."))
-                    continue;
+    TreeProgress pr = {0};
+    TreeOp *op = tree_op_start(kind, src, dst, 0);
+    int err = op ? 0 : errno;
 
-                char src_path[PATH_MAX];
-                char dst_path[PATH_MAX];
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-                snprintf(src_path, sizeof(src_path), "%s/%s", 
-                src, e->d_name);
+    WINDOW *win = NULL;
+    int cancelled = 0;
+    int startx = (app->cols - PROGRESS_W) / 2;
+    int starty = (app->rows - PROGRESS_H) / 2;
 
+    mmask_t old_mask;
+    mousemask(BUTTON1_RELEASED, &old_mask);
 
-                snprintf(dst_path, sizeof(dst_path), "%s/%s", 
-                dst, e->d_name);
-
-                process_tree(src_path, dst_path, OP_MOVE);
-            }
-
-            closedir(dir);
-
-            rmdir(src);
-            return 0;
-        }
-        else
+    while (op && !tree_op_poll(op, &pr))
+    {
+        if (!win)
         {
-            if (copy_file(src, dst) == 0)
+            if (elapsed_ms(&start) < PROGRESS_DELAY_MS)
             {
-                unlink(src);
-                return 0;
+                napms(5);
+                continue;
             }
-
-            return -1;
+            win = newwin(PROGRESS_H, PROGRESS_W, starty > 0 ? starty : 0,
+                startx > 0 ? startx : 0);
+            keypad(win, TRUE);
+            wtimeout(win, 100);
         }
-    }
 
-    if (op == OP_COPY)
-    {
-        if (S_ISDIR(st.st_mode))
-        {
-            if (mkdir(dst, 0755) != 0)
-                return -1;
+        draw_progress(win, title, &pr, cancelled ? "Cancelling..." : NULL, "Cancel");
 
-            DIR *dir = opendir(src);
-            if (!dir)
-                return -1;
+        wint_t ch;
+        int r = wget_wch(win, &ch);
+        if (r == ERR)
+            continue;
 
-            struct dirent *e;
-
-            while ((e = readdir(dir)) != NULL)
-            {
-                if (!strcmp(e->d_name, ".") ||
-                    !strcmp(e->d_name, ".."))
-                    continue;
-
-                char src_path[PATH_MAX];
-                char dst_path[PATH_MAX];
-
-                snprintf(src_path, sizeof(src_path), "%s/%s", 
-                src, e->d_name);
-
-                snprintf(dst_path, sizeof(dst_path), "%s/%s", 
-                dst, e->d_name);
-
-                process_tree(src_path, dst_path, OP_COPY);
-            }
-
-            closedir(dir);
-            return 0;
+        if (r == KEY_CODE_YES && ch == KEY_MOUSE)
+        {
+            MEVENT e;
+            if (getmouse(&e) == OK && e.y == starty + PROGRESS_H - 2)
+                ch = 10;
         }
-        else
+
+        if (ch == 27 || ch == 10)
         {
-            return copy_file(src, dst);
+            tree_op_cancel(op);
+            cancelled = 1;
         }
     }
 
-    if (op == OP_DELETE)
+    if (op)
     {
-        if (S_ISDIR(st.st_mode))
-        {
-            DIR *dir = opendir(src);
-            if (!dir)
-                return -1;
-
-            struct dirent *e;
-
-            while ((e = readdir(dir)) != NULL)
-            {
-                if (!strcmp(e->d_name, ".") ||
-                    !strcmp(e->d_name, ".."))
-                    continue;
-
-                char path[PATH_MAX];
-
-                snprintf(path, sizeof(path), "%s/%s", src, e->d_name);
-
-                process_tree(path, NULL, OP_DELETE);
-            }
+        tree_op_poll(op, &pr);
+        if (tree_op_finish(op) < 0)
+            err = errno;
+    }
 
-            closedir(dir);
-            rmdir(src);
-        }
+    if (err && err != ECANCELED)
+    {
+        char status[128];
+        if (pr.errors > 1)
+            snprintf(status, sizeof(status), "%llu errors, first: %s",
+                (unsigned long long)pr.errors, strerror(err));
         else
+            snprintf(status, sizeof(status), "Error: %s", strerror(err));
+
+        if (!win)
         {
-            unlink(src);
+            win = newwin(PROGRESS_H, PROGRESS_W, starty > 0 ? starty : 0,
+                startx > 0 ? startx : 0);
+            keypad(win, TRUE);
         }
-
-        return 0;
+        wtimeout(win, -1);
+        draw_progress(win, title, &pr, status, "OK");
+
+        wint_t ch;
+        int r;
+        do
+            r = wget_wch(win, &ch);
+        while (r == ERR || (ch != 27 && ch != 10 && ch != KEY_MOUSE));
     }
 
-    return -1;
+    mousemask(old_mask, NULL);
+    if (win)
+    {
+        delwin(win);
+        touchwin(app->wnd);
+        wrefresh(app->wnd);
+    }
+    return err ? -1 : 0;
 }
 
 /**
- * @brief Opens a file in an external editor.
+ * @brief Opens a file in the viewer, or in an external editor.
  *
- * Terminates ncurses, launches the editor,
- * then restores the interface.
+ * The viewer comes up at once whatever the size of the file. For the
+ * editor ('e' in the viewer, or a file the viewer cannot map) ncurses
+ * is suspended, nano runs, then the interface is restored.
  *
  * @param app Pointer to the application.
  */
@@ -397,6 +361,12 @@ void open_file_dialog(App *app)
         return;
     }
 
+    if (view_file(app, path) == VIEWER_CLOSED)
+    {
+        free(path);
+        return;
+    }
+
     endwin();
 
     char command[PATH_MAX + 10];
@@ -406,6 +376,7 @@ void open_file_dialog(App *app)
 
     refresh();
     clear();
+    app->damaged = 1;
 
     free(path);
 }
@@ -413,8 +384,8 @@ void open_file_dialog(App *app)
 /**
  * @brief Moves a file or directory
  *
- * Moves a file or directory using mkdir, 
- * opendir, closedir, rmdir
+ * A rename() when source and destination share a filesystem,
+ * otherwise a copy followed by deleting the source.
  *
  * @param app Pointer to the application.
  */
@@ -455,13 +426,13 @@ void move_dialog(App *app)
         return;
     }
 
-    process_tree(src_path, dst_path, OP_MOVE);
+    run_tree_op(app, "Moving", TREE_MOVE, src_path, dst_path);
 
     free(src_path);
     free(dst_path);
 
-    load_directory(src);
-    load_directory(dst);
+    panel_refresh(src);
+    panel_refresh(dst);
 }
 
 /**
@@ -0,0 +1,410 @@
+/**
+ * @file dir_loader.c
+ * @brief Background directory reader.
+ *
+ * Responsible for:
+ * - reading a directory with getdents64() in 1 MiB batches
+ * - publishing entries to the UI thread as they arrive
+ * - sorting the finished list off the UI thread
+ * - cancellation without blocking the UI
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "dir_loader.h"
+
+#define GETDENTS_BUF (1 << 20)
+#define GETDENTS_FIRST (32 << 10)
+#define ARENA_CHUNK (256 << 10)
+
+/**
+ * @struct linux_dirent64
+ * @brief Record layout returned by getdents64().
+ */
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/**
+ * @struct Chunk
+ * @brief Arena block holding variable-size dirent records.
+ */
+typedef struct Chunk
+{
+    struct Chunk *next;
+    size_t used;
+    char data[];
+} Chunk;
+
+/**
+ * @struct DirLoader
+ * @brief Shared between the reader thread and the panel.
+ *
+ * Entries live in the loader's arena and stay valid until the last
+ * reference is released, so the panel can keep pointers to them.
+ */
+struct DirLoader
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    atomic_int refs;
+    atomic_int cancel;
+    int fd;
+
+    Chunk *chunks;
+    size_t arena_bytes; /**< record bytes handed out */
+    size_t dead_bytes;  /**< of those, records dropped again */
+
+    /* protected by lock */
+    struct dirent **items;
+    size_t count;
+    size_t cap;
+    struct dirent **sorted;
+    int done;
+    int error;
+};
+
+/**
+ * @brief Arena bytes taken by a record of @p size dirent bytes.
+ */
+static size_t record_size(size_t size)
+{
+    return sizeof(EntryMeta) + ((size + 7) & ~(size_t)7);
+}
+
+/**
+ * @brief Allocates a dirent record sized to its name, like scandir(),
+ * with a zeroed EntryMeta in front of it.
+ */
+static struct dirent *arena_alloc(DirLoader *l, size_t size)
+{
+    size = record_size(size);
+
+    if (!l->chunks || l->chunks->used + size > ARENA_CHUNK)
+    {
+        size_t bytes = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+        Chunk *c = malloc(sizeof(Chunk) + bytes);
+        if (!c)
+            return NULL;
+        c->next = l->chunks;
+        c->used = 0;
+        l->chunks = c;
+    }
+
+    char *rec = l->chunks->data + l->chunks->used;
+    l->chunks->used += size;
+    l->arena_bytes += size;
+    memset(rec, 0, sizeof(EntryMeta));
+    return (struct dirent *)(rec + sizeof(EntryMeta));
+}
+
+static void free_loader(DirLoader *l)
+{
+    Chunk *c = l->chunks;
+    while (c)
+    {
+        Chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(l->items);
+    free(l->sorted);
+    pthread_mutex_destroy(&l->lock);
+    free(l);
+}
+
+/**
+ * @brief Drops one reference; the last one frees everything.
+ *
+ * @param l Loader, may be NULL.
+ */
+void dir_loader_release(DirLoader *l)
+{
+    if (!l)
+        return;
+
+    atomic_store(&l->cancel, 1);
+    if (atomic_fetch_sub(&l->refs, 1) == 1)
+        free_loader(l);
+}
+
+/**
+ * @brief Order of the sorted list: strcoll() on the names.
+ */
+int dir_entry_compare(const void *a, const void *b)
+{
+    const struct dirent *x = *(const struct dirent * const *)a;
+    const struct dirent *y = *(const struct dirent * const *)b;
+    return strcoll(x->d_name, y->d_name);
+}
+
+/**
+ * @brief Appends a parsed batch to the published list.
+ */
+static int publish(DirLoader *l, struct dirent **batch, size_t n)
+{
+    pthread_mutex_lock(&l->lock);
+
+    if (l->count + n > l->cap)
+    {
+        size_t cap = l->cap ? l->cap : 4096;
+        while (cap < l->count + n)
+            cap *= 2;
+        struct dirent **items = realloc(l->items, cap * sizeof(*items));
+        if (!items)
+        {
+            pthread_mutex_unlock(&l->lock);
+            return -1;
+        }
+        l->items = items;
+        l->cap = cap;
+    }
+
+    memcpy(l->items + l->count, batch, n * sizeof(*batch));
+    l->count += n;
+
+    pthread_mutex_unlock(&l->lock);
+    return 0;
+}
+
+static void finish(DirLoader *l, struct dirent **sorted, int error)
+{
+    pthread_mutex_lock(&l->lock);
+    l->sorted = sorted;
+    l->error = error;
+    l->done = 1;
+    pthread_mutex_unlock(&l->lock);
+}
+
+/**
+ * @brief Reader thread: getdents64 batches, then a background sort.
+ */
+static void *loader_thread(void *arg)
+{
+    DirLoader *l = arg;
+    char *buf = malloc(GETDENTS_BUF);
+    struct dirent **batch = malloc((GETDENTS_BUF / 24 + 1) * sizeof(*batch));
+    int error = 0;
+
+    if (!buf || !batch)
+        error = ENOMEM;
+
+    // a small first read gets the first screenful out quickly
+    size_t want = GETDENTS_FIRST;
+
+    while (!error && !atomic_load(&l->cancel))
+    {
+        long n = syscall(SYS_getdents64, l->fd, buf, want);
+        want = GETDENTS_BUF;
+        if (n < 0)
+        {
+            error = errno;
+            break;
+        }
+        if (n == 0)
+            break;
+
+        size_t nb = 0;
+        for (long off = 0; off < n;)
+        {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+            size_t len = strlen(d->d_name);
+            struct dirent *e = arena_alloc(l, offsetof(struct dirent, d_name) + len + 1);
+            if (!e)
+            {
+                error = ENOMEM;
+                break;
+            }
+
+            e->d_ino = d->d_ino;
+            e->d_off = d->d_off;
+            e->d_reclen = (unsigned short)(offsetof(struct dirent, d_name) + len + 1);
+            e->d_type = d->d_type;
+            memcpy(e->d_name, d->d_name, len + 1);
+
+            batch[nb++] = e;
+            off += d->d_reclen;
+        }
+
+        if (nb && publish(l, batch, nb) == -1)
+            error = ENOMEM;
+    }
+
+    close(l->fd);
+    free(buf);
+    free(batch);
+
+    // sort a private copy; the panel keeps using the unsorted list meanwhile
+    struct dirent **sorted = NULL;
+    if (!error && !atomic_load(&l->cancel))
+    {
+        sorted = malloc((l->count ? l->count : 1) * sizeof(*sorted));
+        if (sorted)
+        {
+            memcpy(sorted, l->items, l->count * sizeof(*sorted));
+            qsort(sorted, l->count, sizeof(*sorted), dir_entry_compare);
+        }
+    }
+
+    finish(l, sorted, error);
+    dir_loader_release(l);
+    return NULL;
+}
+
+/**
+ * @brief Allocates an entry for a name that appeared after loading.
+ *
+ * The record lives in the loader's arena like the others, so it stays
+ * valid as long as the loader. Only call once dir_loader_poll() has
+ * returned 1: the reader no longer touches the arena then.
+ *
+ * @param l Finished loader.
+ * @param name Entry name.
+ * @param ino Inode number.
+ * @param type DT_* type.
+ * @return The entry, or NULL when out of memory.
+ */
+struct dirent *dir_loader_add(DirLoader *l, const char *name, uint64_t ino,
+    unsigned char type)
+{
+    size_t len = strlen(name);
+    struct dirent *e = arena_alloc(l, offsetof(struct dirent, d_name) + len + 1);
+    if (!e)
+        return NULL;
+
+    e->d_ino = ino;
+    e->d_off = 0;
+    e->d_reclen = (unsigned short)(offsetof(struct dirent, d_name) + len + 1);
+    e->d_type = type;
+    memcpy(e->d_name, name, len + 1);
+    return e;
+}
+
+/**
+ * @brief Counts an entry the panel no longer lists as dead space.
+ *
+ * The record itself stays: something may still point at it until the
+ * loader is released. Same rule as dir_loader_add().
+ *
+ * @param l Finished loader.
+ * @param e Entry dropped from the list.
+ */
+void dir_loader_drop(DirLoader *l, const struct dirent *e)
+{
+    l->dead_bytes += record_size(offsetof(struct dirent, d_name) + strlen(e->d_name) + 1);
+}
+
+/**
+ * @brief Whether most of the arena is dead, so that reading the
+ * directory again would give the memory back.
+ *
+ * Dropped records are never reused, so a directory with steady churn
+ * would otherwise grow its arena without bound.
+ *
+ * @param l Finished loader.
+ * @return 1 once dropped records are over half of at least one chunk's
+ *         worth of records.
+ */
+int dir_loader_mostly_dead(const DirLoader *l)
+{
+    return l->arena_bytes >= ARENA_CHUNK && l->dead_bytes * 2 > l->arena_bytes;
+}
+
+/**
+ * @brief Starts reading an open directory in the background.
+ *
+ * @param dirfd Directory descriptor; the loader closes it.
+ * @return Loader holding two references (reader and caller), or NULL.
+ */
+DirLoader *dir_loader_start(int dirfd)
+{
+    DirLoader *l = calloc(1, sizeof(DirLoader));
+    if (!l)
+    {
+        close(dirfd);
+        return NULL;
+    }
+
+    pthread_mutex_init(&l->lock, NULL);
+    atomic_init(&l->refs, 2);
+    atomic_init(&l->cancel, 0);
+    l->fd = dirfd;
+
+    if (pthread_create(&l->thread, NULL, loader_thread, l) != 0)
+    {
+        close(dirfd);
+        pthread_mutex_destroy(&l->lock);
+        free(l);
+        return NULL;
+    }
+    pthread_detach(l->thread);
+    return l;
+}
+
+/**
+ * @brief Copies what the reader published since the last poll.
+ *
+ * New unsorted entries are appended to @p entries. Once the sorted list
+ * is ready it replaces @p entries (the old array is freed).
+ *
+ * @param l Loader.
+ * @param entries Panel's entry array, grown as needed.
+ * @param count Entries already held; updated.
+ * @param capacity Allocated size of @p entries; updated.
+ * @param error Set to the reader's errno when it failed.
+ * @return 1 once loading has finished, 0 while still reading.
+ */
+int dir_loader_poll(DirLoader *l, struct dirent ***entries, int *count,
+    int *capacity, int *error)
+{
+    pthread_mutex_lock(&l->lock);
+
+    int done = l->done;
+    *error = l->error;
+
+    if (l->sorted)
+    {
+        free(*entries);
+        *entries = l->sorted;
+        *count = (int)l->count;
+        *capacity = (int)l->count;
+        l->sorted = NULL;
+    }
+    else if (l->count > (size_t)*count)
+    {
+        if (l->count > (size_t)*capacity)
+        {
+            size_t cap = *capacity ? (size_t)*capacity : 256;
+            while (cap < l->count)
+                cap *= 2;
+            struct dirent **grown = realloc(*entries, cap * sizeof(*grown));
+            if (!grown)
+            {
+                pthread_mutex_unlock(&l->lock);
+                return done;
+            }
+            *entries = grown;
+            *capacity = (int)cap;
+        }
+        memcpy(*entries + *count, l->items + *count,
+            (l->count - (size_t)*count) * sizeof(**entries));
+        *count = (int)l->count;
+    }
+
+    pthread_mutex_unlock(&l->lock);
+    return done;
+}
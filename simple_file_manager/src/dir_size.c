@@ -0,0 +1,189 @@
+/**
+ * @file dir_size.c
+ * @brief Directory sizes in the panels.
+ *
+ * Responsible for:
+ * - sizing the selected entry in the background on request
+ * - showing the running total while the walk goes on
+ * - showing totals of directories sized before, from the size cache
+ *
+ * The walk itself is a TREE_SIZE tree_op; the panel polls it every
+ * frame. A cached total is looked up with one stat() the first time a
+ * directory is drawn, and the answer is kept in its EntryMeta.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "dir_size.h"
+#include "dir_loader.h"
+#include "size_cache.h"
+#include "tree_op.h"
+
+/** EntryMeta.size_state values */
+enum
+{
+    SIZE_NEW = 0, /**< cache not asked yet */
+    SIZE_NONE,    /**< no total known */
+    SIZE_DONE     /**< bytes is the total */
+};
+
+/**
+ * @brief Starts sizing the selected entry; a walk already running on
+ * the panel is cancelled.
+ *
+ * @param p Pointer to the panel.
+ * @return 0 on success, -1 on error or when there is nothing to size.
+ */
+int dir_size_start(Panel *p)
+{
+    if (p->count <= 0)
+        return -1;
+
+    struct dirent *e = p->entries[p->selected];
+    if (strcmp(e->d_name, "..") == 0 || strcmp(e->d_name, ".") == 0)
+        return -1;
+
+    dir_size_stop(p);
+
+    // a cut path would size some other directory
+    char path[PATH_MAX];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", p->cwd, e->d_name) >= sizeof(path))
+        return -1;
+
+    p->sizing = tree_op_start(TREE_SIZE, path, NULL, 0);
+    if (!p->sizing)
+        return -1;
+    p->sizing_entry = e;
+    p->sizing_bytes = 0;
+    return 0;
+}
+
+/**
+ * @brief Picks up the running total; called once per frame.
+ *
+ * A finished walk leaves its total on the entry and lets the other
+ * directories of the panel look into the cache again, since the walk
+ * may have sized them as well.
+ *
+ * @param p Pointer to the panel.
+ * @return 1 if what the panel shows changed, 0 otherwise.
+ */
+int dir_size_poll(Panel *p)
+{
+    if (!p->sizing)
+        return 0;
+
+    TreeProgress progress;
+    int done = tree_op_poll(p->sizing, &progress);
+    int changed = progress.bytes_done != p->sizing_bytes;
+    p->sizing_bytes = progress.bytes_done;
+
+    if (!done)
+        return changed;
+
+    tree_op_finish(p->sizing);
+    p->sizing = NULL;
+
+    EntryMeta *m = dir_entry_meta(p->sizing_entry);
+    m->size_state = SIZE_DONE;
+    m->bytes = p->sizing_bytes;
+
+    for (int i = 0; i < p->count; i++)
+    {
+        m = dir_entry_meta(p->entries[i]);
+        if (m->size_state == SIZE_NONE)
+            m->size_state = SIZE_NEW;
+    }
+    return 1;
+}
+
+/**
+ * @brief Cancels the panel's walk, if any; call before its entries go.
+ *
+ * @param p Pointer to the panel.
+ */
+void dir_size_stop(Panel *p)
+{
+    if (!p->sizing)
+        return;
+    tree_op_cancel(p->sizing);
+    tree_op_finish(p->sizing);
+    p->sizing = NULL;
+    p->sizing_entry = NULL;
+}
+
+/**
+ * @brief What the panel knows about the size of an entry.
+ *
+ * @param p Panel holding the entry.
+ * @param e The entry.
+ * @param bytes Set to the total, or the total so far, unless
+ * DIR_SIZE_NONE is returned.
+ * @return DIR_SIZE_NONE, DIR_SIZE_PARTIAL or DIR_SIZE_DONE.
+ */
+int dir_size_of(Panel *p, struct dirent *e, uint64_t *bytes)
+{
+    if (p->sizing && e == p->sizing_entry)
+    {
+        *bytes = p->sizing_bytes;
+        return DIR_SIZE_PARTIAL;
+    }
+
+    EntryMeta *m = dir_entry_meta(e);
+    if (m->size_state == SIZE_DONE)
+    {
+        *bytes = m->bytes;
+        return DIR_SIZE_DONE;
+    }
+
+    // nothing sized yet: no stat() for every directory on screen
+    if (m->size_state == SIZE_NONE || e->d_type != DT_DIR || size_cache_empty())
+        return DIR_SIZE_NONE;
+
+    m->size_state = SIZE_NONE;
+    if (strcmp(e->d_name, "..") == 0)
+        return DIR_SIZE_NONE;
+
+    char path[PATH_MAX];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", p->cwd, e->d_name) >= sizeof(path))
+        return DIR_SIZE_NONE;
+
+    struct stat st;
+    if (fstatat(AT_FDCWD, path, &st, AT_SYMLINK_NOFOLLOW) < 0 || !S_ISDIR(st.st_mode))
+        return DIR_SIZE_NONE;
+
+    FileKey key = { (uint64_t)st.st_dev, (uint64_t)st.st_ino, 0,
+        (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec };
+    if (!size_cache_find(&key, &m->bytes))
+        return DIR_SIZE_NONE;
+
+    m->size_state = SIZE_DONE;
+    *bytes = m->bytes;
+    return DIR_SIZE_DONE;
+}
+
+/**
+ * @brief Formats a size the way the panels show it ("512B", "4.0K",
+ * "123M").
+ */
+void dir_size_format(uint64_t bytes, char *buf, size_t len)
+{
+    static const char units[] = "BKMGTPE";
+    double v = (double)bytes;
+    int u = 0;
+
+    while (v >= 1024 && units[u + 1])
+    {
+        v /= 1024;
+        u++;
+    }
+
+    if (u == 0)
+        snprintf(buf, len, "%.0f%c", v, units[u]);
+    else
+        snprintf(buf, len, v < 10 ? "%.1f%c" : "%.0f%c", v, units[u]);
+}
@@ -0,0 +1,220 @@
+/**
+ * @file dir_watch.c
+ * @brief inotify watch on a panel's directory.
+ *
+ * Responsible for:
+ * - moving the watch along when the panel changes directory
+ * - draining the inotify queue without blocking the UI
+ * - collecting the names that changed, each once
+ * - reporting queue overflow and the directory itself going away
+ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "dir_watch.h"
+
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define WATCH_BUF (64 << 10)
+#define WATCH_MAX_NAMES 65536
+
+/**
+ * @struct DirWatch
+ * @brief One inotify instance watching one directory.
+ */
+struct DirWatch
+{
+    int fd;
+    int wd;         /**< -1 when not watching */
+    int flags;      /**< WATCH_* not yet reported */
+
+    char **names;   /**< changed names, may repeat until taken */
+    int count;
+    int cap;
+};
+
+/**
+ * @brief Creates an inotify instance; nothing is watched yet.
+ *
+ * @return The watch, or NULL (no inotify, or out of instances).
+ */
+DirWatch *dir_watch_open(void)
+{
+    DirWatch *w = calloc(1, sizeof(DirWatch));
+    if (!w)
+        return NULL;
+
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fd < 0)
+    {
+        free(w);
+        return NULL;
+    }
+    w->wd = -1;
+    return w;
+}
+
+void dir_watch_free_names(char **names, int count)
+{
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+}
+
+/**
+ * @brief Closes the instance and drops pending names.
+ *
+ * @param w Watch, may be NULL.
+ */
+void dir_watch_close(DirWatch *w)
+{
+    if (!w)
+        return;
+
+    close(w->fd);
+    dir_watch_free_names(w->names, w->count);
+    free(w);
+}
+
+/**
+ * @brief Descriptor to poll for POLLIN, -1 for a NULL watch.
+ */
+int dir_watch_fd(const DirWatch *w)
+{
+    return w ? w->fd : -1;
+}
+
+/**
+ * @brief Watches @p path instead of the previous directory.
+ *
+ * Pending names and flags are dropped: they belong to the old one.
+ * Events of the old watch still queued are skipped by dir_watch_read().
+ *
+ * @param w Watch.
+ * @param path Directory.
+ * @return 0 on success, -1 on error (errno set; nothing is watched).
+ */
+int dir_watch_set(DirWatch *w, const char *path)
+{
+    int wd = inotify_add_watch(w->fd, path, WATCH_EVENTS);
+
+    // the same directory again gives back the same descriptor
+    if (w->wd >= 0 && w->wd != wd)
+        inotify_rm_watch(w->fd, w->wd);
+    w->wd = wd;
+
+    dir_watch_free_names(w->names, w->count);
+    w->names = NULL;
+    w->count = 0;
+    w->cap = 0;
+    w->flags = 0;
+    return wd < 0 ? -1 : 0;
+}
+
+static void add_name(DirWatch *w, const char *name)
+{
+    if (w->flags & WATCH_OVERFLOW)
+        return;
+
+    // too many to apply one by one: a re-read is cheaper
+    if (w->count == WATCH_MAX_NAMES)
+    {
+        dir_watch_free_names(w->names, w->count);
+        w->names = NULL;
+        w->count = 0;
+        w->cap = 0;
+        w->flags = (w->flags & ~WATCH_CHANGED) | WATCH_OVERFLOW;
+        return;
+    }
+
+    if (w->count == w->cap)
+    {
+        int cap = w->cap ? w->cap * 2 : 64;
+        char **names = realloc(w->names, cap * sizeof(*names));
+        if (!names)
+        {
+            w->flags |= WATCH_OVERFLOW;
+            return;
+        }
+        w->names = names;
+        w->cap = cap;
+    }
+
+    char *copy = strdup(name);
+    if (!copy)
+    {
+        w->flags |= WATCH_OVERFLOW;
+        return;
+    }
+    w->names[w->count++] = copy;
+    w->flags |= WATCH_CHANGED;
+}
+
+/**
+ * @brief Drains the inotify queue without blocking.
+ *
+ * @param w Watch, may be NULL.
+ * @return WATCH_* flags accumulated so far, 0 if nothing happened.
+ */
+int dir_watch_read(DirWatch *w)
+{
+    if (!w)
+        return 0;
+
+    char buf[WATCH_BUF] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;)
+    {
+        ssize_t n = read(w->fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        for (char *p = buf; p < buf + n;)
+        {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(*ev) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                w->flags |= WATCH_OVERFLOW;
+                continue;
+            }
+            if (ev->wd != w->wd || w->wd < 0)
+                continue;
+
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                w->flags |= WATCH_GONE;
+            else if (ev->len > 0)
+                add_name(w, ev->name);
+        }
+    }
+    return w->flags;
+}
+
+/**
+ * @brief Hands over the changed names and clears the flags.
+ *
+ * @param w Watch.
+ * @param names Set to the names (caller frees with dir_watch_free_names()).
+ * @param count Set to the number of names.
+ * @return The WATCH_* flags that were pending.
+ */
+int dir_watch_take(DirWatch *w, char ***names, int *count)
+{
+    int flags = w->flags;
+
+    *names = w->names;
+    *count = w->count;
+    w->names = NULL;
+    w->count = 0;
+    w->cap = 0;
+    w->flags = 0;
+    return flags;
+}
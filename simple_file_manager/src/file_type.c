@@ -0,0 +1,448 @@
+/**
+ * @file file_type.c
+ * @brief Cached file type classification for panel colours.
+ *
+ * Responsible for:
+ * - one stat() per entry, remembered in its EntryMeta
+ * - classification by extension (fast path)
+ * - libmagic on a background thread, only for ambiguous files
+ * - a per-panel cache of libmagic results keyed by (dev, ino, size, mtime)
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <pthread.h>
+#include <magic.h>
+#include <sys/stat.h>
+
+#include "file_type.h"
+#include "dir_loader.h"
+
+#define COLOR_TEXT 4
+#define COLOR_ARCHIVE 5
+#define COLOR_MEDIA 6
+#define COLOR_BINARY 3
+#define COLOR_PLAIN 7
+
+/** EntryMeta.state values */
+enum
+{
+    META_NEW = 0,   /**< not looked at yet */
+    META_PENDING,   /**< queued for libmagic, key is valid */
+    META_FINAL      /**< color is final */
+};
+
+/**
+ * @struct TypeCache
+ * @brief Per-panel open addressing table of libmagic results.
+ *
+ * Shared with the magic thread, so guarded by a mutex. The generation
+ * changes when the panel leaves a directory; queued jobs for an older
+ * generation are dropped.
+ */
+typedef struct TypeCache
+{
+    pthread_mutex_t lock;
+    FileKey *keys;
+    uint8_t *colors;  /**< 0 = empty slot */
+    size_t cap;
+    size_t used;
+    unsigned gen;
+} TypeCache;
+
+/**
+ * @struct MagicJob
+ * @brief One ambiguous file waiting for libmagic.
+ */
+typedef struct MagicJob
+{
+    char *path;
+    FileKey key;
+    TypeCache *cache;
+    unsigned gen;
+} MagicJob;
+
+static pthread_t magic_thread;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static MagicJob *queue;
+static size_t queue_len;
+static size_t queue_cap;
+static int queue_stop;
+static int thread_started;
+
+static const struct
+{
+    const char *ext;
+    uint8_t color;
+} known_ext[] = {
+    {"txt", COLOR_TEXT}, {"md", COLOR_TEXT}, {"c", COLOR_TEXT}, {"h", COLOR_TEXT},
+    {"cpp", COLOR_TEXT}, {"hpp", COLOR_TEXT}, {"cc", COLOR_TEXT}, {"py", COLOR_TEXT},
+    {"sh", COLOR_TEXT}, {"json", COLOR_TEXT}, {"xml", COLOR_TEXT}, {"html", COLOR_TEXT},
+    {"css", COLOR_TEXT}, {"js", COLOR_TEXT}, {"ts", COLOR_TEXT}, {"csv", COLOR_TEXT},
+    {"log", COLOR_TEXT}, {"ini", COLOR_TEXT}, {"conf", COLOR_TEXT}, {"cfg", COLOR_TEXT},
+    {"yml", COLOR_TEXT}, {"yaml", COLOR_TEXT}, {"toml", COLOR_TEXT}, {"go", COLOR_TEXT},
+    {"rs", COLOR_TEXT}, {"java", COLOR_TEXT}, {"mk", COLOR_TEXT}, {"rst", COLOR_TEXT},
+    {"zip", COLOR_ARCHIVE}, {"gz", COLOR_ARCHIVE}, {"tgz", COLOR_ARCHIVE},
+    {"tar", COLOR_ARCHIVE}, {"rar", COLOR_ARCHIVE}, {"7z", COLOR_ARCHIVE},
+    {"png", COLOR_MEDIA}, {"jpg", COLOR_MEDIA}, {"jpeg", COLOR_MEDIA}, {"gif", COLOR_MEDIA},
+    {"bmp", COLOR_MEDIA}, {"webp", COLOR_MEDIA}, {"tif", COLOR_MEDIA}, {"tiff", COLOR_MEDIA},
+    {"svg", COLOR_MEDIA}, {"mp4", COLOR_MEDIA}, {"mkv", COLOR_MEDIA}, {"avi", COLOR_MEDIA},
+    {"mov", COLOR_MEDIA}, {"webm", COLOR_MEDIA},
+    {"pdf", COLOR_BINARY}, {"o", COLOR_BINARY}, {"so", COLOR_BINARY}, {"a", COLOR_BINARY},
+};
+
+/**
+ * @brief Maps a MIME type to a colour pair, as the panel always did.
+ *
+ * @param mime MIME type string from libmagic, may be NULL.
+ * @return The ncurses colour pair number.
+ */
+int color_for_mime(const char *mime)
+{
+    if (!mime)
+        return COLOR_PLAIN;
+
+    if (strstr(mime, "text"))
+        return COLOR_TEXT;
+
+    if (strstr(mime, "zip") ||
+        strstr(mime, "gzip") ||
+        strstr(mime, "tar") ||
+        strstr(mime, "rar") ||
+        strstr(mime, "7z"))
+        return COLOR_ARCHIVE;
+
+    if (strstr(mime, "image") ||
+        strstr(mime, "video"))
+        return COLOR_MEDIA;
+
+    if (strstr(mime, "application"))
+        return COLOR_BINARY;
+
+    return COLOR_PLAIN;
+}
+
+/**
+ * @brief Colour from the file name alone, 0 if the extension is unknown.
+ */
+static int color_for_extension(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    if (!dot || dot == name || dot[1] == '\0')
+        return 0;
+
+    for (size_t i = 0; i < sizeof(known_ext) / sizeof(known_ext[0]); i++)
+        if (strcasecmp(dot + 1, known_ext[i].ext) == 0)
+            return known_ext[i].color;
+    return 0;
+}
+
+static size_t key_hash(const FileKey *k)
+{
+    uint64_t h = k->ino * 0x9E3779B97F4A7C15ull;
+    h ^= k->dev + (h << 6) + (h >> 2);
+    h ^= (uint64_t)k->mtime_ns + (h << 6) + (h >> 2);
+    h ^= k->size + (h << 6) + (h >> 2);
+    return (size_t)(h ^ (h >> 29));
+}
+
+/* cache->lock held */
+static int cache_find(TypeCache *c, const FileKey *k)
+{
+    if (!c->cap)
+        return 0;
+    for (size_t i = key_hash(k) & (c->cap - 1);; i = (i + 1) & (c->cap - 1))
+    {
+        if (!c->colors[i])
+            return 0;
+        if (memcmp(&c->keys[i], k, sizeof(*k)) == 0)
+            return c->colors[i];
+    }
+}
+
+/* cache->lock held */
+static void cache_insert(TypeCache *c, const FileKey *k, int color)
+{
+    if ((c->used + 1) * 2 > c->cap)
+    {
+        size_t cap = c->cap ? c->cap * 2 : 1024;
+        FileKey *keys = malloc(cap * sizeof(*keys));
+        uint8_t *colors = calloc(cap, 1);
+        if (!keys || !colors)
+        {
+            free(keys);
+            free(colors);
+            return;
+        }
+        for (size_t i = 0; i < c->cap; i++)
+        {
+            if (!c->colors[i])
+                continue;
+            size_t j = key_hash(&c->keys[i]) & (cap - 1);
+            while (colors[j])
+                j = (j + 1) & (cap - 1);
+            keys[j] = c->keys[i];
+            colors[j] = c->colors[i];
+        }
+        free(c->keys);
+        free(c->colors);
+        c->keys = keys;
+        c->colors = colors;
+        c->cap = cap;
+    }
+
+    size_t i = key_hash(k) & (c->cap - 1);
+    while (c->colors[i] && memcmp(&c->keys[i], k, sizeof(*k)) != 0)
+        i = (i + 1) & (c->cap - 1);
+    if (!c->colors[i])
+        c->used++;
+    c->keys[i] = *k;
+    c->colors[i] = (uint8_t)color;
+}
+
+static TypeCache *panel_cache(Panel *p)
+{
+    if (!p->types)
+    {
+        p->types = calloc(1, sizeof(TypeCache));
+        if (p->types)
+            pthread_mutex_init(&p->types->lock, NULL);
+    }
+    return p->types;
+}
+
+/**
+ * @brief Magic thread: newest job first, so the rows on screen win.
+ */
+static void *magic_worker(void *arg)
+{
+    (void)arg;
+    magic_t cookie = magic_open(MAGIC_MIME_TYPE);
+    if (cookie)
+        magic_load(cookie, NULL);
+
+    for (;;)
+    {
+        pthread_mutex_lock(&queue_lock);
+        while (!queue_len && !queue_stop)
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        if (queue_stop)
+        {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        MagicJob job = queue[--queue_len];
+        pthread_mutex_unlock(&queue_lock);
+
+        TypeCache *c = job.cache;
+        pthread_mutex_lock(&c->lock);
+        int stale = (c->gen != job.gen);
+        pthread_mutex_unlock(&c->lock);
+
+        if (!stale)
+        {
+            int color = color_for_mime(cookie ? magic_file(cookie, job.path) : NULL);
+            pthread_mutex_lock(&c->lock);
+            cache_insert(c, &job.key, color);
+            pthread_mutex_unlock(&c->lock);
+        }
+        free(job.path);
+    }
+
+    if (cookie)
+        magic_close(cookie);
+    return NULL;
+}
+
+static void enqueue(TypeCache *c, const char *path, const FileKey *key)
+{
+    char *copy = strdup(path);
+    if (!copy)
+        return;
+
+    pthread_mutex_lock(&c->lock);
+    unsigned gen = c->gen;
+    pthread_mutex_unlock(&c->lock);
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_len == queue_cap)
+    {
+        size_t cap = queue_cap ? queue_cap * 2 : 256;
+        MagicJob *q = realloc(queue, cap * sizeof(*q));
+        if (!q)
+        {
+            pthread_mutex_unlock(&queue_lock);
+            free(copy);
+            return;
+        }
+        queue = q;
+        queue_cap = cap;
+    }
+    queue[queue_len++] = (MagicJob){copy, *key, c, gen};
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+/**
+ * @brief Starts the libmagic thread.
+ *
+ * @return 0 on success, -1 if the thread could not be created.
+ */
+int file_types_init(void)
+{
+    if (thread_started)
+        return 0;
+    if (pthread_create(&magic_thread, NULL, magic_worker, NULL) != 0)
+        return -1;
+    thread_started = 1;
+    return 0;
+}
+
+/**
+ * @brief Stops the libmagic thread and drops queued jobs.
+ */
+void file_types_shutdown(void)
+{
+    if (!thread_started)
+        return;
+
+    pthread_mutex_lock(&queue_lock);
+    queue_stop = 1;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+    pthread_join(magic_thread, NULL);
+
+    for (size_t i = 0; i < queue_len; i++)
+        free(queue[i].path);
+    free(queue);
+    queue = NULL;
+    queue_len = queue_cap = 0;
+    queue_stop = 0;
+    thread_started = 0;
+}
+
+/**
+ * @brief Determines the display colour of a panel entry.
+ *
+ * The first call for an entry does one stat() and tries the extension
+ * table and the panel cache; ambiguous files are queued for libmagic
+ * and drawn plain until the result lands in the cache.
+ *
+ * @param p Panel holding the entry.
+ * @param e The entry.
+ * @return The ncurses colour pair number.
+ */
+int file_type_color(Panel *p, struct dirent *e)
+{
+    EntryMeta *m = dir_entry_meta(e);
+
+    if (m->state == META_FINAL)
+        return m->color;
+
+    TypeCache *c = panel_cache(p);
+
+    if (m->state == META_PENDING)
+    {
+        if (c)
+        {
+            pthread_mutex_lock(&c->lock);
+            int color = cache_find(c, &m->key);
+            pthread_mutex_unlock(&c->lock);
+            if (color)
+            {
+                m->color = (uint8_t)color;
+                m->state = META_FINAL;
+            }
+        }
+        return m->color;
+    }
+
+    m->state = META_FINAL;
+    m->color = COLOR_PLAIN;
+
+    if (e->d_type == DT_DIR)
+        return m->color;
+
+    // a cut path would stat, cache and sniff some other file: such an
+    // entry is coloured by its extension alone and never cached
+    char path[PATH_MAX];
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", p->cwd, e->d_name) >= sizeof(path))
+    {
+        int color = color_for_extension(e->d_name);
+        return m->color = color ? (uint8_t)color : COLOR_PLAIN;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return m->color;
+
+    if (S_ISDIR(st.st_mode))
+        return m->color;
+
+    if (st.st_mode & S_IXUSR)
+        return m->color = COLOR_BINARY;
+
+    // nothing to sniff in empty or special files (never open a fifo)
+    if (!S_ISREG(st.st_mode) || st.st_size == 0)
+        return m->color;
+
+    int color = color_for_extension(e->d_name);
+    if (color)
+        return m->color = (uint8_t)color;
+
+    m->key = (FileKey){(uint64_t)st.st_dev, (uint64_t)st.st_ino, (uint64_t)st.st_size,
+        (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec};
+
+    if (c)
+    {
+        pthread_mutex_lock(&c->lock);
+        color = cache_find(c, &m->key);
+        pthread_mutex_unlock(&c->lock);
+        if (color)
+            return m->color = (uint8_t)color;
+    }
+
+    if (!c || !thread_started)
+        return m->color;
+
+    m->state = META_PENDING;
+    enqueue(c, path, &m->key);
+    return m->color;
+}
+
+/**
+ * @brief Drops queued libmagic jobs of the panel's previous directory.
+ *
+ * Cached results stay: coming back to a directory costs no libmagic.
+ *
+ * @param p Pointer to the panel.
+ */
+void file_types_forget(Panel *p)
+{
+    if (!p->types)
+        return;
+    pthread_mutex_lock(&p->types->lock);
+    p->types->gen++;
+    pthread_mutex_unlock(&p->types->lock);
+}
+
+/**
+ * @brief Frees the panel's cache; call after file_types_shutdown().
+ *
+ * @param p Pointer to the panel.
+ */
+void file_types_free(Panel *p)
+{
+    if (!p->types)
+        return;
+    pthread_mutex_destroy(&p->types->lock);
+    free(p->types->keys);
+    free(p->types->colors);
+    free(p->types);
+    p->types = NULL;
+}
@@ -0,0 +1,722 @@
+/**
+ * @file file_view.c
+ * @brief Read-only access to a file of any size by lines.
+ *
+ * Responsible for:
+ * - mapping the file read-only, so nothing is read before it is shown
+ * - surviving the file being truncated under the mapping: the pages
+ *   past the new end are replaced by zeros instead of raising SIGBUS
+ * - stepping between lines around any byte offset
+ * - a sparse line index, built in the background with a vectorised
+ *   newline scan (AVX2 or SSE2, chosen at run time, memchr() elsewhere)
+ * - line number to offset and back in bounded time once indexed
+ * - forward and backward search in bounded steps
+ *
+ * The index keeps the offset of every LINE_STRIDE-th line, so it stays a
+ * few megabytes even for a file of billions of lines; a lookup starts
+ * from the nearest mark and walks fewer than LINE_STRIDE lines.
+ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "file_view.h"
+
+#define LINE_STRIDE 256
+#define INDEX_CHUNK (16u << 20)
+#define SEARCH_CHUNK (64u << 20)
+#define BACK_BLOCK (256u << 10)
+
+/* lines longer than this are shown in pieces, so one huge line never
+ * makes a step or a screen scan the whole of it */
+#define LINE_SCAN (64u << 10)
+
+/**
+ * @struct FileView
+ * @brief A mapped file and its line index.
+ *
+ * marks[k] is the offset of line k * LINE_STRIDE. The indexer appends
+ * marks under the lock and then publishes scanned and newlines, so a
+ * reader that has seen newlines also finds every mark below it.
+ */
+struct FileView
+{
+    int fd;
+    const char *data;
+    uint64_t size;
+
+    pthread_t thread;
+    int has_thread;
+    atomic_int stop;
+    int drop_behind;
+
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    uint64_t *marks;
+    size_t nmarks;
+    size_t capacity;
+
+    atomic_ullong scanned;
+    atomic_ullong newlines;
+    atomic_int done;
+};
+
+/**
+ * @struct Scan
+ * @brief Running state of a newline scan.
+ *
+ * With a view the scan adds a mark after every LINE_STRIDE-th newline;
+ * without one it only counts.
+ */
+typedef struct Scan
+{
+    FileView *v;
+    uint64_t count;
+    unsigned until; /**< newlines left before the next mark */
+} Scan;
+
+typedef void (*scan_fn)(Scan *s, const char *p, size_t n, uint64_t base);
+
+/* mappings the SIGBUS handler may patch; a slot is cleared before its
+ * mapping goes away */
+#define MAX_MAPPED 16
+
+static struct
+{
+    _Atomic uintptr_t start;
+    _Atomic uint64_t size;
+} mapped[MAX_MAPPED];
+
+static pthread_once_t sigbus_once = PTHREAD_ONCE_INIT;
+static uintptr_t page_mask;
+
+/**
+ * @brief Reading a page past the end of a file that shrank while
+ * mapped (logrotate's copytruncate, say) raises SIGBUS. If the page is
+ * in a view, the rest of the view is mapped over with zero pages and
+ * the read is retried; any other SIGBUS gets the default action.
+ */
+static void on_sigbus(int sig, siginfo_t *info, void *ctx)
+{
+    (void)ctx;
+    int err = errno;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+
+    for (int i = 0; i < MAX_MAPPED; i++)
+    {
+        uintptr_t start = atomic_load(&mapped[i].start);
+        uint64_t size = atomic_load(&mapped[i].size);
+        if (!start || addr < start || addr - start >= size)
+            continue;
+
+        uintptr_t from = addr & ~page_mask;
+        uintptr_t end = (start + size + page_mask) & ~page_mask;
+        if (mmap((void *)from, end - from, PROT_READ,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED)
+        {
+            errno = err;
+            return;
+        }
+        break;
+    }
+
+    // not ours: returning retries the access, which now kills the process
+    signal(sig, SIG_DFL);
+    errno = err;
+}
+
+static void install_sigbus(void)
+{
+    page_mask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_sigbus;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGBUS, &sa, NULL);
+}
+
+/**
+ * @brief Puts a mapping where the SIGBUS handler finds it.
+ * @return 0, or -1 if every slot is taken.
+ */
+static int guard_mapping(const char *data, uint64_t size)
+{
+    for (int i = 0; i < MAX_MAPPED; i++)
+    {
+        uintptr_t expected = 0;
+        if (atomic_compare_exchange_strong(&mapped[i].start, &expected, (uintptr_t)data))
+        {
+            atomic_store(&mapped[i].size, size);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void unguard_mapping(const char *data)
+{
+    for (int i = 0; i < MAX_MAPPED; i++)
+    {
+        if (atomic_load(&mapped[i].start) == (uintptr_t)data)
+        {
+            atomic_store(&mapped[i].size, 0);
+            atomic_store(&mapped[i].start, 0);
+            return;
+        }
+    }
+}
+
+static void add_mark(FileView *v, uint64_t off)
+{
+    pthread_mutex_lock(&v->lock);
+    if (v->nmarks == v->capacity)
+    {
+        size_t cap = v->capacity ? v->capacity * 2 : 1024;
+        uint64_t *marks = realloc(v->marks, cap * sizeof(*marks));
+        if (!marks)
+        {
+            // out of memory: the index stays as far as it got
+            atomic_store(&v->stop, 1);
+            pthread_mutex_unlock(&v->lock);
+            return;
+        }
+        v->marks = marks;
+        v->capacity = cap;
+    }
+    v->marks[v->nmarks++] = off;
+    pthread_mutex_unlock(&v->lock);
+}
+
+/**
+ * @brief Takes the newlines of one 64-byte block, bit i of @p mask
+ * set for a newline at @p off + i.
+ */
+static inline void take(Scan *s, uint64_t mask, uint64_t off)
+{
+    unsigned n = __builtin_popcountll(mask);
+    s->count += n;
+    if (!s->v)
+        return;
+
+    while (n >= s->until)
+    {
+        for (unsigned i = 1; i < s->until; i++)
+            mask &= mask - 1;
+        add_mark(s->v, off + __builtin_ctzll(mask) + 1);
+        mask &= mask - 1;
+        n -= s->until;
+        s->until = LINE_STRIDE;
+    }
+    s->until -= n;
+}
+
+static void scan_scalar(Scan *s, const char *p, size_t n, uint64_t base)
+{
+    const char *end = p + n;
+    for (const char *q = p; (q = memchr(q, '\n', end - q)); q++)
+        take(s, 1, base + (q - p));
+}
+
+#if defined(__x86_64__)
+
+static void scan_sse2(Scan *s, const char *p, size_t n, uint64_t base)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64)
+    {
+        uint64_t m0 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)(p + i)), nl));
+        uint64_t m1 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)(p + i + 16)), nl));
+        uint64_t m2 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)(p + i + 32)), nl));
+        uint64_t m3 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)(p + i + 48)), nl));
+        uint64_t mask = m0 | m1 << 16 | m2 << 32 | m3 << 48;
+        if (mask)
+            take(s, mask, base + i);
+    }
+    scan_scalar(s, p + i, n - i, base + i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static void scan_avx2(Scan *s, const char *p, size_t n, uint64_t base)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64)
+    {
+        uint64_t lo = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i *)(p + i)), nl));
+        uint64_t hi = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i *)(p + i + 32)), nl));
+        uint64_t mask = lo | hi << 32;
+        if (mask)
+            take(s, mask, base + i);
+    }
+    scan_scalar(s, p + i, n - i, base + i);
+}
+
+#endif
+
+static scan_fn scan;
+static int force_scalar;
+
+static void pick(void)
+{
+    scan = scan_scalar;
+#if defined(__x86_64__)
+    if (force_scalar)
+        return;
+    __builtin_cpu_init();
+    scan = __builtin_cpu_supports("avx2") ? scan_avx2 : scan_sse2;
+#endif
+}
+
+/**
+ * @brief Name of the newline scan in use: "avx2", "sse2" or "memchr".
+ */
+const char *file_view_method(void)
+{
+    if (!scan)
+        pick();
+#if defined(__x86_64__)
+    if (scan == scan_avx2)
+        return "avx2";
+    if (scan == scan_sse2)
+        return "sse2";
+#endif
+    return "memchr";
+}
+
+/**
+ * @brief Uses memchr() instead of the vector scan (for benchmarks);
+ * affects views opened afterwards.
+ */
+void file_view_force_scalar(int on)
+{
+    force_scalar = on;
+    pick();
+}
+
+static void *index_thread(void *arg)
+{
+    FileView *v = arg;
+    Scan s = { v, 0, LINE_STRIDE };
+    uint64_t off = 0;
+
+    while (off < v->size && !atomic_load(&v->stop))
+    {
+        size_t n = v->size - off < INDEX_CHUNK ? v->size - off : INDEX_CHUNK;
+
+        // chunks start page aligned: the next one is read ahead while
+        // this one is scanned
+        if (off + n < v->size)
+        {
+            uint64_t ahead = v->size - off - n < INDEX_CHUNK ? v->size - off - n : INDEX_CHUNK;
+            madvise((char *)v->data + off + n, ahead, MADV_WILLNEED);
+        }
+
+        scan(&s, v->data + off, n, off);
+        if (atomic_load(&v->stop))
+            break;
+
+        if (v->drop_behind)
+        {
+            madvise((char *)v->data + off, n, MADV_DONTNEED);
+            posix_fadvise(v->fd, off, n, POSIX_FADV_DONTNEED);
+        }
+
+        off += n;
+        atomic_store(&v->newlines, s.count);
+        atomic_store(&v->scanned, off);
+    }
+
+    pthread_mutex_lock(&v->lock);
+    if (off == v->size)
+        atomic_store(&v->done, 1);
+    pthread_cond_broadcast(&v->finished);
+    pthread_mutex_unlock(&v->lock);
+    return NULL;
+}
+
+/**
+ * @brief Maps @p path and starts indexing its lines in the background.
+ *
+ * The view shows the file as it was when opened; bytes appended later
+ * are not seen, and bytes cut off by a later truncation read as zeros.
+ *
+ * @param path File to open.
+ * @return The view, or NULL with errno set.
+ */
+FileView *file_view_open(const char *path)
+{
+    if (!scan)
+        pick();
+
+    FileView *v = calloc(1, sizeof(FileView));
+    if (!v)
+        return NULL;
+
+    v->fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (v->fd < 0 || fstat(v->fd, &st) != 0)
+        goto fail;
+    if (!S_ISREG(st.st_mode))
+    {
+        errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+        goto fail;
+    }
+
+    v->size = st.st_size;
+    if (v->size > 0)
+    {
+        pthread_once(&sigbus_once, install_sigbus);
+        void *data = mmap(NULL, v->size, PROT_READ, MAP_SHARED, v->fd, 0);
+        if (data == MAP_FAILED)
+            goto fail;
+        if (guard_mapping(data, v->size) != 0)
+        {
+            munmap(data, v->size);
+            errno = EMFILE;
+            goto fail;
+        }
+        v->data = data;
+    }
+
+    // a file that would push everything else out of the page cache is
+    // dropped behind the indexer, as outrput_revers does
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page = sysconf(_SC_PAGESIZE);
+    v->drop_behind = pages > 0 && page > 0 && v->size > (uint64_t)pages * page / 2;
+
+    pthread_mutex_init(&v->lock, NULL);
+    pthread_cond_init(&v->finished, NULL);
+    add_mark(v, 0);
+
+    if (pthread_create(&v->thread, NULL, index_thread, v) == 0)
+        v->has_thread = 1;
+    else
+        atomic_store(&v->done, v->size == 0);
+    return v;
+
+fail:
+    {
+        int err = errno;
+        if (v->fd >= 0)
+            close(v->fd);
+        free(v);
+        errno = err;
+        return NULL;
+    }
+}
+
+/**
+ * @brief Stops the indexer and unmaps the file.
+ */
+void file_view_close(FileView *v)
+{
+    if (!v)
+        return;
+
+    atomic_store(&v->stop, 1);
+    if (v->has_thread)
+        pthread_join(v->thread, NULL);
+
+    if (v->data)
+    {
+        unguard_mapping(v->data);
+        munmap((void *)v->data, v->size);
+    }
+    close(v->fd);
+    pthread_mutex_destroy(&v->lock);
+    pthread_cond_destroy(&v->finished);
+    free(v->marks);
+    free(v);
+}
+
+const char *file_view_data(const FileView *v)
+{
+    return v->data;
+}
+
+uint64_t file_view_size(const FileView *v)
+{
+    return v->size;
+}
+
+/**
+ * @brief Lines ending inside [0, @p scanned), plus the last line once
+ * the whole file is indexed and it has no newline of its own.
+ */
+static uint64_t lines_in(const FileView *v, uint64_t newlines, int done)
+{
+    if (done && v->size > 0 && v->data[v->size - 1] != '\n')
+        return newlines + 1;
+    return newlines;
+}
+
+/**
+ * @brief Reports how far the index has got.
+ */
+void file_view_progress(FileView *v, FileViewProgress *progress)
+{
+    progress->done = atomic_load(&v->done);
+    progress->lines = atomic_load(&v->newlines);
+    progress->bytes = atomic_load(&v->scanned);
+    progress->lines = lines_in(v, progress->lines, progress->done);
+}
+
+/**
+ * @brief Waits for the index to be complete.
+ *
+ * @param v View.
+ * @param timeout_ms How long to wait at most, forever if negative.
+ * @return 1 if the index is complete, 0 otherwise.
+ */
+int file_view_wait(FileView *v, int timeout_ms)
+{
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += timeout_ms / 1000;
+    until.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (until.tv_nsec >= 1000000000)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&v->lock);
+    while (v->has_thread && !atomic_load(&v->done) && !atomic_load(&v->stop))
+    {
+        if (timeout_ms < 0)
+            pthread_cond_wait(&v->finished, &v->lock);
+        else if (pthread_cond_timedwait(&v->finished, &v->lock, &until) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&v->lock);
+    return atomic_load(&v->done);
+}
+
+/**
+ * @brief Start of the line holding byte @p off (@p off itself if it
+ * starts a line, the size for the end of the file).
+ */
+uint64_t file_view_line_start(const FileView *v, uint64_t off)
+{
+    if (off > v->size)
+        off = v->size;
+    if (off == 0)
+        return 0;
+    uint64_t from = off > LINE_SCAN ? off - LINE_SCAN : 0;
+    const char *nl = memrchr(v->data + from, '\n', off - from);
+    if (nl)
+        return nl - v->data + 1;
+    return from;
+}
+
+/**
+ * @brief End of the line starting at @p off: its newline, or the end of
+ * the file, or LINE_SCAN bytes on for a longer line.
+ */
+uint64_t file_view_line_end(const FileView *v, uint64_t off)
+{
+    if (off >= v->size)
+        return v->size;
+    uint64_t n = v->size - off < LINE_SCAN ? v->size - off : LINE_SCAN;
+    const char *nl = memchr(v->data + off, '\n', n);
+    return nl ? (uint64_t)(nl - v->data) : off + n;
+}
+
+/**
+ * @brief Start of the line after the one starting at @p off, or the
+ * size if there is none.
+ */
+uint64_t file_view_next_line(const FileView *v, uint64_t off)
+{
+    uint64_t end = file_view_line_end(v, off);
+    return end < v->size && v->data[end] == '\n' ? end + 1 : end;
+}
+
+/**
+ * @brief Start of the line before the one starting at @p off.
+ */
+uint64_t file_view_prev_line(const FileView *v, uint64_t off)
+{
+    return off == 0 ? 0 : file_view_line_start(v, off - 1);
+}
+
+static uint64_t mark_at(FileView *v, size_t k)
+{
+    pthread_mutex_lock(&v->lock);
+    uint64_t off = v->marks[k];
+    pthread_mutex_unlock(&v->lock);
+    return off;
+}
+
+/**
+ * @brief Offset of line @p line (0-based).
+ *
+ * @param v View.
+ * @param line Line number; past the last line gives the last line.
+ * @param off Receives the offset.
+ * @return 0 on success, -1 if the index has not got that far yet.
+ */
+int file_view_line_offset(FileView *v, uint64_t line, uint64_t *off)
+{
+    int done = atomic_load(&v->done);
+    uint64_t newlines = atomic_load(&v->newlines);
+    uint64_t lines = lines_in(v, newlines, done);
+
+    if (done && line >= lines)
+        line = lines ? lines - 1 : 0;
+    else if (line > newlines)
+        return -1;
+
+    uint64_t pos = mark_at(v, line / LINE_STRIDE);
+    for (unsigned i = line % LINE_STRIDE; i > 0; i--)
+    {
+        const char *nl = memchr(v->data + pos, '\n', v->size - pos);
+        if (!nl)
+        {
+            // the file was truncated after it was indexed
+            pos = v->size;
+            break;
+        }
+        pos = nl - v->data + 1;
+    }
+    *off = pos;
+    return 0;
+}
+
+/**
+ * @brief Number (0-based) of the line holding byte @p off.
+ *
+ * @return 0 on success, -1 if the index has not got that far yet.
+ */
+int file_view_line_number(FileView *v, uint64_t off, uint64_t *line)
+{
+    uint64_t newlines = atomic_load(&v->newlines);
+    if (off > atomic_load(&v->scanned))
+        return -1;
+
+    // the last mark at or before off
+    size_t lo = 0;
+    size_t hi = newlines / LINE_STRIDE;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo + 1) / 2;
+        if (mark_at(v, mid) <= off)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    uint64_t pos = mark_at(v, lo);
+    Scan s = { NULL, 0, 0 };
+    scan(&s, v->data + pos, off - pos, pos);
+    *line = (uint64_t)lo * LINE_STRIDE + s.count;
+    return 0;
+}
+
+/**
+ * @brief Last occurrence of the needle starting in [lo, @p before),
+ * looking no further than @p end.
+ */
+static const char *last_match(const FileView *v, const char *needle, size_t len,
+    uint64_t lo, uint64_t before, uint64_t end)
+{
+    const char *found = NULL;
+    const char *p = v->data + lo;
+    const char *stop = v->data + before;
+    const char *limit = v->data + end;
+
+    while (p < stop)
+    {
+        const char *hit = memmem(p, limit - p, needle, len);
+        if (!hit || hit >= stop)
+            break;
+        found = hit;
+        p = hit + 1;
+    }
+    return found;
+}
+
+/**
+ * @brief Searches for @p needle from @p from, a bounded step at a time.
+ *
+ * Forward finds the first match starting at or after @p from, backward
+ * the last one starting before it. Each call looks at no more than
+ * SEARCH_CHUNK bytes, so the caller can show progress and give up.
+ *
+ * @param v View.
+ * @param needle Bytes to look for.
+ * @param len Needle length, at least 1.
+ * @param from Where to start.
+ * @param backward Nonzero to search towards the start.
+ * @param at Receives the match, or where to go on from.
+ * @return FILE_VIEW_FOUND, FILE_VIEW_NOT_FOUND or FILE_VIEW_MORE.
+ */
+int file_view_search(const FileView *v, const char *needle, size_t len,
+    uint64_t from, int backward, uint64_t *at)
+{
+    if (len == 0 || v->size < len)
+        return FILE_VIEW_NOT_FOUND;
+    if (from > v->size)
+        from = v->size;
+
+    if (!backward)
+    {
+        uint64_t end = v->size - from > SEARCH_CHUNK + len - 1
+            ? from + SEARCH_CHUNK + len - 1 : v->size;
+        const char *hit = memmem(v->data + from, end - from, needle, len);
+        if (hit)
+        {
+            *at = hit - v->data;
+            return FILE_VIEW_FOUND;
+        }
+        if (end == v->size)
+            return FILE_VIEW_NOT_FOUND;
+        *at = from + SEARCH_CHUNK;
+        return FILE_VIEW_MORE;
+    }
+
+    // backward: blocks from the nearest one out, each searched forward
+    uint64_t lo = from > SEARCH_CHUNK ? from - SEARCH_CHUNK : 0;
+    uint64_t before = from;
+    while (before > lo)
+    {
+        uint64_t start = before - lo > BACK_BLOCK ? before - BACK_BLOCK : lo;
+        uint64_t end = v->size - before > len - 1 ? before + len - 1 : v->size;
+        const char *hit = last_match(v, needle, len, start, before, end);
+        if (hit)
+        {
+            *at = hit - v->data;
+            return FILE_VIEW_FOUND;
+        }
+        before = start;
+    }
+    if (lo == 0)
+        return FILE_VIEW_NOT_FOUND;
+    *at = lo;
+    return FILE_VIEW_MORE;
+}
@@ -0,0 +1,267 @@
+/**
+ * @file filter.c
+ * @brief Type-to-filter mode of a panel.
+ *
+ * Responsible for:
+ * - showing only the entries whose names contain the typed text
+ *   (ASCII case ignored; words separated by spaces must all match)
+ * - updating the result on every keystroke
+ * - jumping to the chosen entry in the full list afterwards
+ *
+ * While filtering, the panel's entries/count are a view of the matches
+ * and the full list is kept aside, so drawing, selection and the
+ * dialogs work on the view unchanged. Matches are kept per query
+ * length: a typed character only searches the previous matches, and
+ * Backspace just drops the last level.
+ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "panel.h"
+#include "name_index.h"
+
+#define QUERY_MAX 255
+
+/**
+ * @struct PanelFilter
+ * @brief Filter state; the panel points to it while filtering.
+ *
+ * level[l] holds the indices (into all) matching the first l query
+ * characters, ascending; level[0] is NULL, meaning every entry.
+ */
+typedef struct PanelFilter
+{
+    struct dirent **all;
+    int all_count;
+    int all_capacity;
+    int all_selected;
+    int all_scroll;
+
+    NameIndex *index;
+
+    char query[QUERY_MAX + 1];
+    int len;
+    int *level[QUERY_MAX + 1];
+    int level_count[QUERY_MAX + 1];
+} PanelFilter;
+
+/**
+ * @brief Index in the full list of the entry selected in the view.
+ */
+static int selected_full(const Panel *p, const PanelFilter *f)
+{
+    if (p->count <= 0)
+        return -1;
+    const int *lv = f->level[f->len];
+    return lv ? lv[p->selected] : p->selected;
+}
+
+/**
+ * @brief Rebuilds the view from the current level, keeping the entry
+ * at full index @p keep selected if it still matches.
+ */
+static void show_level(Panel *p, PanelFilter *f, int keep)
+{
+    const int *lv = f->level[f->len];
+    int n = lv ? f->level_count[f->len] : f->all_count;
+
+    for (int i = 0; i < n; i++)
+        p->entries[i] = f->all[lv ? lv[i] : i];
+    p->count = n;
+
+    int sel = 0;
+    if (keep >= 0)
+    {
+        if (!lv)
+            sel = keep;
+        else
+        {
+            // levels are ascending: binary search for the kept entry
+            int lo = 0, hi = n;
+            while (lo < hi)
+            {
+                int mid = lo + (hi - lo) / 2;
+                if (lv[mid] < keep)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            sel = lo < n && lv[lo] == keep ? lo : 0;
+        }
+    }
+    p->selected = sel;
+    move_selection(p, 0);
+}
+
+/**
+ * @brief Enters filter mode with an empty query.
+ *
+ * @param p Pointer to the panel.
+ * @return 0 on success, -1 when out of memory, already filtering or
+ * still loading.
+ */
+int filter_start(Panel *p)
+{
+    if (p->filter || p->loading)
+        return -1;
+
+    PanelFilter *f = calloc(1, sizeof(PanelFilter));
+    struct dirent **view = malloc((p->count ? p->count : 1) * sizeof(*view));
+    NameIndex *index = name_index_build(p->entries, p->count);
+    if (!f || !view || !index)
+    {
+        free(f);
+        free(view);
+        name_index_free(index);
+        return -1;
+    }
+
+    f->all = p->entries;
+    f->all_count = p->count;
+    f->all_capacity = p->capacity;
+    f->all_selected = p->selected;
+    f->all_scroll = p->scroll;
+    f->index = index;
+
+    p->entries = view;
+    p->capacity = p->count;
+    p->filter = f;
+
+    show_level(p, f, f->all_selected);
+    return 0;
+}
+
+/**
+ * @brief Adds a typed character to the query and narrows the view.
+ *
+ * @param p Pointer to the panel.
+ * @param ch Character (a byte of the name, any case).
+ * @return 0 on success, -1 if the query is full or out of memory.
+ */
+int filter_append(Panel *p, int ch)
+{
+    PanelFilter *f = p->filter;
+    if (!f || f->len == QUERY_MAX)
+        return -1;
+
+    int keep = selected_full(p, f);
+    int *prev = f->level[f->len];
+    int prev_count = prev ? f->level_count[f->len] : f->all_count;
+    char c = (char)((unsigned)(ch - 'A') < 26u ? ch | 0x20 : ch);
+
+    f->query[f->len] = c;
+    f->query[f->len + 1] = '\0';
+
+    // the word being typed: everything after the last space
+    const char *word = f->query;
+    for (int i = 0; i <= f->len; i++)
+        if (f->query[i] == ' ')
+            word = f->query + i + 1;
+    size_t word_len = f->query + f->len + 1 - word;
+
+    int *next = malloc((prev_count ? prev_count : 1) * sizeof(*next));
+    if (!next)
+    {
+        f->query[f->len] = '\0';
+        return -1;
+    }
+
+    int n;
+    if (word_len == 0)
+    {
+        // a space starts a new word and matches what the last one did
+        n = prev_count;
+        for (int i = 0; i < n; i++)
+            next[i] = prev ? prev[i] : i;
+    }
+    else
+        n = name_index_search(f->index, word, word_len, prev, prev_count, next);
+
+    f->len++;
+    f->level[f->len] = next;
+    f->level_count[f->len] = n;
+
+    show_level(p, f, keep);
+    return 0;
+}
+
+/**
+ * @brief Removes the last character; an empty query leaves filter mode
+ * with the selection back where it was.
+ *
+ * @param p Pointer to the panel.
+ */
+void filter_backspace(Panel *p)
+{
+    PanelFilter *f = p->filter;
+    if (!f)
+        return;
+
+    if (f->len == 0)
+    {
+        filter_end(p, 0);
+        return;
+    }
+
+    int keep = selected_full(p, f);
+    free(f->level[f->len]);
+    f->level[f->len] = NULL;
+    f->len--;
+    f->query[f->len] = '\0';
+
+    show_level(p, f, keep);
+}
+
+/**
+ * @brief Leaves filter mode and puts the full list back.
+ *
+ * @param p Pointer to the panel.
+ * @param keep_selection 1: select the entry chosen in the view (jump to
+ * it); 0: restore the selection from before filtering.
+ */
+void filter_end(Panel *p, int keep_selection)
+{
+    PanelFilter *f = p->filter;
+    if (!f)
+        return;
+
+    int sel = keep_selection ? selected_full(p, f) : -1;
+
+    free(p->entries);
+    p->entries = f->all;
+    p->count = f->all_count;
+    p->capacity = f->all_capacity;
+    p->filter = NULL;
+
+    if (sel >= 0)
+    {
+        // centre the chosen entry: it usually comes from far away
+        int visible = p->h - 2;
+        p->selected = sel;
+        p->scroll = sel - visible / 2;
+        if (p->scroll < 0)
+            p->scroll = 0;
+    }
+    else
+    {
+        p->selected = f->all_selected;
+        p->scroll = f->all_scroll;
+    }
+    move_selection(p, 0);
+
+    for (int l = 0; l <= f->len; l++)
+        free(f->level[l]);
+    name_index_free(f->index);
+    free(f);
+}
+
+/**
+ * @brief The query typed so far, NULL when not filtering.
+ */
+const char *filter_query(const Panel *p)
+{
+    return p->filter ? p->filter->query : NULL;
+}
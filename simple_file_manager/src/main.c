@@ -3,11 +3,45 @@
  * @brief Entry point for the file manager application.
  *
  * Initialises the locale and starts the main application loop.
+ * "--bench-load DIR", "--bench-redraw DIR", "--bench-copy FILE DIR",
+ * "--bench-tree SRC DIR", "--bench-tty DIR [PROGRAM]",
+ * "--bench-watch DIR", "--bench-filter [COUNT]", "--bench-size DIR" and
+ * "--bench-view FILE" run benchmarks instead.
  */
 #define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
 #include "app.h"
+#include "bench.h"
 
-int main(void)
+int main(int argc, char *argv[])
 {
+    if (argc == 3 && strcmp(argv[1], "--bench-load") == 0)
+        return bench_load(argv[2]);
+
+    if (argc == 3 && strcmp(argv[1], "--bench-redraw") == 0)
+        return bench_redraw(argv[2]);
+
+    if (argc == 4 && strcmp(argv[1], "--bench-copy") == 0)
+        return bench_copy(argv[2], argv[3]);
+
+    if (argc == 4 && strcmp(argv[1], "--bench-tree") == 0)
+        return bench_tree(argv[2], argv[3]);
+
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--bench-tty") == 0)
+        return bench_tty(argv[2], argc == 4 ? argv[3] : NULL);
+
+    if (argc == 3 && strcmp(argv[1], "--bench-watch") == 0)
+        return bench_watch(argv[2]);
+
+    if ((argc == 2 || argc == 3) && strcmp(argv[1], "--bench-filter") == 0)
+        return bench_filter(argc == 3 ? atoi(argv[2]) : 0);
+
+    if (argc == 3 && strcmp(argv[1], "--bench-size") == 0)
+        return bench_size(argv[2]);
+
+    if (argc == 3 && strcmp(argv[1], "--bench-view") == 0)
+        return bench_view(argv[2]);
+
     return run_app();
-}
\ No newline at end of file
+}
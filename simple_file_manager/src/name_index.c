@@ -0,0 +1,381 @@
+/**
+ * @file name_index.c
+ * @brief Case-insensitive substring search over a panel's names.
+ *
+ * Responsible for:
+ * - packing lower-cased names into one NUL-separated block
+ * - substring search with AVX2 or SSE2, chosen at run time, and memmem()
+ *   elsewhere
+ * - searching all names in one pass, or only a list of candidates
+ *
+ * The vector search compares the first and the last byte of the needle
+ * at 16 or 32 positions at once and only calls memcmp() where both
+ * match. A needle never contains NUL, so a match never spans two names.
+ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "name_index.h"
+
+/* vector loads may run past the end of a name by the needle length plus
+ * one vector; the block is padded so they stay inside the allocation */
+#define NEEDLE_MAX 255
+#define BLOCK_PAD (NEEDLE_MAX + 64)
+
+/**
+ * @struct NameIndex
+ * @brief Lower-cased names, NUL-separated, with their offsets.
+ *
+ * start[i] is where name i begins; start[count] is the block length.
+ */
+struct NameIndex
+{
+    char *block;
+    uint32_t *start;
+    int count;
+};
+
+typedef const char *(*find_fn)(const char *hay, size_t n, const char *needle, size_t k);
+typedef int (*filter_fn)(const NameIndex *ix, const int *candidates, int n,
+    const char *needle, size_t k, int *out);
+
+static inline const char *find_scalar(const char *hay, size_t n, const char *needle, size_t k)
+{
+    return memmem(hay, n, needle, k);
+}
+
+/* the candidate loops are written out per instruction set so the search
+ * inlines into them: most names are shorter than one or two vectors */
+
+static int filter_scalar(const NameIndex *ix, const int *candidates, int n,
+    const char *needle, size_t k, int *out)
+{
+    int matches = 0;
+    for (int c = 0; c < n; c++)
+    {
+        uint32_t off = ix->start[candidates[c]];
+        size_t len = ix->start[candidates[c] + 1] - off - 1;
+        if (len >= k && find_scalar(ix->block + off, len, needle, k))
+            out[matches++] = candidates[c];
+    }
+    return matches;
+}
+
+#if defined(__x86_64__)
+
+static inline const char *find_sse2(const char *hay, size_t n, const char *needle, size_t k)
+{
+    if (k == 1)
+        return memchr(hay, needle[0], n);
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[k - 1]);
+
+    for (size_t i = 0; i + k <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + k - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+        while (mask)
+        {
+            size_t pos = i + __builtin_ctz(mask);
+            if (pos + k > n)
+                return NULL;
+            if (memcmp(hay + pos + 1, needle + 1, k - 2) == 0)
+                return hay + pos;
+            mask &= mask - 1;
+        }
+    }
+    return NULL;
+}
+
+static int filter_sse2(const NameIndex *ix, const int *candidates, int n,
+    const char *needle, size_t k, int *out)
+{
+    int matches = 0;
+    for (int c = 0; c < n; c++)
+    {
+        uint32_t off = ix->start[candidates[c]];
+        size_t len = ix->start[candidates[c] + 1] - off - 1;
+        if (len >= k && find_sse2(ix->block + off, len, needle, k))
+            out[matches++] = candidates[c];
+    }
+    return matches;
+}
+
+__attribute__((target("avx2")))
+static inline const char *find_avx2(const char *hay, size_t n, const char *needle, size_t k)
+{
+    if (k == 1)
+        return memchr(hay, needle[0], n);
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+
+    for (size_t i = 0; i + k <= n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(hay + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(hay + i + k - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+
+        while (mask)
+        {
+            size_t pos = i + __builtin_ctz(mask);
+            if (pos + k > n)
+                return NULL;
+            if (memcmp(hay + pos + 1, needle + 1, k - 2) == 0)
+                return hay + pos;
+            mask &= mask - 1;
+        }
+    }
+    return NULL;
+}
+
+__attribute__((target("avx2")))
+static int filter_avx2(const NameIndex *ix, const int *candidates, int n,
+    const char *needle, size_t k, int *out)
+{
+    int matches = 0;
+    for (int c = 0; c < n; c++)
+    {
+        uint32_t off = ix->start[candidates[c]];
+        size_t len = ix->start[candidates[c] + 1] - off - 1;
+        if (len >= k && find_avx2(ix->block + off, len, needle, k))
+            out[matches++] = candidates[c];
+    }
+    return matches;
+}
+
+#endif
+
+static find_fn find;
+static filter_fn filter;
+static int force_scalar;
+
+static void pick(void)
+{
+    find = find_scalar;
+    filter = filter_scalar;
+#if defined(__x86_64__)
+    if (force_scalar)
+        return;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        find = find_avx2;
+        filter = filter_avx2;
+        return;
+    }
+    find = find_sse2;
+    filter = filter_sse2;
+#endif
+}
+
+/**
+ * @brief Name of the search in use: "avx2", "sse2" or "memmem".
+ */
+const char *name_index_method(void)
+{
+    if (!find)
+        pick();
+#if defined(__x86_64__)
+    if (find == find_avx2)
+        return "avx2";
+    if (find == find_sse2)
+        return "sse2";
+#endif
+    return "memmem";
+}
+
+/**
+ * @brief Uses memmem() instead of the vector search (for benchmarks).
+ */
+void name_index_force_scalar(int on)
+{
+    force_scalar = on;
+    pick();
+}
+
+/**
+ * @brief Lower-cases ASCII letters in place; other bytes (UTF-8
+ * included) are left alone.
+ */
+static void lower_ascii(char *s, size_t n)
+{
+    size_t i = 0;
+#if defined(__x86_64__)
+    // signed compares: 'A' - 1 < c < 'Z' + 1 never holds for bytes >= 0x80
+    const __m128i lo = _mm_set1_epi8('A' - 1);
+    const __m128i hi = _mm_set1_epi8('Z' + 1);
+    const __m128i bit = _mm_set1_epi8(0x20);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+        _mm_storeu_si128((__m128i *)(s + i), _mm_or_si128(v, _mm_and_si128(upper, bit)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        unsigned char c = (unsigned char)s[i];
+        s[i] = (char)((unsigned)(c - 'A') < 26u ? c | 0x20 : c);
+    }
+}
+
+/**
+ * @brief Packs the names of @p entries, lower-cased, into a new index.
+ *
+ * @param entries Entries; indices returned by searches refer to them.
+ * @param count Number of entries.
+ * @return The index, or NULL when out of memory.
+ */
+NameIndex *name_index_build(struct dirent **entries, int count)
+{
+    if (!find)
+        pick();
+
+    NameIndex *ix = calloc(1, sizeof(NameIndex));
+    if (!ix)
+        return NULL;
+
+    // one pass: the entries are sorted, not laid out in order, so each
+    // name is a cache miss; fetch a few ahead instead of sizing first
+    size_t cap = (size_t)count * 48 + BLOCK_PAD;
+    size_t total = 0;
+    ix->block = malloc(cap);
+    ix->start = malloc((count + 1) * sizeof(*ix->start));
+    if (!ix->block || !ix->start)
+    {
+        name_index_free(ix);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (i + 16 < count)
+            __builtin_prefetch(entries[i + 16]->d_name);
+
+        const char *s = entries[i]->d_name;
+        size_t len = strlen(s) + 1;
+        if (total + len + BLOCK_PAD > cap)
+        {
+            char *grown = total + len + BLOCK_PAD > UINT32_MAX ? NULL :
+                realloc(ix->block, cap * 2);
+            if (!grown)
+            {
+                name_index_free(ix);
+                return NULL;
+            }
+            ix->block = grown;
+            cap *= 2;
+        }
+
+        ix->start[i] = (uint32_t)total;
+        memcpy(ix->block + total, s, len);
+        total += len;
+    }
+    memset(ix->block + total, 0, BLOCK_PAD);
+    lower_ascii(ix->block, total);
+    ix->start[count] = (uint32_t)total;
+    ix->count = count;
+    return ix;
+}
+
+void name_index_free(NameIndex *ix)
+{
+    if (!ix)
+        return;
+    free(ix->block);
+    free(ix->start);
+    free(ix);
+}
+
+/**
+ * @brief Index of the name holding block offset @p off, searching
+ * forward from name @p from (hits come in ascending order).
+ */
+static int name_at(const NameIndex *ix, int from, uint32_t off)
+{
+    // gallop: the next hit is usually a few names on
+    int lo = from, step = 1;
+    while (lo + step < ix->count && ix->start[lo + step] <= off)
+    {
+        lo += step;
+        step *= 2;
+    }
+
+    int hi = lo + step < ix->count ? lo + step : ix->count;
+    while (hi - lo > 1)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (ix->start[mid] <= off)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief Finds the names containing @p needle, ignoring ASCII case.
+ *
+ * @param ix Index.
+ * @param needle Lower-case needle, no NUL; empty matches everything.
+ * @param len Needle length (at most 255).
+ * @param candidates Indices to look at, in order, or NULL for all names.
+ * @param ncandidates Number of candidates.
+ * @param out Matching indices in ascending order; room for all
+ * candidates (or all names).
+ * @return Number of matches.
+ */
+int name_index_search(const NameIndex *ix, const char *needle, size_t len,
+    const int *candidates, int ncandidates, int *out)
+{
+    int n = 0;
+
+    if (len > NEEDLE_MAX)
+        len = NEEDLE_MAX;
+
+    if (!candidates)
+    {
+        if (len == 0)
+        {
+            for (int i = 0; i < ix->count; i++)
+                out[n++] = i;
+            return n;
+        }
+
+        // one scan over the whole block, skipping to the next name on a hit
+        size_t end = ix->start[ix->count];
+        size_t off = 0;
+        int i = 0;
+        while (off < end)
+        {
+            const char *hit = find(ix->block + off, end - off, needle, len);
+            if (!hit)
+                break;
+            i = name_at(ix, i, (uint32_t)(hit - ix->block));
+            out[n++] = i;
+            off = ix->start[i + 1];
+        }
+        return n;
+    }
+
+    if (len == 0)
+    {
+        memcpy(out, candidates, ncandidates * sizeof(*out));
+        return ncandidates;
+    }
+    return filter(ix, candidates, ncandidates, needle, len, out);
+}
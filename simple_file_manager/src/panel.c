@@ -3,7 +3,8 @@
  * @brief Module for working with file panels.
  *
  * Responsible for:
- * - loading the directory
+ * - loading the directory (in the background, see dir_loader.c)
+ * - following changes made to it (inotify, see dir_watch.c)
  * - navigation
  * - freeing memory
  */
@@ -15,33 +16,48 @@
 #include <limits.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include "panel.h"
+#include "dir_loader.h"
+#include "dir_watch.h"
+#include "file_type.h"
+#include "filter.h"
+#include "dir_size.h"
 
 /**
  * @brief Frees the resources of the panel.
  *
- * Frees the dirent array,
- * obtained via scandir().
+ * Frees the entry array and drops the panel's reference to the
+ * loader, which owns the entries themselves. A loader that is still
+ * reading notices the cancellation and frees itself.
  *
  * @param p Pointer to the panel.
  */
 void free_panel(Panel *p)
 {
-    if (!p->entries) 
-        return;
-
-    for (int i = 0; i < p->count; i++)
-        free(p->entries[i]);
+    filter_end(p, 0);
+    dir_size_stop(p);
 
     free(p->entries);
     p->entries = NULL;
+    p->count = 0;
+    p->capacity = 0;
+    p->loading = 0;
+
+    // the next loader may reuse these addresses for other entries
+    p->drawn_valid = 0;
+
+    dir_loader_release(p->loader);
+    p->loader = NULL;
 }
 
 /**
- * @brief Loads the contents of the current directory of the panel.
+ * @brief Starts loading the contents of the current directory of the panel.
  *
- * Uses scandir() to obtain a list of files.
+ * Returns immediately; entries appear through panel_poll() as the
+ * background reader publishes them. Navigating away cancels it.
  *
  * @param p Pointer to the panel.
  * @return 0 on success, -1 on error.
@@ -49,21 +65,322 @@ void free_panel(Panel *p)
 int load_directory(Panel *p)
 {
     free_panel(p);
-
-    p->count = scandir(p->cwd, &p->entries, NULL, alphasort);
-    if (p->count < 0)
-        return -1;
+    file_types_forget(p);
 
     p->selected = 0;
     p->scroll = 0;
+    p->reselect[0] = '\0';
+
+    // watch first: whatever changes while reading is applied afterwards
+    p->watching = p->watch && dir_watch_set(p->watch, p->cwd) == 0;
+
+    int fd = open(p->cwd, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    p->loader = dir_loader_start(fd);
+    if (!p->loader)
+        return -1;
+
+    p->loading = 1;
+    return 0;
+}
+
+/**
+ * @brief Picks up entries published by the background reader.
+ *
+ * While reading, new entries are appended unsorted. When the sorted
+ * list arrives the selection follows the same entry, or the name in
+ * reselect after a re-read; an untouched selection lands on "..", as
+ * before.
+ *
+ * @param p Pointer to the panel.
+ * @return 1 if the entry list changed, 0 otherwise.
+ */
+static int poll_loader(Panel *p)
+{
+    struct dirent *sel = p->count > 0 ? p->entries[p->selected] : NULL;
+    int untouched = (p->selected == 0 && p->scroll == 0);
+    int before = p->count;
+    struct dirent **before_entries = p->entries;
+    int error;
+
+    int done = dir_loader_poll(p->loader, &p->entries, &p->count, &p->capacity, &error);
+    if (!done)
+        return p->count != before;
+
+    p->loading = 0;
+    if (p->entries == before_entries && p->count == before)
+        return 0;
 
     for (int i = 0; i < p->count; i++)
-        if (strcmp(p->entries[i]->d_name, "..") == 0)
+    {
+        int match;
+        if (p->reselect[0])
+            match = strcmp(p->entries[i]->d_name, p->reselect) == 0;
+        else if (untouched)
+            match = strcmp(p->entries[i]->d_name, "..") == 0;
+        else
+            match = p->entries[i] == sel;
+
+        if (match)
+        {
             p->selected = i;
+            break;
+        }
+    }
+    p->reselect[0] = '\0';
+    move_selection(p, 0);
+    return 1;
+}
+
+/**
+ * @brief First index whose name does not sort before @p name.
+ */
+static int lower_bound(Panel *p, const char *name)
+{
+    int lo = 0, hi = p->count;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (strcoll(p->entries[mid]->d_name, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+    return strcoll(*(const char * const *)a, *(const char * const *)b);
+}
+
+/**
+ * @brief Applies changed names to the sorted entry list in place.
+ *
+ * Each name is looked up on disk (fstatat) and in the list (binary
+ * search), so creates, deletes, renames and replacements all come down
+ * to "remove the old entry, insert the new one". Removals are compacted
+ * in one pass and the sorted insertions merged from the back in
+ * another, so a batch costs one walk over the list, not one per name.
+ *
+ * @param p Pointer to the panel (finished loading).
+ * @param names Changed names, sorted here; duplicates allowed.
+ * @param n Number of names.
+ * @return 0 on success, -1 if the directory must be re-read.
+ */
+static int apply_changes(Panel *p, char **names, int n)
+{
+    int dirfd = open(p->cwd, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+        return -1;
 
+    qsort(names, n, sizeof(*names), compare_strings);
+
+    int *removed = malloc(n * sizeof(*removed));
+    struct dirent **added = malloc(n * sizeof(*added));
+    if (!removed || !added)
+    {
+        free(removed);
+        free(added);
+        close(dirfd);
+        return -1;
+    }
+
+    int nremoved = 0, nadded = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (i > 0 && strcmp(names[i], names[i - 1]) == 0)
+            continue;
+
+        struct stat st;
+        int exists = fstatat(dirfd, names[i], &st, AT_SYMLINK_NOFOLLOW) == 0;
+        int pos = lower_bound(p, names[i]);
+        int found = pos < p->count && strcmp(p->entries[pos]->d_name, names[i]) == 0;
+
+        if (found)
+        {
+            struct dirent *e = p->entries[pos];
+            if (exists && e->d_ino == st.st_ino && e->d_type == IFTODT(st.st_mode))
+                continue;
+            removed[nremoved++] = pos;
+        }
+        if (exists)
+        {
+            struct dirent *e = dir_loader_add(p->loader, names[i], st.st_ino,
+                IFTODT(st.st_mode));
+            if (e)
+                added[nadded++] = e;
+        }
+    }
+    close(dirfd);
+
+    struct dirent *sel = p->count > 0 ? p->entries[p->selected] : NULL;
+    int sel_index = p->selected;
+
+    if (p->count + nadded > p->capacity)
+    {
+        int cap = p->capacity ? p->capacity : 256;
+        while (cap < p->count + nadded)
+            cap *= 2;
+        struct dirent **grown = realloc(p->entries, cap * sizeof(*grown));
+        if (!grown)
+        {
+            free(removed);
+            free(added);
+            return -1;
+        }
+        p->entries = grown;
+        p->capacity = cap;
+    }
+
+    if (nremoved)
+    {
+        for (int i = 0; i < nremoved; i++)
+        {
+            if (p->entries[removed[i]] == sel)
+                sel = NULL;
+            dir_loader_drop(p->loader, p->entries[removed[i]]);
+            p->entries[removed[i]] = NULL;
+        }
+
+        int w = 0;
+        for (int i = 0; i < p->count; i++)
+            if (p->entries[i])
+                p->entries[w++] = p->entries[i];
+        p->count = w;
+    }
+
+    // added is in name order: merge it in from the back
+    int i = p->count - 1, j = nadded - 1, w = p->count + nadded - 1;
+    while (j >= 0)
+    {
+        if (i >= 0 && dir_entry_compare(&p->entries[i], &added[j]) > 0)
+            p->entries[w--] = p->entries[i--];
+        else
+            p->entries[w--] = added[j--];
+    }
+    p->count += nadded;
+
+    free(removed);
+    free(added);
+
+    // the selection stays on its entry, or near where it was
+    if (sel)
+    {
+        int pos = lower_bound(p, sel->d_name);
+        p->selected = pos < p->count ? pos : p->count - 1;
+    }
+    else
+        p->selected = sel_index < p->count ? sel_index : p->count - 1;
+    if (p->selected < 0)
+        p->selected = 0;
+
+    move_selection(p, 0);
     return 0;
 }
 
+/**
+ * @brief Re-reads the directory, keeping the selected name.
+ */
+static void rescan(Panel *p)
+{
+    char name[sizeof(p->reselect)] = "";
+    if (p->count > 0)
+        snprintf(name, sizeof(name), "%s", p->entries[p->selected]->d_name);
+
+    load_directory(p);
+    snprintf(p->reselect, sizeof(p->reselect), "%s", name);
+}
+
+/**
+ * @brief Moves to the nearest ancestor that still exists.
+ */
+static void leave_removed_directory(Panel *p)
+{
+    char *slash;
+
+    while ((slash = strrchr(p->cwd, '/')) != NULL)
+    {
+        if (slash == p->cwd)
+        {
+            p->cwd[1] = '\0';
+            break;
+        }
+        *slash = '\0';
+
+        struct stat st;
+        if (stat(p->cwd, &st) == 0 && S_ISDIR(st.st_mode))
+            break;
+    }
+    load_directory(p);
+}
+
+/**
+ * @brief Brings the panel up to date; called once per frame.
+ *
+ * Picks up entries from the background reader and the running total
+ * of a size walk, and applies changes the watch saw. The watch is
+ * drained even while loading so its queue does not overflow; those
+ * names are applied once the sorted list is in.
+ * An overflowed queue means a re-read, and so does an arena mostly
+ * taken by entries that are gone; a removed directory means a move to
+ * its nearest surviving parent.
+ *
+ * @param p Pointer to the panel.
+ * @return 1 if the entry list or a shown size changed, 0 otherwise.
+ */
+int panel_poll(Panel *p)
+{
+    int flags = dir_watch_read(p->watch);
+
+    if (flags & WATCH_GONE)
+    {
+        leave_removed_directory(p);
+        return 1;
+    }
+    if (flags & WATCH_OVERFLOW)
+    {
+        rescan(p);
+        return 1;
+    }
+
+    int changed = dir_size_poll(p);
+    if (p->loader && p->loading)
+        changed |= poll_loader(p);
+
+    // changes wait while filtering: the view points into the list
+    if (p->loader && !p->loading && !p->filter && (flags & WATCH_CHANGED))
+    {
+        char **names;
+        int count;
+
+        // replaced and removed entries are dead arena space until the
+        // loader goes; a re-read gives it back once it is most of it
+        dir_watch_take(p->watch, &names, &count);
+        if (apply_changes(p, names, count) < 0 || dir_loader_mostly_dead(p->loader))
+            rescan(p);
+        dir_watch_free_names(names, count);
+        changed = 1;
+    }
+    return changed;
+}
+
+/**
+ * @brief Shows the result of an operation on the panel's directory.
+ *
+ * A watched panel is already being updated in place; otherwise the
+ * directory is read again.
+ *
+ * @param p Pointer to the panel.
+ */
+void panel_refresh(Panel *p)
+{
+    if (!p->watching)
+        load_directory(p);
+}
+
 /**
  * @brief Navigate to the selected directory.
  *
@@ -73,6 +390,9 @@ int load_directory(Panel *p)
  */
 void enter_directory(Panel *p)
 {
+    if (p->count <= 0)
+        return;
+
     struct dirent *e = p->entries[p->selected];
     if (e->d_type != DT_DIR) 
         return;
@@ -0,0 +1,154 @@
+/**
+ * @file size_cache.c
+ * @brief Directory sizes remembered across visits.
+ *
+ * Responsible for:
+ * - a process-wide table of subtree totals keyed by (dev, ino)
+ * - treating a total as stale once the directory's mtime moves on
+ *
+ * Shared by the size workers and the UI, so guarded by a mutex; stores
+ * happen once per finished directory, lookups once per drawn one.
+ *
+ * A directory's mtime only covers its own entries: a file rewritten in
+ * place deeper down is not noticed until something above it changes.
+ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "size_cache.h"
+
+#define SIZE_CACHE_INIT 1024
+#define SIZE_CACHE_MAX (1 << 22)
+
+/**
+ * @struct SizeSlot
+ * @brief One cached total; ino 0 marks an empty slot.
+ */
+typedef struct SizeSlot
+{
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_ns;
+    uint64_t bytes;
+} SizeSlot;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static SizeSlot *slots;
+static size_t cap;
+static size_t used;
+
+static size_t slot_of(uint64_t dev, uint64_t ino, size_t mask)
+{
+    uint64_t h = (dev * 0x9E3779B97F4A7C15ull) ^ (ino * 0xC2B2AE3D27D4EB4Full);
+    return (size_t)(h ^ (h >> 29)) & mask;
+}
+
+static SizeSlot *lookup(uint64_t dev, uint64_t ino)
+{
+    size_t mask = cap - 1;
+    for (size_t i = slot_of(dev, ino, mask);; i = (i + 1) & mask)
+    {
+        SizeSlot *s = &slots[i];
+        if (s->ino == 0 || (s->ino == ino && s->dev == dev))
+            return s;
+    }
+}
+
+static int grow(void)
+{
+    size_t new_cap = cap ? cap * 2 : SIZE_CACHE_INIT;
+    SizeSlot *old = slots;
+    size_t old_cap = cap;
+
+    // past the limit start over rather than grow without bound
+    if (new_cap > SIZE_CACHE_MAX)
+    {
+        memset(slots, 0, cap * sizeof(SizeSlot));
+        used = 0;
+        return 0;
+    }
+
+    SizeSlot *fresh = calloc(new_cap, sizeof(SizeSlot));
+    if (!fresh)
+        return -1;
+    slots = fresh;
+    cap = new_cap;
+    for (size_t i = 0; i < old_cap; i++)
+        if (old[i].ino)
+            *lookup(old[i].dev, old[i].ino) = old[i];
+    free(old);
+    return 0;
+}
+
+/**
+ * @brief Looks up the total of a directory.
+ *
+ * @param key dev, ino and mtime of the directory (size is ignored).
+ * @param bytes Set to the cached total.
+ * @return 1 if a total for this version of the directory is known.
+ */
+int size_cache_find(const FileKey *key, uint64_t *bytes)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&lock);
+    if (cap && key->ino)
+    {
+        SizeSlot *s = lookup(key->dev, key->ino);
+        if (s->ino && s->mtime_ns == key->mtime_ns)
+        {
+            *bytes = s->bytes;
+            found = 1;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return found;
+}
+
+/**
+ * @brief Remembers the total of a directory, replacing older versions.
+ *
+ * @param key dev, ino and mtime of the directory.
+ * @param bytes Disk usage of everything below it, itself included.
+ */
+void size_cache_store(const FileKey *key, uint64_t bytes)
+{
+    if (!key->ino)
+        return;
+
+    pthread_mutex_lock(&lock);
+    if ((used + 1) * 2 <= cap || grow() == 0)
+    {
+        SizeSlot *s = lookup(key->dev, key->ino);
+        if (!s->ino)
+            used++;
+        *s = (SizeSlot){ key->dev, key->ino, key->mtime_ns, bytes };
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Whether nothing was ever stored (saves the UI a stat per row).
+ */
+int size_cache_empty(void)
+{
+    pthread_mutex_lock(&lock);
+    int empty = used == 0;
+    pthread_mutex_unlock(&lock);
+    return empty;
+}
+
+/**
+ * @brief Forgets every total (for benchmarks and shutdown).
+ */
+void size_cache_clear(void)
+{
+    pthread_mutex_lock(&lock);
+    free(slots);
+    slots = NULL;
+    cap = used = 0;
+    pthread_mutex_unlock(&lock);
+}
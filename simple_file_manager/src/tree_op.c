@@ -0,0 +1,999 @@
+/**
+ * @file tree_op.c
+ * @brief Background recursive copy, move, delete and size.
+ *
+ * Responsible for:
+ * - walking the tree on a pool of worker threads
+ * - work stealing: owners take their newest task, thieves the oldest
+ * - opening, creating and removing entries relative to directory fds
+ * - rename() as the fast path for moves
+ * - progress counters and cancellation
+ * - disk usage: statx() with only the fields it needs, hard links
+ *   counted once, finished directories remembered in the size cache
+ *
+ * Every task holds a reference on the directory node it lives in and
+ * every node on its parent, so a directory is finished (removed after
+ * a move or delete, given its mode back after a copy) exactly when the
+ * last entry below it is done.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+
+#include "tree_op.h"
+#include "copy_engine.h"
+#include "size_cache.h"
+
+#define GETDENTS_BUF (64 << 10)
+#define DEQUE_INIT 256
+#define MAX_THREADS 32
+#define INODE_SET_INIT 1024
+
+#define SIZE_MASK (STATX_TYPE | STATX_INO | STATX_NLINK | STATX_BLOCKS)
+
+/**
+ * @struct linux_dirent64
+ * @brief Record layout returned by getdents64().
+ */
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/**
+ * @struct Node
+ * @brief A directory being worked on.
+ *
+ * pending counts the scan in progress, the unfinished entries inside
+ * and nothing else; the root node has no parent and no name.
+ */
+typedef struct Node
+{
+    struct Node *parent;
+    int src_fd;
+    int dst_fd;
+    mode_t mode;
+    atomic_int pending;
+
+    /* TREE_SIZE: total below, and whether all of it could be read */
+    FileKey key;
+    atomic_ullong bytes;
+    atomic_int incomplete;
+
+    char name[];
+} Node;
+
+/**
+ * @struct Task
+ * @brief One entry to process, named relative to its parent node.
+ */
+typedef struct Task
+{
+    Node *parent;
+    const char *dst_name; /**< NULL: same as name (only the root differs) */
+    unsigned char type;   /**< DT_* from getdents64(), may be DT_UNKNOWN */
+    char name[];
+} Task;
+
+/**
+ * @struct Worker
+ * @brief A pool thread and its deque.
+ *
+ * The owner pushes and pops at the tail, so it goes depth first and
+ * keeps few directories open; thieves take from the head, which holds
+ * the biggest unexplored subtrees.
+ */
+typedef struct Worker
+{
+    pthread_t thread;
+    struct TreeOp *op;
+    int id;
+
+    pthread_mutex_t lock;
+    Task **items;
+    size_t head, tail, cap; /* ring indices, cap is a power of two */
+
+    char *buf;
+} Worker;
+
+/**
+ * @struct InodeSet
+ * @brief Files with more than one link already counted by a size walk.
+ */
+typedef struct InodeSet
+{
+    pthread_mutex_t lock;
+    uint64_t *keys; /* dev, ino pairs; ino 0 is empty */
+    size_t cap;
+    size_t used;
+} InodeSet;
+
+/**
+ * @struct TreeOp
+ * @brief Shared state of one operation.
+ */
+struct TreeOp
+{
+    TreeOpKind kind;
+    int threads;
+    int started;
+    Worker workers[MAX_THREADS];
+    Node *root;
+    char *root_names;
+
+    atomic_int cancel;
+    atomic_int cross_device;  /**< a move hit EXDEV: copy and delete */
+    atomic_int methods;       /**< COPY_CLONE dropped once it fails */
+    atomic_long outstanding;  /**< tasks queued or running */
+    atomic_long unscanned;    /**< directories not read yet */
+
+    atomic_ullong entries_done;
+    atomic_ullong entries_total;
+    atomic_ullong bytes_done;
+    atomic_ullong errors;
+    atomic_int first_error;
+
+    InodeSet linked;
+
+    /* idle workers sleep on idle_cond until generation moves on */
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    atomic_ulong generation;
+    atomic_int idle;
+    atomic_int done;
+};
+
+/**
+ * @struct FileProgress
+ * @brief Turns the copy engine's per-file totals into op-wide bytes.
+ */
+typedef struct FileProgress
+{
+    TreeOp *op;
+    off_t last;
+} FileProgress;
+
+/**
+ * @brief Returns a sensible pool size: metadata calls mostly wait on
+ * the disk, so twice the CPUs, between 4 and 16.
+ */
+int tree_op_default_threads(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    long n = cpus > 0 ? cpus * 2 : 4;
+
+    if (n < 4)
+        n = 4;
+    if (n > 16)
+        n = 16;
+    return (int)n;
+}
+
+static void fail(TreeOp *op, int err)
+{
+    int zero = 0;
+    atomic_fetch_add(&op->errors, 1);
+    atomic_compare_exchange_strong(&op->first_error, &zero, err);
+}
+
+/**
+ * @brief Records a failure below @p n: its total is not cached.
+ */
+static void fail_in(TreeOp *op, Node *n, int err)
+{
+    atomic_store(&n->incomplete, 1);
+    fail(op, err);
+}
+
+static int is_cancelled(TreeOp *op)
+{
+    return atomic_load_explicit(&op->cancel, memory_order_relaxed);
+}
+
+static size_t inode_slot(uint64_t dev, uint64_t ino, size_t mask)
+{
+    uint64_t h = (dev * 0x9E3779B97F4A7C15ull) ^ (ino * 0xC2B2AE3D27D4EB4Full);
+    return (size_t)(h ^ (h >> 29)) & mask;
+}
+
+static uint64_t *inode_find(InodeSet *set, uint64_t dev, uint64_t ino)
+{
+    size_t mask = set->cap - 1;
+    for (size_t i = inode_slot(dev, ino, mask);; i = (i + 1) & mask)
+    {
+        uint64_t *k = &set->keys[2 * i];
+        if (k[1] == 0 || (k[0] == dev && k[1] == ino))
+            return k;
+    }
+}
+
+/**
+ * @brief Adds a hard linked file to the set.
+ *
+ * @return 1 the first time a file is seen, 0 after that. Out of memory
+ * every link counts, as it would without the set.
+ */
+static int inode_set_add(InodeSet *set, uint64_t dev, uint64_t ino)
+{
+    int added = 1;
+
+    pthread_mutex_lock(&set->lock);
+    if ((set->used + 1) * 2 > set->cap)
+    {
+        size_t cap = set->cap ? set->cap * 2 : INODE_SET_INIT;
+        uint64_t *keys = calloc(cap, 2 * sizeof(uint64_t));
+        if (!keys)
+        {
+            pthread_mutex_unlock(&set->lock);
+            return 1;
+        }
+
+        uint64_t *old = set->keys;
+        size_t old_cap = set->cap;
+        set->keys = keys;
+        set->cap = cap;
+        for (size_t i = 0; i < old_cap; i++)
+            if (old[2 * i + 1])
+                memcpy(inode_find(set, old[2 * i], old[2 * i + 1]), &old[2 * i],
+                    2 * sizeof(uint64_t));
+        free(old);
+    }
+
+    uint64_t *k = inode_find(set, dev, ino);
+    if (k[1])
+        added = 0;
+    else
+    {
+        k[0] = dev;
+        k[1] = ino;
+        set->used++;
+    }
+    pthread_mutex_unlock(&set->lock);
+    return added;
+}
+
+/**
+ * @brief Counts @p bytes of disk usage under @p n.
+ */
+static void add_bytes(TreeOp *op, Node *n, uint64_t bytes)
+{
+    atomic_fetch_add_explicit(&n->bytes, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&op->bytes_done, bytes, memory_order_relaxed);
+}
+
+static void push(Worker *w, Task *t)
+{
+    pthread_mutex_lock(&w->lock);
+    if (w->tail - w->head == w->cap)
+    {
+        size_t cap = w->cap ? w->cap * 2 : DEQUE_INIT;
+        Task **items = malloc(cap * sizeof(*items));
+        if (!items)
+        {
+            pthread_mutex_unlock(&w->lock);
+            abort();
+        }
+        for (size_t i = w->head; i < w->tail; i++)
+            items[i & (cap - 1)] = w->items[i & (w->cap - 1)];
+        free(w->items);
+        w->items = items;
+        w->cap = cap;
+    }
+    w->items[w->tail++ & (w->cap - 1)] = t;
+    pthread_mutex_unlock(&w->lock);
+}
+
+static Task *pop(Worker *w)
+{
+    Task *t = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->tail != w->head)
+        t = w->items[--w->tail & (w->cap - 1)];
+    pthread_mutex_unlock(&w->lock);
+    return t;
+}
+
+static Task *steal(Worker *w)
+{
+    TreeOp *op = w->op;
+
+    for (int i = 1; i < op->threads; i++)
+    {
+        Worker *v = &op->workers[(w->id + i) % op->threads];
+        Task *t = NULL;
+
+        pthread_mutex_lock(&v->lock);
+        if (v->tail != v->head)
+            t = v->items[v->head++ & (v->cap - 1)];
+        pthread_mutex_unlock(&v->lock);
+
+        if (t)
+            return t;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Wakes idle workers after new tasks were pushed.
+ */
+static void announce(TreeOp *op)
+{
+    atomic_fetch_add(&op->generation, 1);
+    if (atomic_load(&op->idle) == 0)
+        return;
+
+    pthread_mutex_lock(&op->idle_lock);
+    pthread_cond_broadcast(&op->idle_cond);
+    pthread_mutex_unlock(&op->idle_lock);
+}
+
+/**
+ * @brief Marks the operation over and wakes everyone.
+ */
+static void finish_all(TreeOp *op)
+{
+    pthread_mutex_lock(&op->idle_lock);
+    atomic_store(&op->done, 1);
+    pthread_cond_broadcast(&op->idle_cond);
+    pthread_mutex_unlock(&op->idle_lock);
+}
+
+/**
+ * @brief Queues entry @p name of @p parent on worker @p w.
+ */
+static int add_task(Worker *w, Node *parent, const char *name,
+    const char *dst_name, unsigned char type)
+{
+    TreeOp *op = w->op;
+    size_t len = strlen(name);
+
+    Task *t = malloc(sizeof(Task) + len + 1);
+    if (!t)
+        return -1;
+    t->parent = parent;
+    t->dst_name = dst_name;
+    t->type = type;
+    memcpy(t->name, name, len + 1);
+
+    atomic_fetch_add(&parent->pending, 1);
+    atomic_fetch_add(&op->outstanding, 1);
+    atomic_fetch_add(&op->entries_total, 1);
+    if (type == DT_DIR || type == DT_UNKNOWN)
+        atomic_fetch_add(&op->unscanned, 1);
+
+    push(w, t);
+    return 0;
+}
+
+/**
+ * @brief Drops one reference on @p n; the last one finishes the
+ * directory and drops its reference on the parent in turn.
+ */
+static void node_put(TreeOp *op, Node *n)
+{
+    while (n && atomic_fetch_sub(&n->pending, 1) == 1)
+    {
+        Node *parent = n->parent;
+
+        if (parent && op->kind == TREE_SIZE)
+        {
+            // a cancelled or partly unreadable total is shown, not kept
+            uint64_t total = atomic_load(&n->bytes);
+            if (!is_cancelled(op) && !atomic_load(&n->incomplete))
+                size_cache_store(&n->key, total);
+            else
+                atomic_store(&parent->incomplete, 1);
+            atomic_fetch_add(&parent->bytes, total);
+        }
+
+        if (parent)
+        {
+            // also after a cancel: the copy was made 0700 to fill it
+            if (n->dst_fd >= 0 && fchmod(n->dst_fd, n->mode & 07777) < 0)
+                fail(op, errno);
+
+            // a copy keeps its source; a failed child leaves it non-empty
+            if ((op->kind == TREE_DELETE || op->kind == TREE_MOVE) &&
+                !is_cancelled(op) &&
+                unlinkat(parent->src_fd, n->name, AT_REMOVEDIR) < 0 &&
+                errno != ENOTEMPTY && errno != EEXIST)
+                fail(op, errno);
+        }
+        if (parent)
+            atomic_fetch_add(&op->entries_done, 1);
+
+        if (n->src_fd >= 0)
+            close(n->src_fd);
+        if (n->dst_fd >= 0)
+            close(n->dst_fd);
+        free(n);
+        n = parent;
+    }
+}
+
+static int file_progress(off_t done, off_t total, void *arg)
+{
+    FileProgress *fp = arg;
+    (void)total;
+
+    atomic_fetch_add_explicit(&fp->op->bytes_done, done - fp->last,
+        memory_order_relaxed);
+    fp->last = done;
+    return is_cancelled(fp->op);
+}
+
+/**
+ * @brief Copies a regular file; a partial destination is removed.
+ */
+static int copy_regular(TreeOp *op, Node *p, const char *name, const char *dname)
+{
+    int in = openat(p->src_fd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (in < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(in, &st) < 0)
+    {
+        close(in);
+        return -1;
+    }
+
+    int out = openat(p->dst_fd, dname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        st.st_mode & 07777);
+    if (out < 0)
+    {
+        close(in);
+        return -1;
+    }
+
+    FileProgress fp = { op, 0 };
+    int used = 0;
+    int rc = copy_fd_with(in, out, &st, atomic_load(&op->methods),
+        file_progress, &fp, &used);
+    int err = errno;
+
+    // no reflink between these filesystems: spare the ioctl per file
+    if (rc == 0 && st.st_size > 0 && used != COPY_CLONE)
+        atomic_fetch_and(&op->methods, ~COPY_CLONE);
+
+    close(in);
+    if (close(out) < 0 && rc == 0)
+    {
+        rc = -1;
+        err = errno;
+    }
+    if (rc < 0)
+        unlinkat(p->dst_fd, dname, 0);
+
+    errno = err;
+    return rc;
+}
+
+/**
+ * @brief Recreates a symlink, FIFO or device node at the destination.
+ */
+static int copy_special(Node *p, const char *name, const char *dname,
+    const struct stat *st)
+{
+    if (S_ISLNK(st->st_mode))
+    {
+        char target[PATH_MAX];
+        ssize_t n = readlinkat(p->src_fd, name, target, sizeof(target) - 1);
+        if (n < 0)
+            return -1;
+        target[n] = '\0';
+        return symlinkat(target, p->dst_fd, dname);
+    }
+    return mknodat(p->dst_fd, dname, st->st_mode, st->st_rdev);
+}
+
+/**
+ * @brief Counts the disk usage of a non-directory entry of @p p.
+ */
+static int size_entry(TreeOp *op, Node *p, const char *name)
+{
+    struct statx sx;
+
+    if (statx(p->src_fd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+            SIZE_MASK, &sx) < 0)
+        return -1;
+
+    if (sx.stx_nlink > 1 && !S_ISDIR(sx.stx_mode) &&
+        !inode_set_add(&op->linked, makedev(sx.stx_dev_major, sx.stx_dev_minor),
+            sx.stx_ino))
+        return 0;
+
+    add_bytes(op, p, sx.stx_blocks * 512);
+    return 0;
+}
+
+/**
+ * @brief Opens a directory, makes its counterpart and queues its entries.
+ *
+ * @return 0 when the directory's node is set up, 1 when a size walk
+ * took its total from the cache instead, -1 on error.
+ */
+static int walk_dir(Worker *w, Node *p, const char *name, const char *dname)
+{
+    TreeOp *op = w->op;
+
+    int src = openat(p->src_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (src < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(src, &st) < 0)
+    {
+        close(src);
+        return -1;
+    }
+
+    FileKey key = { 0 };
+    if (op->kind == TREE_SIZE)
+    {
+        uint64_t cached;
+        key = (FileKey){ (uint64_t)st.st_dev, (uint64_t)st.st_ino, 0,
+            (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec };
+        if (size_cache_find(&key, &cached))
+        {
+            close(src);
+            add_bytes(op, p, cached);
+            return 1;
+        }
+    }
+
+    int dst = -1;
+    if (op->kind == TREE_COPY || op->kind == TREE_MOVE)
+    {
+        // writable until the last entry is in, the real mode is set then
+        if (mkdirat(p->dst_fd, dname, 0700) < 0 && errno != EEXIST)
+        {
+            close(src);
+            return -1;
+        }
+        dst = openat(p->dst_fd, dname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dst < 0)
+        {
+            close(src);
+            return -1;
+        }
+    }
+
+    size_t len = strlen(name);
+    Node *n = malloc(sizeof(Node) + len + 1);
+    if (!n)
+    {
+        close(src);
+        if (dst >= 0)
+            close(dst);
+        return -1;
+    }
+    n->parent = p;
+    n->src_fd = src;
+    n->dst_fd = dst;
+    n->mode = st.st_mode;
+    atomic_init(&n->pending, 1);
+    n->key = key;
+    atomic_init(&n->bytes, 0);
+    atomic_init(&n->incomplete, 0);
+    memcpy(n->name, name, len + 1);
+    atomic_fetch_add(&p->pending, 1);
+
+    if (op->kind == TREE_SIZE)
+        add_bytes(op, n, (uint64_t)st.st_blocks * 512);
+
+    int added = 0;
+    for (;;)
+    {
+        long r = syscall(SYS_getdents64, src, w->buf, GETDENTS_BUF);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            fail_in(op, n, errno);
+            break;
+        }
+        if (r == 0 || is_cancelled(op))
+            break;
+
+        for (long off = 0; off < r;)
+        {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(w->buf + off);
+            off += d->d_reclen;
+
+            if (d->d_name[0] == '.' && (d->d_name[1] == '\0' ||
+                (d->d_name[1] == '.' && d->d_name[2] == '\0')))
+                continue;
+
+            if (add_task(w, n, d->d_name, NULL, d->d_type) < 0)
+            {
+                fail(op, ENOMEM);
+                continue;
+            }
+            added++;
+        }
+        if (added)
+        {
+            announce(op);
+            added = 0;
+        }
+    }
+
+    node_put(op, n);
+    return 0;
+}
+
+/**
+ * @brief Processes one entry; the entry is counted done unless it is a
+ * directory, which node_put() counts when everything below it is done.
+ */
+static void run_task(Worker *w, Task *t)
+{
+    TreeOp *op = w->op;
+    Node *p = t->parent;
+    const char *dname = t->dst_name ? t->dst_name : t->name;
+    int type = t->type;
+    int scan = type == DT_DIR || type == DT_UNKNOWN;
+    int counted = 0;
+    struct stat st;
+
+    if (is_cancelled(op))
+        goto out;
+
+    if (type == DT_UNKNOWN)
+    {
+        if (fstatat(p->src_fd, t->name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+        {
+            fail_in(op, p, errno);
+            goto out;
+        }
+        type = IFTODT(st.st_mode);
+    }
+
+    if (op->kind == TREE_SIZE && type != DT_DIR)
+    {
+        if (size_entry(op, p, t->name) < 0)
+            fail_in(op, p, errno);
+        goto out;
+    }
+
+    if (op->kind == TREE_MOVE && !atomic_load(&op->cross_device))
+    {
+        if (renameat(p->src_fd, t->name, p->dst_fd, dname) == 0)
+            goto out;
+        if (errno == EXDEV)
+            atomic_store(&op->cross_device, 1);
+        else if (type != DT_DIR || (errno != ENOTEMPTY && errno != EEXIST))
+        {
+            fail(op, errno);
+            goto out;
+        }
+        // existing destination directory: merge into it entry by entry
+    }
+
+    if (type == DT_DIR)
+    {
+        int rc = walk_dir(w, p, t->name, dname);
+        if (rc < 0)
+            fail_in(op, p, errno);
+        else
+            counted = rc == 0;
+        goto out;
+    }
+
+    if (op->kind == TREE_DELETE)
+    {
+        if (unlinkat(p->src_fd, t->name, 0) < 0)
+            fail(op, errno);
+        goto out;
+    }
+
+    int rc;
+    if (type == DT_REG)
+        rc = copy_regular(op, p, t->name, dname);
+    else if (t->type != DT_UNKNOWN &&
+        fstatat(p->src_fd, t->name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+        rc = -1;
+    else
+        rc = copy_special(p, t->name, dname, &st);
+
+    if (rc < 0)
+    {
+        if (errno != ECANCELED)
+            fail(op, errno);
+    }
+    else if (op->kind == TREE_MOVE && unlinkat(p->src_fd, t->name, 0) < 0)
+        fail(op, errno);
+
+out:
+    if (!counted)
+        atomic_fetch_add(&op->entries_done, 1);
+    if (scan)
+        atomic_fetch_sub(&op->unscanned, 1);
+    node_put(op, p);
+    free(t);
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    TreeOp *op = w->op;
+
+    while (!atomic_load(&op->done))
+    {
+        // read before looking for work, so a push after the look wakes us
+        unsigned long seen = atomic_load(&op->generation);
+
+        Task *t = pop(w);
+        if (!t)
+            t = steal(w);
+
+        if (t)
+        {
+            run_task(w, t);
+            if (atomic_fetch_sub(&op->outstanding, 1) == 1)
+                finish_all(op);
+            continue;
+        }
+
+        pthread_mutex_lock(&op->idle_lock);
+        atomic_fetch_add(&op->idle, 1);
+        while (!atomic_load(&op->done) && atomic_load(&op->generation) == seen)
+            pthread_cond_wait(&op->idle_cond, &op->idle_lock);
+        atomic_fetch_sub(&op->idle, 1);
+        pthread_mutex_unlock(&op->idle_lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Opens the directory holding @p path and points *name at the
+ * last component. Trailing slashes must already be stripped.
+ */
+static int open_parent(const char *path, const char **name)
+{
+    const char *slash = strrchr(path, '/');
+    char dir[PATH_MAX];
+
+    if (!slash)
+    {
+        *name = path;
+        return open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    size_t len = slash == path ? 1 : (size_t)(slash - path);
+    if (len >= sizeof(dir))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(dir, path, len);
+    dir[len] = '\0';
+    *name = slash + 1;
+    return open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+static void free_op(TreeOp *op)
+{
+    for (int i = 0; i < op->threads; i++)
+    {
+        free(op->workers[i].items);
+        free(op->workers[i].buf);
+        pthread_mutex_destroy(&op->workers[i].lock);
+    }
+    free(op->linked.keys);
+    pthread_mutex_destroy(&op->linked.lock);
+    pthread_mutex_destroy(&op->idle_lock);
+    pthread_cond_destroy(&op->idle_cond);
+    free(op);
+}
+
+/**
+ * @brief Starts copying, moving, deleting or sizing @p src in the
+ * background.
+ *
+ * @param kind Operation.
+ * @param src Source path.
+ * @param dst Destination path, the new name of @p src (NULL for delete
+ * and size).
+ * @param threads Pool size, 0 for tree_op_default_threads().
+ * @return The operation, or NULL with errno set (EINVAL for a copy or
+ * move into itself).
+ */
+TreeOp *tree_op_start(TreeOpKind kind, const char *src, const char *dst,
+    int threads)
+{
+    char src_path[PATH_MAX], dst_path[PATH_MAX];
+    int has_dst = kind == TREE_COPY || kind == TREE_MOVE;
+
+    if (!src || (has_dst && !dst))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    snprintf(src_path, sizeof(src_path), "%s", src);
+    snprintf(dst_path, sizeof(dst_path), "%s", dst ? dst : "");
+    for (size_t n = strlen(src_path); n > 1 && src_path[n - 1] == '/'; n--)
+        src_path[n - 1] = '\0';
+    for (size_t n = strlen(dst_path); n > 1 && dst_path[n - 1] == '/'; n--)
+        dst_path[n - 1] = '\0';
+
+    size_t src_len = strlen(src_path);
+    int same = has_dst && strcmp(src_path, dst_path) == 0;
+    if (kind == TREE_COPY && same)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (has_dst && strncmp(src_path, dst_path, src_len) == 0 &&
+        dst_path[src_len] == '/')
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (threads <= 0)
+        threads = tree_op_default_threads();
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+
+    TreeOp *op = calloc(1, sizeof(TreeOp));
+    if (!op)
+        return NULL;
+    op->kind = kind;
+    op->threads = threads;
+    atomic_init(&op->methods, COPY_ALL);
+    pthread_mutex_init(&op->idle_lock, NULL);
+    pthread_mutex_init(&op->linked.lock, NULL);
+    pthread_cond_init(&op->idle_cond, NULL);
+
+    for (int i = 0; i < threads; i++)
+    {
+        Worker *w = &op->workers[i];
+        w->op = op;
+        w->id = i;
+        pthread_mutex_init(&w->lock, NULL);
+        w->buf = malloc(GETDENTS_BUF);
+        if (!w->buf)
+        {
+            op->threads = i + 1;
+            free_op(op);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    // the root node is the directory holding src; it is never removed
+    const char *src_name, *dst_name = NULL;
+    Node *root = calloc(1, sizeof(Node) + 1);
+    if (!root)
+    {
+        free_op(op);
+        return NULL;
+    }
+    root->dst_fd = -1;
+    root->src_fd = open_parent(src_path, &src_name);
+    if (root->src_fd >= 0 && has_dst)
+        root->dst_fd = open_parent(dst_path, &dst_name);
+
+    if (root->src_fd < 0 || (has_dst && root->dst_fd < 0))
+    {
+        int err = errno;
+        if (root->src_fd >= 0)
+            close(root->src_fd);
+        free(root);
+        free_op(op);
+        errno = err;
+        return NULL;
+    }
+    atomic_init(&root->pending, 1);
+    op->root = root;
+
+    // names point into src_path/dst_path: keep copies in the root task
+    size_t dst_len = dst_name ? strlen(dst_name) + 1 : 0;
+    char *names = NULL;
+    if (!same)
+    {
+        names = malloc(dst_len + 1);
+        if (names && dst_name)
+            memcpy(names, dst_name, dst_len);
+        if (!names || add_task(&op->workers[0], root, src_name,
+                dst_name ? names : NULL, DT_UNKNOWN) < 0)
+        {
+            free(names);
+            close(root->src_fd);
+            if (root->dst_fd >= 0)
+                close(root->dst_fd);
+            free(root);
+            free_op(op);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    else
+        atomic_init(&op->done, 1);
+    op->root_names = names;
+
+    // fewer threads still finish the work, none means doing it here
+    while (op->started < threads && pthread_create(&op->workers[op->started].thread,
+            NULL, worker_main, &op->workers[op->started]) == 0)
+        op->started++;
+    if (op->started == 0)
+        worker_main(&op->workers[0]);
+    return op;
+}
+
+/**
+ * @brief Copies the counters into @p progress.
+ *
+ * @param op Operation.
+ * @param progress Filled in, may be NULL.
+ * @return 1 when the operation is over, 0 while it runs.
+ */
+int tree_op_poll(TreeOp *op, TreeProgress *progress)
+{
+    if (progress)
+    {
+        progress->entries_done = atomic_load(&op->entries_done);
+        progress->entries_total = atomic_load(&op->entries_total);
+        progress->bytes_done = atomic_load(&op->bytes_done);
+        progress->errors = atomic_load(&op->errors);
+        progress->first_error = atomic_load(&op->first_error);
+        progress->scanning = atomic_load(&op->unscanned) > 0;
+    }
+
+    return atomic_load(&op->done);
+}
+
+/**
+ * @brief Asks the workers to stop; what is done stays done, a file
+ * being copied is removed.
+ */
+void tree_op_cancel(TreeOp *op)
+{
+    atomic_store(&op->cancel, 1);
+}
+
+/**
+ * @brief Waits for the operation to end and frees it.
+ *
+ * @param op Operation, may be NULL.
+ * @return 0 if every entry succeeded, -1 otherwise (errno set to the
+ * first error, ECANCELED after tree_op_cancel()).
+ */
+int tree_op_finish(TreeOp *op)
+{
+    if (!op)
+        return -1;
+
+    for (int i = 0; i < op->started; i++)
+        pthread_join(op->workers[i].thread, NULL);
+
+    int cancelled = atomic_load(&op->cancel);
+    int err = atomic_load(&op->first_error);
+    int rc = cancelled || atomic_load(&op->errors) ? -1 : 0;
+
+    node_put(op, op->root);
+    free(op->root_names);
+    free_op(op);
+
+    if (rc < 0)
+        errno = cancelled ? ECANCELED : err;
+    return rc;
+}
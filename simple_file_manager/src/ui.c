@@ -4,33 +4,34 @@
  *
  * Responsible for:
  * - initialising ncurses
- * - drawing panels
- * - processing input
+ * - drawing panels, repainting only what changed since the last frame
+ * - processing input, including the type-to-filter keys
  * - updating layout
  */
 #define _GNU_SOURCE
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <time.h>
 #include <ncursesw/curses.h>
-#include <magic.h> // для определения типа файла, чтобы не мучиться 
 #include <sys/stat.h>
 #include <ctype.h>
 
 #include "ui.h"
 #include "panel.h"
 #include "dialog.h"
+#include "file_type.h"
+#include "filter.h"
+#include "dir_size.h"
 
 
-static magic_t magic_cookie = NULL;
-
 /**
  * @brief Initialisation of ncurses and colour schemes.
  *
  * Configures terminal mode, mouse, colours,
- * and initialises libmagic for file type detection.
+ * and starts the background file type detection.
  */
 void init_curses(void)
 {
@@ -60,72 +61,22 @@ void init_curses(void)
     init_pair(6, COLOR_BLUE, -1);
     init_pair(7, COLOR_WHITE, -1);
 
-    magic_cookie = magic_open(MAGIC_MIME_TYPE);
-    magic_load(magic_cookie, NULL);
+    file_types_init();
 }
 
 /**
  * @brief Terminates ncurses.
  *
- * Frees libmagic resources and returns the terminal
+ * Stops file type detection and returns the terminal
  * to its normal state.
  */
 void cleanup_curses(void)
 {
-    if (magic_cookie)
-        magic_close(magic_cookie);
+    file_types_shutdown();
 
     endwin();
 }
 
-/**
- * @brief Determines the display colour of a file.
- *
- * @param dir The current directory of the panel.
- * @param name The file name.
- * @return The ncurses colour pair number.
- *
- * Uses stat() and libmagic to determine the type.
- */
-int get_file_color(const char *dir, const char *name)
-{
-    char path[PATH_MAX];
-    snprintf(path, sizeof(path), "%s/%s", dir, name);
-
-    struct stat st;
-    if (stat(path, &st) == 0)
-    {
-        if (S_ISDIR(st.st_mode))
-            return 7;
-
-        if (st.st_mode & S_IXUSR)
-            return 3;
-    }
-
-    const char *mime = magic_file(magic_cookie, path);
-    if (!mime)
-        return 7;
-
-    if (strstr(mime, "text"))
-        return 4;
-
-    if (strstr(mime, "zip") ||
-        strstr(mime, "gzip") ||
-        strstr(mime, "tar") ||
-        strstr(mime, "rar") ||
-        strstr(mime, "7z"))
-        return 5;
-
-    if (strstr(mime, "image") ||
-        strstr(mime, "video"))
-        return 6;
-
-    if (strstr(mime, "application"))
-        return 3;
-
-    return 7;
-}
-
 /**
  * @brief Updates the sizes and positions of interface elements.
  *
@@ -141,6 +92,7 @@ void update_layout(App *app)
     getmaxyx(stdscr, app->rows, app->cols);
 
     wresize(app->wnd, app->rows, app->cols);
+    app->damaged = 1;
 
     int mid = app->cols / 2;
     int bottom = app->rows - 4;
@@ -183,66 +135,153 @@ static void draw_button(WINDOW *wnd, Button *btn)
     wattroff(wnd, COLOR_PAIR(2));
 }
 
+/**
+ * @brief Draws the frame of a panel: corners and lines, inside untouched.
+ */
+static void draw_border(WINDOW *wnd, int y0, int x0, int h, int w)
+{
+    mvwaddch(wnd, y0, x0, ACS_ULCORNER);
+    mvwhline(wnd, y0, x0 + 1, ACS_HLINE, w - 2);
+    mvwaddch(wnd, y0, x0 + w - 1, ACS_URCORNER);
+
+    mvwvline(wnd, y0 + 1, x0, ACS_VLINE, h - 2);
+    mvwvline(wnd, y0 + 1, x0 + w - 1, ACS_VLINE, h - 2);
+
+    mvwaddch(wnd, y0 + h - 1, x0, ACS_LLCORNER);
+    mvwhline(wnd, y0 + h - 1, x0 + 1, ACS_HLINE, w - 2);
+    mvwaddch(wnd, y0 + h - 1, x0 + w - 1, ACS_LRCORNER);
+}
+
 /**
  * @brief Draws a single file panel.
  *
+ * Only the visible rows are looked at, and a row is repainted only if
+ * it shows a different entry or colour than in the last frame: moving
+ * the selection repaints the old and the new row, a scroll every row,
+ * an idle frame nothing. drawn_valid = 0 repaints everything.
+ *
  * @param app Pointer to the application.
  * @param p Pointer to the panel.
  * @param active Panel activity flag.
+ * @return 1 if anything was drawn, 0 otherwise.
  */
-void draw_panel(App *app, Panel *p, int active)
+int draw_panel(App *app, Panel *p, int active)
 {
     int x0 = p->x;
     int y0 = p->y;
     int w  = p->w;
     int h  = p->h;
+    int drew = 0;
 
-    // рамка
-    for (int y = 0; y < h; y++)
-        for (int x = 0; x < w; x++)
-        {
-            if (y == 0 && x == 0) 
-                mvwaddch(app->wnd,y0+y,x0+x,ACS_ULCORNER);
-            else if (y == 0 && x == w-1) 
-                mvwaddch(app->wnd,y0+y,x0+x,ACS_URCORNER);
-            else if (y == h-1 && x == 0) 
-                mvwaddch(app->wnd,y0+y,x0+x,ACS_LLCORNER);
-            else if (y == h-1 && x == w-1) 
-                mvwaddch(app->wnd,y0+y,x0+x,ACS_LRCORNER);
-            else if (y == 0 || y == h-1) 
-                mvwaddch(app->wnd,y0+y,x0+x,ACS_HLINE);
-            else if (x == 0 || x == w-1) 
-                mvwaddch(app->wnd,y0+y,x0+x,ACS_VLINE);
-        }
+    if (w < 4 || h < 2)
+        return 0;
+
+    int visible = h - 2;
+
+    if (!p->drawn_valid || p->drawn_rows != visible)
+    {
+        PanelRow *rows = realloc(p->drawn, visible * sizeof(PanelRow));
+        if (!rows && visible > 0)
+            return 0;
+        p->drawn = rows;
+        p->drawn_rows = visible;
+
+        // colour -1 matches no row: all of them are painted below
+        for (int i = 0; i < visible; i++)
+            p->drawn[i] = (PanelRow){ NULL, -1, 0, 0 };
+        p->drawn_title[0] = '\0';
+
+        draw_border(app->wnd, y0, x0, h, w);
+        p->drawn_valid = 1;
+        drew = 1;
+    }
+
+    char title[sizeof(p->drawn_title)];
+    if (p->filter)
+        snprintf(title, sizeof(title), "/%.*s_ (%d)", w > 16 ? w-16 : 0, filter_query(p), p->count);
+    else if (p->loading)
+        snprintf(title, sizeof(title), "%.*s [loading %d]", w > 24 ? w-20 : 0, p->cwd, p->count);
+    else
+        snprintf(title, sizeof(title), "%.*s", w-4, p->cwd);
 
-    mvwprintw(app->wnd,y0,x0+2,"%.*s",w-4,p->cwd);
+    if (strcmp(title, p->drawn_title) != 0)
+    {
+        mvwhline(app->wnd, y0, x0 + 1, ACS_HLINE, w - 2);
+        mvwprintw(app->wnd, y0, x0 + 2, "%s", title);
+        snprintf(p->drawn_title, sizeof(p->drawn_title), "%s", title);
+        drew = 1;
+    }
 
-    int visible = h-2;
     for (int i = 0; i < visible; i++)
     {
         int idx = p->scroll + i;
-        if (idx >= p->count)
-            break;
+        const struct dirent *e = idx < p->count ? p->entries[idx] : NULL;
+        int color = 0;
+        int size_state = DIR_SIZE_NONE;
+        uint64_t size = 0;
+
+        if (e)
+        {
+            int is_selected = (idx == p->selected && active);
+            color = is_selected ? 2 : file_type_color(p, p->entries[idx]);
+            size_state = dir_size_of(p, p->entries[idx], &size);
+        }
 
-        int is_selected = (idx == p->selected && active);
+        if (p->drawn[i].entry == e && p->drawn[i].color == color &&
+            p->drawn[i].size_state == size_state && p->drawn[i].size == size)
+            continue;
 
-        if (is_selected)
+        if (e && size_state != DIR_SIZE_NONE && w > 16)
         {
-            wattron(app->wnd, COLOR_PAIR(2));
+            // "+" while the walk is still counting
+            char text[16];
+            dir_size_format(size, text, sizeof(text) - 1);
+            if (size_state == DIR_SIZE_PARTIAL)
+                strcat(text, "+");
+
+            wattron(app->wnd, COLOR_PAIR(color));
+            mvwprintw(app->wnd, y0 + 1 + i, x0 + 2, "%-*.*s %7s", w - 12, w - 12, e->d_name, text);
+            wattroff(app->wnd, COLOR_PAIR(color));
         }
-        else
+        else if (e)
         {
-            int color = get_file_color(p->cwd, p->entries[idx]->d_name);
             wattron(app->wnd, COLOR_PAIR(color));
+            mvwprintw(app->wnd, y0 + 1 + i, x0 + 2, "%-*.*s", w - 4, w - 4, e->d_name);
+            wattroff(app->wnd, COLOR_PAIR(color));
         }
-
-        mvwprintw(app->wnd, y0 + 1 + i, x0 + 2, "%-*.*s", w - 4, w - 4, p->entries[idx]->d_name);
-
-        if (is_selected)
-            wattroff(app->wnd, COLOR_PAIR(2));
         else
-            wattroff(app->wnd, COLOR_PAIR(get_file_color(p->cwd, p->entries[idx]->d_name)));
+            mvwprintw(app->wnd, y0 + 1 + i, x0 + 2, "%*s", w - 4, "");
+
+        p->drawn[i] = (PanelRow){ e, color, size_state, size };
+        drew = 1;
     }
+    return drew;
+}
+
+/**
+ * @brief Handles a key while the panel is filtering.
+ *
+ * Printable keys and Backspace edit the query, Enter jumps to the
+ * selected match, Esc puts the old selection back. Anything else
+ * (arrows, mouse, Tab) is left to the normal handling.
+ *
+ * @param p Pointer to the active panel.
+ * @param ch Key from getch().
+ * @return 1 if the key was used, 0 otherwise.
+ */
+static int handle_filter_key(Panel *p, int ch)
+{
+    if (ch == 27)
+        filter_end(p, 0);
+    else if (ch == 10)
+        filter_end(p, 1);
+    else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8)
+        filter_backspace(p);
+    else if (ch >= 32 && ch <= 255)
+        filter_append(p, ch);
+    else
+        return 0;
+    return 1;
 }
 
 /**
@@ -287,6 +326,15 @@ int handle_input(App *app)
         return 1;
     }
 
+    if (p->filter && handle_filter_key(p, ch))
+        return 1;
+
+    if (ch == '/')
+    {
+        filter_start(p);
+        return 1;
+    }
+
     if (ch == 'q' || ch == 'Q')
         return 0;
 
@@ -322,6 +370,9 @@ int handle_input(App *app)
         open_file_dialog(app);
     }
 
+    if (ch == 's' || ch == 'S')
+        dir_size_start(p);
+
     if (ch == KEY_MOUSE)
     {
         MEVENT e;
@@ -391,21 +442,37 @@ int handle_input(App *app)
 /**
  * @brief Draws the entire interface.
  *
- * Redraws panels and buttons,
- * then refreshes the window.
+ * After a layout change (app->damaged) the window is cleared and
+ * everything is drawn; otherwise the panels repaint what changed and
+ * an unchanged frame costs no output at all. The refresh is batched
+ * with wnoutrefresh() + doupdate().
  *
  * @param app Pointer to the application.
  */
 void draw_ui(App *app)
 {
-    werase(app->wnd);
-    wbkgd(app->wnd,COLOR_PAIR(1));
+    int drew = 0;
 
-    draw_panel(app,&app->left, app->active == 0);
-    draw_panel(app,&app->right,app->active == 1);
+    if (app->damaged)
+    {
+        werase(app->wnd);
+        wbkgd(app->wnd,COLOR_PAIR(1));
 
-    for (int i = 0; i < app->button_count; i++)
-        draw_button(app->wnd, &app->buttons[i]);
+        for (int i = 0; i < app->button_count; i++)
+            draw_button(app->wnd, &app->buttons[i]);
+
+        app->left.drawn_valid = 0;
+        app->right.drawn_valid = 0;
+        app->damaged = 0;
+        drew = 1;
+    }
+
+    drew |= draw_panel(app,&app->left, app->active == 0);
+    drew |= draw_panel(app,&app->right,app->active == 1);
+
+    if (!drew)
+        return;
 
-    wrefresh(app->wnd);
+    wnoutrefresh(app->wnd);
+    doupdate();
 }
\ No newline at end of file
@@ -0,0 +1,524 @@
+/**
+ * @file viewer.c
+ * @brief Full-screen file viewer.
+ *
+ * Responsible for:
+ * - showing a file of any size from the first keypress, by lines
+ * - scrolling by line and page, to the start and to the end
+ * - jumping to a line number or to a percentage of the file
+ * - searching forward and backward, with Esc to give up
+ *
+ * The screen position is a byte offset, so scrolling never waits for
+ * the line index; only line numbers do, and they show up once the
+ * background indexer has passed the position.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ncursesw/curses.h>
+
+#include "viewer.h"
+#include "file_view.h"
+#include "ui.h"
+
+#define TAB_WIDTH 8
+#define HSCROLL_STEP 8
+#define QUERY_MAX 255
+#define VIEWER_TICK_MS 100
+
+/**
+ * @struct Viewer
+ * @brief Viewer state.
+ *
+ * match is the offset of the last search hit, highlighted while it is
+ * on screen; searches go on from it.
+ */
+typedef struct Viewer
+{
+    FileView *v;
+    const char *path;
+    WINDOW *win;
+    int rows, cols;
+
+    uint64_t top;
+    int hscroll;
+
+    char query[QUERY_MAX + 1];
+    size_t query_len;
+    int backward;
+    int has_match;
+    uint64_t match;
+
+    char status[32 + QUERY_MAX + 1];   /**< a label and a whole query */
+
+    char *line;
+    size_t line_cap;
+} Viewer;
+
+static int text_rows(const Viewer *vw)
+{
+    return vw->rows > 2 ? vw->rows - 2 : 1;
+}
+
+/**
+ * @brief Lays out one line for the screen: tabs expanded, control bytes
+ * shown as '.', the first @p skip columns dropped.
+ *
+ * UTF-8 sequences take one column. Bytes [hit, hit_end) of the line are
+ * reported as columns [*hl_from, *hl_to), both -1 if not on screen.
+ *
+ * @return Number of bytes written to @p out.
+ */
+static size_t layout_line(const char *s, size_t n, int skip, int width,
+    char *out, long hit, long hit_end, int *hl_from, int *hl_to)
+{
+    size_t len = 0;
+    int col = 0;
+    int from = -1, to = -1;
+    size_t i = 0;
+
+    for (; i < n; i++)
+    {
+        unsigned char c = (unsigned char)s[i];
+
+        if ((long)i == hit)
+            from = col;
+        if ((long)i == hit_end)
+            to = col;
+
+        if ((c & 0xC0) == 0x80)
+        {
+            // continuation byte: goes with the character before it
+            if (col > skip && col <= skip + width)
+                out[len++] = (char)c;
+            continue;
+        }
+        if (col >= skip + width)
+            break;
+
+        if (c == '\t')
+        {
+            int next = (col / TAB_WIDTH + 1) * TAB_WIDTH;
+            for (; col < next && col < skip + width; col++)
+                if (col >= skip)
+                    out[len++] = ' ';
+            continue;
+        }
+
+        if (c < 32 || c == 127)
+            c = '.';
+        if (col >= skip)
+            out[len++] = (char)c;
+        col++;
+    }
+
+    if ((long)i == hit)
+        from = col;
+    if (from >= 0 && to < 0)
+        to = col;
+
+    *hl_from = *hl_to = -1;
+    if (from >= 0 && to > skip && from < skip + width)
+    {
+        *hl_from = from > skip ? from - skip : 0;
+        *hl_to = (to < skip + width ? to : skip + width) - skip;
+    }
+    return len;
+}
+
+/**
+ * @brief Draws the title bar, the text and the status line.
+ */
+static void draw_viewer(Viewer *vw)
+{
+    WINDOW *win = vw->win;
+    const char *data = file_view_data(vw->v);
+    uint64_t size = file_view_size(vw->v);
+    int width = vw->cols;
+
+    size_t need = (size_t)width * 4 + 1;
+    if (need > vw->line_cap)
+    {
+        char *line = realloc(vw->line, need);
+        if (!line)
+            return;
+        vw->line = line;
+        vw->line_cap = need;
+    }
+
+    werase(win);
+
+    uint64_t off = vw->top;
+    for (int y = 1; y <= text_rows(vw) && off < size; y++)
+    {
+        uint64_t end = file_view_line_end(vw->v, off);
+
+        long hit = -1, hit_end = -1;
+        if (vw->has_match && vw->match + vw->query_len > off && vw->match <= end)
+        {
+            hit = (long)(vw->match - off);
+            hit_end = hit + (long)vw->query_len;
+            if (hit < 0)
+                hit = 0;
+        }
+
+        int hl_from, hl_to;
+        size_t len = layout_line(data + off, end - off, vw->hscroll, width,
+            vw->line, hit, hit_end, &hl_from, &hl_to);
+        mvwaddnstr(win, y, 0, vw->line, (int)len);
+        if (hl_from >= 0 && hl_to > hl_from)
+            mvwchgat(win, y, hl_from, hl_to - hl_from, A_REVERSE, 0, NULL);
+
+        off = file_view_next_line(vw->v, off);
+    }
+
+    // title: path on the left, position on the right
+    FileViewProgress pr;
+    file_view_progress(vw->v, &pr);
+
+    char pos[96];
+    uint64_t line;
+    int pct = size ? (int)(off * 100 / size) : 100;
+    int n = 0;
+    if (file_view_line_number(vw->v, vw->top, &line) == 0)
+        n = snprintf(pos, sizeof(pos), "line %llu", (unsigned long long)line + 1);
+    else
+        n = snprintf(pos, sizeof(pos), "line ?");
+    if (pr.done)
+        snprintf(pos + n, sizeof(pos) - n, " of %llu  %3d%% ",
+            (unsigned long long)pr.lines, pct);
+    else
+        snprintf(pos + n, sizeof(pos) - n, " of %llu+ (indexing %d%%)  %3d%% ",
+            (unsigned long long)pr.lines, size ? (int)(pr.bytes * 100 / size) : 0, pct);
+
+    wattron(win, COLOR_PAIR(2));
+    mvwhline(win, 0, 0, ' ', width);
+    int room = width - (int)strlen(pos) - 2;
+    int path_len = (int)strlen(vw->path);
+    if (room > 0)
+        mvwprintw(win, 0, 1, "%s", path_len > room ? vw->path + path_len - room : vw->path);
+    mvwprintw(win, 0, width > (int)strlen(pos) ? width - (int)strlen(pos) : 0, "%s", pos);
+    wattroff(win, COLOR_PAIR(2));
+
+    const char *help = "q quit  / ? search  n N next  g go to line or %  e edit";
+    mvwprintw(win, vw->rows - 1, 0, "%.*s", width, vw->status[0] ? vw->status : help);
+
+    wrefresh(win);
+}
+
+static void scroll_lines(Viewer *vw, int n)
+{
+    uint64_t size = file_view_size(vw->v);
+
+    for (; n > 0; n--)
+    {
+        uint64_t next = file_view_next_line(vw->v, vw->top);
+        if (next >= size)
+            break;
+        vw->top = next;
+    }
+    for (; n < 0 && vw->top > 0; n++)
+        vw->top = file_view_prev_line(vw->v, vw->top);
+}
+
+static void go_end(Viewer *vw)
+{
+    vw->top = file_view_size(vw->v);
+    for (int i = 0; i < text_rows(vw) && vw->top > 0; i++)
+        vw->top = file_view_prev_line(vw->v, vw->top);
+}
+
+/**
+ * @brief Shows @p status and reports whether Esc was pressed since.
+ */
+static int busy(Viewer *vw, const char *status)
+{
+    snprintf(vw->status, sizeof(vw->status), "%s", status);
+    draw_viewer(vw);
+
+    wtimeout(vw->win, 0);
+    int ch = wgetch(vw->win);
+    wtimeout(vw->win, VIEWER_TICK_MS);
+    return ch == 27;
+}
+
+/**
+ * @brief Reads a line of text on the status line, like less does.
+ *
+ * @param vw Viewer.
+ * @param label Shown before the text.
+ * @param buf Receives the text, NUL-terminated.
+ * @param size Size of @p buf.
+ * @return Length of the text, 0 if empty or cancelled with Esc.
+ */
+static size_t prompt(Viewer *vw, const char *label, char *buf, size_t size)
+{
+    size_t len = 0;
+    buf[0] = '\0';
+    curs_set(TRUE);
+
+    while (1)
+    {
+        snprintf(vw->status, sizeof(vw->status), "%s%s", label, buf);
+        draw_viewer(vw);
+        wmove(vw->win, vw->rows - 1, (int)strlen(vw->status));
+        wrefresh(vw->win);
+
+        int ch = wgetch(vw->win);
+        if (ch == 27)
+            len = 0;
+        if (ch == 27 || ch == 10)
+            break;
+        if ((ch == KEY_BACKSPACE || ch == 127 || ch == 8) && len > 0)
+        {
+            // drop a whole UTF-8 character
+            while (len > 0 && ((unsigned char)buf[--len] & 0xC0) == 0x80)
+                ;
+            buf[len] = '\0';
+        }
+        else if (ch >= 32 && ch <= 255 && ch != 127 && len + 1 < size)
+        {
+            buf[len++] = (char)ch;
+            buf[len] = '\0';
+        }
+    }
+
+    curs_set(FALSE);
+    vw->status[0] = '\0';
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Asks for a line number or a percentage and goes there.
+ *
+ * A line the indexer has not reached yet is waited for, with progress
+ * on the status line.
+ */
+static void go_to(Viewer *vw)
+{
+    char text[64];
+    if (!prompt(vw, "Go to line, or percentage like 50%: ", text, sizeof(text)))
+        return;
+
+    char *end;
+    if (strchr(text, '%'))
+    {
+        double pct = strtod(text, &end);
+        if (end == text || pct < 0 || pct > 100)
+            return;
+        uint64_t off = (uint64_t)(pct / 100 * file_view_size(vw->v));
+        vw->top = file_view_line_start(vw->v, off);
+        return;
+    }
+
+    unsigned long long line = strtoull(text, &end, 10);
+    if (end == text)
+        return;
+    if (line > 0)
+        line--;
+
+    uint64_t off;
+    while (file_view_line_offset(vw->v, line, &off) != 0)
+    {
+        FileViewProgress pr;
+        file_view_progress(vw->v, &pr);
+        uint64_t size = file_view_size(vw->v);
+        char status[96];
+        snprintf(status, sizeof(status), "Counting lines... %d%% (Esc to stop)",
+            size ? (int)(pr.bytes * 100 / size) : 0);
+        if (busy(vw, status))
+        {
+            vw->status[0] = '\0';
+            return;
+        }
+        file_view_wait(vw->v, VIEWER_TICK_MS);
+    }
+    vw->status[0] = '\0';
+    vw->top = off;
+}
+
+/**
+ * @brief Runs the current search from the current position.
+ *
+ * @param vw Viewer.
+ * @param backward Nonzero to look towards the start of the file.
+ */
+static void search(Viewer *vw, int backward)
+{
+    uint64_t size = file_view_size(vw->v);
+    uint64_t from;
+    if (backward)
+        from = vw->has_match ? vw->match : vw->top;
+    else
+        from = vw->has_match ? vw->match + 1 : vw->top;
+
+    uint64_t at;
+    int r;
+    while ((r = file_view_search(vw->v, vw->query, vw->query_len, from,
+        backward, &at)) == FILE_VIEW_MORE)
+    {
+        from = at;
+        char status[96];
+        snprintf(status, sizeof(status), "Searching... %d%% (Esc to stop)",
+            (int)(from * 100 / size));
+        if (busy(vw, status))
+        {
+            vw->status[0] = '\0';
+            return;
+        }
+    }
+
+    if (r == FILE_VIEW_NOT_FOUND)
+    {
+        snprintf(vw->status, sizeof(vw->status), "Not found: %s", vw->query);
+        return;
+    }
+    vw->status[0] = '\0';
+    vw->has_match = 1;
+    vw->match = at;
+    vw->top = file_view_line_start(vw->v, at);
+}
+
+static void ask_search(Viewer *vw, int backward)
+{
+    char query[QUERY_MAX + 1];
+    size_t len = prompt(vw, backward ? "?" : "/", query, sizeof(query));
+    if (!len)
+        return;
+
+    memcpy(vw->query, query, len + 1);
+    vw->query_len = len;
+    vw->backward = backward;
+    vw->has_match = 0;
+    search(vw, backward);
+}
+
+static void open_window(Viewer *vw)
+{
+    if (vw->win)
+        delwin(vw->win);
+    getmaxyx(stdscr, vw->rows, vw->cols);
+    vw->win = newwin(vw->rows, vw->cols, 0, 0);
+    keypad(vw->win, TRUE);
+    wtimeout(vw->win, VIEWER_TICK_MS);
+}
+
+/**
+ * @brief Shows @p path until the user leaves.
+ *
+ * @param app Pointer to the application.
+ * @param path File to show.
+ * @return VIEWER_CLOSED, VIEWER_EDIT, or VIEWER_ERROR if the file could
+ * not be opened.
+ */
+int view_file(App *app, const char *path)
+{
+    Viewer vw;
+    memset(&vw, 0, sizeof(vw));
+    vw.path = path;
+
+    vw.v = file_view_open(path);
+    if (!vw.v)
+        return VIEWER_ERROR;
+
+    int old_delay = is_nodelay(stdscr);
+    nodelay(stdscr, FALSE);
+
+    open_window(&vw);
+
+    int result = VIEWER_CLOSED;
+    int running = 1;
+    uint64_t shown_bytes = (uint64_t)-1;
+    int redraw = 1;
+
+    while (running)
+    {
+        FileViewProgress pr;
+        file_view_progress(vw.v, &pr);
+        if (redraw || pr.bytes != shown_bytes)
+        {
+            draw_viewer(&vw);
+            shown_bytes = pr.bytes;
+            redraw = 0;
+        }
+
+        int ch = wgetch(vw.win);
+        if (ch == ERR)
+            continue;
+
+        redraw = 1;
+        if (ch != KEY_RESIZE)
+            vw.status[0] = '\0';
+
+        switch (ch)
+        {
+        case 'q': case 'Q': case 27: case KEY_F(3): case KEY_F(10):
+            running = 0;
+            break;
+        case 'e': case 'E': case KEY_F(4):
+            result = VIEWER_EDIT;
+            running = 0;
+            break;
+        case KEY_DOWN: case 'j': case 10:
+            scroll_lines(&vw, 1);
+            break;
+        case KEY_UP: case 'k':
+            scroll_lines(&vw, -1);
+            break;
+        case KEY_NPAGE: case ' ': case 'f':
+            scroll_lines(&vw, text_rows(&vw));
+            break;
+        case KEY_PPAGE: case 'b':
+            scroll_lines(&vw, -text_rows(&vw));
+            break;
+        case KEY_HOME: case '<':
+            vw.top = 0;
+            break;
+        case KEY_END: case '>': case 'G':
+            go_end(&vw);
+            break;
+        case KEY_LEFT:
+            vw.hscroll = vw.hscroll > HSCROLL_STEP ? vw.hscroll - HSCROLL_STEP : 0;
+            break;
+        case KEY_RIGHT:
+            vw.hscroll += HSCROLL_STEP;
+            break;
+        case 'g': case ':':
+            go_to(&vw);
+            break;
+        case '/': case '?':
+            ask_search(&vw, ch == '?');
+            break;
+        case 'n': case 'N':
+            if (vw.query_len)
+                search(&vw, ch == 'n' ? vw.backward : !vw.backward);
+            break;
+        case KEY_RESIZE:
+        {
+            int rows, cols;
+            getmaxyx(stdscr, rows, cols);
+            resize_term(rows, cols);
+            app->rows = rows;
+            app->cols = cols;
+            wresize(app->wnd, rows, cols);
+            update_layout(app);
+            open_window(&vw);
+            break;
+        }
+        default:
+            redraw = 0;
+            break;
+        }
+    }
+
+    delwin(vw.win);
+    free(vw.line);
+    file_view_close(vw.v);
+
+    nodelay(stdscr, old_delay);
+    app->damaged = 1;
+    return result;
+}
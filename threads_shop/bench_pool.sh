@@ -0,0 +1,19 @@
+#!/bin/sh
+# Pool mode scaling: purchases/sec and purchase latency percentiles for
+# many buyer tasks over sharded kiosks, from 1 to 64 pool threads.
+# usage: ./bench_pool.sh [buyers] [kiosks] [need]
+
+BUYERS=${1:-100000}
+KIOSKS=${2:-4096}
+NEED=${3:-2000}
+SHOP_BIN=./bin/shop
+
+[ -x "$SHOP_BIN" ] || make >/dev/null || exit 1
+
+printf "%-8s %12s %10s %14s %10s %10s %10s %10s\n" \
+    threads purchases seconds purchases/s p50_us p99_us p999_us steals
+for t in 1 2 4 8 16 32 64; do
+    "$SHOP_BIN" -q -p "$t" -b "$BUYERS" -k "$KIOSKS" -n "$NEED" | awk -F'[ =]' '
+        /^threads=/ { printf "%-8s %12s %10s %14s %10s %10s %10s %10s\n",
+                      $2, $8, $10, $12, $14, $16, $18, $22 }'
+done
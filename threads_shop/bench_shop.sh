@@ -0,0 +1,18 @@
+#!/bin/sh
+# Claims per second against the lock-free kiosks from 1 to 64 buyer
+# threads. Buyers take one unit per claim (-c 1) and the worker restocks in
+# bulk without breaks, so supply never runs out and the number measures
+# CAS traffic on the kiosk cache lines.
+# usage: ./bench_shop.sh [kiosks] [units_per_buyer]
+
+KIOSKS=${1:-8}
+NEED=${2:-200000}
+SHOP_BIN=./bin/shop
+
+[ -x "$SHOP_BIN" ] || make >/dev/null || exit 1
+
+printf "%-8s %-8s %12s %10s %14s\n" buyers kiosks transactions seconds tx_per_sec
+for b in 1 2 4 8 16 32 64; do
+    "$SHOP_BIN" -q -d 0 -t 0 -c 1 -r 1000000 -k "$KIOSKS" -n "$NEED" -b "$b" | awk -F'[ =]' '
+        /^buyers=/ { printf "%-8s %-8s %12s %10s %14s\n", $2, $4, $6, $8, $10 }'
+done
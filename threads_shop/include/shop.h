@@ -2,22 +2,89 @@
 #define SHOP_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 
-#define KIOSKS 5
-#define BUYERS 3
+#define CACHE_LINE 64
 
+// one kiosk per cache line, so buyers hammering neighbouring kiosks do not
+// invalidate each other's lines (false sharing)
 typedef struct 
 {
-    int goods;
-    pthread_mutex_t mutex;
+    _Alignas(CACHE_LINE) atomic_int goods;
+    // virtual time of the last delivery; a buyer who takes goods from it
+    // cannot be earlier than that
+    atomic_long stamp;
+    char pad[CACHE_LINE - sizeof(atomic_int) - sizeof(atomic_long)];
 } kiosk_t;
 
-extern kiosk_t kiosks[KIOSKS];
+typedef struct 
+{
+    int kiosks;
+    int buyers;
+    int need;           // average need per buyer, +-1%
+    int restock;        // goods per worker delivery
+    int cart;           // most goods taken per claim, 0 = no limit
+    int delay_ms;       // buyer rest after a partial purchase
+    int delivery_ms;    // time the worker needs for one delivery
+    int virtual_time;   // advance per-thread clocks instead of sleeping
+    int pool_threads;   // > 0: buyers are tasks on this many threads
+    int quiet;
+} shop_config_t;
 
-extern int buyers_done;
-extern pthread_mutex_t done_mutex;
+extern shop_config_t config;
+extern kiosk_t *kiosks;
+
+extern atomic_int buyers_done;
+// successful claims, summed by the buyers as they finish
+extern atomic_long transactions;
+// virtual time at which the last buyer was satisfied
+extern atomic_long finish_clock;
 
 void* buyer_thread(void* arg);
 void* worker_thread(void* arg);
 
-#endif
\ No newline at end of file
+// sharded work-stealing run, see pool.c
+int pool_run(void);
+
+// Event words. A buyer that finds every kiosk empty bumps demand and
+// sleeps on restocks until the worker delivers; the worker sleeps on
+// demand until some buyer goes hungry. Both are futexes, nobody polls.
+extern atomic_int restocks;
+extern atomic_int demand;
+extern atomic_int restock_waiters;
+// latest virtual time at which a buyer went hungry
+extern atomic_long demand_clock;
+
+void shop_wait(atomic_int *word, int expected);
+void shop_wake(atomic_int *word, int count);
+
+// spend ms on the thread's clock; sleeps only in real-time mode
+void shop_rest(long *clock, int ms);
+
+static inline void clock_max(long *clock, long t) 
+{
+    if (t > *clock) 
+        *clock = t;
+}
+
+// take min(need, goods) with one CAS; returns how much was taken
+static inline int kiosk_claim(kiosk_t *k, int need) 
+{
+    int goods = atomic_load_explicit(&k->goods, memory_order_relaxed);
+    while (goods > 0) 
+    {
+        int take = goods < need ? goods : need;
+        if (atomic_compare_exchange_weak_explicit(&k->goods, &goods, goods - take,
+                memory_order_acquire, memory_order_relaxed)) 
+            return take;
+    }
+    return 0;
+}
+
+// returns the new stock
+static inline int kiosk_restock(kiosk_t *k, int amount) 
+{
+    return atomic_fetch_add_explicit(&k->goods, amount, memory_order_release) + amount;
+}
+
+#endif
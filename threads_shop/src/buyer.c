@@ -1,60 +1,88 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
+#include <time.h>
 #include "shop.h"
 
+// atomic max, for the shared virtual clocks
+static void publish_clock(atomic_long *shared, long clock) 
+{
+    long cur = atomic_load(shared);
+    while (cur < clock && !atomic_compare_exchange_weak(shared, &cur, clock)) 
+        ;
+}
+
 void* buyer_thread(void* arg) 
 {
     int id = *(int*)arg;
     free(arg);
 
-    int need = 9900 + rand() % 201;
+    unsigned int seed = (unsigned int)time(NULL) ^ (unsigned int)(id * 2654435761u);
+    int spread = config.need / 50;
+    int need = config.need - spread / 2 + (spread ? (int)(rand_r(&seed) % (spread + 1)) : 0);
+    long tx = 0;
+    long clock = 0;
+
+    if (!config.quiet) 
+        printf("Buyer %d has appeared on the horizon; their need is %d\n", id, need);
 
-    printf("Buyer %d has appeared on the horizon; their need is %d\n", id, need);
+    // start at a different kiosk per buyer so they do not all pile onto K0
+    int start = id % config.kiosks;
 
     while (need > 0) 
     {
         int found = 0;
+        // read before the sweep: a delivery after this point changes it
+        int seen = atomic_load(&restocks);
 
-        for (int i = 0; i < KIOSKS; i++) 
+        for (int n = 0; n < config.kiosks && need > 0; n++) 
         {
-            if (pthread_mutex_trylock(&kiosks[i].mutex) == 0) 
-            {
-                found = 1;
-
-                printf("Buyer %d entered kiosk K%d; the kiosk contains %d goods\n",
-                       id, i, kiosks[i].goods);
-
-                while (kiosks[i].goods > 0 && need > 0) 
-                {
-                    kiosks[i].goods--;
-                    need--;
-                }
+            int i = (start + n) % config.kiosks;
+            int want = (config.cart > 0 && config.cart < need) ? config.cart : need;
+            int got = kiosk_claim(&kiosks[i], want);
+            if (got == 0) 
+                continue;
 
-                printf("Buys %d has left kiosk K%d; their needs is now =%d\n",
-                       id, i, need);
+            found = 1;
+            need -= got;
+            tx++;
+            clock_max(&clock, atomic_load_explicit(&kiosks[i].stamp, memory_order_relaxed));
 
-                pthread_mutex_unlock(&kiosks[i].mutex);
-                break;
-            }
+            if (!config.quiet) 
+                printf("Buyer %d took %d goods in kiosk K%d; their need is now %d\n",
+                       id, got, i, need);
         }
+        start = (start + 1) % config.kiosks;
 
-        if (!found) 
-        {
-            sleep(2);
-        } 
-        else if (need > 0) 
+        if (need == 0) 
+            break;
+
+        if (found) 
         {
-            printf("Buyer %d passed out in the side street for 2 seconds\n", id);
-            sleep(2);
+            if (!config.quiet) 
+                printf("Buyer %d passed out in the side street for %d ms\n", id, config.delay_ms);
+            shop_rest(&clock, config.delay_ms);
+            continue;
         }
+
+        // every kiosk empty: ask for a delivery and sleep until one lands
+        publish_clock(&demand_clock, clock);
+        atomic_fetch_add(&demand, 1);
+        shop_wake(&demand, 1);
+
+        atomic_fetch_add(&restock_waiters, 1);
+        shop_wait(&restocks, seen);
+        atomic_fetch_sub(&restock_waiters, 1);
     }
 
-    printf("Customer %d is satisfied\n", id);
+    if (!config.quiet) 
+        printf("Customer %d is satisfied\n", id);
 
-    pthread_mutex_lock(&done_mutex);
-    buyers_done++;
-    pthread_mutex_unlock(&done_mutex);
+    publish_clock(&finish_clock, clock);
+    atomic_fetch_add(&transactions, tx);
+    atomic_fetch_add(&buyers_done, 1);
+    // the worker may be asleep waiting for demand that will never come
+    atomic_fetch_add(&demand, 1);
+    shop_wake(&demand, 1);
 
     return NULL;
-}
\ No newline at end of file
+}
@@ -1,27 +1,124 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
 #include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include "shop.h"
 
-kiosk_t kiosks[KIOSKS];
-int buyers_done = 0;
-pthread_mutex_t done_mutex = PTHREAD_MUTEX_INITIALIZER;
+shop_config_t config = {
+    .kiosks = 5,
+    .buyers = 3,
+    .need = 10000,
+    .restock = 200,
+    .cart = 0,
+    .delay_ms = 2000,
+    .delivery_ms = 1000,
+    .virtual_time = 0,
+    .pool_threads = 0,
+    .quiet = 0,
+};
+kiosk_t *kiosks = NULL;
+atomic_int buyers_done = 0;
+atomic_long transactions = 0;
+atomic_long finish_clock = 0;
+atomic_int restocks = 0;
+atomic_int demand = 0;
+atomic_int restock_waiters = 0;
+atomic_long demand_clock = 0;
 
-int main() 
+// returns at once if *word no longer holds expected, so no wakeup is lost
+void shop_wait(atomic_int *word, int expected) 
 {
+    syscall(SYS_futex, (int *)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+void shop_wake(atomic_int *word, int count) 
+{
+    syscall(SYS_futex, (int *)word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+void shop_rest(long *clock, int ms) 
+{
+    if (ms <= 0) 
+        return;
+    *clock += ms;
+    if (config.virtual_time) 
+        return;
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static void usage(const char *prog) 
+{
+    fprintf(stderr, "Usage: %s [-k kiosks] [-b buyers] [-n need] [-r restock] [-c cart] [-d delay_ms] [-t delivery_ms] [-v] [-p threads] [-q]\n", prog);
+}
+
+int main(int argc, char *argv[]) 
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "k:b:n:r:c:d:t:vp:q")) != -1) 
+    {
+        switch (opt) 
+        {
+            case 'k': config.kiosks = atoi(optarg); break;
+            case 'b': config.buyers = atoi(optarg); break;
+            case 'n': config.need = atoi(optarg); break;
+            case 'r': config.restock = atoi(optarg); break;
+            case 'c': config.cart = atoi(optarg); break;
+            case 'd': config.delay_ms = atoi(optarg); break;
+            case 't': config.delivery_ms = atoi(optarg); break;
+            case 'v': config.virtual_time = 1; break;
+            case 'p': config.pool_threads = atoi(optarg); break;
+            case 'q': config.quiet = 1; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (config.kiosks < 1 || config.buyers < 1 || config.need < 1 || config.restock < 1) 
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
     srand(time(NULL));
 
-    for (int i = 0; i < KIOSKS; i++) 
+    kiosks = aligned_alloc(CACHE_LINE, config.kiosks * sizeof(kiosk_t));
+    if (!kiosks) 
+    {
+        perror("malloc");
+        return 1;
+    }
+
+    for (int i = 0; i < config.kiosks; i++) 
+    {
+        atomic_init(&kiosks[i].goods, 900 + rand() % 201);
+        atomic_init(&kiosks[i].stamp, 0);
+    }
+
+    if (config.pool_threads > 0) 
     {
-        kiosks[i].goods = 900 + rand() % 201;
-        pthread_mutex_init(&kiosks[i].mutex, NULL);
+        int rc = pool_run();
+        free(kiosks);
+        return rc;
+    }
+
+    pthread_t *buyers = malloc(config.buyers * sizeof(pthread_t));
+    if (!buyers) 
+    {
+        perror("malloc");
+        return 1;
     }
 
-    pthread_t buyers[BUYERS];
     pthread_t worker;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
 
-    for (int i = 0; i < BUYERS; i++) 
+    for (int i = 0; i < config.buyers; i++) 
     {
         int* id = malloc(sizeof(int));
         *id = i;
@@ -30,14 +127,23 @@ int main()
 
     pthread_create(&worker, NULL, worker_thread, NULL);
 
-    for (int i = 0; i < BUYERS; i++) 
+    for (int i = 0; i < config.buyers; i++) 
     {
         pthread_join(buyers[i], NULL);
     }
 
-    pthread_cancel(worker);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
     pthread_join(worker, NULL);
 
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    long tx = atomic_load(&transactions);
+
     printf("All buyers' needs were met. Completion...\n");
+    printf("buyers=%d kiosks=%d transactions=%ld seconds=%.3f tx_per_sec=%.0f simulated_seconds=%.3f\n",
+           config.buyers, config.kiosks, tx, secs, secs > 0 ? tx / secs : 0.0,
+           atomic_load(&finish_clock) / 1000.0);
+
+    free(buyers);
+    free(kiosks);
     return 0;
 }
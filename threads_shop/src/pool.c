@@ -0,0 +1,360 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "shop.h"
+
+// Pool mode: buyers are tasks, not threads. Each pool thread owns a shard
+// of the kiosks (kiosk k belongs to thread k % threads) and is the only
+// one that touches their stock. A buyer runs on whatever thread holds it;
+// buying from a kiosk in another shard means handing the task to that
+// shard's MPSC inbox, and the owner continues it after the purchase.
+// Idle threads pop their own deque, then steal from others.
+
+typedef struct mpsc_node 
+{
+    _Atomic(struct mpsc_node *) next;
+} mpsc_node_t;
+
+typedef struct 
+{
+    mpsc_node_t node;       // first: a node pointer is a task pointer
+    int id;
+    int need;
+    int kiosk;              // pending purchase
+    uint64_t issued_ns;
+} task_t;
+
+// Vyukov's intrusive MPSC queue: one xchg per push, no CAS loop
+typedef struct 
+{
+    _Alignas(CACHE_LINE) _Atomic(mpsc_node_t *) head;
+    _Alignas(CACHE_LINE) mpsc_node_t *tail;
+    mpsc_node_t stub;
+} mpsc_t;
+
+// Chase-Lev work-stealing deque (C11 version by Le et al.): the owner
+// pushes and takes at the bottom, thieves CAS the top
+typedef struct 
+{
+    _Alignas(CACHE_LINE) atomic_long top;
+    _Alignas(CACHE_LINE) atomic_long bottom;
+    _Atomic(task_t *) *buf;
+    long mask;
+} deque_t;
+
+typedef struct 
+{
+    deque_t deque;
+    mpsc_t inbox;
+    int index;
+    unsigned int seed;
+    long purchases;
+    long remote;
+    long steals;
+    long deliveries;
+    uint32_t *lat;          // purchase latencies in ns
+    size_t lat_count;
+    size_t lat_cap;
+    pthread_t thread;
+} pool_thread_t;
+
+static pool_thread_t *pool;
+static int nthreads;
+static _Alignas(CACHE_LINE) atomic_int satisfied;
+
+static uint64_t now_ns(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void mpsc_init(mpsc_t *q) 
+{
+    atomic_init(&q->stub.next, NULL);
+    atomic_init(&q->head, &q->stub);
+    q->tail = &q->stub;
+}
+
+static void mpsc_push(mpsc_t *q, mpsc_node_t *n) 
+{
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    mpsc_node_t *prev = atomic_exchange_explicit(&q->head, n, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, n, memory_order_release);
+}
+
+// consumer only; NULL when empty or a producer is between its two steps
+static mpsc_node_t *mpsc_pop(mpsc_t *q) 
+{
+    mpsc_node_t *tail = q->tail;
+    mpsc_node_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &q->stub) 
+    {
+        if (!next) 
+            return NULL;
+        q->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+    if (next) 
+    {
+        q->tail = next;
+        return tail;
+    }
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire)) 
+        return NULL;
+
+    mpsc_push(q, &q->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) 
+    {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+static int deque_init(deque_t *d, long capacity) 
+{
+    long cap = 1;
+    while (cap < capacity) 
+        cap <<= 1;
+    d->buf = calloc(cap, sizeof(*d->buf));
+    d->mask = cap - 1;
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    return d->buf ? 0 : -1;
+}
+
+// capacity covers every buyer, so a push never overflows
+static void deque_push(deque_t *d, task_t *t) 
+{
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    atomic_store_explicit(&d->buf[b & d->mask], t, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+static task_t *deque_take(deque_t *d) 
+{
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b) 
+    {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    task_t *task = atomic_load_explicit(&d->buf[b & d->mask], memory_order_relaxed);
+    if (t == b) 
+    {
+        // last task: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                memory_order_seq_cst, memory_order_relaxed)) 
+            task = NULL;
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+static task_t *deque_steal(deque_t *d) 
+{
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    if (t >= b) 
+        return NULL;
+    task_t *task = atomic_load_explicit(&d->buf[t & d->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed)) 
+        return NULL;
+    return task;
+}
+
+static void record_latency(pool_thread_t *self, uint64_t ns) 
+{
+    if (self->lat_count == self->lat_cap) 
+    {
+        size_t cap = self->lat_cap ? self->lat_cap * 2 : 4096;
+        uint32_t *l = realloc(self->lat, cap * sizeof(uint32_t));
+        if (!l) 
+            return;
+        self->lat = l;
+        self->lat_cap = cap;
+    }
+    self->lat[self->lat_count++] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+}
+
+// owner side of a purchase; an empty kiosk gets a delivery first
+static void purchase(pool_thread_t *self, task_t *task) 
+{
+    kiosk_t *k = &kiosks[task->kiosk];
+    int goods = atomic_load_explicit(&k->goods, memory_order_relaxed);
+    if (goods == 0) 
+    {
+        goods = config.restock;
+        self->deliveries++;
+    }
+
+    int want = (config.cart > 0 && config.cart < task->need) ? config.cart : task->need;
+    int got = goods < want ? goods : want;
+    atomic_store_explicit(&k->goods, goods - got, memory_order_relaxed);
+
+    task->need -= got;
+    self->purchases++;
+    record_latency(self, now_ns() - task->issued_ns);
+}
+
+// run a buyer until it is satisfied or needs a kiosk in another shard
+static void run_task(pool_thread_t *self, task_t *task) 
+{
+    while (task->need > 0) 
+    {
+        task->kiosk = rand_r(&self->seed) % config.kiosks;
+        task->issued_ns = now_ns();
+
+        int owner = task->kiosk % nthreads;
+        if (owner != self->index) 
+        {
+            self->remote++;
+            mpsc_push(&pool[owner].inbox, &task->node);
+            return;
+        }
+        purchase(self, task);
+    }
+
+    if (!config.quiet) 
+        printf("Customer %d is satisfied\n", task->id);
+    atomic_fetch_add_explicit(&satisfied, 1, memory_order_relaxed);
+}
+
+static void *pool_thread(void *arg) 
+{
+    pool_thread_t *self = arg;
+
+    while (atomic_load_explicit(&satisfied, memory_order_relaxed) < config.buyers) 
+    {
+        // requests for our kiosks first: they hold buyers mid-purchase
+        mpsc_node_t *n;
+        while ((n = mpsc_pop(&self->inbox)) != NULL) 
+        {
+            task_t *task = (task_t *)n;
+            purchase(self, task);
+            deque_push(&self->deque, task);
+        }
+
+        task_t *task = deque_take(&self->deque);
+        for (int i = 1; !task && i < nthreads; i++) 
+        {
+            task = deque_steal(&pool[(self->index + i) % nthreads].deque);
+            if (task) 
+                self->steals++;
+        }
+
+        if (task) 
+            run_task(self, task);
+        else 
+            sched_yield();
+    }
+    return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b) 
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int pool_run(void) 
+{
+    nthreads = config.pool_threads;
+    pool = aligned_alloc(CACHE_LINE, ((nthreads * sizeof(pool_thread_t) + CACHE_LINE - 1) / CACHE_LINE) * CACHE_LINE);
+    task_t *tasks = malloc(config.buyers * sizeof(task_t));
+    if (!pool || !tasks) 
+    {
+        perror("malloc");
+        return 1;
+    }
+    memset(pool, 0, nthreads * sizeof(pool_thread_t));
+    atomic_store(&satisfied, 0);
+
+    unsigned int seed = (unsigned int)time(NULL);
+    int spread = config.need / 50;
+
+    for (int i = 0; i < nthreads; i++) 
+    {
+        pool[i].index = i;
+        pool[i].seed = seed ^ (unsigned int)(i * 2654435761u);
+        mpsc_init(&pool[i].inbox);
+        if (deque_init(&pool[i].deque, config.buyers) == -1) 
+        {
+            perror("malloc");
+            return 1;
+        }
+    }
+
+    // buyers start spread round-robin over the deques
+    for (int i = 0; i < config.buyers; i++) 
+    {
+        tasks[i].id = i;
+        tasks[i].need = config.need - spread / 2 + (spread ? (int)(rand_r(&seed) % (spread + 1)) : 0);
+        deque_push(&pool[i % nthreads].deque, &tasks[i]);
+    }
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < nthreads; i++) 
+        pthread_create(&pool[i].thread, NULL, pool_thread, &pool[i]);
+    for (int i = 0; i < nthreads; i++) 
+        pthread_join(pool[i].thread, NULL);
+    double secs = (now_ns() - t0) / 1e9;
+
+    long purchases = 0, remote = 0, steals = 0, deliveries = 0;
+    size_t samples = 0;
+    for (int i = 0; i < nthreads; i++) 
+    {
+        purchases += pool[i].purchases;
+        remote += pool[i].remote;
+        steals += pool[i].steals;
+        deliveries += pool[i].deliveries;
+        samples += pool[i].lat_count;
+    }
+
+    uint32_t *lat = malloc((samples ? samples : 1) * sizeof(uint32_t));
+    size_t off = 0;
+    for (int i = 0; i < nthreads; i++) 
+    {
+        if (lat) 
+            memcpy(lat + off, pool[i].lat, pool[i].lat_count * sizeof(uint32_t));
+        off += pool[i].lat_count;
+        free(pool[i].lat);
+        free(pool[i].deque.buf);
+    }
+    double p50 = 0, p99 = 0, p999 = 0;
+    if (lat && samples) 
+    {
+        qsort(lat, samples, sizeof(uint32_t), cmp_u32);
+        p50 = lat[samples / 2] / 1000.0;
+        p99 = lat[(size_t)(samples * 0.99)] / 1000.0;
+        p999 = lat[(size_t)(samples * 0.999)] / 1000.0;
+    }
+
+    printf("All buyers' needs were met. Completion...\n");
+    printf("threads=%d buyers=%d kiosks=%d purchases=%ld seconds=%.3f purchases_per_sec=%.0f "
+           "p50_us=%.1f p99_us=%.1f p999_us=%.1f remote=%ld steals=%ld deliveries=%ld\n",
+           nthreads, config.buyers, config.kiosks, purchases, secs,
+           secs > 0 ? purchases / secs : 0.0, p50, p99, p999, remote, steals, deliveries);
+
+    free(lat);
+    free(tasks);
+    free(pool);
+    return 0;
+}
@@ -1,41 +1,69 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
+#include <limits.h>
 #include "shop.h"
 
+// the kiosk buyers are most likely waiting on
+static int emptiest_kiosk(void) 
+{
+    int best = 0;
+    int best_goods = INT_MAX;
+    for (int i = 0; i < config.kiosks; i++) 
+    {
+        int goods = atomic_load_explicit(&kiosks[i].goods, memory_order_relaxed);
+        if (goods < best_goods) 
+        {
+            best = i;
+            best_goods = goods;
+        }
+    }
+    return best;
+}
+
 void* worker_thread(void* arg) 
 {
     (void)arg;
+    long clock = 0;
+    long deliveries = 0;
+    int handled = 0;
 
-    printf("The worker gets to work.\n");
+    if (!config.quiet) 
+        printf("The worker gets to work.\n");
 
-    while (1) 
+    for (;;) 
     {
-        pthread_testcancel(); // важно!
-
-        int index = rand() % KIOSKS;
-
-        if (pthread_mutex_trylock(&kiosks[index].mutex) == 0) 
+        // no break to take: sleep until a buyer goes hungry. All demand
+        // raised before this read is covered by the one delivery below.
+        int current = atomic_load(&demand);
+        while (current == handled && atomic_load(&buyers_done) < config.buyers) 
         {
-            kiosks[index].goods += 200;
+            shop_wait(&demand, current);
+            current = atomic_load(&demand);
+        }
+        if (atomic_load(&buyers_done) >= config.buyers) 
+            break;
+        handled = current;
 
-            printf("A worker went into the K%d kiosk and unloaded the goods. There are now %d goods there.\n",
-                   index, kiosks[index].goods);
+        int index = emptiest_kiosk();
+        // a delivery cannot leave before the demand it answers
+        clock_max(&clock, atomic_load(&demand_clock));
+        shop_rest(&clock, config.delivery_ms);
 
-            pthread_mutex_unlock(&kiosks[index].mutex);
-        }
+        atomic_store_explicit(&kiosks[index].stamp, clock, memory_order_relaxed);
+        int goods = kiosk_restock(&kiosks[index], config.restock);
+        deliveries++;
 
-        printf("The worker stepped out for a 1 second smoke break.\n");
-        sleep(1);
+        atomic_fetch_add(&restocks, 1);
+        if (atomic_load(&restock_waiters) > 0) 
+            shop_wake(&restocks, INT_MAX);
 
-        pthread_mutex_lock(&done_mutex);
-        if (buyers_done == BUYERS) 
-        {
-            pthread_mutex_unlock(&done_mutex);
-            break;
-        }
-        pthread_mutex_unlock(&done_mutex);
+        if (!config.quiet) 
+            printf("A worker went into the K%d kiosk and unloaded the goods. There are now %d goods there.\n",
+                   index, goods);
     }
 
+    if (!config.quiet) 
+        printf("The worker made %ld deliveries.\n", deliveries);
+
     return NULL;
-}
\ No newline at end of file
+}